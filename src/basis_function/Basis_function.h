@@ -26,6 +26,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 /*!
 This class represents a basis set around a single center.  
+
+The calc functions must not change the object: all the results go into
+the caller's arrays, so one basis set can be evaluated by several
+threads at once.
 */
 template <class T> class Templated_Basis_function
 {
@@ -62,6 +66,26 @@ public:
   ) =0;
 
 
+  /*!
+    \brief
+    calcLap() for n distances at once.  Each of r(0..4,k) holds one
+    component of distance k, and the results go into
+    symvals(function, [val, grad, lap], k), so that every index k is
+    contiguous.  Functions that are evaluated for many pairs override
+    this with a single loop over k.
+   */
+  virtual void calcLapMany(const Array2 <doublevar> & r, int n,
+                           Array3 <T> & symvals) {
+    int nf=nfunc();
+    Array1 <doublevar> R(5);
+    Array2 <T> lap(nf,5);
+    for(int k=0; k< n; k++) {
+      for(int d=0; d< 5; d++) R(d)=r(d,k);
+      calcLap(R,lap);
+      for(int f=0; f< nf; f++)
+        for(int d=0; d< 5; d++) symvals(f,d,k)=lap(f,d);
+    }
+  }
   virtual void calcHessian(const Array1 <doublevar> & r,
 			   Array2 <T> & symvals,
 			   //!< (func, [val,grad,d2f/dx2,d2f/dy2,d2f/dz2
@@ -153,4 +153,41 @@ void Cutoff_cusp::calcLap(
   }
 }
 
+/*!
+The same as calcLap(), for all the distances in one loop.
+*/
+void Cutoff_cusp::calcLapMany(const Array2 <doublevar> & r, int n,
+                              Array3 <doublevar> & symvals)
+{
+  int ld=r.GetDim(1), ls=symvals.GetDim(2);
+  const doublevar * r0=r.v, * x=r.v+2*ld, * y=r.v+3*ld, * z=r.v+4*ld;
+  doublevar * val=symvals.v;
+  doublevar * gx=val+ls, * gy=val+2*ls, * gz=val+3*ls, * lap=val+4*ls;
+  //local copies, since the stores could otherwise alias the members
+  const doublevar rc=rcut, rci=rcutinv, g=gamma, c=cusp, p0=pade0;
+#pragma GCC ivdep
+  for(int k=0; k< n; k++) {
+    bool inside=r0[k] < rc;
+    //outside the cutoff the form is evaluated at zz=0, where the Pade 
+    //denominator is 1, and then masked; beyond rcut 1+gamma*pp can vanish
+    doublevar zz=inside?r0[k]*rci:0.0;
+    doublevar zz2=zz*zz;
+    doublevar pp=zz-zz2+zz*zz2/3;
+    doublevar pade=1./(1+g*pp);
+    doublevar pade2=pade*pade;
+    doublevar ppd=1.-2.*zz+zz2;
+    doublevar ppdd=-2.+2.*zz;
+    doublevar dadr=ppd*pade2/r0[k];
+    doublevar dadr2=ppdd*pade2*rci
+                    -2.*g*ppd*ppd*pade2*pade*rci
+                    +2.*dadr;
+    doublevar m=inside?c:0.0;
+    val[k]=m*rc*(pp*pade-p0);
+    gx[k]=m*dadr*x[k];
+    gy[k]=m*dadr*y[k];
+    gz[k]=m*dadr*z[k];
+    lap[k]=m*dadr2;
+  }
+}
+
 //------------------------------------------------------------------------
@@ -117,4 +117,26 @@ void Exponent_cusp::calcLap(
   symvals(startfill, 4)=(2/r(0)-gamma)*exponent;
 }
 
+void Exponent_cusp::calcLapMany(const Array2 <doublevar> & r, int n,
+                                Array3 <doublevar> & symvals)
+{
+  int ld=r.GetDim(1), ls=symvals.GetDim(2);
+  const doublevar * r0=r.v, * x=r.v+2*ld, * y=r.v+3*ld, * z=r.v+4*ld;
+  doublevar * val=symvals.v;
+  doublevar * gx=val+ls, * gy=val+2*ls, * gz=val+3*ls, * lap=val+4*ls;
+  const doublevar g=gamma, c=cusp;
+#pragma GCC ivdep
+  for(int k=0; k< n; k++) {
+    doublevar reducedexp=g*r0[k];
+    reducedexp=reducedexp > 22.0?22.0:reducedexp;
+    doublevar exponent=c*exp(-reducedexp);
+    doublevar rinv=1.0/r0[k];
+    val[k]=-exponent/g;
+    gx[k]=exponent*x[k]*rinv;
+    gy[k]=exponent*y[k]*rinv;
+    gz[k]=exponent*z[k]*rinv;
+    lap[k]=(2*rinv-g)*exponent;
+  }
+}
+
 //------------------------------------------------------------------------
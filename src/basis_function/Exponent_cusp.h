@@ -69,6 +69,9 @@ public:
     const int startfill=0
   );
 
+  void calcLapMany(const Array2 <doublevar> & r, int n,
+                   Array3 <doublevar> & symvals);
+
   virtual void getVarParms(Array1 <doublevar> & parms);
   virtual void setVarParms(Array1 <doublevar> & parms);
   virtual int nparms() {
@@ -236,4 +236,43 @@ void Poly_pade_function::calcLap(
     }
 }
 
+/*!
+The same as calcLap(), for all the distances in one loop.  Past the
+cutoff, zz is set to 1, where the values and derivatives are all zero.
+*/
+void Poly_pade_function::calcLapMany(const Array2 <doublevar> & r, int n,
+                                     Array3 <doublevar> & symvals)
+{
+  int ld=r.GetDim(1), ls=symvals.GetDim(2);
+  const doublevar * r0=r.v, * x=r.v+2*ld, * y=r.v+3*ld, * z=r.v+4*ld;
+  //local copies, since the stores could otherwise alias the members
+  const doublevar rcinv=1./rcut;
+  for(int i=0; i< nmax; i++)
+  {
+    const doublevar b=beta(i), bnorm=-(b+1)*rcinv;
+    doublevar * val=symvals.v+5*i*ls;
+    doublevar * gx=val+ls, * gy=val+2*ls, * gz=val+3*ls, * lap=val+4*ls;
+#pragma GCC ivdep
+    for(int k=0; k< n; k++)
+    {
+      doublevar zz=r0[k]*rcinv;
+      zz=zz > 1.?1.:zz;
+      doublevar zz2=zz*zz;
+      doublevar zpp=zz2*(6.-8.*zz+3.*zz2);
+      doublevar zpp1=1-zpp;
+      doublevar zppd=12.*zz*(1.-2.*zz+zz2);
+      doublevar zppdd2=6.-24.*zz+18*zz2;
+      doublevar zpade=1./(1+b*zpp);
+      doublevar zpade2=zpade*zpade;
+      doublevar crsd=zppd*zpade2*bnorm/r0[k];
+      doublevar crsdd2=zpade2*(zppdd2-b*zppd*zppd*zpade)*bnorm*rcinv;
+      val[k]=zpp1*zpade;
+      gx[k]=crsd*x[k];
+      gy[k]=crsd*y[k];
+      gz[k]=crsd*z[k];
+      lap[k]=2*(crsdd2+crsd);
+    }
+  }
+}
+
 //------------------------------------------------------------------------
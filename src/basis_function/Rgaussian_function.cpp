@@ -245,4 +245,43 @@ void Rgaussian_function::calcLap(
   
 }
 
+void Rgaussian_function::calcLapMany(const Array2 <doublevar> & r, int n,
+                                     Array3 <doublevar> & symvals)
+{
+  int ld=r.GetDim(1), ls=symvals.GetDim(2);
+  const doublevar * r0=r.v, * r2=r.v+ld, * x=r.v+2*ld, * y=r.v+3*ld,
+    * z=r.v+4*ld;
+  for(int i=0; i< nmax; i++) {
+    doublevar * val=symvals.v+5*i*ls;
+    doublevar * gx=val+ls, * gy=val+2*ls, * gz=val+3*ls, * lap=val+4*ls;
+    for(int k=0; k< n; k++) {
+      val[k]=0; gx[k]=0; lap[k]=0;
+    }
+    //one term of the expansion at a time, over all the distances
+    for(int j=0; j< numExpansion(i); j++) {
+      doublevar c=gausscoeff(i,j), a=gaussexp(i,j), p=radiusexp(i,j);
+#pragma GCC ivdep
+      for(int k=0; k< n; k++) {
+        doublevar exponent=a*r2[k];
+        exponent=exponent > 60.0?60.0:exponent;
+        exponent=exp(-exponent);
+        val[k]+=c*pow(r0[k],p)*exponent;
+        gx[k]+=c*exponent*pow(r0[k],p-1)*(p-2*r2[k]*a);
+        lap[k]+=c*pow(r0[k],p-2)*(p*(p-1)-2*a*p*r2[k]
+                                  -2*(p+1)*a*r2[k]
+                                  +4*a*a*r2[k]*r2[k])*exponent;
+      }
+    }
+    //gx held the radial derivative until now
+#pragma GCC ivdep
+    for(int k=0; k< n; k++) {
+      doublevar dv=gx[k]/r0[k];
+      gx[k]=dv*x[k];
+      gy[k]=dv*y[k];
+      gz[k]=dv*z[k];
+      lap[k]+=2*dv;
+    }
+  }
+}
+
 //------------------------------------------------------------------------
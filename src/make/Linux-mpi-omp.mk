@@ -0,0 +1,17 @@
+######################################################################
+# Compiler definitions for Linux systems, MPI between nodes and 
+# OpenMP threads within a node.  Set OMP_NUM_THREADS to the number of
+# threads per MPI process.
+#  all compiler specific information should be declared here
+CXX:=mpicxx 
+
+CXXFLAGS:= -O3 -fomit-frame-pointer -funroll-loops -ffast-math -fopenmp
+CXXFLAGS += -DUSE_MPI $(INCLUDEPATH)
+
+#DEBUG := -Wall  -DRANGE_CHECKING -DDEBUG_WRITE
+DEBUG:= -Wall -DNO_RANGE_CHECKING   -DNDEBUG 
+
+
+######################################################################
+# This is the invokation to generate dependencies
+DEPENDMAKER:=g++ -MM  $(INCLUDEPATH)
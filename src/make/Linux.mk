@@ -12,7 +12,7 @@ CXXFLAGS := -O3  \
 
 
 DEBUG:= -Wall -DNO_RANGE_CHECKING -DNDEBUG    -DDEBUG_WRITE
-LDFLAGS:= 
+LDFLAGS:= -pthread
 
 HDF_LIBS:=-L/opt/hdf5-1.8.5/lib -lhdf5
 HDF_INCLUDE:=-I/opt/hdf5-1.8.5/include
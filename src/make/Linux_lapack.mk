@@ -14,7 +14,7 @@ BLAS_LIBS :=  $(LAPACK_LIBS)
 BLAS_INCLUDE := $(LAPACK_INCLUDE) 
 
 DEBUG:= -Wall -DNO_RANGE_CHECKING -DNDEBUG   -D__USE_GNU -DDEBUG_WRITE
-LDFLAGS:= 
+LDFLAGS:= -pthread
 
 ######################################################################
 # This is the invokation to generate dependencies
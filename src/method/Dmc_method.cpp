@@ -132,12 +132,20 @@ void Dmc_method::read(vector <string> words,
     avg_words.push_back(tmp_dens);
   }
   
-  vector <string> dynamics_words;
+  dynamics_words.clear();
   if(!readsection(words, pos=0, dynamics_words, "DYNAMICS") ) 
     dynamics_words.push_back("SPLIT");
 
   low_io=0;
   if(haskeyword(words, pos=0,"LOW_IO")) low_io=1;
+  text_config=haskeyword(words, pos=0,"TEXT_CONFIG");
+
+  //Keep each walker's wave function state in memory, so it doesn't
+  //have to be recalculated every time we switch walkers.
+  if(!readvalue(words, pos=0, cache_wf_memory, "CACHE_WF_MEMORY"))
+    cache_wf_memory=0;
+  if(cache_wf_memory < 0) 
+    error("CACHE_WF_MEMORY must be positive");
   
   allocate(dynamics_words, dyngen);
   dyngen->enforceNodes(1);
@@ -190,7 +198,8 @@ int Dmc_method::generateVariables(Program_options & options) {
 
 
 int Dmc_method::allocateIntermediateVariables(System * sys,
-                                              Wavefunction_data * wfdata) {
+                                              Wavefunction_data * wfdata,
+                                              Pseudopotential * pseudo) {
   if(wf) delete wf;
   wf=NULL;
   if(sample) delete sample;
@@ -218,6 +227,11 @@ int Dmc_method::allocateIntermediateVariables(System * sys,
     allocate(avg_words[i], sys, wfdata, average_var(i));
   }
   
+  threads.allocate(sys, wfdata, pseudo, sample, wf, dyngen, average_var,
+                   dynamics_words, avg_words);
+  threads.allocateDensities(densplt);
+  for(int t=0; t< threads.nthreads(); t++) 
+    threads.dyngen(t)->enforceNodes(1);
 
   return 1;
 }
@@ -235,6 +249,8 @@ int Dmc_method::showinfo(ostream & os)
   os << "###########################################################\n";
   os << "Diffusion Monte Carlo:\n";
   os << "Number of processors " <<           mpi_info.nprocs << endl;
+  if(qmc_nthreads() > 1)
+    os << "Threads per processor " <<        qmc_nthreads() << endl;
   os << "Blocks: " <<                        nblock    << endl;
   os << "Steps per block: " <<               nstep     << endl;
   os << "Timestep: " <<                      timestep  << endl;
@@ -242,6 +258,8 @@ int Dmc_method::showinfo(ostream & os)
     os << "T-moves turned on" << endl;
   if(tmoves_sizeconsistent)
     os << "Size-consistent T-moves turned on" << endl;
+  if(cache_wf_memory > 0) 
+    os << "Wave function cache: " << cache_wf_memory << " MB" << endl;
 
   string indent="  ";
 
@@ -332,7 +350,22 @@ void Dmc_method::runWithVariables(Properties_manager & prop,
                                   ostream & output)
 {
 
-  allocateIntermediateVariables(sys, wfdata);
+  allocateIntermediateVariables(sys, wfdata, pseudo);
+  seed_thread_rng();
+  nbranch=0;
+  branch_pending=0;
+#ifdef USE_MPI
+  //The branching is done on every process, with the same random numbers.
+  if(mpi_info.nprocs > 1) { 
+    long int branch_seed[2];
+    if(mpi_info.node==0) { 
+      branch_seed[0]=long(rng.ulec()*2147483500)+1;
+      branch_seed[1]=long(rng.ulec()*2147483300)+1;
+    }
+    MPI_Bcast(branch_seed,2,MPI_LONG,0,MPI_Comm_grp);
+    branch_rng.seed(branch_seed[0],branch_seed[1]);
+  }
+#endif
   if(!wfdata->supports(laplacian_update))
     error("DMC doesn't support all-electron moves..please"
           " change your wave function to use the new Jastrow");
@@ -347,6 +380,39 @@ void Dmc_method::runWithVariables(Properties_manager & prop,
   restorecheckpoint(readconfig, sys, wfdata, pseudo);
   prop.initializeLog(average_var);
 
+  //Find out how much the wave function state of a walker takes, and
+  //how many walkers we can fit into the cache.
+  clearWfState();
+  wfstate.Resize(nconfig);
+  wfstate=NULL;
+  samplestate.Resize(nconfig);
+  samplestate=NULL;
+  if(cache_wf_memory > 0) { 
+    pts(0).config_pos.restorePos(sample);
+    wf->updateLap(wfdata, sample);
+    int bytes=wf->saveState(wfstate(0));
+    if(bytes > 0) { 
+      bytes+=sample->saveState(samplestate(0));
+      ncache_walkers=min(nconfig, int(cache_wf_memory*1024*1024/bytes));
+    }
+    if(ncache_walkers==0 && wfstate(0)) { 
+      delete wfstate(0);
+      wfstate(0)=NULL;
+    }
+    if(ncache_walkers==0 && samplestate(0)) { 
+      delete samplestate(0);
+      samplestate(0)=NULL;
+    }
+    if(output) { 
+      if(bytes > 0) 
+        output << "Caching the wave function of " << ncache_walkers 
+               << " walkers (" << bytes << " bytes each)" << endl;
+      else 
+        output << "This wave function doesn't support caching; "
+               << "recalculating it for each walker" << endl;
+    }
+  }
+
   //MB: new properties manager for forward walking (one per each length)
   Array1 <Properties_manager> prop_fw;
   prop_fw.Resize(fw_length.GetSize());
@@ -385,72 +451,114 @@ void Dmc_method::runWithVariables(Properties_manager & prop,
       
       doublevar avg_acceptance=0;
       
-      for(int walker=0; walker < nconfig; walker++) {
-        pts(walker).config_pos.restorePos(sample);
-        wf->updateLap(wfdata, sample);
+      //Each thread moves its walkers with its own copies of the sample,
+      //wave function, and dynamics.  The averages are accumulated
+      //afterwards in walker order, so the properties don't depend on 
+      //the number of threads.
+      step_pts.Resize(nconfig,npsteps);
+      //The walkers that were copied here in the last branching are moved
+      //while the ones from other processes are still on their way.
+      int nlocal=branch_pending?branch_transfer.ncopied:nconfig;
+      for(int part=0; part < 2; part++) { 
+        int wstart=(part==0)?0:nlocal;
+        int wend=(part==0)?nlocal:nconfig;
+        if(part==1) finishBranch();
+        //Static schedule, as in VMC: without RANDOM_STREAMS each thread
+        //draws its own sequence, so the walkers have to go to the same 
+        //threads every run for the results to be reproducible.
+#pragma omp parallel for schedule(static) reduction(+:acsum,totpoints)
+        for(int walker=wstart; walker < wend; walker++) {
+          int t=qmc_thread_id();
+          System * tsys=threads.sys(t);
+          Pseudopotential * tpseudo=threads.pseudo(t);
+          Sample_point * tsample=threads.sample(t);
+          Wavefunction * twf=threads.wf(t);
+        
+          pts(walker).config_pos.restorePos(tsample);
+          if(samplestate(walker)) tsample->restoreState(samplestate(walker));
+          if(wfstate(walker)) twf->restoreState(wfstate(walker));
+          else twf->updateLap(wfdata, tsample);
 	//------Do several steps without branching
-        for(int p=0; p < npsteps; p++) {
-          pseudo->randomize();
-          if(all_electron_moves) move_all_electron(wfdata,wf,sample,guidingwf,pts(walker),acsum);
-          else move_electron_by_electron(wfdata,wf,sample,guidingwf,pts(walker),acsum);
-          totpoints++;
-          Properties_point pt;
-          if(tmoves or tmoves_sizeconsistent) {  //------------------T-moves
-            doTmove(pt,pseudo,sys,wfdata,wf,sample,guidingwf);
-          } ///---------------------------------done with the T-moves
-          else {
-            mygather.gatherData(pt, pseudo, sys, wfdata, wf, 
-                                sample, guidingwf);
-          }
-          Dmc_history new_hist;
-          new_hist.main_en=pts(walker).prop.energy(0);
-          pts(walker).past_energies.push_front(new_hist);
-          deque<Dmc_history> & past(pts(walker).past_energies);
-          if(past.size() > nhist) 
-            past.erase(past.begin()+nhist, past.end());
+          for(int p=0; p < npsteps; p++) {
+            rng.setStream(pts(walker).walker_id, block*nstep+step+p);
+            tpseudo->randomize();
+            if(all_electron_moves) move_all_electron(wfdata,twf,tsample,guidingwf,pts(walker),acsum);
+            else move_electron_by_electron(wfdata,twf,tsample,guidingwf,
+                                           threads.dyngen(t),pts(walker),acsum);
+            totpoints++;
+            Properties_point pt;
+            if(tmoves or tmoves_sizeconsistent) {  //------------------T-moves
+              doTmove(pt,tpseudo,tsys,wfdata,twf,tsample,guidingwf);
+            } ///---------------------------------done with the T-moves
+            else {
+              mygather.gatherData(pt, tpseudo, tsys, wfdata, twf, 
+                                  tsample, guidingwf);
+            }
+            Dmc_history new_hist;
+            new_hist.main_en=pts(walker).prop.energy(0);
+            pts(walker).past_energies.push_front(new_hist);
+            deque<Dmc_history> & past(pts(walker).past_energies);
+            if(past.size() > nhist) 
+              past.erase(past.begin()+nhist, past.end());
           
-          pts(walker).prop=pt;
-          if(!pure_dmc) { 
-            pts(walker).weight*=getWeight(pts(walker),teff,etrial);
-            //Introduce a small bias to avoid instability.
-            if(pts(walker).weight>max_poss_weight) pts(walker).weight=max_poss_weight;
-          }
-          else
-            pts(walker).weight=getWeightPURE_DMC(pts(walker),teff,etrial);
+            pts(walker).prop=pt;
+            if(!pure_dmc) { 
+              pts(walker).weight*=getWeight(pts(walker),teff,etrial);
+              //Introduce a small bias to avoid instability.
+              if(pts(walker).weight>max_poss_weight) pts(walker).weight=max_poss_weight;
+            }
+            else
+              pts(walker).weight=getWeightPURE_DMC(pts(walker),teff,etrial);
           
-          if(pts(walker).ignore_walker) {
-            pts(walker).ignore_walker=0;
-            pts(walker).weight=1;
-            pts(walker).prop.count=0;
+            if(pts(walker).ignore_walker) {
+              pts(walker).ignore_walker=0;
+              pts(walker).weight=1;
+              pts(walker).prop.count=0;
+            }
+            pts(walker).prop.weight=pts(walker).weight;
+            //This is somewhat inaccurate..will need to change it later
+            //For the moment, the autocorrelation will be slightly
+            //underestimated
+            pts(walker).prop.parent=walker;
+            pts(walker).prop.nchildren=1;
+            pts(walker).prop.children(0)=walker;
+            pts(walker).prop.avgrets.Resize(1,average_var.GetDim(0));
+            for(int i=0; i< average_var.GetDim(0); i++) { 
+              threads.average_var(t,i)->randomize(wfdata,twf,tsys,tsample);
+              threads.average_var(t,i)->evaluate(wfdata, twf, tsys, tpseudo, tsample, pts(walker).prop, pts(walker).prop.avgrets(0,i));
+            }
+            step_pts(walker,p)=pts(walker).prop;
+            for(int i=0; i< densplt.GetDim(0); i++)
+              threads.densplt(t,i)->accumulate(tsample,pts(walker).prop.weight(0));
+            //the nonlocal densities have no per-thread copies
+            if(nldensplt.GetDim(0)) { 
+#pragma omp critical(dmc_density)
+              for(int i=0; i< nldensplt.GetDim(0); i++)
+                nldensplt(i)->accumulate(tsample,pts(walker).prop.weight(0),
+                                         wfdata,twf);
+            }
           }
-          pts(walker).prop.weight=pts(walker).weight;
-          //This is somewhat inaccurate..will need to change it later
-          //For the moment, the autocorrelation will be slightly
-          //underestimated
-          pts(walker).prop.parent=walker;
-          pts(walker).prop.nchildren=1;
-          pts(walker).prop.children(0)=walker;
-          pts(walker).prop.avgrets.Resize(1,average_var.GetDim(0));
-          for(int i=0; i< average_var.GetDim(0); i++) { 
-            average_var(i)->randomize(wfdata,wf,sys,sample);
-            average_var(i)->evaluate(wfdata, wf, sys, pseudo, sample, pts(walker).prop, pts(walker).prop.avgrets(0,i));
+
+          rng.endStream();
+          pts(walker).config_pos.savePos(tsample);
+          if(walker < ncache_walkers) { 
+            twf->saveState(wfstate(walker));
+            tsample->saveState(samplestate(walker));
           }
-          prop.insertPoint(step+p, walker, pts(walker).prop);
-          for(int i=0; i< densplt.GetDim(0); i++)
-            densplt(i)->accumulate(sample,pts(walker).prop.weight(0));
-          for(int i=0; i< nldensplt.GetDim(0); i++)
-            nldensplt(i)->accumulate(sample,pts(walker).prop.weight(0),
-                                     wfdata,wf);
-          
-          
+        }
+      }
+      //The weights are final, so they can be on their way while we do the
+      //averages.
+      if(!pure_dmc) startBranch();
+      
+      for(int walker=0; walker < nconfig; walker++) { 
+        for(int p=0; p < npsteps; p++) { 
+          prop.insertPoint(step+p, walker, step_pts(walker,p));
           //MB: making the history of prop.avgrets for forward walking
           if(max_fw_length){
-            forwardWalking(walker, step+p,prop_fw);
+            forwardWalking(walker, step+p,step_pts(walker,p),prop_fw);
           }//if FW
-          
         }
-
-        pts(walker).config_pos.savePos(sample);
       }
       //---Finished moving all walkers
 
@@ -472,7 +580,11 @@ void Dmc_method::runWithVariables(Properties_manager & prop,
       totbranch+=nkilled;
     }
 
+    finishBranch();
+
     ///----Finished block
+    threads.reduceDensities();
+    threads.reduceStats();
     
     if(!low_io || block==nblock-1) {
       savecheckpoint(storeconfig,sample);
@@ -550,6 +662,7 @@ void Dmc_method::runWithVariables(Properties_manager & prop,
     }
     dyngen->resetStats();
   }
+  checkpoint_writer.wait();
   
   if(output) {
     output << "\n ----------Finished DMC------------\n\n";
@@ -575,12 +688,13 @@ void Dmc_method::move_electron_by_electron(Wavefunction_data * wfdata,
                                            Wavefunction * wf, 
                                            Sample_point * sample,
                                            Guiding_function * guidingwf,
+                                           Dynamics_generator * sampler,
                                            Dmc_point & pt,
                                            doublevar & acsum) { 
   Dynamics_info dinfo;
   for(int e=0; e< nelectrons; e++) {
     int acc;
-    acc=dyngen->sample(e, sample, wf, wfdata, guidingwf,
+    acc=sampler->sample(e, sample, wf, wfdata, guidingwf,
         dinfo, timestep);
 
     if(dinfo.accepted) {               
@@ -683,43 +797,19 @@ void Dmc_method::savecheckpoint(string & filename,
                                  Sample_point * config) {
 
   if(save_trace!="") { 
-    if(mpi_info.node==0) { 
-      cout << "entering trace write" << endl;
-      long int time_ent=clock();
-      FILE * f=fopen(save_trace.c_str(),"a");
-      for(int i=0;i<nconfig; i++) {
-        pts(i).config_pos.writeBinary(f,pts(i).weight);
-      //  fwrite(&pts(i).weight, sizeof(doublevar),1, f);
-      }
-
-#ifdef USE_MPI
-      Dmc_point tmppt;
-      for(int p=1; p < mpi_info.nprocs; p++) { 
-        int nconfigthis;
-        MPI_Recv(nconfigthis,p);
-        for(int i=0; i < nconfigthis; i++) { 
-          tmppt.config_pos.mpiReceive(p);
-          MPI_Recv(tmppt.weight,p);
-          tmppt.config_pos.writeBinary(f,tmppt.weight);
-        }
-      }
-#endif
-      long int time_b=clock();
-      single_write(cout,"writing to trace : ",double(time_b-time_ent)/CLOCKS_PER_SEC,"\n");
-      fclose(f);
-    }
-#ifdef USE_MPI
-    else { 
-      MPI_Send(nconfig,0);
-      for(int i=0; i< nconfig; i++) { 
-        pts(i).config_pos.mpiSend(0);
-        MPI_Send(pts(i).weight,0);
-      }
-    }
-#endif
+    single_write(cout,"entering trace write\n");
+    long int time_ent=clock();
+    vector <doublevar> trace;
+    for(int i=0;i<nconfig; i++) 
+      pts(i).config_pos.packBinary(trace,pts(i).weight);
+    parallel_append(save_trace,trace);
+    long int time_b=clock();
+    single_write(cout,"writing to trace : ",double(time_b-time_ent)/CLOCKS_PER_SEC,"\n");
   }
   if(filename=="") return;
-  write_configurations(filename, pts);
+  for(int i=0; i< nconfig; i++) pts(i).stream_epoch=stream_epoch;
+  if(text_config) write_configurations(filename, pts, checkpoint_writer);
+  else write_binary_configurations(filename, pts, checkpoint_writer);
 
 
   return;
@@ -747,16 +837,37 @@ void Dmc_method::restorecheckpoint(string & filename, System * sys,
       pts(i).config_pos=configs(i);
   }
   int ncread=pts.GetDim(0);
-  
-  //cout << "ncread " << ncread << "  nwread " << nwread << endl;
-  if(nconfig < ncread) { 
-    Array1 <Dmc_point> tmp_pts(nconfig);
-    for(int i=0; i< nconfig; i++) tmp_pts(i)=pts(i);
-    pts=tmp_pts;
+  long int ntot;
+  long int first=parallel_prefix_sum(ncread,ntot);
+  if(ntot==0) error("No configurations in ", filename);
+
+  //Walkers keep their ids from the file, and new ones are numbered after 
+  //the largest id on any process.  The random streams start a run after
+  //the one that wrote the file, so a restart doesn't repeat its numbers.
+  long int maxid=-1, maxepoch=0;
+  for(int i=0; i< ncread; i++) { 
+    maxid=max(maxid,pts(i).walker_id);
+    maxepoch=max(maxepoch,long(pts(i).stream_epoch));
   }
-  else if(nconfig > ncread) { 
-    error("Not enough configurations in ", filename);
+  next_walker_id=parallel_max(maxid)+1;
+  for(int i=0; i< ncread; i++) 
+    if(pts(i).walker_id < 0) pts(i).walker_id=next_walker_id+first+i;
+  next_walker_id+=ntot;
+  stream_epoch=Random_generator::newStreamEpoch(parallel_max(maxepoch));
+
+  //The file can come from a run with a different number of walkers or 
+  //processes.  Each process then has its share of the file, which may not
+  //be nconfig walkers.
+  if(ntot != long(nconfig)*mpi_info.nprocs) { 
+    stringstream warn;
+    warn << "Warning: " << filename << " has " << ntot << " walkers, but "
+         << "this run has " << nconfig*mpi_info.nprocs << ". Resampling them "
+         << "by weight.\n";
+    single_write(cout,warn.str());
+    resampleWalkers();
   }
+  else if(ncread != nconfig) 
+    error("Dmc_method: expected ", nconfig, " walkers on this process");
 
   for(int walker=0; walker < nconfig; walker++) {
     pts(walker).config_pos.restorePos(sample);
@@ -905,12 +1016,13 @@ void Dmc_method::doTmove(Properties_point & pt,Pseudopotential * pseudo, System
 
 }
 //----------------------------------------------------------------------
-void Dmc_method::forwardWalking(int walker, int step, Array1<Properties_manager> & prop_fw) {
+void Dmc_method::forwardWalking(int walker, int step, Properties_point & pt,
+                                Array1<Properties_manager> & prop_fw) {
   
   //store the observables
   Dmc_history_avgrets new_avgrets;
-  new_avgrets.avgrets=pts(walker).prop.avgrets;
-  new_avgrets.weight=pts(walker).prop.weight(0);
+  new_avgrets.avgrets=pt.avgrets;
+  new_avgrets.weight=pt.weight(0);
   
   
   pts(walker).past_properties.push_front(new_avgrets);
@@ -926,305 +1038,448 @@ void Dmc_method::forwardWalking(int walker, int step, Array1<Properties_manager>
   doublevar oldweight;
   for(int s=0;s<fw_length.GetSize();s++){
     if(fw_length(s)>size){
-      pts(walker).prop.avgrets=pts(walker).past_properties[size-1].avgrets;
+      pt.avgrets=pts(walker).past_properties[size-1].avgrets;
       oldweight=pts(walker).past_properties[size-1].weight;
     }
     else{
       //call the prop.avgrets from fw_length(s) steps a go
-      pts(walker).prop.avgrets=pts(walker).past_properties[fw_length(s)-1].avgrets;
+      pt.avgrets=pts(walker).past_properties[fw_length(s)-1].avgrets;
       oldweight=pts(walker).past_properties[fw_length(s)-1].weight;
     }
     
     //insert it into observables
-    prop_fw(s).insertPoint(step, walker, pts(walker).prop);
+    prop_fw(s).insertPoint(step, walker, pt);
   }
 }
 
 
 //----------------------------------------------------------------------
 //Auxilliary functions for branching
-struct Queue_element {
-  int from_node;
-  int to_node;
-  Queue_element() { }
-  Queue_element(int from, int to) { from_node=from; to_node=to; }
-};
-
-struct weight_obj {
-  double w;
-  int i;
-};
-
-bool operator<(const weight_obj & a,const weight_obj & b) {
-  return a.w < b.w;
+
+/*!
+Every process has to end up with nconfig walkers.  The ones with too
+many walkers (nwalkers(n) > nconfig) send their extra ones to the ones
+with too few.  The extra walkers and the empty slots are both numbered
+by a prefix sum over the processes, and extra walker number i goes to
+empty slot number i.  Each process computes the plan from nwalkers
+alone, so there is no need to communicate it.
+*/
+void plan_migration(Array1 <int> & nwalkers, int nconfig, int node, 
+                    vector <Migration> & sends, vector <Migration> & recvs) { 
+  int nprocs=nwalkers.GetDim(0);
+  Array1 <int> surplus_start(nprocs+1), deficit_start(nprocs+1);
+  surplus_start(0)=0;
+  deficit_start(0)=0;
+  for(int n=0; n< nprocs; n++) { 
+    surplus_start(n+1)=surplus_start(n)+max(nwalkers(n)-nconfig,0);
+    deficit_start(n+1)=deficit_start(n)+max(nconfig-nwalkers(n),0);
+  }
+  if(surplus_start(nprocs)!=deficit_start(nprocs)) 
+    error("DMC branching changed the total number of walkers");
+
+  sends.clear();
+  recvs.clear();
+  //overlap of this process's range with the others' ranges, in order
+  for(int n=0; n< nprocs; n++) { 
+    int nsend=min(surplus_start(node+1),deficit_start(n+1))
+      -max(surplus_start(node),deficit_start(n));
+    if(nsend > 0) sends.push_back(Migration(n,nsend));
+    int nrecv=min(deficit_start(node+1),surplus_start(n+1))
+      -max(deficit_start(node),surplus_start(n));
+    if(nrecv > 0) recvs.push_back(Migration(n,nrecv));
+  }
 }
-void match_walkers(Array1<double> & weights, Array1 <int> & branch) {
-  const double split_threshold=1.8;
-  branch=-1;
-  int totwalkers=weights.GetDim(0);
-  Array1<weight_obj> walkers(totwalkers);
-  for(int i=0; i< totwalkers; i++) {
-    walkers(i).w=weights(i);
-    walkers(i).i=i;
+
+//! How many of the teeth at (k+offset)*spacing, k=0..totwalkers-1, are below x
+static int comb_teeth(doublevar x, doublevar spacing, doublevar offset, 
+                      int totwalkers) { 
+  return max(0,min(totwalkers,int(ceil(x/spacing-offset))));
+}
+
+/*!
+The walkers of all the processes are laid end to end by weight, and each 
+new walker is a tooth of a comb with the average weight as spacing, so 
+each walker gets as many copies as there are teeth on its stretch.  Each 
+process only needs the weight before its own walkers.  The processes 
+agree on where their stretches meet by sharing the number of teeth 
+before each of them, so the copies add up to totwalkers however the sums
+round.
+*/
+void Dmc_method::combWalkers(doublevar start, doublevar totweight, 
+                             doublevar offset, Array1 <int> & my_branch,
+                             Array1 <int> & nwalkers, 
+                             Array1 <long int> & first_newid) { 
+  int nold=pts.GetDim(0);
+  int nprocs=mpi_info.nprocs;
+  int totwalkers=nprocs*nconfig;
+  doublevar spacing=totweight/totwalkers;
+  int first=comb_teeth(start,spacing,offset,totwalkers);
+  Array1 <int> firsts(nprocs+1);
+  firsts(mpi_info.node)=first;
+#ifdef USE_MPI
+  MPI_Allgather(&first,1,MPI_INT,firsts.v,1,MPI_INT,MPI_Comm_grp);
+#endif
+  firsts(0)=0;
+  firsts(nprocs)=totwalkers;
+  for(int n=1; n< nprocs; n++) firsts(n)=max(firsts(n),firsts(n-1));
+  nwalkers.Resize(nprocs);
+  for(int n=0; n< nprocs; n++) nwalkers(n)=firsts(n+1)-firsts(n);
+
+  my_branch.Resize(nold);
+  int below=firsts(mpi_info.node);
+  int last=firsts(mpi_info.node+1);
+  doublevar upper=start;
+  long int nextra=0;
+  for(int i=0; i< nold; i++) { 
+    upper+=pts(i).weight;
+    int nupper=last;
+    if(i < nold-1) 
+      nupper=min(last,max(below,comb_teeth(upper,spacing,offset,totwalkers)));
+    my_branch(i)=nupper-below;
+    if(my_branch(i) > 1) nextra+=my_branch(i)-1;
+    below=nupper;
   }
-  sort(walkers.v,walkers.v+totwalkers);
-  int currsmallest=0;
-  for(int i=totwalkers-1; i > 1; i--) { 
-    if(walkers(i).w < split_threshold) break;
-    int w=walkers(i).i;
-    int smallest=walkers(currsmallest).i;
-    double weight1=weights(w)/(weights(w)+weights(smallest));
-    if(weight1+rng.ulec() >= 1.0) { 
-      branch(w)=2;
-      branch(smallest)=0;
-      weights(w)+=weights(smallest);
-      weights(w)/=2.0;
-    }
-    else { 
-      branch(w)=0;
-      branch(smallest)=2;
-      weights(smallest)+=weights(w);
-      weights(smallest)/=2.0;
-    }
-    currsmallest++;
+
+  //new ids for the extra copies, numbered in the order of the walkers
+  long int totextra;
+  long int newid=next_walker_id+parallel_prefix_sum(nextra,totextra);
+  next_walker_id+=totextra;
+  first_newid.Resize(nold);
+  for(int i=0; i< nold; i++) { 
+    first_newid(i)=newid;
+    if(my_branch(i) > 1) newid+=my_branch(i)-1;
   }
-  //for(int i=0; i< totwalkers; i++) {
-  //  cout << walkers(i).w << endl;
-  //}
+}
+
+//----------------------------------------------------------------------
+
+//MPI_Iexscan and MPI_Iallreduce are new in MPI-3; before that the weight 
+//sums are taken in calcBranch().
+#if defined(USE_MPI) && MPI_VERSION >= 3
+#define DMC_NONBLOCKING_BRANCH
+#endif
 
+void Dmc_method::startBranch() { 
+  branch_weight=0;
+  for(int walker=0; walker < nconfig; walker++)
+    branch_weight+=pts(walker).weight;
+#ifdef DMC_NONBLOCKING_BRANCH
+  MPI_Iexscan(&branch_weight,&branch_start,1,MPI_DOUBLE,MPI_SUM,
+              MPI_Comm_grp,&branch_requests[0]);
+  MPI_Iallreduce(&branch_weight,&branch_total,1,MPI_DOUBLE,MPI_SUM,
+                 MPI_Comm_grp,&branch_requests[1]);
+#endif
 }
 
 //----------------------------------------------------------------------
 
 int Dmc_method::calcBranch() { 
-  int totwalkers=mpi_info.nprocs*nconfig;
-  Array1 <doublevar> weights(totwalkers);
-  Array1 <doublevar> my_weights(nconfig);
-  
-  for(int walker=0; walker < nconfig; walker++)
-    my_weights(walker)=pts(walker).weight;
-#ifdef USE_MPI
-  MPI_Allgather(my_weights.v,nconfig, MPI_DOUBLE, weights.v,nconfig,MPI_DOUBLE, MPI_Comm_grp);
+#ifdef DMC_NONBLOCKING_BRANCH
+  MPI_Waitall(2,branch_requests,MPI_STATUSES_IGNORE);
+  if(mpi_info.node==0) branch_start=0; //MPI_Iexscan leaves it undefined
 #else
-  weights=my_weights;
+  branch_start=parallel_prefix_sum(branch_weight,branch_total);
 #endif
-  Array1 <int> my_branch(nconfig);
-  Array1 <int> nwalkers(mpi_info.nprocs);
-  nwalkers=0;
-  int root=0;
-  if(mpi_info.node==root) {  //this if/else clause may be refactored out
-
-    Array1 <int> branch(totwalkers);
-    //----Find which walkers branch/die
-    //we do it on one node since otherwise we'll have different random numbers!
-    //we'll assign the weight for each copy that will be produced
-    //this is the core of the branching algorithm..
-    //my homegrown algo, based on Umrigar, Nightingale, and Runge
-    branch=-1;
-
-    long int time_a=clock();
-    match_walkers(weights,branch);
-    long int time_b=clock();
-    single_write(cout,"matching: ",double(time_b-time_a)/CLOCKS_PER_SEC,"\n");
-    for(int w=0; w< totwalkers; w++) {
-      if(branch(w)==-1) branch(w)=1;
+
+  //The comb is offset by the same random number on every process.
+  Random_generator & brng=(mpi_info.nprocs > 1)?branch_rng:rng;
+  brng.setStream(Random_generator::reservedStream(1),nbranch++);
+  doublevar offset=brng.ulec();
+  brng.endStream();
+
+  Array1 <int> my_branch, nwalkers;
+  Array1 <long int> first_newid;
+  combWalkers(branch_start, branch_total, offset, my_branch, nwalkers,
+              first_newid);
+  doublevar newweight=branch_total/(mpi_info.nprocs*nconfig);
+  int killsize=0;
+  for(int i=0; i< nconfig; i++) {
+    pts(i).weight=newweight;
+    if(my_branch(i)==0) killsize++;
+  }
+  Array1 <int> source; //the walker each one is copied from; -1 if it's received
+  startCopyWalkers(my_branch, nwalkers, first_newid, source, branch_transfer);
+
+  //The cached wave functions and sample point sums follow their walkers.  
+  //The first copy takes over the parent's state and the others get a clone of it.
+  //This only needs the local copies, so it's done while the walkers 
+  //from other processes are on their way.
+  if(ncache_walkers > 0) { 
+    Array1 <Wavefunction_storage *> oldstate(nconfig);
+    Array1 <Sample_state *> oldsample(nconfig);
+    Array1 <int> taken(nconfig);
+    taken=0;
+    for(int i=0; i< nconfig; i++) { 
+      oldstate(i)=wfstate(i);
+      wfstate(i)=NULL;
+      oldsample(i)=samplestate(i);
+      samplestate(i)=NULL;
     }
-    //----end homegrown algo
-    //count how many walkers each node will have
-    //without balancing
-    int walk=0;
-    for(int n=0; n< mpi_info.nprocs; n++) { 
-      for(int i=0; i< nconfig; i++) {
-        nwalkers(n)+=branch(walk);
-        walk++;
+    for(int i=0; i< ncache_walkers; i++) { 
+      int s=source(i);
+      if(s >= 0 && oldstate(s) && !taken(s)) { 
+        wfstate(i)=oldstate(s);
+        samplestate(i)=oldsample(s);
+        taken(s)=1;
       }
-      //cout << "nwalkers " << n << " " << nwalkers(n) << endl;
     }
-    //now send nwalkers and which to branch to all processors
-    for(int i=0; i< nconfig; i++) { 
-      my_branch(i)=branch(i);
-      my_weights(i)=weights(i);
+    for(int i=0; i< ncache_walkers; i++) { 
+      int s=source(i);
+      if(s >= 0 && oldstate(s) && !wfstate(i)) { 
+        wf->restoreState(oldstate(s));
+        wf->saveState(wfstate(i));
+        if(oldsample(s)) { 
+          sample->restoreState(oldsample(s));
+          sample->saveState(samplestate(i));
+        }
+      }
     }
-    time_a=clock();
-#ifdef USE_MPI
-    MPI_Bcast(nwalkers.v, mpi_info.nprocs, MPI_INT, mpi_info.node, MPI_Comm_grp);
-    for(int i=1; i< mpi_info.nprocs; i++) {
-      MPI_Send(branch.v+i*nconfig,nconfig,MPI_INT,i,0,MPI_Comm_grp);
-      MPI_Send(weights.v+i*nconfig, nconfig, MPI_DOUBLE, i,0,MPI_Comm_grp);
+    for(int i=0; i< nconfig; i++) { 
+      if(oldstate(i) && !taken(i)) delete oldstate(i);
+      if(oldsample(i) && !taken(i)) delete oldsample(i);
     }
-#endif
-    time_b=clock();
-    single_write(cout,"sending branch: ",double(time_b-time_a)/CLOCKS_PER_SEC,"\n");
-
-               
   }
-  else { 
-#ifdef USE_MPI
-    MPI_Bcast(nwalkers.v, mpi_info.nprocs, MPI_INT, root, MPI_Comm_grp);
-    MPI_Status status;
-    MPI_Recv(my_branch.v,nconfig, MPI_INT,root,0,MPI_Comm_grp, &status);
-    MPI_Recv(my_weights.v,nconfig, MPI_DOUBLE,root,0,MPI_Comm_grp, &status);
-#endif	
+
+  branch_pending=1;
+  return killsize;
+}
+
+//----------------------------------------------------------------------
+
+void Dmc_method::finishBranch() { 
+  if(branch_pending) { 
+    finishCopyWalkers(branch_transfer);
+    branch_pending=0;
   }
-  //--end if/else clause
+}
+//----------------------------------------------------------------------
 
+void Dmc_method::resampleWalkers() { 
+  int nold=pts.GetDim(0);
+  doublevar myweight=0;
+  for(int i=0; i< nold; i++) myweight+=pts(i).weight;
+  doublevar totweight;
+  doublevar start=parallel_prefix_sum(myweight,totweight);
+  //The new walkers all get the average weight of the old ones.
+  long int nread;
+  parallel_prefix_sum(long(nold),nread);
+  doublevar newweight=totweight/nread;
+
+  Array1 <int> my_branch, nwalkers;
+  Array1 <long int> first_newid;
+  combWalkers(start, totweight, 0.5, my_branch, nwalkers, first_newid);
+  for(int i=0; i< nold; i++) pts(i).weight=newweight;
+
+  Array1 <int> source;
+  Dmc_transfer transfer;
+  startCopyWalkers(my_branch, nwalkers, first_newid, source, transfer);
+  finishCopyWalkers(transfer);
+}
+
+//----------------------------------------------------------------------
+
+void Dmc_method::startCopyWalkers(Array1 <int> & my_branch, 
+                                  Array1 <int> & nwalkers,
+                                  Array1 <long int> & first_newid, 
+                                  Array1 <int> & source,
+                                  Dmc_transfer & transfer) { 
   long int time_a=clock();
-  for(int i=0; i< nconfig; i++) { 
-    pts(i).weight=my_weights(i);
-  }
+  int nold=pts.GetDim(0);
+  vector <Migration> sends;
+  plan_migration(nwalkers, nconfig, mpi_info.node, sends, transfer.recvs);
+  //the copies we keep go first, and the rest are sent
+  int nlocal=min(nwalkers(mpi_info.node),nconfig);
   
-  //Now we all have my_branch and nwalkers..we need to figure out who 
-  //needs to send walkers to whom--after this, nwalkers should be a flat array equal to 
-  //nconfig(so don't try to use it for anything useful afterwards)
-  vector <Queue_element> send_queue;
-  int curr_needs_walker=0;
-  int nnwalkers=nwalkers(mpi_info.node); //remember how many total we should have
-  for(int i=0; i< mpi_info.nprocs; i++) { 
-    while(nwalkers(i) > nconfig) {
-      if(nwalkers(curr_needs_walker) < nconfig) { 
-        nwalkers(curr_needs_walker)++;
-        nwalkers(i)--;
-        send_queue.push_back(Queue_element(i,curr_needs_walker));
-        //cout << mpi_info.node << ":nwalkers " << nwalkers(i) << "  " << nwalkers(curr_needs_walker) << endl;
-        //cout << mpi_info.node << ":send " << i << "  " << curr_needs_walker << endl;
-      }
-      else { 
-        curr_needs_walker++;
-      }
-    }
-  }
-  
-  for(int i=0; i< mpi_info.nprocs; i++) assert(nwalkers(i)==nconfig);
-  int killsize=0;
-  for(int i=0; i< nconfig; i++) {
-    //cout << mpi_info.node << ":branch " << i << "  " << my_branch(i) << " weight " << pts(i).weight <<  endl;
-    if(my_branch(i)==0) killsize++;
-  }
-  //cout << mpi_info.node << ": send queue= " << send_queue.size() << endl;
-  //now do branching for the walkers that we get to keep
-  Array1 <Dmc_point> savepts=pts;
+  //Find out which walker each of the local copies comes from, and its id.
+  //The first copy of a walker keeps the id.
+  Array1 <int> ncopies(nold);
+  ncopies=0;
+  source.Resize(nconfig);
+  source=-1;
+  Array1 <long int> ids(nconfig);
   int curr=0; //what walker we're currently copying from
   int curr_copy=0; //what walker we're currently copying to
-  while(curr_copy < min(nnwalkers,nconfig)) { 
-    if(my_branch(curr)>0) { 
-      //cout << mpi_info.node << ": copying " << curr << " to " << curr_copy << " branch " << my_branch(curr) << endl;
-      my_branch(curr)--;
-      pts(curr_copy)=savepts(curr);
-      //pts(curr_copy).weight=1;
+  while(curr_copy < nlocal) { 
+    if(ncopies(curr) < my_branch(curr)) { 
+      source(curr_copy)=curr;
+      ids(curr_copy)=(ncopies(curr)==0)?pts(curr).walker_id
+        :first_newid(curr)+ncopies(curr)-1;
+      ncopies(curr)++;
       curr_copy++;
     }
     else curr++;
   }
-  long int time_b=clock();
-  single_write(cout,"Finding out where to send: ",double(time_b-time_a)/CLOCKS_PER_SEC,"\n");
-  
-  time_a=clock(); 
-  //Finally, send or receive spillover walkers 
-  if(nnwalkers > nconfig) { 
-    vector<Queue_element>::iterator queue_pos=send_queue.begin();
-    while(curr < nconfig) { 
-      if(my_branch(curr) > 0) { 
-        my_branch(curr)--;
-        while(queue_pos->from_node != mpi_info.node) { 
-          queue_pos++;
-        }
-        //cout << mpi_info.node << ":curr " << curr << " my_branch " << my_branch(curr) << endl;
-        //cout << mpi_info.node << ":sending " << queue_pos->from_node << " to " << queue_pos->to_node << endl;
-        savepts(curr).mpiSend(queue_pos->to_node);
-        queue_pos++;
-      }
-      else curr++;
+
+  //Send the spillover walkers before making the local copies, so that 
+  //they are on their way in the meantime.  All the walkers that go to 
+  //one process are packed into a single message.
+#ifdef USE_MPI
+  int nsends=sends.size();
+  transfer.sendbuf.Resize(nsends);
+  transfer.requests.Resize(nsends);
+  for(int s=0; s< nsends; s++) { 
+    transfer.sendbuf(s).clear(); //the transfer may be reused
+    for(int i=0; i< sends[s].nwalk; i++) { 
+      while(ncopies(curr)==my_branch(curr)) curr++;
+      long int id=pts(curr).walker_id;
+      if(ncopies(curr) > 0) 
+        pts(curr).walker_id=first_newid(curr)+ncopies(curr)-1;
+      ncopies(curr)++;
+      pts(curr).pack(transfer.sendbuf(s));
+      pts(curr).walker_id=id;
     }
-    
+    transfer.sendbuf(s).mpiIsend(sends[s].node,transfer.requests(s));
+  }
+#endif
+
+  //now do branching for the walkers that we get to keep
+  Array1 <Dmc_point> savepts=pts;
+  pts.Resize(nconfig);
+  for(int i=0; i< nlocal; i++) { 
+    pts(i)=savepts(source(i));
+    pts(i).walker_id=ids(i);
   }
-  else { //if nnwalkers == nconfig, then this will just get skipped immediately
-    vector <Queue_element>::iterator queue_pos=send_queue.begin();
-    while(curr_copy < nconfig) { 
-      while(queue_pos->to_node != mpi_info.node) queue_pos++;
-      //cout << mpi_info.node <<":receiving from " << queue_pos->from_node << " to " << curr_copy << endl;
-      pts(curr_copy).mpiReceive(queue_pos->from_node);
-      //pts(curr_copy).weight=1;
+  transfer.ncopied=nlocal;
+  long int time_b=clock();
+  single_write(cout,"copying walkers: ",double(time_b-time_a)/CLOCKS_PER_SEC,"\n");
+}
+
+//----------------------------------------------------------------------
+
+void Dmc_method::finishCopyWalkers(Dmc_transfer & transfer) { 
+  long int time_a=clock(); 
+  int curr_copy=transfer.ncopied;
+#ifdef USE_MPI
+  for(vector<Migration>::iterator r=transfer.recvs.begin(); 
+      r!=transfer.recvs.end(); r++) { 
+    Pack_buffer recvbuf;
+    recvbuf.mpiReceive(r->node);
+    for(int i=0; i< r->nwalk; i++) { 
+      pts(curr_copy).unpack(recvbuf);
       curr_copy++;
-      queue_pos++;
     }
   }
-  time_b=clock();
+  int nsends=transfer.requests.GetDim(0);
+  if(nsends > 0) 
+    MPI_Waitall(nsends,transfer.requests.v,MPI_STATUSES_IGNORE);
+#endif
+  assert(curr_copy==nconfig);
+  long int time_b=clock();
   single_write(cout,"sending walkers:",double(time_b-time_a)/CLOCKS_PER_SEC,"\n");
-  
-  return killsize;
-  //exit(0);
 }
+
 //----------------------------------------------------------------------
 
+void Dmc_method::clearWfState() { 
+  for(int i=0; i< wfstate.GetDim(0); i++) 
+    if(wfstate(i)) delete wfstate(i);
+  wfstate.Resize(0);
+  for(int i=0; i< samplestate.GetDim(0); i++) 
+    if(samplestate(i)) delete samplestate(i);
+  samplestate.Resize(0);
+  ncache_walkers=0;
+}
+
 //----------------------------------------------------------------------
 
 
-void Dmc_point::mpiSend(int node) { 
-#ifdef USE_MPI
-  prop.mpiSend(node);
-  config_pos.mpiSend(node);
+void Dmc_point::pack(Pack_buffer & buf) const { 
+  prop.pack(buf);
+  config_pos.pack(buf);
   int n=past_energies.size();
-  MPI_Send(&n,1, MPI_INT,node,0,MPI_Comm_grp);
-  for(deque<Dmc_history>::iterator i=past_energies.begin();
+  buf.pack(n);
+  for(deque<Dmc_history>::const_iterator i=past_energies.begin();
       i!= past_energies.end(); i++) { 
-    i->mpiSend(node);
+    i->pack(buf);
   }
   
   //MB: sending the past_properties for the forward walking
   int m=past_properties.size();
-  MPI_Send(&m,1, MPI_INT,node,0,MPI_Comm_grp);
-  for(deque<Dmc_history_avgrets>::iterator i=past_properties.begin();
+  buf.pack(m);
+  for(deque<Dmc_history_avgrets>::const_iterator i=past_properties.begin();
       i!= past_properties.end(); i++) { 
-    i->mpiSend(node);
+    i->pack(buf);
   }
 
-  MPI_Send(&weight,1,MPI_DOUBLE,node,0,MPI_Comm_grp);
-  MPI_Send(&ignore_walker,1, MPI_INT,node,0,MPI_Comm_grp);
-
-  int nelectrons=age.GetDim(0);
-  MPI_Send(&nelectrons,1, MPI_INT,node,0,MPI_Comm_grp);
-  MPI_Send(age.v,nelectrons, MPI_DOUBLE, node,0,MPI_Comm_grp);
-#endif
+  buf.pack(weight);
+  buf.pack(ignore_walker);
+  buf.pack(age);
+  buf.pack(walker_id);
 }
 
 //----------------------------------------------------------------------
 
-void Dmc_point::mpiReceive(int node) {
-#ifdef USE_MPI
-  prop.mpiReceive(node);
-  config_pos.mpiReceive(node);
+void Dmc_point::unpack(Pack_buffer & buf) { 
+  prop.unpack(buf);
+  config_pos.unpack(buf);
   int n;
-  MPI_Status status;
-  MPI_Recv(&n,1,MPI_INT,node,0,MPI_Comm_grp, &status);
+  buf.unpack(n);
   Dmc_history tmp_hist;
   past_energies.clear();
   for(int i=0; i< n; i++) {
-    tmp_hist.mpiReceive(node);
+    tmp_hist.unpack(buf);
     past_energies.push_back(tmp_hist);
   }
 
   //MB: receiving the past_properties for the forward walking
   int m;
-  MPI_Recv(&m,1,MPI_INT,node,0,MPI_Comm_grp, &status);
+  buf.unpack(m);
   Dmc_history_avgrets tmp_prop;
   past_properties.clear();
   for(int i=0; i< m; i++) {
-    tmp_prop.mpiReceive(node);
+    tmp_prop.unpack(buf);
     past_properties.push_back(tmp_prop);
   }
 
+  buf.unpack(weight);
+  buf.unpack(ignore_walker);
+  buf.unpack(age);
+  buf.unpack(walker_id);
+}
 
-  MPI_Recv(&weight,1,MPI_DOUBLE,node,0,MPI_Comm_grp, &status);
-  MPI_Recv(&ignore_walker,1,MPI_INT,node,0,MPI_Comm_grp, &status);
-      
-  int nelectrons;
-  MPI_Recv(&nelectrons,1,MPI_INT,node,0,MPI_Comm_grp,&status);
-  age.Resize(nelectrons);
-  MPI_Recv(age.v,nelectrons,MPI_DOUBLE, node,0,MPI_Comm_grp,&status);
+//----------------------------------------------------------------------
+
+void Dmc_point::mpiSend(int node) { 
+#ifdef USE_MPI
+  Pack_buffer buf;
+  pack(buf);
+  buf.mpiSend(node);
 #endif
 }
+
 //----------------------------------------------------------------------
 
+void Dmc_point::mpiReceive(int node) {
+#ifdef USE_MPI
+  Pack_buffer buf;
+  buf.mpiReceive(node);
+  unpack(buf);
+#endif
+}
+//----------------------------------------------------------------------
+
+void Dmc_point::packCheckpoint(Pack_buffer & buf) const { 
+  config_pos.pack(buf);
+  buf.pack(weight);
+  buf.pack(sign);
+  buf.pack(walker_id);
+  buf.pack(stream_epoch);
+}
+
+//----------------------------------------------------------------------
+void Dmc_point::unpackCheckpoint(Pack_buffer & buf) { 
+  config_pos.unpack(buf);
+  //files from VMC only have the positions
+  if(buf.done()) return;
+  buf.unpack(weight);
+  buf.unpack(sign);
+  //older files don't have the stream
+  if(buf.done()) return;
+  buf.unpack(walker_id);
+  buf.unpack(stream_epoch);
+}
+
+//----------------------------------------------------------------------
 void Dmc_point::write(ostream & os) { 
   string indent="";
   config_pos.write(os);
@@ -1232,6 +1487,8 @@ void Dmc_point::write(ostream & os) {
   //prop.write(indent,os);
   os << "weight " << weight<< endl;
   os << "sign " << sign << endl;
+  os << "walker_id " << walker_id << endl;
+  os << "stream_epoch " << stream_epoch << endl;
   /*
   for(deque<Dmc_history>::iterator i=past_energies.begin(); 
       i!=past_energies.end(); i++) { 
@@ -1263,6 +1520,9 @@ void Dmc_point::read(istream & is) {
   //prop.read(is);
   is >> dum >> weight;
   is >> dum >> sign;
+  is >> dum;
+  if(caseless_eq(dum, "walker_id")) 
+    is >> walker_id >> dum >> stream_epoch;
   //ignoring the past stuff for the moment..
 }
 
@@ -1291,36 +1551,40 @@ void Dmc_history::mpiSend(int node) {
 void Dmc_history::mpiReceive(int node) { 
 #ifdef USE_MPI
   MPI_Status status;
-  int n1,n2;
   MPI_Recv(&main_en,1,MPI_DOUBLE,node,0,MPI_Comm_grp,&status);
 #endif
 }
 
 
+void Dmc_history_avgrets::pack(Pack_buffer & buf) const { 
+  buf.pack(weight);
+  int n1=avgrets.GetDim(1);
+  buf.pack(n1);
+  for(int j=0;j<n1;j++)
+    buf.pack(avgrets(0,j).vals);
+}
+
+void Dmc_history_avgrets::unpack(Pack_buffer & buf) { 
+  buf.unpack(weight);
+  int n1;
+  buf.unpack(n1);
+  avgrets.Resize(1,n1);
+  for(int j=0;j<n1;j++)
+    buf.unpack(avgrets(0,j).vals);
+}
+
 void Dmc_history_avgrets::mpiSend(int node) { 
 #ifdef USE_MPI
-  MPI_Send(&weight,1,MPI_DOUBLE,node,0,MPI_Comm_grp);
-  int n1=avgrets.GetDim(1);
-  MPI_Send(&n1,1,MPI_INT,node,0,MPI_Comm_grp);
-  for(int j=0;j<n1;j++){
-    int n2=avgrets(0,j).vals.GetDim(0);
-    MPI_Send(&n2,1,MPI_INT,node,0,MPI_Comm_grp);
-    MPI_Send(avgrets(0,j).vals.v,n2,MPI_DOUBLE,node,0,MPI_Comm_grp);
-  }
+  Pack_buffer buf;
+  pack(buf);
+  buf.mpiSend(node);
 #endif
 }
 
 void Dmc_history_avgrets::mpiReceive(int node) { 
 #ifdef USE_MPI
-  MPI_Status status;
-  int n1,n2;
-  MPI_Recv(&weight,1,MPI_DOUBLE,node,0,MPI_Comm_grp,&status);
-  MPI_Recv(&n1,1,MPI_INT,node,0,MPI_Comm_grp,&status);
-  avgrets.Resize(1,n1);
-  for(int j=0;j<n1;j++){
-    MPI_Recv(&n2,1,MPI_INT,node,0,MPI_Comm_grp,&status);
-    avgrets(0,j).vals.Resize(n2);
-    MPI_Recv(avgrets(0,j).vals.v,n2,MPI_DOUBLE,node,0,MPI_Comm_grp,&status);  
-  }
+  Pack_buffer buf;
+  buf.mpiReceive(node);
+  unpack(buf);
 #endif
 }
@@ -32,6 +32,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "System.h"
 #include "Split_sample.h"
 #include "Properties.h"
+#include "Walker_threads.h"
+#include "Checkpoint_writer.h"
+#include "Pack_buffer.h"
+#include "ulec.h"
 #include <deque>
 
 class Program_options;
@@ -40,6 +44,8 @@ struct Dmc_history {
   doublevar main_en;
   void mpiSend(int node);  
   void mpiReceive(int node);
+  void pack(Pack_buffer & buf) const { buf.pack(main_en); }
+  void unpack(Pack_buffer & buf) { buf.unpack(main_en); }
   void read(istream & is) { 
     string dummy;
     is >> dummy >> main_en;
@@ -55,6 +61,8 @@ struct Dmc_history_avgrets {
   doublevar weight;
   void mpiSend(int node);
   void mpiReceive(int node);
+  void pack(Pack_buffer & buf) const;
+  void unpack(Pack_buffer & buf);
   void read(istream & is);
   void write(ostream & os);
 };
@@ -68,13 +76,23 @@ struct Dmc_point {
   int sign;
   Config_save_point config_pos;  
   Array1 <doublevar> age;  //!< age of each electron
+  long int walker_id; //!< stays with the walker through branching and restarts; its random stream
+  int stream_epoch; //!< the run of the random streams when the walker was written out
   Dmc_point() { 
     weight=1;
     ignore_walker=0;
     sign=1;
+    walker_id=-1;
+    stream_epoch=0;
   }
   void mpiSend(int node);
   void mpiReceive(int node);
+  //! Everything that mpiSend() sends, in one buffer
+  void pack(Pack_buffer & buf) const;
+  void unpack(Pack_buffer & buf);
+  //! Same as read() and write(): the positions, weight, sign, and stream
+  void packCheckpoint(Pack_buffer & buf) const;
+  void unpackCheckpoint(Pack_buffer & buf);
   void read(istream & is);
   void write(ostream & os);
   
@@ -82,6 +100,24 @@ struct Dmc_point {
 };
 
 
+//! Walkers to or from one process when they are balanced after branching
+struct Migration {
+  int node;  //!< the process to send to or receive from
+  int nwalk; //!< how many walkers
+  Migration() { }
+  Migration(int node_, int nwalk_) { node=node_; nwalk=nwalk_; }
+};
+
+//! The walkers in flight between Dmc_method::startCopyWalkers() and finishCopyWalkers()
+struct Dmc_transfer { 
+  vector <Migration> recvs;
+  int ncopied; //!< how many walkers were copied on this process
+#ifdef USE_MPI
+  Array1 <Pack_buffer> sendbuf;
+  Array1 <MPI_Request> requests;
+#endif
+};
+
 class Dmc_method : public Qmc_avg_method
 {
 public:
@@ -111,10 +147,12 @@ public:
     guidingwf=NULL;
     dyngen=NULL;
     sample=NULL;
+    ncache_walkers=0;
     
   }
   ~Dmc_method()
   {
+    clearWfState();
     if(have_allocated_variables) {
       if(mypseudo) delete mypseudo;
       if(mysys) delete mysys;
@@ -137,10 +175,13 @@ public:
 
 
 
-  int allocateIntermediateVariables(System * , Wavefunction_data *);
+  int allocateIntermediateVariables(System * , Wavefunction_data *,
+                                    Pseudopotential *);
   void deallocateIntermediateVariables() {
+    threads.clear();
     if(sample) delete sample;
     sample=NULL;
+    clearWfState();
     deallocate(wf);
     wf=NULL;
     for(int i=0; i< average_var.GetDim(0); i++) { 
@@ -153,7 +194,8 @@ public:
   void savecheckpoint(string & filename, Sample_point *);
   void restorecheckpoint(string & filename, System * sys,
 			 Wavefunction_data * wfdata,Pseudopotential * pseudo);
-  void forwardWalking(int walker, int step, Array1<Properties_manager> & prop_fw);
+  void forwardWalking(int walker, int step, Properties_point & pt,
+                      Array1<Properties_manager> & prop_fw);
   void doTmove(Properties_point & pt,Pseudopotential * pseudo, System * sys,
                Wavefunction_data * wfdata, Wavefunction * wf, Sample_point * sample,
                Guiding_function * guideingwf);
@@ -164,6 +206,7 @@ public:
                                            Wavefunction * wf, 
                                            Sample_point * sample,
                                            Guiding_function * guidingwf,
+                                           Dynamics_generator * sampler,
                                            Dmc_point & pt,
                                            doublevar & acsum);
   void move_all_electron(Wavefunction_data * wfdata,
@@ -176,13 +219,66 @@ public:
   
   doublevar getWeightPURE_DMC(Dmc_point & pt,
 			   doublevar teff, doublevar etr);
+  //! Start summing the weights of the walkers over the processes for calcBranch()
+  void startBranch();
+  /*!
+    Branch the walkers with a comb; returns how many were killed here.  
+    The walkers from other processes are only received in finishBranch(),
+    so the ones copied here can be moved in the meantime.
+   */
   int calcBranch();
+  //! Receive the walkers sent in the last calcBranch(), if any are pending
+  void finishBranch();
+  /*!
+    Choose the copies of the walkers by combing through the walkers of 
+    all the processes by weight, with the teeth offset by offset (0 to 1)
+    times the spacing.  start is the total weight of the walkers on the 
+    processes before this one and totweight that of all of them.  Fills 
+    in the arguments of startCopyWalkers(), and hands out the new ids.
+   */
+  void combWalkers(doublevar start, doublevar totweight, doublevar offset,
+                   Array1 <int> & my_branch, Array1 <int> & nwalkers,
+                   Array1 <long int> & first_newid);
+  /*!
+    Replace the walkers on this process with my_branch(i) copies of each
+    walker i, and send the extra ones so that every process ends up with
+    nconfig.  nwalkers(n) is how many copies process n makes.  The first
+    copy of a walker keeps its id and copy c > 0 gets first_newid(i)+c-1.
+    source(j) is the walker that j is a copy of, or -1 if it comes from 
+    another process.  The walkers from other processes are only there 
+    after finishCopyWalkers(); anything in between overlaps with the 
+    messages.
+   */
+  void startCopyWalkers(Array1 <int> & my_branch, Array1 <int> & nwalkers,
+                        Array1 <long int> & first_newid, Array1 <int> & source,
+                        Dmc_transfer & transfer);
+  //! Receive the walkers from other processes and wait for the sends
+  void finishCopyWalkers(Dmc_transfer & transfer);
+  /*!
+    Resample the walkers read from a file, however many there are on each
+    process, to nconfig per process.  The walkers are chosen in proportion
+    to their weights, and all of them get the average weight.
+   */
+  void resampleWalkers();
+  Random_generator branch_rng; //!< has the same sequence on all processes
+  int nbranch; //!< number of branching steps so far
+  doublevar branch_weight; //!< the weight of this process's walkers, from startBranch()
+  doublevar branch_start; //!< the weight of the walkers on the processes before this one
+  doublevar branch_total; //!< the weight of all the walkers
+#ifdef USE_MPI
+  MPI_Request branch_requests[2];
+#endif
+  Dmc_transfer branch_transfer; //!< the migration started by calcBranch()
+  int branch_pending; //!< whether branch_transfer still has to be finished
+  Checkpoint_writer checkpoint_writer;
+  void clearWfState();
   void find_cutoffs();
   void updateEtrial(doublevar feedback);
   
   //-----Options.
   bool all_electron_moves; //!< Move all electrons at once.
   int low_io; //!< write out configs and densities only at the end.
+  int text_config; //!< write the configurations as text instead of binary
   int tmoves; //!< whether to do Casula's t-moves
   int tmoves_sizeconsistent; //!< Do the size-consistent version of T-moves.
   string save_trace; //!<whether to make a binary file at the end of each block with all the coordinates.
@@ -211,6 +307,7 @@ public:
   doublevar max_poss_weight;
   int max_fw_length; //!maximum length for forward walking time
   int pure_dmc; //turn on SHDMC mode (pure diffusion for the length of nhist)
+  doublevar cache_wf_memory; //!< megabytes per process for keeping the wave function state of the walkers; 0 recalculates it
 
   //---Control variables and state
   int have_allocated_variables;
@@ -228,6 +325,14 @@ public:
   Wavefunction_data * mywfdata;
 
   Array1 <Dmc_point> pts;
+  Array1 <Wavefunction_storage *> wfstate; //!< saved wave function state of each walker, or NULL to recalculate
+  Array1 <Sample_state *> samplestate; //!< saved Ewald/density sums of each walker's sample point, or NULL
+  int ncache_walkers; //!< walkers below this index keep their wave function state
+  long int next_walker_id; //!< the id for the next new walker; the same on all processes
+  int stream_epoch; //!< this run of the random streams
+  Walker_threads threads; //!< per-thread copies of the walker objects
+  Array2 <Properties_point> step_pts; //!< (walker,step) points between branchings
+  vector <string> dynamics_words;
 
   Array1 < Local_density_accumulator *> densplt;
   vector <vector <string> > dens_words;
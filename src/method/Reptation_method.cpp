@@ -54,6 +54,26 @@ void Reptile::mpiReceive(int node) {
   }
 }
 //----------------------------------------------------------------------
+void Reptile::packCheckpoint(Pack_buffer & buf) const { 
+  buf.pack(direction);
+  int nrep=reptile.size();
+  buf.pack(nrep);
+  for(deque<Reptile_point>::const_iterator r=reptile.begin();
+      r!=reptile.end(); r++) {
+    r->pack(buf);
+  }
+}
+void Reptile::unpackCheckpoint(Pack_buffer & buf) { 
+  buf.unpack(direction);
+  int nrep;
+  buf.unpack(nrep);
+  reptile.resize(nrep);
+  for(deque<Reptile_point>::iterator r=reptile.begin();
+      r!=reptile.end(); r++) {
+    r->unpack(buf);
+  }
+}
+//----------------------------------------------------------------------
 void Reptile::read(istream & is) { 
   string dummy;
   is >> dummy >> direction;
@@ -127,6 +147,7 @@ void Reptation_method::read(vector <string> words,
 
   if(!readvalue(words, pos=0, storeconfig, "STORECONFIG"))
     storeconfig=options.runid+".config";
+  text_config=haskeyword(words, pos=0,"TEXT_CONFIG");
 
   if(readvalue(words, pos=0, center_trace, "CENTER_TRACE"))
     canonical_filename(center_trace);
@@ -281,7 +302,8 @@ int Reptation_method::readcheck(string & filename,
 void Reptation_method::storecheck(Array1<Reptile> & reptiles,
                                   string & filename) {
   if(filename=="") return;
-  write_configurations(filename,reptiles); 
+  if(text_config) write_configurations(filename,reptiles,checkpoint_writer); 
+  else write_binary_configurations(filename,reptiles,checkpoint_writer);
 }
 
 
@@ -628,6 +650,7 @@ void Reptation_method::runWithVariables(Properties_manager & prop,
     // << endl;
 
   }   //block
+  checkpoint_writer.wait();
 
 
   if(output) {
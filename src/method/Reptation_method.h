@@ -34,6 +34,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "Space_warper.h"
 class Program_options;
 #include "Properties.h"
+#include "Checkpoint_writer.h"
+#include "Pack_buffer.h"
 #include <deque>
 
 //----------------------------------------------------------------------
@@ -118,6 +120,26 @@ struct Reptile_point {
     is >> dummy;
   }
   //--------------------------------------------------
+  void pack(Pack_buffer & buf) const { 
+    prop.pack(buf);
+    buf.pack(age);
+    buf.pack(branching);
+    int nelectrons=electronpos.GetDim(0);
+    buf.pack(nelectrons);
+    for(int e=0; e< nelectrons; e++) 
+      buf.pack(electronpos(e));
+  }
+  void unpack(Pack_buffer & buf) { 
+    prop.unpack(buf);
+    buf.unpack(age);
+    buf.unpack(branching);
+    int nelectrons;
+    buf.unpack(nelectrons);
+    electronpos.Resize(nelectrons);
+    for(int e=0; e< nelectrons; e++) 
+      buf.unpack(electronpos(e));
+  }
+  //--------------------------------------------------
 
   void mpiSend(int node) { 
     prop.mpiSend(node);
@@ -150,6 +172,9 @@ class Reptile {
   void mpiReceive(int node);
   void read(istream & is);
   void write(ostream & os);
+  //! Everything that write() writes; see write_binary_configurations()
+  void packCheckpoint(Pack_buffer & buf) const;
+  void unpackCheckpoint(Pack_buffer & buf);
   deque <Reptile_point> reptile; 
   int direction;
 };
@@ -243,6 +268,8 @@ private:
   string readconfig;
   string log_label;
   string storeconfig;
+  int text_config; //!< write the configurations as text instead of binary
+  Checkpoint_writer checkpoint_writer;
   doublevar timestep;
   int reptile_length;
 
@@ -92,7 +92,7 @@ doublevar Split_sampler::transition_prob(int point1, int point2,
                                          doublevar timestep, 
                                          drift_type dtype) {
   doublevar prob=0;
-  static Array1 <doublevar> drift(3);
+  Array1 <doublevar> drift(3);
   //cout << "transition probability" << endl;
 
   drift=trace(point1).drift;
@@ -392,8 +392,8 @@ int Split_sampler::split_driver(int e,
 
   if(depth > recursion_depth_) return 0;
 
-  static Array1 <doublevar> c_olddrift(3);
-  static Array1 <doublevar> c_newdrift(3);
+  Array1 <doublevar> c_olddrift(3);
+  Array1 <doublevar> c_newdrift(3);
   
   c_olddrift=trace(0).drift;  
   limDrift(c_olddrift, timesteps(depth), dtype);
@@ -422,7 +422,10 @@ int Split_sampler::split_driver(int e,
   sample->translateElectron(e, trace(depth).translation);
   trace(depth).sign=sample->overallSign();
   
-  if(wfdata->supports(laplacian_update) ) {
+  if(propose_moves) { 
+    wf->proposeLap(wfdata, sample, e, trace(depth).lap);
+  }
+  else if(wfdata->supports(laplacian_update) ) {
     wf->updateLap(wfdata, sample);
     wf->getLap(wfdata, e, trace(depth).lap);
   }
@@ -460,14 +463,21 @@ int Split_sampler::split_driver(int e,
   
   if (acc+rng.ulec() > 1.0) {
     info.accepted=1;
+    if(propose_moves) wf->acceptMove(wfdata, sample, e);
     return depth;
   }
   else {
     info.accepted=0;
     
-    static Array1 <doublevar> rev(3,0.0);
-    for(int d=0; d< 3; d++) rev(d)=-trace(depth).translation(d);
-    sample->translateElectron(e,rev);
+    if(propose_moves) { 
+      wfStore.restoreUpdate(sample, e);
+      wf->rejectMove(sample, e);
+    }
+    else { 
+      Array1 <doublevar> rev(3,0.0);
+      for(int d=0; d< 3; d++) rev(d)=-trace(depth).translation(d);
+      sample->translateElectron(e,rev);
+    }
 
     depth++;
     
@@ -492,7 +502,13 @@ int Split_sampler::sample(int e,
     wfStore.initialize(sample, wf);
   
   wf->updateLap(wfdata, sample);
-  wfStore.saveUpdate(sample, wf, e);
+  //With move proposals, a rejection leaves the wave function as it was
+  propose_moves=wfdata->supports(move_proposal) 
+    && wfdata->supports(laplacian_update);
+  if(propose_moves) 
+    wfStore.saveUpdate(sample, e);
+  else 
+    wfStore.saveUpdate(sample, wf, e);
   trace.Resize(recursion_depth_+1);
 
   for(int i=0; i < recursion_depth_+1; i++) {
@@ -532,7 +548,7 @@ int Split_sampler::sample(int e,
     }
   }
 
-  if(!acc) {
+  if(!acc && !propose_moves) {
     wfStore.restoreUpdate(sample, wf, e);
   }
   //cout << "-----------split done" << endl;
@@ -563,6 +579,19 @@ void Split_sampler::resetStats() {
   acceptances=0;
   tries=0;
 }
+
+//----------------------------------------------------------------------
+
+void Split_sampler::addStats(Dynamics_generator * other) { 
+  Split_sampler * split=dynamic_cast<Split_sampler *>(other);
+  assert(split != NULL);
+  assert(split->recursion_depth_==recursion_depth_);
+  for(int i=0; i< recursion_depth_; i++) { 
+    acceptances(i)+=split->acceptances(i);
+    tries(i)+=split->tries(i);
+  }
+  split->resetStats();
+}
 //----------------------------------------------------------------------
 //######################################################################
 
@@ -575,6 +604,14 @@ void UNR_sampler::resetStats() {
   tries=0;
 }
 
+void UNR_sampler::addStats(Dynamics_generator * other) { 
+  UNR_sampler * unr=dynamic_cast<UNR_sampler *>(other);
+  assert(unr != NULL);
+  acceptance+=unr->acceptance;
+  tries+=unr->tries;
+  unr->resetStats();
+}
+
 
 void UNR_sampler::getDriftEtc(Point & pt, Sample_point * sample,
 			      doublevar tstep, int e,
@@ -695,6 +732,13 @@ int UNR_sampler::sample(int e, Sample_point * sample,
   Point p1; p1.lap.Resize(wf->nfunc(), 5);
   
   wf->updateLap(wfdata, sample);
+  int propose_moves=wfdata->supports(move_proposal) 
+    && wfdata->supports(laplacian_update);
+  if(propose_moves) { 
+    if(! wfStore.isInitialized())
+      wfStore.initialize(sample, wf);
+    wfStore.saveUpdate(sample, e);
+  }
   sample->getElectronPos(e,p1.pos);
   wf->getLap(wfdata, e, p1.lap);
   p1.sign=sample->overallSign();
@@ -739,8 +783,13 @@ int UNR_sampler::sample(int e, Sample_point * sample,
   Array1 <doublevar> translate(3);
   for(int d=0; d< 3; d++) translate(d)=p2.pos(d)-p1.pos(d);
   sample->translateElectron(e,translate);
-  wf->updateLap(wfdata, sample);
-  wf->getLap(wfdata, e, p2.lap);
+  if(propose_moves) { 
+    wf->proposeLap(wfdata, sample, e, p2.lap);
+  }
+  else { 
+    wf->updateLap(wfdata, sample);
+    wf->getLap(wfdata, e, p2.lap);
+  }
   p2.sign=sample->overallSign();
   guidewf->getLap(p2.lap, p2.drift);
 
@@ -783,10 +832,16 @@ int UNR_sampler::sample(int e, Sample_point * sample,
   if(acc+rng.ulec()>1.0) { 
     info.accepted=1;
     acceptance++;
+    if(propose_moves) wf->acceptMove(wfdata, sample, e);
     return 1;
   }
   else { 
-    sample->setElectronPos(e,p1.pos);
+    if(propose_moves) { 
+      wfStore.restoreUpdate(sample, e);
+      wf->rejectMove(sample, e);
+    }
+    else 
+      sample->setElectronPos(e,p1.pos);
     info.accepted=0;
     return 0;
   }
@@ -97,6 +97,11 @@ class Dynamics_generator {
   virtual int showinfo(string & indent, ostream & os)=0;
   virtual void showStats(ostream & os)=0;
   virtual  void resetStats()=0;
+  /*!
+    Add the statistics of another generator of the same type (a
+    thread's copy of this one) and reset them.
+   */
+  virtual void addStats(Dynamics_generator * other)=0;
 
 
   virtual ~Dynamics_generator() {}
@@ -187,6 +192,7 @@ class Split_sampler:public Dynamics_generator {
   
   void showStats(ostream & os);
   void resetStats();
+  void addStats(Dynamics_generator * other);
  private:
  
   doublevar transition_prob(int point1, int point2,
@@ -204,6 +210,7 @@ class Split_sampler:public Dynamics_generator {
 
   string indent; //for debugging..
   Storage_container wfStore;
+  int propose_moves; //!< whether the wave function does proposeLap()
 };
 
 
@@ -253,9 +260,11 @@ class UNR_sampler:public Dynamics_generator {
 
   void showStats(ostream & os);
   void resetStats();
+  void addStats(Dynamics_generator * other);
  private:
   doublevar acceptance;
   long int tries;
+  Storage_container wfStore;
 };
 
 //----------------------------------------------------------------------
@@ -298,6 +307,13 @@ class SRK_dmc:public Dynamics_generator {
       acceptances=0; tries=0;
       retries=0; nbottom=0;
     }
+    void addStats(Dynamics_generator * other) { 
+      SRK_dmc * srk=dynamic_cast<SRK_dmc *>(other);
+      assert(srk != NULL);
+      acceptances+=srk->acceptances; tries+=srk->tries;
+      retries+=srk->retries; nbottom+=srk->nbottom;
+      srk->resetStats();
+    }
   private:
     int rk_step(int e, Sample_point * sample, 
         Wavefunction * wf,Wavefunction_data * wfdata, 
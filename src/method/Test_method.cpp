@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "Program_options.h"
 #include "System.h"
 #include "Basis_function.h"
+#include "ulec.h"
 void Test_method::read(vector <string> words,
                        unsigned int & pos,
                        Program_options & options)
@@ -69,6 +70,13 @@ void Test_method::read(vector <string> words,
     backflow.init(sysprop,occupation,backtxt);
   }
   
+  vector <string> batchtxt;
+  batch_mo=NULL;
+  if(readsection(words,pos=0, batchtxt,"ORBITAL_BATCH_TEST"))
+    allocate(batchtxt,sysprop,batch_mo);
+  if(!readvalue(words,pos=0,batch_tolerance,"ORBITAL_BATCH_TOLERANCE"))
+    batch_tolerance=1e-10;
+  
   if(haskeyword(words, pos=0, "PLOT_EE_CUSP"))
     plot_cusp=1;
   else
@@ -87,6 +95,15 @@ void Test_method::read(vector <string> words,
     testhessian=0;
   }
 
+  compare_wfdata=NULL;
+  vector <string> comparetxt;
+  if(readsection(words, pos=0, comparetxt, "COMPARE_WF")) { 
+    allocate(comparetxt, sysprop, compare_wfdata);
+    if(!readvalue(words, pos=0, compare_steps, "COMPARE_STEPS"))
+      compare_steps=100;
+    compare_recompute=haskeyword(words, pos=0, "COMPARE_RECOMPUTE");
+  }
+
   cout << "done setup " << endl;
 }
 
@@ -281,12 +298,21 @@ void Test_method::run(Program_options & options, ostream & output)
   if(test_backflow) { 
     testBackflow();
   }
+
+  if(compare_wfdata) { 
+    compareWf(mywf, sample);
+  }
+
+  if(batch_mo) { 
+    testOrbitalBatch(sample);
+  }
   
 
   delete mywf; mywf=NULL;
   delete sample;
   sample=NULL;
   if(basis) delete basis;
+  if(batch_mo) delete batch_mo;
 }
 
 
@@ -369,6 +395,186 @@ void Test_method::testParmDeriv(Wavefunction * mywf, Sample_point * sample){
 
 //----------------------------------------------------------------------
 
+/*!
+Walk with VMC on the trial function, and move the electrons of a second
+sample for the comparison function one by one along with it.  Both see
+the same electron moves, so any difference in the values comes from how
+they are computed.  The nonlocal pseudopotential is evaluated for both 
+at every step with the same quadrature rotation and the same random 
+numbers, which covers the test ratios as well.  With COMPARE_RECOMPUTE,
+the comparison function is computed from scratch at every step instead of 
+being updated, so giving it the trial function checks the updates.
+*/
+void Test_method::compareWf(Wavefunction * mywf, Sample_point * sample) { 
+  cout <<"#######################################################\n";
+  cout <<" Comparing to the second wave function for "<< compare_steps 
+    << " steps" << endl;
+  if(compare_recompute) 
+    cout <<" recomputing it from scratch at every step" << endl;
+  cout <<"#######################################################\n";
+  Wavefunction * cmpwf=NULL;
+  Sample_point * cmpsample=NULL;
+  compare_wfdata->generateWavefunction(cmpwf);
+  sysprop->generateSample(cmpsample);
+  cmpsample->attachObserver(cmpwf);
+  Array1 <doublevar> epos(3);
+  for(int e=0; e< nelectrons; e++) { 
+    sample->getElectronPos(e,epos);
+    cmpsample->setElectronPos(e,epos);
+  }
+  if(cmpwf->nfunc()!=mywf->nfunc()) 
+    error("COMPARE_WF must have as many functions as the trial function");
+
+  Split_sampler sampler;
+  sampler.setRecursionDepth(2);
+  sampler.setDivider(2.0);
+  Primary guidewf;
+  Dynamics_info dinfo;
+  doublevar timestep=0.3;
+  int nfunc=mywf->nfunc();
+  Wf_return lap(nfunc,5), cmplap(nfunc,5);
+  doublevar maxval=0, maxgrad=0, maxlap=0;
+  doublevar kinetic_diff=0;
+  doublevar maxnonloc=0, energy_diff=0;
+  Array1 <doublevar> nonloc(nfunc), cmpnonloc(nfunc);
+  Array1 <doublevar> accept_var(psp->nTest());
+  int naccept=0;
+  mywf->updateLap(wfdata, sample);
+  cmpwf->updateLap(compare_wfdata, cmpsample);
+  for(int step=0; step< compare_steps; step++) { 
+    for(int e=0; e< nelectrons; e++) { 
+      if(sampler.sample(e, sample, mywf, wfdata, &guidewf, dinfo,
+                        timestep)) { 
+        naccept++;
+        sample->getElectronPos(e,epos);
+        cmpsample->setElectronPos(e,epos);
+        if(!compare_recompute) 
+          cmpwf->updateLap(compare_wfdata, cmpsample);
+      }
+    }
+    mywf->updateLap(wfdata, sample);
+    if(compare_recompute) { 
+      cmpwf->notify(all_electrons_move,0);
+      cmpwf->updateLap(compare_wfdata, cmpsample);
+    }
+    doublevar kinetic=0, cmpkinetic=0;
+    for(int e=0; e< nelectrons; e++) { 
+      mywf->getLap(wfdata, e, lap);
+      cmpwf->getLap(compare_wfdata, e, cmplap);
+      for(int f=0; f< nfunc; f++) { 
+        maxval=max(maxval, fabs(lap.amp(f,0)-cmplap.amp(f,0)));
+        for(int d=1; d< 4; d++) 
+          maxgrad=max(maxgrad, fabs(lap.amp(f,d)-cmplap.amp(f,d)));
+        maxlap=max(maxlap, fabs(lap.amp(f,4)-cmplap.amp(f,4)));
+      }
+      kinetic-=0.5*lap.amp(0,4);
+      cmpkinetic-=0.5*cmplap.amp(0,4);
+    }
+    kinetic_diff+=kinetic-cmpkinetic;
+
+    psp->randomize();
+    for(int i=0; i< accept_var.GetDim(0); i++) accept_var(i)=rng.ulec();
+    psp->calcNonlocWithTest(wfdata, sysprop, sample, mywf, accept_var, nonloc);
+    psp->calcNonlocWithTest(compare_wfdata, sysprop, cmpsample, cmpwf, 
+                            accept_var, cmpnonloc);
+    for(int f=0; f< nfunc; f++) 
+      maxnonloc=max(maxnonloc, fabs(nonloc(f)-cmpnonloc(f)));
+    energy_diff+=kinetic-cmpkinetic+nonloc(0)-cmpnonloc(0);
+  }
+  cout << "acceptance " << doublevar(naccept)/(compare_steps*nelectrons) 
+    << endl;
+  cout << "max difference in log value " << maxval << endl;
+  cout << "max difference in gradient " << maxgrad << endl;
+  cout << "max difference in laplacian " << maxlap << endl;
+  cout << "average difference in kinetic energy " 
+    << kinetic_diff/compare_steps << endl;
+  cout << "max difference in nonlocal energy " << maxnonloc << endl;
+  cout << "average difference in local energy " 
+    << energy_diff/compare_steps << endl;
+  
+  delete cmpwf;
+  delete cmpsample;
+}
+
+//----------------------------------------------------------------------
+
+/*!
+Check that the batched orbital evaluations, over walkers and over test
+positions of one electron, give the same numbers as evaluating the points
+one at a time.  Stops with an error if any difference is larger than 
+ORBITAL_BATCH_TOLERANCE.
+*/
+void Test_method::testOrbitalBatch(Sample_point * sample) { 
+  cout <<"#######################################################\n";
+  cout <<" Checking the batched orbital evaluations \n";
+  cout <<"#######################################################\n";
+  int nmo=batch_mo->getNmo();
+  Array1 <Array1 <int> > occupation(1);
+  occupation(0).Resize(nmo);
+  for(int i=0; i< nmo; i++) occupation(0)(i)=i;
+  batch_mo->buildLists(occupation);
+
+  const int npoints=4;
+  int e=0;
+  MO_workspace <doublevar> ws;
+  Array1 <Sample_point *> samples(npoints);
+  samples(0)=sample;
+  for(int w=1; w< npoints; w++) { 
+    samples(w)=NULL;
+    sysprop->generateSample(samples(w));
+    samples(w)->randomGuess();
+  }
+  Array1 <Array2 <doublevar> > batchval(npoints), batchlap(npoints);
+  for(int w=0; w< npoints; w++) { 
+    batchval(w).Resize(nmo,1);
+    batchlap(w).Resize(nmo,5);
+  }
+  Array2 <doublevar> val(nmo,1), lap(nmo,5);
+  doublevar maxval=0, maxlap=0, maxpos=0;
+
+  batch_mo->updateValBatch(samples,e,0,batchval,ws);
+  batch_mo->updateLapBatch(samples,e,0,batchlap,ws);
+  for(int w=0; w< npoints; w++) { 
+    batch_mo->updateVal(samples(w),e,0,val,ws);
+    batch_mo->updateLap(samples(w),e,0,lap,ws);
+    for(int m=0; m< nmo; m++) { 
+      maxval=max(maxval, fabs(batchval(w)(m,0)-val(m,0)));
+      for(int d=0; d< 5; d++) 
+        maxlap=max(maxlap, fabs(batchlap(w)(m,d)-lap(m,d)));
+    }
+  }
+
+  //test positions around electron e, as the pseudopotential uses them
+  Array1 <doublevar> epos(3), newpos(3);
+  Array2 <doublevar> pos(npoints,3);
+  sample->getElectronPos(e,epos);
+  for(int k=0; k< npoints; k++) 
+    for(int d=0; d< 3; d++) pos(k,d)=epos(d)+rng.ulec()-0.5;
+  batch_mo->updateValBatch(sample,e,pos,0,batchval,ws);
+  for(int k=0; k< npoints; k++) { 
+    for(int d=0; d< 3; d++) newpos(d)=pos(k,d);
+    sample->setElectronPos(e,newpos);
+    batch_mo->updateVal(sample,e,0,val,ws);
+    for(int m=0; m< nmo; m++) 
+      maxpos=max(maxpos, fabs(batchval(k)(m,0)-val(m,0)));
+  }
+  sample->setElectronPos(e,epos);
+
+  cout << "max difference in batched values " << maxval << endl;
+  cout << "max difference in batched laplacians " << maxlap << endl;
+  cout << "max difference in batched test positions " << maxpos << endl;
+  for(int w=1; w< npoints; w++) delete samples(w);
+  if(maxval > batch_tolerance || maxlap > batch_tolerance 
+     || maxpos > batch_tolerance) { 
+    cout << "batched orbital evaluations FAILED: tolerance " 
+      << batch_tolerance << endl;
+    error("The batched orbital evaluations differ from the one-at-a-time "
+          "evaluations by more than ORBITAL_BATCH_TOLERANCE");
+  }
+  cout << "batched orbital evaluations OK" << endl;
+}
+
+
 void Test_method::plotCusp(Wavefunction * mywf, Sample_point * sample){
   
   Array1 < Array1 <doublevar> >orig_walker(nelectrons);
@@ -471,7 +677,11 @@ void Test_method::testBackflow() {
 
   int e=2;
 
-  backflow.updateLap(sample,jast,e,0,newvals,coor_deriv,coor_laplacian);
+  Sample_point * bf_sample=NULL;
+  backflow.generateSample(bf_sample);
+  MO_workspace <doublevar> mo_ws;
+  backflow.updateLap(sample,jast,e,0,newvals,coor_deriv,coor_laplacian,
+                     bf_sample,mo_ws);
   
 
   Sample_point * tmp_sample=NULL;
@@ -515,7 +725,8 @@ void Test_method::testBackflow() {
       
       backflow_config(sample,e,jast_corr,onebody,threebody_diffspin,tmp_sample);
       
-      backflow.updateLap(sample,jast,e,0,newvals,deriv_tmp,lap_tmp);
+      backflow.updateLap(sample,jast,e,0,newvals,deriv_tmp,lap_tmp,
+                         bf_sample,mo_ws);
       
       tmp_sample->getElectronPos(0,diff_pos);
       //if(j>e) { 
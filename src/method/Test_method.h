@@ -32,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 class Program_options;
 #include "Basis_function.h"
 #include "Backflow_wf_data.h"
+#include "MO_matrix.h"
 #include "System.h"
 /*!
 \brief
@@ -49,6 +50,7 @@ public:
   {
 
     deallocate(wfdata);
+    deallocate(compare_wfdata);
     if(sysprop) delete sysprop;
   }
 
@@ -57,6 +59,8 @@ public:
   void testBackflow();
   void plotCusp(Wavefunction * mywf, Sample_point * sample);
   void testParmDeriv(Wavefunction * mywf, Sample_point * sample);
+  void compareWf(Wavefunction * mywf, Sample_point * sample);
+  void testOrbitalBatch(Sample_point * sample);
   int nelectrons; //!< Number of electrons
   string wfoutputfile;
   System * sysprop;
@@ -71,6 +75,16 @@ public:
   int plot_cusp;
   int parms_ders;
   int testhessian;
+  //! A second wave function that should give the same values as the
+  //! trial function, such as one with a different updating scheme
+  Wavefunction_data * compare_wfdata;
+  int compare_steps;
+  //! Recompute the comparison function at every step instead of updating
+  int compare_recompute;
+  //! Orbitals to check the batched evaluations of
+  MO_matrix * batch_mo;
+  //! Largest difference from the one-at-a-time evaluations that passes
+  doublevar batch_tolerance;
 };
 
 #endif //TEST_METHOD_H_INCLUDED
@@ -72,17 +72,16 @@ void Vmc_method::read(vector <string> words,
   //myprop.read(proptxt, options.systemtext[0], options.twftext[0]);
 
 
-  vector <string> dynsec;
-  if(!readsection(words, pos=0, dynsec, "DYNAMICS")) {
-    dynsec.push_back("SPLIT");
-    dynsec.push_back("DEPTH");
-    dynsec.push_back("2");
-    dynsec.push_back("DIVIDER");
-    dynsec.push_back("2");
+  if(!readsection(words, pos=0, dynamics_words, "DYNAMICS")) {
+    dynamics_words.push_back("SPLIT");
+    dynamics_words.push_back("DEPTH");
+    dynamics_words.push_back("2");
+    dynamics_words.push_back("DIVIDER");
+    dynamics_words.push_back("2");
   }
     
 
-  allocate(dynsec, sampler);
+  allocate(dynamics_words, sampler);
   
   vector<string> tmp_dens;
   pos=0;
@@ -128,6 +127,7 @@ void Vmc_method::read(vector <string> words,
 
   low_io=0;
   if(haskeyword(words,pos=0,"LOW_IO")) low_io=1;
+  text_config=haskeyword(words,pos=0,"TEXT_CONFIG");
  
 }
 
@@ -167,7 +167,8 @@ int Vmc_method::generateVariables(Program_options & options) {
 //----------------------------------------------------------------------
 
 int Vmc_method::allocateIntermediateVariables(System * locsys, 
-                                              Wavefunction_data * locwfdata) {
+                                              Wavefunction_data * locwfdata,
+                                              Pseudopotential * locpsp) {
 
 //  debug_write(cout, "temporary variables\n");
   locsys->generateSample(sample);
@@ -180,7 +181,11 @@ int Vmc_method::allocateIntermediateVariables(System * locsys,
   for(int i=0; i< average_var.GetDim(0); i++) { 
     allocate(avg_words[i], locsys, locwfdata, average_var(i));
   }
-  
+
+  threads.allocate(locsys, locwfdata, locpsp, sample, wf, sampler,
+                   average_var, dynamics_words, avg_words);
+  threads.allocateDensities(densplt);
+  seed_thread_rng();
   
   return 1;
 }
@@ -188,6 +193,7 @@ int Vmc_method::allocateIntermediateVariables(System * locsys,
 //----------------------------------------------------------------------
 
 int Vmc_method::deallocateIntermediateVariables() {
+  threads.clear();
   if(wf) delete wf;
   wf=NULL;
   if(sample) delete sample;
@@ -221,6 +227,7 @@ int Vmc_method::showinfo(ostream & os)
     os << "Configurations per processor: " <<  nconfig   << endl;
     os << "Number of processors: "        <<  mpi_info.nprocs << endl;
     os << "Total configurations: " <<          nconfig*mpi_info.nprocs << endl;
+    os << "Threads per processor: " <<         qmc_nthreads() << endl;
     os << "Blocks: " <<                        nblock    << endl;
     os << "Steps per block: " <<               nstep     << endl;
     os << "Number of decorrelation steps: " << ndecorr   << endl;
@@ -278,6 +285,21 @@ void Vmc_method::readcheck(string & filename) {
       single_write(cout,"Could not open ",filename,". Generating configurations from scratch\n");
     }
   }
+  //Each process gets its share of the file, however many processes 
+  //wrote it.  Missing walkers are generated and extra ones dropped.
+  long int ntot;
+  parallel_prefix_sum(config_pos.GetDim(0),ntot);
+  if(ntot > 0 && ntot != long(nconfig)*mpi_info.nprocs) { 
+    stringstream warn;
+    warn << "Warning: " << filename << " has " << ntot << " walkers, but "
+         << "this run has " << nconfig*mpi_info.nprocs << ".\n";
+    single_write(cout,warn.str());
+  }
+  if(config_pos.GetDim(0) > nconfig) { 
+    Array1 <Config_save_point> tmpconfig=config_pos;
+    config_pos.Resize(nconfig);
+    for(int i=0; i< nconfig; i++) config_pos(i)=tmpconfig(i);
+  }
   if(config_pos.GetDim(0) < nconfig) { 
     Array1 <Config_save_point> tmpconfig=config_pos;
     config_pos.Resize(nconfig);
@@ -317,7 +339,8 @@ void Vmc_method::storecheck(string & filename, int append) {
 
   string tmpfilename="tmp.config";
    */
-  write_configurations(filename, config_pos);
+  if(text_config) write_configurations(filename, config_pos, checkpoint_writer);
+  else write_binary_configurations(filename, config_pos, checkpoint_writer);
 }
 
 
@@ -358,8 +381,14 @@ void Vmc_method::runWithVariables(Properties_manager & prop,
   nelectrons=sys->nelectrons(0)+sys->nelectrons(1);
 
   
-  allocateIntermediateVariables(sys, wfdata);
+  allocateIntermediateVariables(sys, wfdata, psp);
   readcheck(readconfig);
+  //VMC doesn't branch, so the walkers keep their index for the whole run,
+  //and it's used as their stream.  The VMC configuration files only have 
+  //the positions, so unlike DMC a restarted VMC run doesn't know how many
+  //runs came before it; it only differs from the first one by where the 
+  //walkers start.
+  Random_generator::newStreamEpoch();
   
   doublevar est_timestep=generate_sample(sample,wf,wfdata,guidewf,nconfig,
                                          config_pos,50,10);
@@ -376,6 +405,12 @@ void Vmc_method::runWithVariables(Properties_manager & prop,
   prop.setSize(wf->nfunc(), nblock, nstep, nconfig, sys, wfdata);
   output.precision(10);
   prop.initializeLog(average_var);
+  //Thread 0 inserts directly into prop; the others are merged into it
+  //at the end of each block.
+  int nthreads=threads.nthreads();
+  Array1 <Properties_manager> thread_prop(nthreads);
+  for(int t=1; t< nthreads; t++) 
+    thread_prop(t).setSize(wf->nfunc(), nblock, nstep, nconfig, sys, wfdata);
   //our averaging variables
   Array1 <doublevar> avglifetime(nblock);
   unsigned int maxlife=0;
@@ -388,27 +423,44 @@ void Vmc_method::runWithVariables(Properties_manager & prop,
  
   for(int block=0; block< nblock; block++) {
     int nwf_guide=wf->nfunc();
-    Dynamics_info dinfo;
 
     doublevar acceptance=0;
+    doublevar block_lifetime=0, block_diffusion=0;
+    //The walkers are split between the threads in fixed blocks, so that 
+    //each thread's sequential random numbers go to the same walkers on 
+    //every run.  Without RANDOM_STREAMS, the results then still depend on 
+    //the number of threads, but a run with the same seed and number of 
+    //threads is reproduced.
+#pragma omp parallel for schedule(static) \
+    reduction(+:acceptance,block_lifetime,block_diffusion) \
+    reduction(max:maxlife)
     for(int walker=0; walker<nconfig; walker++) {  
+      int t=qmc_thread_id();
+      Sample_point * tsample=threads.sample(t);
+      Wavefunction * twf=threads.wf(t);
+      Pseudopotential * tpsp=threads.pseudo(t);
+      Dynamics_generator * tsampler=threads.dyngen(t);
+      Properties_manager & tprop=(t==0)?prop:thread_prop(t);
+      Dynamics_info dinfo;
       
-      config_pos(walker).restorePos(sample);
-      wf->notify(all_electrons_move,0);
+      config_pos(walker).restorePos(tsample);
+      twf->notify(all_electrons_move,0);
      
-      wf->updateLap(wfdata, sample);
+      twf->updateLap(wfdata, tsample);
       
       if(print_wf_vals) { 
         Wf_return wfval(nwf_guide,2);
-        wf->getVal(wfdata,0, wfval);
+        twf->getVal(wfdata,0, wfval);
+#pragma omp critical(vmc_output)
         cout << "node " << mpi_info.node << "  amp " << wfval.amp(0,0) 
           << " phase " << cos(wfval.phase(0,0)) << endl;
       }
       
       for(int step=0; step< nstep; step++) {
+        rng.setStream(mpi_info.node*nconfig+walker, block*nstep+step);
         Array1 <doublevar> rotx(3), roty(3), rotz(3);
         generate_random_rotation(rotx, roty, rotz);
-        psp->rotateQuadrature(rotx, roty, rotz);
+        tpsp->rotateQuadrature(rotx, roty, rotz);
 
         //------------------------------------------
         
@@ -417,23 +469,26 @@ void Vmc_method::runWithVariables(Properties_manager & prop,
         for(int decorr=0; decorr< ndecorr; decorr++) {
 
             for(int e=0; e<nelectrons; e++) {
-              sample->getElectronPos(e,oldpos);
+              tsample->getElectronPos(e,oldpos);
               
-              int acc=sampler->sample(e,sample, wf, 
+              int acc=tsampler->sample(e,tsample, twf, 
                                  wfdata, guidewf,dinfo, timestep);
-              sample->getElectronPos(e,newpos);
+              tsample->getElectronPos(e,newpos);
               
               for(int d=0; d< 3; d++) {
-                diffusion_rate(block)+=(newpos(d)-oldpos(d))                  
+                block_diffusion+=(newpos(d)-oldpos(d))                  
                   *(newpos(d)-oldpos(d));
               }
               if(print_wf_vals) { 
                 Wf_return wfval(nwf_guide, 2);
-                wf->getVal(wfdata,0,wfval);
+                twf->getVal(wfdata,0,wfval);
+#pragma omp critical(vmc_output)
+                {
                 cout << "step " << e << " amp " << wfval.amp(0,0) 
                   << " phase " << cos(wfval.phase(0,0)) << endl;
                 cout << "pos " << newpos(0) << " " << newpos(1) << " " 
                   << newpos(2) << endl;
+                }
               }
               
               if(acc>0) {
@@ -444,55 +499,70 @@ void Vmc_method::runWithVariables(Properties_manager & prop,
                 age(walker,e)++;
                 if(age(walker,e) > maxlife) maxlife=age(walker,e);
               }
-              avglifetime(block)+=age(walker, e);
+              block_lifetime+=age(walker, e);
            }  //electron
         }  //decorrelation
           
         
         Properties_point pt;
-        mygather.gatherData(pt, psp, sys, wfdata, wf, 
-                            sample, guidewf);
+        mygather.gatherData(pt, tpsp, threads.sys(t), wfdata, twf, 
+                            tsample, guidewf);
         
         for(int i=0; i< densplt.GetDim(0); i++)
 
-          densplt(i)->accumulate(sample,1.0);
-        for(int i=0; i< nldensplt.GetDim(0); i++)
-          nldensplt(i)->accumulate(sample,1.0,wfdata,wf);
+          threads.densplt(t,i)->accumulate(tsample,1.0);
+        //the nonlocal densities have no per-thread copies
+        if(nldensplt.GetDim(0) > 0) { 
+#pragma omp critical(vmc_density)
+          for(int i=0; i< nldensplt.GetDim(0); i++)
+            nldensplt(i)->accumulate(tsample,1.0,wfdata,twf);
+        }
         
         pt.avgrets.Resize(1,average_var.GetDim(0));
         for(int i=0; i< average_var.GetDim(0); i++) { 
-          average_var(i)->randomize(wfdata,wf,sys,sample);
-          average_var(i)->evaluate(wfdata, wf, sys, psp, sample,pt, pt.avgrets(0,i));
+          Average_generator * avg=threads.average_var(t,i);
+          avg->randomize(wfdata,twf,threads.sys(t),tsample);
+          avg->evaluate(wfdata, twf, threads.sys(t), tpsp, tsample,pt, pt.avgrets(0,i));
         }
         pt.parent=walker;
         pt.nchildren=1; pt.children(0)=1;
-        prop.insertPoint(step, walker, pt);
+        tprop.insertPoint(step, walker, pt);
         
         //This may screw up if we have >1 walker!
         if(config_trace!="" && block >0) {
           if(nconfig !=1) error("trace only works with nconfig=1");
-          config_pos(walker).savePos(sample);
+          config_pos(walker).savePos(tsample);
           storecheck(config_trace,1);
         }
         if(dump_file!="") { 
           if(mpi_info.nprocs !=1) error("Only one processor dump for now");
+#pragma omp critical(vmc_dump)
+          {
           ofstream dumpout(dump_file.c_str(),ios::app);
           dumpout << pt.energy(0) << " ";
           dumpout << pt.wf_val.sign(0) << " " << pt.wf_val.amp(0,0) << " ";
           for(int e=0; e< nelectrons; e++)  { 
-            sample->getElectronPos(e,newpos);
+            tsample->getElectronPos(e,newpos);
             for(int d=0; d< 3; d++) dumpout << newpos(d) << " ";
           }
           dumpout << endl;
+          }
             
         }
         
       }   //step
+      rng.endStream();
       
-      config_pos(walker).savePos(sample);
+      config_pos(walker).savePos(tsample);
       
     }   //walker
+    avglifetime(block)+=block_lifetime;
+    diffusion_rate(block)+=block_diffusion;
 
+    for(int t=1; t< nthreads; t++) 
+      prop.mergeBlock(thread_prop(t));
+    threads.reduceDensities();
+    threads.reduceStats();
     prop.endBlock();
     if(!low_io || block==nblock-1) { 
       storecheck(storeconfig);
@@ -534,6 +604,7 @@ void Vmc_method::runWithVariables(Properties_manager & prop,
       jsonout << "<RS>" << endl;
     }
   }              //blocks done
+  checkpoint_writer.wait();
 
 
 
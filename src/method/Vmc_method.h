@@ -31,6 +31,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "Pseudopotential.h"
 #include "Split_sample.h"
 #include "Space_warper.h"
+#include "Walker_threads.h"
+#include "Checkpoint_writer.h"
 class Program_options;
 #include "Properties.h"
 
@@ -38,6 +40,11 @@ class Program_options;
 \brief
 Evaluates the expectation value \f$ <\Psi|H|\Psi>/<\Psi|\Psi> \f$
 stochastically.  Keyword: VMC 
+
+When compiled with OpenMP, the walkers on each processor are divided
+among the threads.  Each thread inserts its points into its own 
+Properties_manager and densities, which are added together at the end
+of every block.
 */
 class Vmc_method : public Qmc_avg_method
 {
@@ -90,7 +97,8 @@ public:
    }
 
 private:
-  int allocateIntermediateVariables(System * , Wavefunction_data *);
+  int allocateIntermediateVariables(System * , Wavefunction_data *,
+                                    Pseudopotential *);
   int deallocateIntermediateVariables();
   void readcheck(string & );
   void storecheck(string &, int append=0);
@@ -99,6 +107,9 @@ private:
   int have_attached_variables;
 
   Dynamics_generator * sampler;
+  vector <string> dynamics_words;
+  Walker_threads threads;
+  Checkpoint_writer checkpoint_writer;
 
   int nblock;
   int nstep;
@@ -117,6 +128,7 @@ private:
   int ndim;
   int print_wf_vals; //!< whether or not to put the values of the wavefunction to cout
   int low_io; //!< Only output the configurations and any Density objects at the end of the run, not every block
+  int text_config; //!< write the configurations as text instead of binary
   string config_trace; //!< where to lay down a trace of configurations
 
   string guidetype;
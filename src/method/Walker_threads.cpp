@@ -0,0 +1,117 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include "Walker_threads.h"
+
+void Walker_threads::allocate(System * sys_, Wavefunction_data * wfdata,
+                              Pseudopotential * pseudo_,
+                              Sample_point * sample_,
+                              Wavefunction * wf_,
+                              Dynamics_generator * dyngen_,
+                              Array1 <Average_generator *> & average_var_,
+                              vector <string> & dynamics_words,
+                              vector <vector <string> > & avg_words) {
+  clear();
+  int nthreads=qmc_nthreads();
+  int navg=average_var_.GetDim(0);
+  sys.Resize(nthreads);
+  pseudo.Resize(nthreads);
+  sample.Resize(nthreads);
+  wf.Resize(nthreads);
+  dyngen.Resize(nthreads);
+  average_var.Resize(nthreads,navg);
+  sys=NULL; pseudo=NULL; sample=NULL; wf=NULL; dyngen=NULL;
+  average_var=NULL;
+
+  sys(0)=sys_;
+  pseudo(0)=pseudo_;
+  sample(0)=sample_;
+  wf(0)=wf_;
+  dyngen(0)=dyngen_;
+  for(int i=0; i< navg; i++) average_var(0,i)=average_var_(i);
+
+  //The constructors may read files or broadcast over MPI, so the
+  //copies are made serially.
+  for(int t=1; t< nthreads; t++) {
+    sys_->makeCopy(sys(t));
+    if(pseudo_) pseudo_->makeCopy(pseudo(t));
+    wfdata->generateWavefunction(wf(t));
+    sys(t)->generateSample(sample(t));
+    sample(t)->attachObserver(wf(t));
+    if(dyngen_) ::allocate(dynamics_words, dyngen(t));
+    for(int i=0; i< navg; i++)
+      ::allocate(avg_words[i], sys(t), wfdata, average_var(t,i));
+  }
+}
+
+//----------------------------------------------------------------------
+
+void Walker_threads::allocateDensities(Array1 <Local_density_accumulator *> & densplt_) {
+  int nthreads=sample.GetDim(0);
+  int ndens=densplt_.GetDim(0);
+  assert(nthreads > 0);
+  densplt.Resize(nthreads,ndens);
+  for(int i=0; i< ndens; i++) { 
+    densplt(0,i)=densplt_(i);
+    for(int t=1; t< nthreads; t++) 
+      densplt_(i)->makeEmptyCopy(sys(t),densplt(t,i));
+  }
+}
+
+//----------------------------------------------------------------------
+
+void Walker_threads::reduceDensities() { 
+  for(int t=1; t< densplt.GetDim(0); t++) 
+    for(int i=0; i< densplt.GetDim(1); i++) 
+      densplt(0,i)->addAndClear(densplt(t,i));
+}
+
+//----------------------------------------------------------------------
+
+void Walker_threads::reduceStats() { 
+  for(int t=1; t< dyngen.GetDim(0); t++) 
+    if(dyngen(t)) dyngen(0)->addStats(dyngen(t));
+}
+
+//----------------------------------------------------------------------
+
+void Walker_threads::clear() {
+  for(int t=1; t< densplt.GetDim(0); t++) 
+    for(int i=0; i< densplt.GetDim(1); i++) 
+      if(densplt(t,i)) delete densplt(t,i);
+  densplt.Resize(0,0);
+  for(int t=1; t< sample.GetDim(0); t++) {
+    for(int i=0; i< average_var.GetDim(1); i++)
+      if(average_var(t,i)) delete average_var(t,i);
+    if(dyngen(t)) delete dyngen(t);
+    if(sample(t)) delete sample(t);
+    deallocate(wf(t));
+    if(pseudo(t)) delete pseudo(t);
+    if(sys(t)) delete sys(t);
+  }
+  sys.Resize(0);
+  pseudo.Resize(0);
+  sample.Resize(0);
+  wf.Resize(0);
+  dyngen.Resize(0);
+  average_var.Resize(0,0);
+}
+
+//----------------------------------------------------------------------
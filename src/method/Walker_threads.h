@@ -0,0 +1,89 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef WALKER_THREADS_H_INCLUDED
+#define WALKER_THREADS_H_INCLUDED
+
+#include "Qmc_std.h"
+#include "Wavefunction.h"
+#include "Wavefunction_data.h"
+#include "Sample_point.h"
+#include "System.h"
+#include "Pseudopotential.h"
+#include "Split_sample.h"
+#include "Average_generator.h"
+#include "Properties.h"
+
+/*!
+\brief
+The objects that a thread needs to move walkers on its own.
+
+Element 0 is the set owned by the calling method, so a run with a
+single thread uses exactly the same objects as the serial code.  The
+other threads get their own System, Sample_point, Wavefunction,
+Dynamics_generator, Average_generators and Pseudopotential quadrature.
+The wave function data (orbitals, Jastrow parameters) and the radial
+pseudopotential tables are shared between all of the threads.
+*/
+class Walker_threads {
+ public:
+  Walker_threads() { }
+  ~Walker_threads() { clear(); }
+
+  void allocate(System * sys_, Wavefunction_data * wfdata,
+                Pseudopotential * pseudo_, Sample_point * sample_,
+                Wavefunction * wf_, Dynamics_generator * dyngen_,
+                Array1 <Average_generator *> & average_var_,
+                vector <string> & dynamics_words,
+                vector <vector <string> > & avg_words);
+
+  /*!
+    Give each thread an empty copy of the density accumulators; element
+    0 is densplt_ itself.  Call after allocate().
+   */
+  void allocateDensities(Array1 <Local_density_accumulator *> & densplt_);
+
+  /*!
+    Add the thread copies of the densities into element 0.  This must be 
+    done before writing them.
+   */
+  void reduceDensities();
+
+  /*!
+    Add the statistics of the threads' Dynamics_generators into 
+    element 0's.
+   */
+  void reduceStats();
+
+  void clear();
+
+  int nthreads() { return sample.GetDim(0); }
+
+  Array1 <System *> sys;
+  Array1 <Pseudopotential *> pseudo;
+  Array1 <Sample_point *> sample;
+  Array1 <Wavefunction *> wf;
+  Array1 <Dynamics_generator *> dyngen;
+  Array2 <Average_generator *> average_var; //!< (thread, average)
+  Array2 <Local_density_accumulator *> densplt; //!< (thread, density)
+};
+
+#endif //WALKER_THREADS_H_INCLUDED
+//----------------------------------------------------------------------
@@ -52,7 +52,6 @@ void Center_set::read(vector <string> & words, unsigned int pos,
 {
 
   usingsampcenters=usingatoms=0;
-  int nelectrons=sys->nelectrons(0)+sys->nelectrons(1);
   unsigned int startpos=pos;
 
   if(readvalue(words,pos, centerfile, "READ"))
@@ -102,7 +101,6 @@ void Center_set::read(vector <string> & words, unsigned int pos,
   }
 
 
-  edist.Resize(nelectrons,ncenters, 5);
   nbasis.Resize(ncenters);
   nbasis=0;
 }
@@ -168,8 +166,10 @@ void Center_set::assignBasis(Array1 <CBasis_function *> basisfunc)
 
 //------------------------------------------------------------
 
-void Center_set::updateDistance(int e, Sample_point * sample)
+void Center_set::updateDistance(int e, Sample_point * sample,
+                                Array2 <doublevar> & edist)
 {
+  edist.Resize(ncenters,5);
   if(usingatoms)
   {
     Array1 <doublevar> R(5);
@@ -179,7 +179,7 @@ void Center_set::updateDistance(int e, Sample_point * sample)
       sample->getEIDist(e, i, R);
       for(int d=0; d< 5; d++)
       {
-        edist(e,i,d)=R(d);
+        edist(i,d)=R(d);
       }
     }
   }
@@ -191,7 +191,7 @@ void Center_set::updateDistance(int e, Sample_point * sample)
       sample->getECDist(e, i, R);
       for(int d=0; d< 5; d++)
       {
-        edist(e,i,d)=R(d);
+        edist(i,d)=R(d);
       }
     }
   }
@@ -201,17 +201,17 @@ void Center_set::updateDistance(int e, Sample_point * sample)
     sample->getElectronPos(e, r);
     for(int i=0; i< ncenters; i++)
     {
-      edist(e,i,1)=0;
+      edist(i,1)=0;
       for(int d=0; d< 3; d++)
       {
-        edist(e,i,d+2)=r(d)-position(i,d);
-	//cout << "positions " << position(i,d) << " dist " << edist(e,i,d+2) <<  endl;
-        edist(e,i,1)+=edist(e,i,d+2)*edist(e,i,d+2);
+        edist(i,d+2)=r(d)-position(i,d);
+	//cout << "positions " << position(i,d) << " dist " << edist(i,d+2) <<  endl;
+        edist(i,1)+=edist(i,d+2)*edist(i,d+2);
       }
     }
     for(int i=0; i< ncenters; i++)
     {
-      edist(e,i,0)=sqrt(edist(e,i,1));
+      edist(i,0)=sqrt(edist(i,1));
     }
 
   }
@@ -66,16 +66,21 @@ public:
   void assignBasis(Array1 <Basis_function *>);
   void assignBasis(Array1 <CBasis_function *>);
 
-  void updateDistance(int, Sample_point *);
-  void getDistance(const int e, const int cent,
-                   Array1 <doublevar> & distance)
+  /*!
+    Calculate the distances from electron e to all the centers, in the
+    form (center, [r, r^2, x, y, z]).  The result is stored by the caller,
+    so the centers can be shared between threads.
+   */
+  void updateDistance(int e, Sample_point * sample, 
+                      Array2 <doublevar> & edist);
+  void getDistance(const Array2 <doublevar> & edist, const int cent,
+                   Array1 <doublevar> & distance) const
   {
-    assert(e< edist.GetDim(0));
-    assert(cent < ncenters);
+    assert(cent < edist.GetDim(0));
     assert(distance.GetDim(0) >=5);
     for(int d=0; d< 5; d++)
     {
-      distance(d)=edist(e,cent,d);
+      distance(d)=edist(cent,d);
     }
   }
 
@@ -128,7 +133,6 @@ private:
   int usingatoms;
   int usingsampcenters;
   Array2 <doublevar> position;
-  Array3 <doublevar> edist;
   
   vector <string> labels;
 
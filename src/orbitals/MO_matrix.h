@@ -56,6 +56,37 @@ class General_MO_matrix {
 //----------------------------------------------------------------------
 
 
+/*!
+\brief
+Scratch space for evaluating the orbitals of a Templated_MO_matrix.
+
+The MO matrices keep nothing that changes from one evaluation to the
+next; instead each caller owns one of these and passes it to
+updateVal/updateLap/updateHessian.  That way a single set of orbitals
+can be evaluated by several walkers at once.  The arrays are sized by
+the MO matrix as needed, so an empty workspace can be passed the first
+time.
+*/
+template <class T> class MO_workspace {
+ public:
+  Array2 <doublevar> edist;  //!< (center, [r,r^2,x,y,z]) for the electron
+  Array1 <doublevar> R;      //!< distance to a single center
+  Array1 <doublevar> symmvals1d; //!< values of one basis object
+  Array2 <doublevar> symmvals2d; //!< (function, derivatives) of one basis object
+  Array1 <T> basisvals1d;     //!< values of all the basis functions
+  Array2 <T> basisvals2d;     //!< (function, derivatives) of all the basis functions
+  Array2 <T> sum;             //!< (function, derivatives) summed over equivalent centers
+  Array2 <T> newvals;         //!< (derivative, MO) result before transposing
+  Array1 <T *> moplace;       //!< coefficient rows that contribute
+  Array2 <T> sval;            //!< (contribution, derivative)
+  Array2 <T> basisblock;      //!< ([walker, derivative], function) for batches
+  Array2 <T> moblock;         //!< ([walker, derivative], MO) for batches
+  MO_workspace() { R.Resize(5); }
+};
+
+//----------------------------------------------------------------------
+
+
 template <class T> class Templated_MO_matrix: public General_MO_matrix {
 protected:
   Center_set centers;
@@ -70,6 +101,7 @@ protected:
   string oldsofile;
 
   Array1 <doublevar> kpoint; //!< the k-point of the orbitals in fractional units(1 0 0) is X, etc..
+  MO_workspace <T> default_workspace;
 public:
 
   /*!
@@ -98,13 +130,19 @@ public:
   virtual void writeorb(ostream &, Array2 <doublevar> & rotation, Array1 <int> &)
   { error("writeorb not implemented"); } 
 
+  /*!
+    Evaluate the orbitals in list listnum at the position of electron e,
+    using the scratch space in ws.  This does not change the MO matrix, 
+    so it may be called from several threads with different workspaces.
+   */
   virtual void updateVal(
     Sample_point * sample,
     int e,
     //!< electron number
     int listnum,
-    Array2 <T> & newvals
+    Array2 <T> & newvals,
     //!< The return: in form (MO)
+    MO_workspace <T> & ws
   )=0;
 
   virtual void updateLap(
@@ -113,19 +151,86 @@ public:
     //!< electron number
     int listnum,
     //!< Choose the list that was built in buildLists
-    Array2 <T> & newvals
+    Array2 <T> & newvals,
     //!< The return: in form (MO,[value gradient lap])
+    MO_workspace <T> & ws
   )=0;
 
   virtual void updateHessian(Sample_point * sample,
 			     int e,
 			     int listnum,
-			     Array2 <T>& newvals
+			     Array2 <T>& newvals,
 			     //!< in form (MO, [value gradient, dxx,dyy,dzz,dxy,dxz,dyz])
+			     MO_workspace <T> & ws
 			     ) { 
     error("this MO_matrix doesn't support Hessians");
   }
 
+  /*!
+    Evaluate electron e of several walkers at once; newvals(w) is what
+    updateVal would give for samples(w), and must already have the right
+    size.  This version just calls updateVal for each walker.
+   */
+  virtual void updateValBatch(Array1 <Sample_point *> & samples,
+                              int e, int listnum,
+                              Array1 <Array2 <T> > & newvals,
+                              MO_workspace <T> & ws) {
+    assert(newvals.GetDim(0) >= samples.GetDim(0));
+    for(int w=0; w< samples.GetDim(0); w++)
+      updateVal(samples(w),e,listnum,newvals(w),ws);
+  }
+
+  //! As updateValBatch, for updateLap
+  virtual void updateLapBatch(Array1 <Sample_point *> & samples,
+                              int e, int listnum,
+                              Array1 <Array2 <T> > & newvals,
+                              MO_workspace <T> & ws) {
+    assert(newvals.GetDim(0) >= samples.GetDim(0));
+    for(int w=0; w< samples.GetDim(0); w++)
+      updateLap(samples(w),e,listnum,newvals(w),ws);
+  }
+
+  /*!
+    Evaluate electron e of one sample at each of the positions pos(k,:);
+    newvals(k) is what updateVal would give with the electron moved 
+    there.  The electron is put back afterwards.  This version just calls
+    updateVal for each position.
+   */
+  virtual void updateValBatch(Sample_point * sample, int e,
+                              const Array2 <doublevar> & pos, int listnum,
+                              Array1 <Array2 <T> > & newvals,
+                              MO_workspace <T> & ws) {
+    int npos=pos.GetDim(0);
+    int ndim=pos.GetDim(1);
+    assert(newvals.GetDim(0) >= npos);
+    Array1 <doublevar> oldpos(ndim), newpos(ndim);
+    sample->getElectronPos(e,oldpos);
+    for(int k=0; k< npos; k++) { 
+      for(int d=0; d< ndim; d++) newpos(d)=pos(k,d);
+      sample->setElectronPosNoNotify(e,newpos);
+      sample->updateEIDist();
+      updateVal(sample,e,listnum,newvals(k),ws);
+    }
+    sample->setElectronPosNoNotify(e,oldpos);
+  }
+
+  /*!
+    The same as above, using a workspace owned by the MO matrix.  These
+    are for serial callers only.
+   */
+  void updateVal(Sample_point * sample, int e, int listnum,
+                 Array2 <T> & newvals) {
+    updateVal(sample,e,listnum,newvals,default_workspace);
+  }
+  void updateLap(Sample_point * sample, int e, int listnum,
+                 Array2 <T> & newvals) {
+    updateLap(sample,e,listnum,newvals,default_workspace);
+  }
+  void updateHessian(Sample_point * sample, int e, int listnum,
+                     Array2 <T> & newvals) {
+    updateHessian(sample,e,listnum,newvals,default_workspace);
+  }
+
   Templated_MO_matrix()
   {}
 
@@ -310,14 +310,16 @@ void MO_matrix_Cbasfunc::read(vector <string> & words,
 void MO_matrix_Cbasfunc::updateVal(Sample_point * sample, int e,
                                    int listnum,
                                    //!< which list to use
-                                   Array2 <dcomplex> & newvals
+                                   Array2 <dcomplex> & newvals,
                                    //!< The return: in form (MO, val)
+                                   MO_workspace <dcomplex> & ws
 ) {
 
-  Array1 <dcomplex> basisvals(totbasis);
-  centers.updateDistance(e, sample);
+  Array1 <dcomplex> & basisvals(ws.basisvals1d);
+  basisvals.Resize(totbasis);
+  centers.updateDistance(e, sample, ws.edist);
   CBasis_function * tempbasis;
-  Array1 <doublevar> R(5);
+  Array1 <doublevar> & R(ws.R);
   int currfunc=0;
   newvals=0;
   // some problem with Array.h and this shorthand, going back to
@@ -341,7 +343,7 @@ void MO_matrix_Cbasfunc::updateVal(Sample_point * sample, int e,
   for(int ion=0; ion < centers.equiv_centers.GetDim(0); ion++) {
     for(int c=0; c < centers.ncenters_atom(ion); c++) {
       int cen2=centers.equiv_centers(ion, c);
-      centers.getDistance(e, cen2, R);
+      centers.getDistance(ws.edist, cen2, R);
       for(int n=0; n < centers.nbasis(cen2); n++) {
 	int b=centers.basis(cen2,n);
 	tempbasis=basis(b);
@@ -372,16 +374,18 @@ void MO_matrix_Cbasfunc::updateVal(Sample_point * sample, int e,
 void MO_matrix_Cbasfunc::updateLap(Sample_point * sample, int e,
 				  int listnum,
 				  //!< which list to use
-				  Array2 <dcomplex> & newvals
+				  Array2 <dcomplex> & newvals,
 				  //!< The return: in form (MO, [val, grad, lap])
+				  MO_workspace <dcomplex> & ws
 ) {
   // exactly the same structure as updateVal above, only assigns
   // 5 values (function, 3 gradient components, laplacian) instead
   // of just one
-  Array2 <dcomplex> basisvals(totbasis,5);
-  centers.updateDistance(e, sample);
+  Array2 <dcomplex> & basisvals(ws.basisvals2d);
+  basisvals.Resize(totbasis,5);
+  centers.updateDistance(e, sample, ws.edist);
   CBasis_function * tempbasis;
-  Array1 <doublevar> R(5);
+  Array1 <doublevar> & R(ws.R);
   int currfunc=0;
   newvals=0;
   basisvals=0;
@@ -390,7 +394,7 @@ void MO_matrix_Cbasfunc::updateLap(Sample_point * sample, int e,
   for(int ion=0; ion < centers.equiv_centers.GetDim(0); ion++) {
     for(int c=0; c < centers.ncenters_atom(ion); c++) {
       int cen2=centers.equiv_centers(ion, c);
-      centers.getDistance(e, cen2, R);
+      centers.getDistance(ws.edist, cen2, R);
       for(int n=0; n < centers.nbasis(cen2); n++) {
 	int b=centers.basis(cen2,n);
 	tempbasis=basis(b);
@@ -92,6 +92,10 @@ public:
   virtual void read(vector <string> & words, unsigned int & startpos, 
                     System * sys);
 
+  using Complex_MO_matrix::updateVal;
+  using Complex_MO_matrix::updateLap;
+  using Complex_MO_matrix::updateHessian;
+
   // finally, the two key functions of the class that actually evaluate the
   // molecular orbitals (and their derivatives)
   virtual void updateVal(Sample_point * sample,
@@ -99,8 +103,9 @@ public:
 			 //!< electron number
 			 int listnum,
 			 //!< Choose the list that was built in buildLists
-			 Array2 <dcomplex> & newvals
+			 Array2 <dcomplex> & newvals,
 			 //!< The return: in form (MO)
+			 MO_workspace <dcomplex> & ws
 			 );
   
   virtual void updateLap(Sample_point * sample,
@@ -108,8 +113,9 @@ public:
 			 //!< electron number
 			 int listnum,
 			 //!< Choose the list that was built in buildLists
-			 Array2 <dcomplex> & newvals
+			 Array2 <dcomplex> & newvals,
 			 //!< The return: in form ([value gradient lap], MO)
+			 MO_workspace <dcomplex> & ws
 			 );
 
   virtual void updateHessian(Sample_point * sample,
@@ -117,8 +123,9 @@ public:
 			     //!< electron number
 			     int listnum,
 			     //!< Choose the list that was built in buildLists
-			     Array2 <dcomplex>& newvals
+			     Array2 <dcomplex>& newvals,
 			     //!< in form ([value gradient, dxx,dyy,dzz,dxy,dxz,dyz], MO)
+			     MO_workspace <dcomplex> & ws
 			     ) {
     error("CBASFUNC_MO: updateHessian not implemented/adopted.");
   }
@@ -209,14 +209,16 @@ int MO_matrix_basfunc::writeinput(string & indent, ostream & os)
 void MO_matrix_basfunc::updateVal(Sample_point * sample, int e,
                                    int listnum,
                                    //!< which list to use
-                                   Array2 <doublevar> & newvals
+                                   Array2 <doublevar> & newvals,
                                    //!< The return: in form (MO, val)
+                                   MO_workspace <doublevar> & ws
 ) {
 
-  Array1 <doublevar> basisvals(totbasis);
-  centers.updateDistance(e, sample);
+  Array1 <doublevar> & basisvals(ws.basisvals1d);
+  basisvals.Resize(totbasis);
+  centers.updateDistance(e, sample, ws.edist);
   Basis_function * tempbasis;
-  Array1 <doublevar> R(5);
+  Array1 <doublevar> & R(ws.R);
   int currfunc=0;
   newvals=0;
   basisvals=0;
@@ -237,7 +239,7 @@ void MO_matrix_basfunc::updateVal(Sample_point * sample, int e,
   for(int ion=0; ion < centers.equiv_centers.GetDim(0); ion++) {
     for(int c=0; c < centers.ncenters_atom(ion); c++) {
       int cen2=centers.equiv_centers(ion, c);
-      centers.getDistance(e, cen2, R);
+      centers.getDistance(ws.edist, cen2, R);
       for(int n=0; n < centers.nbasis(cen2); n++) {
 	int b=centers.basis(cen2,n);
 	tempbasis=basis(b);
@@ -268,16 +270,18 @@ void MO_matrix_basfunc::updateVal(Sample_point * sample, int e,
 void MO_matrix_basfunc::updateLap(Sample_point * sample, int e,
 				  int listnum,
 				  //!< which list to use
-				  Array2 <doublevar> & newvals
+				  Array2 <doublevar> & newvals,
 				  //!< The return: in form (MO, [val, grad, lap])
+				  MO_workspace <doublevar> & ws
 ) {
   // exactly the same structure as updateVal above, only assigns
   // 5 values (function, 3 gradient components, laplacian) instead
   // of just one
-  Array2 <doublevar> basisvals(totbasis,5);
-  centers.updateDistance(e, sample);
+  Array2 <doublevar> & basisvals(ws.basisvals2d);
+  basisvals.Resize(totbasis,5);
+  centers.updateDistance(e, sample, ws.edist);
   Basis_function * tempbasis;
-  Array1 <doublevar> R(5);
+  Array1 <doublevar> & R(ws.R);
   int currfunc=0;
   newvals=0;
   basisvals=0;
@@ -286,7 +290,7 @@ void MO_matrix_basfunc::updateLap(Sample_point * sample, int e,
   for(int ion=0; ion < centers.equiv_centers.GetDim(0); ion++) {
     for(int c=0; c < centers.ncenters_atom(ion); c++) {
       int cen2=centers.equiv_centers(ion, c);
-      centers.getDistance(e, cen2, R);
+      centers.getDistance(ws.edist, cen2, R);
       for(int n=0; n < centers.nbasis(cen2); n++) {
 	int b=centers.basis(cen2,n);
 	tempbasis=basis(b);
@@ -325,8 +329,9 @@ void MO_matrix_basfunc::updateHessian(
   int listnum,
   //const Array1 <int> & occupation,
   //!<A list of the MO's to evaluate
-  Array2 <doublevar> & newvals
+  Array2 <doublevar> & newvals,
   //!< The return: in form (MO, [val, grad, dxx,dyy,...])
+  MO_workspace <doublevar> & ws
 )
 {
 
@@ -335,10 +340,11 @@ void MO_matrix_basfunc::updateHessian(
   // exactly the same structure as updateVal above, only assigns
   // 5 values (function, 3 gradient components, laplacian) instead
   // of just one
-  Array2 <doublevar> basisvals(totbasis,10);
-  centers.updateDistance(e, sample);
+  Array2 <doublevar> & basisvals(ws.basisvals2d);
+  basisvals.Resize(totbasis,10);
+  centers.updateDistance(e, sample, ws.edist);
   Basis_function * tempbasis;
-  Array1 <doublevar> R(5);
+  Array1 <doublevar> & R(ws.R);
   int currfunc=0;
   newvals=0;
   basisvals=0;
@@ -348,7 +354,7 @@ void MO_matrix_basfunc::updateHessian(
   for(int ion=0; ion < centers.equiv_centers.GetDim(0); ion++) {
     for(int c=0; c < centers.ncenters_atom(ion); c++) {
       int cen2=centers.equiv_centers(ion, c);
-      centers.getDistance(e, cen2, R);
+      centers.getDistance(ws.edist, cen2, R);
       for(int n=0; n < centers.nbasis(cen2); n++) {
 	int b=centers.basis(cen2,n);
 	tempbasis=basis(b);
@@ -92,6 +92,10 @@ public:
     error("BASFUNC_MO: writeorb not implemented");
   }
 
+  using MO_matrix::updateVal;
+  using MO_matrix::updateLap;
+  using MO_matrix::updateHessian;
+
   // finally, the two key functions of the class that actually evaluate the
   // molecular orbitals (and their derivatives)
   virtual void updateVal(Sample_point * sample,
@@ -99,8 +103,9 @@ public:
 			 //!< electron number
 			 int listnum,
 			 //!< Choose the list that was built in buildLists
-			 Array2 <doublevar> & newvals
+			 Array2 <doublevar> & newvals,
 			 //!< The return: in form (MO)
+			 MO_workspace <doublevar> & ws
 			 );
   
   virtual void updateLap(Sample_point * sample,
@@ -108,8 +113,9 @@ public:
 			 //!< electron number
 			 int listnum,
 			 //!< Choose the list that was built in buildLists
-			 Array2 <doublevar> & newvals
+			 Array2 <doublevar> & newvals,
 			 //!< The return: in form ([value gradient lap], MO)
+			 MO_workspace <doublevar> & ws
 			 );
 
   virtual void updateHessian(Sample_point * sample,
@@ -117,8 +123,9 @@ public:
 			     //!< electron number
 			     int listnum,
 			     //!< Choose the list that was built in buildLists
-			     Array2 <doublevar>& newvals
+			     Array2 <doublevar>& newvals,
 			     //!< in form ([value gradient, dxx,dyy,dzz,dxy,dxz,dyz], MO)
+			     MO_workspace <doublevar> & ws
 			     );
 
 
@@ -53,6 +53,16 @@ private:
   doublevar TINY=1e-8; //Cutoff for evaluation of basis functions
   Array1 <T> kptfac; //!< K-point factor for each center.
 
+  void gatherBasis(Sample_point * sample, int e, int nderiv,
+                   Array2 <T> & block, int row, MO_workspace <T> & ws);
+  void startBatch(int npoints, int listnum, int nderiv, 
+                  MO_workspace <T> & ws);
+  void finishBatch(int npoints, int listnum, int nderiv, 
+                   Array1 <Array2 <T> > & newvals, MO_workspace <T> & ws);
+  void evaluateBatch(Array1 <Sample_point *> & samples, int e, int listnum,
+                     int nderiv, Array1 <Array2 <T> > & newvals,
+                     MO_workspace <T> & ws);
+
 public:
 
   /*!
@@ -70,13 +80,17 @@ public:
 
   virtual void writeorb(ostream &, Array2 <doublevar> & rotation, Array1 <int> &);
 
+  using Templated_MO_matrix<T>::updateVal;
+  using Templated_MO_matrix<T>::updateLap;
+
   virtual void updateVal(
     Sample_point * sample,
     int e,
     //!< electron number
     int listnum,
-    Array2 <T> & newvals
+    Array2 <T> & newvals,
     //!< The return: in form (MO)
+    MO_workspace <T> & ws
   );
   
   virtual void updateLap(
@@ -85,10 +99,28 @@ public:
     //!< electron number
     int listnum,
     //!< Choose the list that was built in buildLists
-    Array2 <T> & newvals
+    Array2 <T> & newvals,
     //!< The return: in form ([value gradient lap], MO)
+    MO_workspace <T> & ws
   );
 
+  /*!
+    The basis functions of all the walkers are gathered into one block,
+    and the orbitals are evaluated with a single matrix multiplication.
+   */
+  virtual void updateValBatch(Array1 <Sample_point *> & samples,
+                              int e, int listnum,
+                              Array1 <Array2 <T> > & newvals,
+                              MO_workspace <T> & ws);
+  virtual void updateLapBatch(Array1 <Sample_point *> & samples,
+                              int e, int listnum,
+                              Array1 <Array2 <T> > & newvals,
+                              MO_workspace <T> & ws);
+  virtual void updateValBatch(Sample_point * sample, int e,
+                              const Array2 <doublevar> & pos, int listnum,
+                              Array1 <Array2 <T> > & newvals,
+                              MO_workspace <T> & ws);
+
   MO_matrix_blas()
   {}
 
@@ -321,44 +353,39 @@ inline void product_kernel(int n, dcomplex & a, dcomplex * x, dcomplex * y) {
 }
 
 
-template <class T> struct MOBLAS_CalcObjVal { 
-  T * moplace;
-  T sval;
-};
-
-template <class T> struct MOBLAS_CalcObjLap { 
-  T * moplace;
-  T sval[5];
-};
-
-
-
 template <class T> void MO_matrix_blas<T>::updateVal(Sample_point * sample,
-                    int e, int listnum, Array2 <T> & newvals) {
+                    int e, int listnum, Array2 <T> & newvals,
+                    MO_workspace <T> & ws) {
 
-  int centermax=centers.size();
   int ionmax=centers.equiv_centers.GetDim(0);
   
   assert(e < sample->electronSize());
   assert(newvals.GetDim(1) >=1);
 
 
-  Array1 <doublevar> R(5);
-  static Array1 <doublevar> symmvals_temp(maxbasis);
-  static Array1 <T> symmvals_sum(maxbasis);
-  static Array1 <T> newvals_T;
+  Array1 <doublevar> & R(ws.R);
+  Array1 <doublevar> & symmvals_temp(ws.symmvals1d);
+  Array2 <T> & symmvals_sum(ws.sum);
+  Array2 <T> & newvals_T(ws.newvals);
   Array2 <T> & moCoefftmp(moCoeff_list(listnum));
   int totbasis=moCoefftmp.GetDim(0);
   int nmo_list=moCoefftmp.GetDim(1);
-  newvals_T.Resize(nmo_list);
+  symmvals_temp.Resize(maxbasis);
+  symmvals_sum.Resize(maxbasis,1);
+  newvals_T.Resize(1,nmo_list);
   newvals_T=T(0.0);
 
   int b;
   int totfunc=0;
   
-  centers.updateDistance(e, sample);
+  centers.updateDistance(e, sample, ws.edist);
   
-  static Array1 <MOBLAS_CalcObjVal<T> > calcobjs(totbasis);
+  //The basis functions that contribute, with a pointer to their 
+  //row of coefficients.
+  Array1 <T *> & moplace(ws.moplace);
+  Array2 <T> & sval(ws.sval);
+  moplace.Resize(totbasis);
+  sval.Resize(totbasis,1);
   int ncalcobj=0;
 
   for(int ion=0; ion < ionmax; ion++)  {
@@ -369,18 +396,18 @@ template <class T> void MO_matrix_blas<T>::updateVal(Sample_point * sample,
       int imax=nfunctions(b);
       for(int centerind=0; centerind < centers.ncenters_atom(ion); centerind++) {
         int center=centers.equiv_centers(ion,centerind);
-        centers.getDistance(e, center, R);
+        centers.getDistance(ws.edist, center, R);
         if(R(0) < obj_cutoff(b)) {
           basis(b)->calcVal(R, symmvals_temp);
 
-          for(int i=0; i< imax; i++) symmvals_sum(i)+=kptfac(center)*symmvals_temp(i);
+          for(int i=0; i< imax; i++) symmvals_sum(i,0)+=kptfac(center)*symmvals_temp(i);
         }
       }
 
       for(int i=0; i< imax; i++) {
-        if(abs(symmvals_sum(i)) > TINY) {
-          calcobjs(ncalcobj).sval=symmvals_sum(i);
-          calcobjs(ncalcobj).moplace=moCoefftmp.v+totfunc*nmo_list;
+        if(abs(symmvals_sum(i,0)) > TINY) {
+          sval(ncalcobj,0)=symmvals_sum(i,0);
+          moplace(ncalcobj)=moCoefftmp.v+totfunc*nmo_list;
           ncalcobj++;
         }
         totfunc++;
@@ -389,13 +416,13 @@ template <class T> void MO_matrix_blas<T>::updateVal(Sample_point * sample,
   }
 
   for(int i=0; i< ncalcobj; i++) { 
-    product_kernel(nmo_list,calcobjs(i).sval,calcobjs(i).moplace,newvals_T.v);
+    product_kernel(nmo_list,sval(i,0),moplace(i),newvals_T.v);
     
   }
 
 
   for(int m=0; m < nmo_list; m++) {
-    newvals(m,0)=newvals_T(m);
+    newvals(m,0)=newvals_T(0,m);
 
   }  
 
@@ -412,7 +439,8 @@ template <class T> void MO_matrix_blas<T>::updateLap(
   Sample_point * sample, 
   int e, 
   int listnum,
-  Array2 <T> & newvals) {
+  Array2 <T> & newvals,
+  MO_workspace <T> & ws) {
 
   int ionmax=centers.equiv_centers.GetDim(0);
 
@@ -420,22 +448,27 @@ template <class T> void MO_matrix_blas<T>::updateLap(
   assert(newvals.GetDim(1) >=5);
 
 
-  Array1 <doublevar> R(5);
-  static Array2 <doublevar> symmvals_temp(maxbasis,5);
-  static Array2 <T> symmvals_sum(maxbasis,5);
-  static Array2 <T> newvals_T;
+  Array1 <doublevar> & R(ws.R);
+  Array2 <doublevar> & symmvals_temp(ws.symmvals2d);
+  Array2 <T> & symmvals_sum(ws.sum);
+  Array2 <T> & newvals_T(ws.newvals);
   Array2 <T> & moCoefftmp(moCoeff_list(listnum));
   int totbasis=moCoefftmp.GetDim(0);
   int nmo_list=moCoefftmp.GetDim(1);
+  symmvals_temp.Resize(maxbasis,5);
+  symmvals_sum.Resize(maxbasis,5);
   newvals_T.Resize(5, nmo_list);
   newvals_T=0.0;
 
   int b;
   int totfunc=0;
   
-  centers.updateDistance(e, sample);
+  centers.updateDistance(e, sample, ws.edist);
 
-  static Array1 <MOBLAS_CalcObjLap<T> > calcobjs(totbasis);
+  Array1 <T *> & moplace(ws.moplace);
+  Array2 <T> & sval(ws.sval);
+  moplace.Resize(totbasis);
+  sval.Resize(totbasis,5);
   int ncalcobj=0;
   
 
@@ -449,7 +482,7 @@ template <class T> void MO_matrix_blas<T>::updateLap(
       int imax=nfunctions(b);
       for(int centerind=0; centerind < centers.ncenters_atom(ion); centerind++) {
         int center=centers.equiv_centers(ion,centerind);
-        centers.getDistance(e, center, R);
+        centers.getDistance(ws.edist, center, R);
         if(R(0) < obj_cutoff(b)) {
           basis(b)->calcLap(R, symmvals_temp);
 
@@ -464,8 +497,8 @@ template <class T> void MO_matrix_blas<T>::updateLap(
       for(int i=0; i< imax; i++) {
         if(abs(symmvals_sum(i,0)) > TINY) {
           for(int j=0; j< 5; j++) 
-            calcobjs(ncalcobj).sval[j]=symmvals_sum(i,j);
-          calcobjs(ncalcobj).moplace=moCoefftmp.v+totfunc*nmo_list;
+            sval(ncalcobj,j)=symmvals_sum(i,j);
+          moplace(ncalcobj)=moCoefftmp.v+totfunc*nmo_list;
           ncalcobj++;
         }
         totfunc++;
@@ -476,7 +509,7 @@ template <class T> void MO_matrix_blas<T>::updateLap(
 
   for(int i=0; i< ncalcobj; i++) { 
     for(int j=0; j< 5; j++) { 
-      product_kernel(nmo_list,calcobjs(i).sval[j],calcobjs(i).moplace,
+      product_kernel(nmo_list,sval(i,j),moplace(i),
           newvals_T.v+j*nmo_list);
     }
   }
@@ -491,6 +524,173 @@ template <class T> void MO_matrix_blas<T>::updateLap(
 }
 
 
+//------------------------------------------------------------------------
+
+//c(m,n)+=a(m,k)*b(k,n), all row-major
+inline void product_kernel(int m, int n, int k, doublevar * a, 
+                           doublevar * b, doublevar * c) { 
+#ifdef USE_BLAS
+  cblas_dgemm(CblasRowMajor,CblasNoTrans,CblasNoTrans,m,n,k,
+              1.0,a,k,b,n,1.0,c,n);
+#else
+  for(int i=0; i< m; i++) { 
+    for(int l=0; l< k; l++) { 
+      doublevar f=a[i*k+l];
+      if(f==0.0) continue;
+      for(int j=0; j< n; j++) c[i*n+j]+=f*b[l*n+j];
+    }
+  }
+#endif
+}
+
+inline void product_kernel(int m, int n, int k, dcomplex * a, 
+                           dcomplex * b, dcomplex * c) { 
+#ifdef USE_BLAS
+  dcomplex one(1.0,0.0);
+  cblas_zgemm(CblasRowMajor,CblasNoTrans,CblasNoTrans,m,n,k,
+              &one,a,k,b,n,&one,c,n);
+#else
+  for(int i=0; i< m; i++) { 
+    for(int l=0; l< k; l++) { 
+      dcomplex f=a[i*k+l];
+      if(f==dcomplex(0.0,0.0)) continue;
+      for(int j=0; j< n; j++) c[i*n+j]+=f*b[l*n+j];
+    }
+  }
+#endif
+}
+
+//------------------------------------------------------------------------
+
+/*!
+  Put the basis functions for electron e, summed over equivalent centers,
+  into block(row+d, function) for the first nderiv of [val, grad, lap].
+*/
+template <class T> void MO_matrix_blas<T>::gatherBasis(Sample_point * sample,
+    int e, int nderiv, Array2 <T> & block, int row, MO_workspace <T> & ws) { 
+  assert(nderiv==1 || nderiv==5);
+  int ionmax=centers.equiv_centers.GetDim(0);
+  Array1 <doublevar> & R(ws.R);
+  Array2 <doublevar> & symmvals_temp(ws.symmvals2d);
+  symmvals_temp.Resize(maxbasis,5);
+  int nfunc=block.GetDim(1);
+  for(int d=0; d< nderiv; d++) 
+    for(int f=0; f< nfunc; f++) block(row+d,f)=T(0.0);
+
+  centers.updateDistance(e, sample, ws.edist);
+  int totfunc=0;
+  for(int ion=0; ion < ionmax; ion++)  {
+    int center0=centers.equiv_centers(ion,0);
+    for(int n=0; n< centers.nbasis(center0); n++) {
+      int b=centers.basis(center0, n);
+      int imax=nfunctions(b);
+      for(int centerind=0; centerind < centers.ncenters_atom(ion); centerind++) {
+        int center=centers.equiv_centers(ion,centerind);
+        centers.getDistance(ws.edist, center, R);
+        if(R(0) < obj_cutoff(b)) {
+          if(nderiv==1) basis(b)->calcVal(R, ws.symmvals1d);
+          else basis(b)->calcLap(R, symmvals_temp);
+          for(int i=0; i< imax; i++) { 
+            if(nderiv==1) 
+              block(row,totfunc+i)+=kptfac(center)*ws.symmvals1d(i);
+            else 
+              for(int d=0; d< 5; d++) 
+                block(row+d,totfunc+i)+=kptfac(center)*symmvals_temp(i,d);
+          }
+        }
+      }
+      //drop the same small functions as updateVal and updateLap do
+      for(int i=0; i< imax; i++) { 
+        if(abs(block(row,totfunc+i)) <= TINY) 
+          for(int d=0; d< nderiv; d++) block(row+d,totfunc+i)=T(0.0);
+      }
+      totfunc+=imax;
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+
+/*!
+  The basis functions of point k go into rows k*nderiv to 
+  (k+1)*nderiv-1 of ws.basisblock, and finishBatch multiplies the whole
+  block by the MO coefficients at once.
+*/
+template <class T> void MO_matrix_blas<T>::startBatch(int npoints, 
+    int listnum, int nderiv, MO_workspace <T> & ws) { 
+  Array2 <T> & moCoefftmp(moCoeff_list(listnum));
+  int nrows=npoints*nderiv;
+  ws.symmvals1d.Resize(maxbasis);
+  ws.basisblock.Resize(nrows,moCoefftmp.GetDim(0));
+  ws.moblock.Resize(nrows,moCoefftmp.GetDim(1));
+  ws.moblock=T(0.0);
+}
+
+template <class T> void MO_matrix_blas<T>::finishBatch(int npoints, 
+    int listnum, int nderiv, Array1 <Array2 <T> > & newvals, 
+    MO_workspace <T> & ws) { 
+  assert(newvals.GetDim(0) >= npoints);
+  Array2 <T> & moCoefftmp(moCoeff_list(listnum));
+  int totbasis=moCoefftmp.GetDim(0);
+  int nmo_list=moCoefftmp.GetDim(1);
+  product_kernel(npoints*nderiv,nmo_list,totbasis,ws.basisblock.v,
+                 moCoefftmp.v,ws.moblock.v);
+
+  for(int k=0; k< npoints; k++) { 
+    assert(newvals(k).GetDim(1) >= nderiv);
+    for(int m=0; m< nmo_list; m++) { 
+      for(int d=0; d< nderiv; d++) { 
+        newvals(k)(m,d)=ws.moblock(k*nderiv+d,m);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+
+template <class T> void MO_matrix_blas<T>::evaluateBatch(
+    Array1 <Sample_point *> & samples, int e, int listnum, int nderiv,
+    Array1 <Array2 <T> > & newvals, MO_workspace <T> & ws) { 
+  int nwalkers=samples.GetDim(0);
+  startBatch(nwalkers,listnum,nderiv,ws);
+  for(int w=0; w< nwalkers; w++) { 
+    assert(e < samples(w)->electronSize());
+    gatherBasis(samples(w),e,nderiv,ws.basisblock,w*nderiv,ws);
+  }
+  finishBatch(nwalkers,listnum,nderiv,newvals,ws);
+}
+
+//------------------------------------------------------------------------
+
+template <class T> void MO_matrix_blas<T>::updateValBatch(
+    Array1 <Sample_point *> & samples, int e, int listnum,
+    Array1 <Array2 <T> > & newvals, MO_workspace <T> & ws) { 
+  evaluateBatch(samples,e,listnum,1,newvals,ws);
+}
+
+template <class T> void MO_matrix_blas<T>::updateLapBatch(
+    Array1 <Sample_point *> & samples, int e, int listnum,
+    Array1 <Array2 <T> > & newvals, MO_workspace <T> & ws) { 
+  evaluateBatch(samples,e,listnum,5,newvals,ws);
+}
+
+template <class T> void MO_matrix_blas<T>::updateValBatch(
+    Sample_point * sample, int e, const Array2 <doublevar> & pos, 
+    int listnum, Array1 <Array2 <T> > & newvals, MO_workspace <T> & ws) { 
+  int npos=pos.GetDim(0);
+  int ndim=pos.GetDim(1);
+  startBatch(npos,listnum,1,ws);
+  Array1 <doublevar> oldpos(ndim), newpos(ndim);
+  sample->getElectronPos(e,oldpos);
+  for(int k=0; k< npos; k++) { 
+    for(int d=0; d< ndim; d++) newpos(d)=pos(k,d);
+    sample->setElectronPosNoNotify(e,newpos);
+    gatherBasis(sample,e,1,ws.basisblock,k,ws);
+  }
+  sample->setElectronPosNoNotify(e,oldpos);
+  finishBatch(npos,listnum,1,newvals,ws);
+}
+
 #endif // MO_MATRIX_BLAS_H_INCLUDED
 
 //--------------------------------------------------------------------------
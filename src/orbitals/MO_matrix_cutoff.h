@@ -66,11 +66,6 @@ private:
   Array1 < Array2 <T> > moCoeff_list;
   Array1 < Array1 <int> > basismo_list;
 
- Array1 <doublevar> symmvals_temp1d;
- Array2 <doublevar> symmvals_temp2d;
-
-
-
 public:
 
   /*!
@@ -103,26 +98,33 @@ public:
   virtual void writeorb(ostream &, Array2 <doublevar> & rotation, Array1 <int> &);
 
 
+  using Templated_MO_matrix<T>::updateVal;
+  using Templated_MO_matrix<T>::updateLap;
+  using Templated_MO_matrix<T>::updateHessian;
+
   virtual void updateVal(
     Sample_point * sample,
     int e,
     //!< electron number
     int listnum,
-    Array2 <T> & newvals
+    Array2 <T> & newvals,
     //!< The return: in form (MO)
+    MO_workspace <T> & ws
   );
   
   virtual void updateLap(
     Sample_point * sample,
     int e,
     int listnum,
-    Array2 <T> & newvals
+    Array2 <T> & newvals,
+    MO_workspace <T> & ws
   );
   virtual void updateHessian(Sample_point * sample,
 			     int e,
 			     int listnum,
-			     Array2 <T>& newvals
+			     Array2 <T>& newvals,
 			     //!< in form ([value gradient, dxx,dyy,dzz,dxy,dxz,dyz], MO)
+			     MO_workspace <T> & ws
 			     );
   MO_matrix_cutoff()
   {}
@@ -241,9 +243,6 @@ template <class T> void MO_matrix_cutoff<T>::init() {
       } //i
     } //n
   }  //ion
-  symmvals_temp1d.Resize(maxbasis);
-  symmvals_temp2d.Resize(maxbasis,10);
-
 }
 
 //---------------------------------------------------------------------------------------------
@@ -411,11 +410,13 @@ template <class T> int MO_matrix_cutoff<T>::writeinput(string & indent, ostream
 //------------------------------------------------------------------------
 
 template <class T> void MO_matrix_cutoff<T>::updateVal(
-  Sample_point * sample,  int e,  int listnum,  Array2 <T> & newvals) {
+  Sample_point * sample,  int e,  int listnum,  Array2 <T> & newvals,
+  MO_workspace <T> & ws) {
   //cout << "start updateval " << endl;
   int centermax=centers.size();
-  static Array1 <doublevar> R(5);
-  //Array1 <doublevar> symmvals_temp(maxbasis);
+  Array1 <doublevar> & R(ws.R);
+  Array1 <doublevar> & symmvals_temp1d(ws.symmvals1d);
+  symmvals_temp1d.Resize(maxbasis);
 
   //Make references for easier access to the list variables.
   Array1 <int> & basismotmp(basismo_list(listnum));
@@ -433,11 +434,11 @@ template <class T> void MO_matrix_cutoff<T>::updateVal(
   int totfunc=0;
   int b; //basis
   //cout << "here " << endl;
-  centers.updateDistance(e, sample);
+  centers.updateDistance(e, sample, ws.edist);
   //int retscale=newvals.GetDim(1);
   for(int ion=0; ion < centermax; ion++) {
     //sample->getECDist(e, ion, R);
-    centers.getDistance(e,ion,R);
+    centers.getDistance(ws.edist,ion,R);
     for(int n=0; n< centers.nbasis(ion); n++) {
       b=centers.basis(ion,n);
       tempbasis=basis(b);
@@ -478,7 +479,7 @@ template <class T> void MO_matrix_cutoff<T>::updateVal(
 //------------------------------------------------------------------------
 
 template <class T>void MO_matrix_cutoff<T>::updateLap( Sample_point * sample,
-  int e, int listnum, Array2 <T> & newvals) {
+  int e, int listnum, Array2 <T> & newvals, MO_workspace <T> & ws) {
 
   //cout << "updateLap" << endl;
   int centermax=centers.size();
@@ -489,7 +490,9 @@ template <class T>void MO_matrix_cutoff<T>::updateLap( Sample_point * sample,
   assert(newvals.GetDim(1) >=5);
 
   // cout << "array " << endl;
-  Array1 <doublevar> R(5);
+  Array1 <doublevar> & R(ws.R);
+  Array2 <doublevar> & symmvals_temp2d(ws.symmvals2d);
+  symmvals_temp2d.Resize(maxbasis,5);
   // cout << "symvals " << endl;
    //cout << "arrayref " << endl;
 
@@ -504,12 +507,12 @@ template <class T>void MO_matrix_cutoff<T>::updateLap( Sample_point * sample,
   int scaleval=0, scalesymm=0;
   int mo=0;
   int scalebasis=basisfilltmp.GetDim(1);
-  centers.updateDistance(e, sample);
+  centers.updateDistance(e, sample, ws.edist);
   int totfunc=0;
   int b;
   int symmvals_stride=symmvals_temp2d.GetDim(1);
   for(int ion=0; ion < centermax; ion++) {
-    centers.getDistance(e, ion, R);
+    centers.getDistance(ws.edist, ion, R);
     for(int n=0; n< centers.nbasis(ion); n++) {
       b=centers.basis(ion, n);
       tempbasis=basis(b);
@@ -576,8 +579,9 @@ template <class T>void MO_matrix_cutoff<T>::updateHessian(
   int listnum,
   //const Array1 <int> & occupation,
   //!<A list of the MO's to evaluate
-  Array2 <T> & newvals
+  Array2 <T> & newvals,
   //!< The return: in form (MO, [val, grad, dxx,dyy,...])
+  MO_workspace <T> & ws
 )
 {
 
@@ -587,8 +591,9 @@ template <class T>void MO_matrix_cutoff<T>::updateHessian(
   assert(newvals.GetDim(1)==10);
   
 
-  Array1 <doublevar> R(5);
- // static Array2 <doublevar> symmvals_temp(maxbasis,10);
+  Array1 <doublevar> & R(ws.R);
+  Array2 <doublevar> & symmvals_temp2d(ws.symmvals2d);
+  symmvals_temp2d.Resize(maxbasis,10);
 
   //References to make the code easier to read and slightly faster.
   Array1 <int> & basismotmp(basismo_list(listnum));
@@ -601,12 +606,12 @@ template <class T>void MO_matrix_cutoff<T>::updateHessian(
   int scaleval=0, scalesymm=0;
   int mo=0;
   int scalebasis=basisfilltmp.GetDim(1);
-  centers.updateDistance(e, sample);
+  centers.updateDistance(e, sample, ws.edist);
   int totfunc=0;
   int b;
   int symmvals_stride=symmvals_temp2d.GetDim(1);
   for(int ion=0; ion < centermax; ion++)  {
-    centers.getDistance(e, ion, R);
+    centers.getDistance(ws.edist, ion, R);
     for(int n=0; n< centers.nbasis(ion); n++)  {
       b=centers.basis(ion, n);
       tempbasis=basis(b);
@@ -130,10 +130,15 @@ public:
   virtual int showinfo(ostream & os);
   virtual int writeinput(string &, ostream &);
   virtual void writeorb(ostream &, Array2 <doublevar> & rotation, Array1 <int> & tmp) { } 
-  virtual void updateVal(Sample_point *,int e,int listnum,Array2<T>&);
-  virtual void updateLap(Sample_point *,int e, int listnum, Array2<T>&);
+  using Templated_MO_matrix<T>::updateVal;
+  using Templated_MO_matrix<T>::updateLap;
+  using Templated_MO_matrix<T>::updateHessian;
+  virtual void updateVal(Sample_point *,int e,int listnum,Array2<T>&,
+                         MO_workspace <T> &);
+  virtual void updateLap(Sample_point *,int e, int listnum, Array2<T>&,
+                         MO_workspace <T> &);
   virtual void updateHessian(Sample_point * sample,
-			     int e, int listnum,Array2<T>&);
+			     int e, int listnum,Array2<T>&, MO_workspace <T> &);
 
   MO_matrix_einspline() { } 
 };
@@ -284,7 +289,7 @@ template <class T>int MO_matrix_einspline<T>::writeinput(string & indent, ostrea
 //----------------------------------------------------------------------
 
 template <class T> void MO_matrix_einspline<T>::updateVal(Sample_point * sample,
-    int e, int listnum, Array2 <T> & newvals) { 
+    int e, int listnum, Array2 <T> & newvals, MO_workspace <T> & ws) { 
 #ifdef USE_EINSPLINE
   Array1 <doublevar> pos(ndim),u(ndim);
   sample->getElectronPos(e,pos);
@@ -316,10 +321,11 @@ template <class T> void MO_matrix_einspline<T>::updateVal(Sample_point * sample,
 //----------------------------------------------------------------------
 
 template <class T> void MO_matrix_einspline<T>::updateLap(Sample_point * sample,
-    int e,int listnum,Array2 <T> & newvals) {
+    int e,int listnum,Array2 <T> & newvals, MO_workspace <T> & ws) {
 #ifdef USE_EINSPLINE
-  Array2 <T> hessvals(nmo_lists(listnum),1+ndim+ndim*(ndim+1)/2);
-  updateHessian(sample,e,listnum,hessvals);
+  Array2 <T> & hessvals(ws.basisvals2d);
+  hessvals.Resize(nmo_lists(listnum),1+ndim+ndim*(ndim+1)/2);
+  updateHessian(sample,e,listnum,hessvals,ws);
   for(int i=0; i < nmo_lists(listnum); i++) {
     for (int d=0; d <= ndim; d++) {
       newvals(i,d)=hessvals(i,d);
@@ -336,7 +342,7 @@ template <class T> void MO_matrix_einspline<T>::updateLap(Sample_point * sample,
 //----------------------------------------------------------------------
 
 template <class T> void MO_matrix_einspline<T>::updateHessian(Sample_point * sample,
-    int e,int listnum,Array2 <T> & newvals) { 
+    int e,int listnum,Array2 <T> & newvals, MO_workspace <T> & ws) { 
 #ifdef USE_EINSPLINE
   Array1 <doublevar> pos(ndim),u(ndim);
   sample->getElectronPos(e,pos);
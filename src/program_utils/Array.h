@@ -875,6 +875,19 @@ inline void array_cp(Array2 <T> & x, const Array2 <T> & y) {
   x=y;
 }
 
+/*!
+Array3's operator= returns by value, which would copy the array twice;
+this copies the elements directly.
+ */
+template < class T > 
+inline void array_cp(Array3 <T> & x, const Array3 <T> & y) {
+  x.Resize(y.GetDim(0), y.GetDim(1), y.GetDim(2));
+  for(int i=0; i< y.GetDim(0); i++) 
+    for(int j=0; j< y.GetDim(1); j++) 
+      for(int k=0; k< y.GetDim(2); k++) 
+        x(i,j,k)=y(i,j,k);
+}
+
 /*!
 These replace the arrays with the sum over all processors.
  */
@@ -346,5 +346,16 @@ public:
 };
 
 
+template < class T > 
+inline void array_cp(Array4 <T> & x, const Array4 <T> & y) {
+  x.Resize(y.GetDim(0), y.GetDim(1), y.GetDim(2), y.GetDim(3));
+  for(int i=0; i< y.GetDim(0); i++) 
+    for(int j=0; j< y.GetDim(1); j++) 
+      for(int k=0; k< y.GetDim(2); k++) 
+        for(int l=0; l< y.GetDim(3); l++) 
+          x(i,j,k,l)=y(i,j,k,l);
+}
+
+
 #endif // ARRAY45_H_INCLUDED
 //--------------------------------------------------------------------------
@@ -0,0 +1,100 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include "Checkpoint_writer.h"
+#include <cstdio>
+
+Checkpoint_writer::Checkpoint_writer():failed(0) { }
+
+//----------------------------------------------------------------------
+
+Checkpoint_writer::~Checkpoint_writer() {
+#ifdef USE_CHECKPOINT_THREAD
+  if(io_thread.joinable()) io_thread.join();
+#endif
+}
+
+//----------------------------------------------------------------------
+
+void Checkpoint_writer::write(const string & filename_, 
+                              vector <string> & pieces,
+                              vector <long int> & offsets_) {
+  wait();
+  filename=filename_;
+  //Node 0 starts the new file, and only then can everyone write to it.
+  if(mpi_info.node==0) { 
+    string backfilename=filename+".backup";
+    rename(filename.c_str(),backfilename.c_str());
+    FILE * f=fopen(filename.c_str(),"w");
+    if(!f) error("Checkpoint_writer: couldn't write ", filename);
+    fclose(f);
+  }
+#ifdef USE_MPI
+  MPI_Barrier(MPI_Comm_grp);
+#endif
+  buffer.swap(pieces);
+  offsets=offsets_;
+  pieces.clear();
+#ifdef USE_CHECKPOINT_THREAD
+  io_thread=std::thread(writeFile,this);
+#else
+  writeFile(this);
+  wait();
+#endif
+}
+
+//----------------------------------------------------------------------
+
+void Checkpoint_writer::wait() {
+#ifdef USE_CHECKPOINT_THREAD
+  if(io_thread.joinable()) io_thread.join();
+#endif
+  if(failed) {
+    failed=0;
+    error("Checkpoint_writer: couldn't write ", filename);
+  }
+#ifdef USE_MPI
+  MPI_Barrier(MPI_Comm_grp);
+#endif
+}
+
+//----------------------------------------------------------------------
+
+//Runs in the I/O thread, so it only touches the writer's own members.
+void Checkpoint_writer::writeFile(Checkpoint_writer * writer) {
+  int npieces=writer->buffer.size();
+  long int nbytes=0;
+  for(int i=0; i< npieces; i++) nbytes+=writer->buffer[i].size();
+  if(nbytes==0) return;
+  FILE * f=fopen(writer->filename.c_str(),"r+b");
+  if(!f) {
+    writer->failed=1;
+    return;
+  }
+  for(int i=0; i< npieces; i++) { 
+    if(writer->buffer[i].size()==0) continue;
+    if(fseek(f,writer->offsets[i],SEEK_SET)) writer->failed=1;
+    fwrite(writer->buffer[i].data(),1,writer->buffer[i].size(),f);
+  }
+  if(ferror(f)) writer->failed=1;
+  fclose(f);
+}
+
+//----------------------------------------------------------------------
@@ -0,0 +1,81 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef CHECKPOINT_WRITER_H_INCLUDED
+#define CHECKPOINT_WRITER_H_INCLUDED
+
+#include "Qmc_std.h"
+
+//std::thread is only there in C++11; otherwise the files are written
+//in the calling thread.
+#if __cplusplus >= 201103L
+#define USE_CHECKPOINT_THREAD
+#include <thread>
+#endif
+
+/*!
+\brief
+Writes checkpoint files from a background thread, so that the walkers
+can keep moving while the file system catches up.
+
+Every process writes its own pieces of the file at the offsets it 
+is given, so nothing has to be gathered onto one process.  There are 
+two sets of buffers: the one being written and the one that the caller
+fills with the next snapshot.  write() waits for the previous file to 
+be finished, takes the caller's buffers and hands back the old ones, so
+at most one write is in flight at a time.  The old file is moved to
+filename.backup first.  Call wait() before anything reads the file 
+again, for example at the end of a run.
+*/
+class Checkpoint_writer {
+ public:
+  Checkpoint_writer();
+  ~Checkpoint_writer();
+
+  /*!
+    Start writing pieces(i) at byte offsets(i) of filename.  Collective:
+    all the processes have to call it, each with its own pieces, and 
+    together they have to cover the file.  pieces is swapped with the 
+    internal buffers, so on return it holds the old (cleared) ones and
+    can be reused for the next snapshot.
+   */
+  void write(const string & filename, vector <string> & pieces,
+             vector <long int> & offsets);
+
+  /*!
+    Wait for the file being written to be finished by all the processes.
+    Collective.
+   */
+  void wait();
+
+ private:
+  static void writeFile(Checkpoint_writer * writer);
+
+  string filename;
+  vector <string> buffer;
+  vector <long int> offsets;
+  int failed; //!< whether the last write couldn't open its file
+#ifdef USE_CHECKPOINT_THREAD
+  std::thread io_thread;
+#endif
+};
+
+#endif //CHECKPOINT_WRITER_H_INCLUDED
+//--------------------------------------------------------------------------
@@ -112,6 +112,59 @@ dcomplex Determinant(const Array2 <dcomplex> & a, const int n);
 void MultiplyMatrices(const Array2 <doublevar> & a, const Array2 <doublevar> & b,
                       Array2 <doublevar> & c, int n);
 
+//c(m,n)=alpha*a(m,k)*b(k,n)+beta*c(m,n), all row-major.  If transb,
+//b is stored as b(n,k).
+inline void gemm_rowmajor(int transb, int m, int n, int k, doublevar alpha,
+                         const doublevar * a, int lda,
+                         const doublevar * b, int ldb, doublevar beta,
+                         doublevar * c, int ldc) {
+#ifdef USE_BLAS
+  cblas_dgemm(CblasRowMajor,CblasNoTrans,transb?CblasTrans:CblasNoTrans,
+              m,n,k,alpha,a,lda,b,ldb,beta,c,ldc);
+#else
+  if(!transb) {
+    //row by row, so that the inner loop runs along the rows of b
+    for(int i=0; i< m; i++) {
+      doublevar * ci=c+i*ldc;
+      for(int j=0; j< n; j++) ci[j]=beta==0.0?0.0:beta*ci[j];
+      for(int l=0; l< k; l++) {
+        doublevar f=alpha*a[i*lda+l];
+        const doublevar * bl=b+l*ldb;
+        for(int j=0; j< n; j++) ci[j]+=f*bl[j];
+      }
+    }
+    return;
+  }
+  for(int i=0; i< m; i++) {
+    for(int j=0; j< n; j++) {
+      doublevar sum=0.0;
+      for(int l=0; l< k; l++)
+        sum+=a[i*lda+l]*b[j*ldb+l];
+      c[i*ldc+j]=alpha*sum+beta*c[i*ldc+j];
+    }
+  }
+#endif
+}
+
+inline void gemm_rowmajor(int transb, int m, int n, int k, dcomplex alpha,
+                         const dcomplex * a, int lda,
+                         const dcomplex * b, int ldb, dcomplex beta,
+                         dcomplex * c, int ldc) {
+#ifdef USE_BLAS
+  cblas_zgemm(CblasRowMajor,CblasNoTrans,transb?CblasTrans:CblasNoTrans,
+              m,n,k,&alpha,a,lda,b,ldb,&beta,c,ldc);
+#else
+  for(int i=0; i< m; i++) {
+    for(int j=0; j< n; j++) {
+      dcomplex sum=0.0;
+      for(int l=0; l< k; l++)
+        sum+=a[i*lda+l]*(transb?b[j*ldb+l]:b[l*ldb+j]);
+      c[i*ldc+j]=alpha*sum+beta*c[i*ldc+j];
+    }
+  }
+#endif
+}
+
 void InvertMatrix(const Array2 <doublevar> & a, Array2 <doublevar> & a1, const int n);
 doublevar InverseUpdateRow(Array2 <doublevar> & a1, const Array2 <doublevar> & a,
                            const int lRow, const int n);
@@ -151,6 +204,8 @@ doublevar TransposeInverseUpdateColumn(Array2 <doublevar> & a1, const Array2 <do
 doublevar Pfaffian_nopivot(const Array2 <doublevar> & a);
 
 doublevar Pfaffian_partialpivot(const Array2 <doublevar> & a);
+//! Pfaffian_partialpivot() with the trailing updates done nb columns at a time
+doublevar Pfaffian_blocked(const Array2 <doublevar> & a, int nb=32);
      
 doublevar UpdateInversePfaffianMatrix(Array2 <doublevar> & a, Array1 <doublevar> & row,
                               Array1 <doublevar> & column, int n);
@@ -99,6 +99,12 @@ int dgetrs(char trans, int n, int nrhs, double * A, int lda, int * ipiv,
 
 const doublevar TINY=1.0e-20;
 
+//Scratch space for the routines below.  Each thread gets its own 
+//copy, so the inversions and updates can be called from threads.
+extern Array2 <doublevar> tmp2;
+extern Array1 <doublevar> tmp11,tmp12;
+extern Array1 <int> itmp1;
+#pragma omp threadprivate(tmp2,tmp11,tmp12,itmp1)
 Array2 <doublevar> tmp2;
 Array1 <doublevar> tmp11,tmp12;
 Array1 <int> itmp1;
@@ -1067,7 +1073,110 @@ doublevar Pfaffian_partialpivot(const Array2 <doublevar> & in){
   }
   //cout << "Pfaffian_partialpivot end"<<endl;
   return PF*d;
-  
+
+}
+
+//--------------------------------------------------------------------------
+
+//c(m,m)+=p(m,k) q(m,k)^T, all row-major
+static void pfaffian_trailing_update(int m, int k, const doublevar * p, int ldp,
+                                     const doublevar * q, int ldq,
+                                     doublevar * c, int ldc) {
+#ifdef USE_BLAS
+  cblas_dgemm(CblasRowMajor,CblasNoTrans,CblasTrans,m,m,k,1.0,
+              p,ldp,q,ldq,1.0,c,ldc);
+#else
+  for(int i=0; i< m; i++) {
+    for(int j=0; j< m; j++) {
+      doublevar sum=0.0;
+      for(int l=0; l< k; l++) sum+=p[i*ldp+l]*q[j*ldq+l];
+      c[i*ldc+j]+=sum;
+    }
+  }
+#endif
+}
+
+/*!
+The same Parlett-Reid elimination as Pfaffian_partialpivot(), but the
+rank-2 updates of the trailing matrix are held for a panel of nb columns:
+with the Gauss vectors \f$ \tau \f$ and pivot columns \f$ w \f$ of the
+panel in U and V, the trailing matrix is \f$ A+UV^T-VU^T \f$, so only the
+two columns being eliminated are formed on the way, and the rest is
+updated at the end of the panel with one matrix-matrix product.
+*/
+doublevar Pfaffian_blocked(const Array2 <doublevar> & in, int nb) {
+  assert(in.dim[0]==in.dim[1]);
+  int n=in.dim[0];
+  if (n%2!=0) return 0.0;
+  nb=max(2,nb-nb%2);
+  int np=nb/2;
+  Array2 <doublevar> tmp(n,n);
+  for (int i=0;i<n;i++)
+    for (int j=0;j<n;j++)
+      tmp(i,j)=in(i,j);
+  //[U -V] and [V U], so that the trailing update is a single product
+  Array2 <doublevar> P(n,nb), Q(n,nb);
+  Array1 <doublevar> c(n), w(n);
+  doublevar PF=1.0;
+
+  for(int kb=0; kb< n; kb+=nb) {
+    int kend=min(kb+nb,n);
+    int m=0;
+    for(int i=kb; i< n; i++)
+      for(int l=0; l< nb; l++) { P(i,l)=0.0; Q(i,l)=0.0; }
+    for(int k=kb; k< kend; k+=2) {
+      //current column k
+      for(int i=k+1; i< n; i++) {
+        doublevar sum=tmp(i,k);
+        for(int l=0; l< m; l++)
+          sum+=P(i,l)*Q(k,l)+P(i,np+l)*Q(k,np+l);
+        c(i)=sum;
+      }
+      int piv=k+1;
+      doublevar big=fabs(c(k+1));
+      for(int i=k+2; i< n; i++)
+        if(fabs(c(i)) > big) { big=fabs(c(i)); piv=i; }
+      if(big==0.0) return 0.0;
+      if(piv!=k+1) {
+        int r=k+1;
+        for(int j=0; j< n; j++) swap(tmp(r,j),tmp(piv,j));
+        for(int i=0; i< n; i++) swap(tmp(i,r),tmp(i,piv));
+        for(int l=0; l< nb; l++) {
+          swap(P(r,l),P(piv,l));
+          swap(Q(r,l),Q(piv,l));
+        }
+        swap(c(r),c(piv));
+        PF=-PF;
+      }
+      //c(k+1) is A(k+1,k)=-A(k,k+1)
+      doublevar a=c(k+1);
+      PF*=-a;
+      if(k+2 >= n) break;
+
+      //current column k+1, then A += tau w^T - w tau^T
+      for(int i=k+2; i< n; i++) {
+        doublevar sum=tmp(i,k+1);
+        for(int l=0; l< m; l++)
+          sum+=P(i,l)*Q(k+1,l)+P(i,np+l)*Q(k+1,np+l);
+        w(i)=sum;
+      }
+      for(int i=k+2; i< n; i++) {
+        doublevar tau=c(i)/a;
+        P(i,m)=tau;
+        P(i,np+m)=-w(i);
+        Q(i,m)=w(i);
+        Q(i,np+m)=tau;
+      }
+      m++;
+    }
+    //only the last panel can be short, and it has no trailing matrix
+    if(kend < n) {
+      assert(m==np);
+      pfaffian_trailing_update(n-kend,nb,P.v+kend*nb,nb,Q.v+kend*nb,nb,
+                               tmp.v+kend*n+kend,n);
+    }
+  }
+  return PF;
 }
 
 doublevar UpdateInversePfaffianMatrix(Array2 <doublevar> & in, 
@@ -1186,10 +1295,34 @@ doublevar UpdateInversePfaffianMatrix(Array2 <doublevar> & in,
 
 
 doublevar PfaffianInverseMatrix(const Array2 <doublevar> & a, Array2 <doublevar> & a1){
-  if(!InvertPfaffianMatrix(a,a1,a.dim[0]))
+  int n=a.dim[0];
+#ifdef USE_LAPACK
+  //LAPACK sees the transpose of a, so solving with the identity gives the 
+  //transpose of its inverse, which is a1 in row-major order.
+  if(n > 1) { 
+    Array2 <doublevar>& temp(tmp2);
+    temp.Resize(n,n);
+    Array1 <int>& indx(itmp1);
+    indx.Resize(n);
+    for(int i=0; i< n; i++) { 
+      for(int j=0; j< n; j++) { 
+        temp(i,j)=a(i,j);
+        a1(i,j)=0.0;
+      }
+      a1(i,i)=1.0;
+    }
+    if(dgetrf(n,n,temp.v,n,indx.v) > 0) { 
+      cout <<"ERROR: singular matrix in inversion\n";
+      return 0.0;
+    }
+    dgetrs('N',n,n,temp.v,n,indx.v,a1.v,n);
+    return Pfaffian_blocked(a);
+  }
+#endif
+  if(!InvertPfaffianMatrix(a,a1,n))
     return 0.0;
   else
-    return  Pfaffian_partialpivot(a);
+    return Pfaffian_blocked(a);
 }
 
 
@@ -0,0 +1,140 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef PACK_BUFFER_H_INCLUDED
+#define PACK_BUFFER_H_INCLUDED
+
+#include "Qmc_std.h"
+#include "Array.h"
+#include <cstring>
+
+/*!
+\brief
+A flat buffer of bytes that objects pack themselves into, so that they
+can be sent in one MPI message or written to a binary file in one piece.
+
+Objects that support it have pack(Pack_buffer &) and unpack(Pack_buffer &),
+which must read back exactly what was written, in the same order.  The
+numbers are stored in the native binary format, so the buffer can only
+be read on a machine with the same endianness and word sizes.
+*/
+class Pack_buffer {
+ public:
+  Pack_buffer():pos(0) { }
+
+  void clear() { buf.clear(); pos=0; }
+  //! Start reading from the beginning again
+  void rewind() { pos=0; }
+  int size() const { return buf.size(); }
+  //! Whether everything has been read
+  int done() const { return pos >= int(buf.size()); }
+  char * data() { return buf.size()?&buf[0]:NULL; }
+  //! Make room for n bytes (for example to read a file into), and rewind
+  void resize(int n) { buf.resize(n); pos=0; }
+  //! Copy in n bytes to be read, and rewind
+  void assign(const char * p, int n) { buf.assign(p,p+n); pos=0; }
+
+  void pack(const int & x) { packBytes(&x,sizeof(int)); }
+  void pack(const long int & x) { packBytes(&x,sizeof(long int)); }
+  void pack(const doublevar & x) { packBytes(&x,sizeof(doublevar)); }
+  void pack(const string & s) {
+    int n=s.size();
+    pack(n);
+    packBytes(s.data(),n);
+  }
+  //! Only for arrays of plain numbers
+  template <class T> void pack(const Array1 <T> & a) {
+    int n=a.GetDim(0);
+    pack(n);
+    packBytes(a.v,n*sizeof(T));
+  }
+  template <class T> void pack(const Array2 <T> & a) {
+    int n=a.GetDim(0), m=a.GetDim(1);
+    pack(n);
+    pack(m);
+    packBytes(a.v,n*m*sizeof(T));
+  }
+
+  void unpack(int & x) { unpackBytes(&x,sizeof(int)); }
+  void unpack(long int & x) { unpackBytes(&x,sizeof(long int)); }
+  void unpack(doublevar & x) { unpackBytes(&x,sizeof(doublevar)); }
+  void unpack(string & s) {
+    int n;
+    unpack(n);
+    checkRead(n);
+    s.assign(&buf[pos],n);
+    pos+=n;
+  }
+  template <class T> void unpack(Array1 <T> & a) {
+    int n;
+    unpack(n);
+    a.Resize(n);
+    unpackBytes(a.v,n*sizeof(T));
+  }
+  template <class T> void unpack(Array2 <T> & a) {
+    int n,m;
+    unpack(n);
+    unpack(m);
+    a.Resize(n,m);
+    unpackBytes(a.v,n*m*sizeof(T));
+  }
+
+#ifdef USE_MPI
+  //! Send the whole buffer as one message
+  void mpiSend(int node) {
+    MPI_Send(data(),size(),MPI_CHAR,node,0,MPI_Comm_grp);
+  }
+  //! Send without waiting; the buffer must not change until req is done.
+  void mpiIsend(int node, MPI_Request & req) {
+    MPI_Isend(data(),size(),MPI_CHAR,node,0,MPI_Comm_grp,&req);
+  }
+  //! Receive a message from mpiSend() or mpiIsend(), of any size
+  void mpiReceive(int node) {
+    MPI_Status status;
+    MPI_Probe(node,0,MPI_Comm_grp,&status);
+    int n;
+    MPI_Get_count(&status,MPI_CHAR,&n);
+    resize(n);
+    MPI_Recv(data(),n,MPI_CHAR,node,0,MPI_Comm_grp,&status);
+  }
+#endif
+
+ private:
+  void packBytes(const void * p, int n) {
+    int s=buf.size();
+    buf.resize(s+n);
+    if(n > 0) memcpy(&buf[s],p,n);
+  }
+  void unpackBytes(void * p, int n) {
+    checkRead(n);
+    if(n > 0) memcpy(p,&buf[pos],n);
+    pos+=n;
+  }
+  void checkRead(int n) {
+    if(n < 0 || pos+n > int(buf.size()))
+      error("Pack_buffer: tried to read past the end of the data");
+  }
+
+  vector <char> buf;
+  int pos; //!< read position
+};
+
+#endif //PACK_BUFFER_H_INCLUDED
+//--------------------------------------------------------------------------
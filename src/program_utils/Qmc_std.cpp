@@ -40,6 +40,39 @@ int parallel_sum(int inp) {
   return inp;
 }
 
+long int parallel_max(long int inp) {
+#ifdef USE_MPI
+  long int ret;
+  MPI_Allreduce(&inp, &ret, 1,MPI_LONG, MPI_MAX, MPI_Comm_grp);
+  return ret;
+#endif
+  return inp;
+}
+
+long int parallel_prefix_sum(long int inp, long int & total) {
+#ifdef USE_MPI
+  long int before=0;
+  MPI_Exscan(&inp, &before, 1, MPI_LONG, MPI_SUM, MPI_Comm_grp);
+  if(mpi_info.node==0) before=0; //MPI_Exscan leaves it undefined
+  MPI_Allreduce(&inp, &total, 1, MPI_LONG, MPI_SUM, MPI_Comm_grp);
+  return before;
+#endif
+  total=inp;
+  return 0;
+}
+
+doublevar parallel_prefix_sum(doublevar inp, doublevar & total) {
+#ifdef USE_MPI
+  doublevar before=0;
+  MPI_Exscan(&inp, &before, 1, MPI_DOUBLE, MPI_SUM, MPI_Comm_grp);
+  if(mpi_info.node==0) before=0; 
+  MPI_Allreduce(&inp, &total, 1, MPI_DOUBLE, MPI_SUM, MPI_Comm_grp);
+  return before;
+#endif
+  total=inp;
+  return 0;
+}
+
 doublevar parallel_sum(doublevar inp) {
 #ifdef USE_MPI
   doublevar ret;
@@ -25,6 +25,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mpi.h"
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <assert.h>
 #include <vector>
 #include <string>
@@ -62,9 +66,33 @@ extern mpi_info_struct mpi_info;
 extern MPI_Comm MPI_Comm_grp;  // communicator for each independent process
 #endif
 
+/*!
+Number of threads available to a parallel region and the number of
+the calling thread.  Without OpenMP these are always 1 and 0.
+*/
+inline int qmc_nthreads() { 
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+inline int qmc_thread_id() { 
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
 int parallel_sum(int inp);
 doublevar parallel_sum(doublevar inp);
 dcomplex parallel_sum(dcomplex inp);
+long int parallel_max(long int inp);
+//! The sum of inp over the processes before this one; total is the sum over all of them
+long int parallel_prefix_sum(long int inp, long int & total);
+doublevar parallel_prefix_sum(doublevar inp, doublevar & total);
 
 int MPI_Send_complex(dcomplex & , int node);
 int MPI_Recv_complex(dcomplex &, int node);
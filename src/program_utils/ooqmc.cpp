@@ -50,7 +50,13 @@ Would be a nice feature.  Could be done through exceptions.
 int main(int argc, char* argv[])
 {
 #ifdef USE_MPI
+#ifdef _OPENMP
+  //Only the master thread makes MPI calls.
+  int thread_support;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+#else
   MPI_Init(&argc, &argv);
+#endif
 #endif
 
   int inputfilestart=1;
@@ -302,6 +308,20 @@ void doinput(Program_options & options,
   //  rng.seed(12345, 98234 );
   //}
 
+  //Counter-based random numbers for each walker, so that the run doesn't
+  //depend on how the walkers are divided between processes and threads.
+  //The key is the seed before it's changed for each process.
+  pos=0;
+  if(haskeyword(words, pos, "RANDOM_STREAMS")) { 
+    long int is1, is2;
+    rng.getseed(is1, is2);
+#ifdef USE_MPI
+    MPI_Bcast(&is1, 1, MPI_LONG, 0, MPI_Comm_grp);
+    MPI_Bcast(&is2, 1, MPI_LONG, 0, MPI_Comm_grp);
+#endif
+    Random_generator::setStreamKey(is1, is2);
+  }
+
   pos=0;
   readvalue(words, pos, options.runid, "RUNID");
 
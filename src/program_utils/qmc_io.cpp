@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "qmc_io.h"
 #include <cstdio>
+#include <climits>
 //---------------------------------------------------------------------
 
 int caseless_eq(const string & s1, const string & s2) {
@@ -382,6 +383,155 @@ int checkbrackets(vector <string> & words)
 
 //----------------------------------------------------------------------
 
+void binary_pack_checksum(Array1 <doublevar> & a, vector <doublevar> & rec) { 
+  int n=a.GetDim(0);
+  rec.push_back(0.0);
+  rec.push_back(0.0);
+  rec.push_back(n);
+  for(int i=0; i< n; i++) rec.push_back(a(i));
+  rec.push_back(checksum(a));
+}
+
+//----------------------------------------------------------------------
+
+//Start of a binary configuration file.  The version goes up whenever the
+//layout of the header or the index changes.
+static const string configfile_magic="QWALK_CONFIGS";
+static const int configfile_version=1;
+
+static void configfile_header(long int nwalkers, Pack_buffer & buf) { 
+  buf.clear();
+  buf.pack(configfile_magic);
+  buf.pack(configfile_version);
+  buf.pack(nwalkers);
+}
+
+int is_binary_configfile(const string & filename) { 
+  FILE * f=fopen(filename.c_str(),"rb");
+  if(!f) return 0;
+  Pack_buffer buf;
+  configfile_header(0,buf);
+  int nmagic=sizeof(int)+configfile_magic.size();
+  Array1 <char> start(nmagic);
+  int nread=fread(start.v,1,nmagic,f);
+  fclose(f);
+  return nread==nmagic && !memcmp(start.v,buf.data(),nmagic);
+}
+
+//----------------------------------------------------------------------
+
+void binary_configfile_part(Array1 <long int> & sizes, string & data, 
+                            vector <string> & pieces, 
+                            vector <long int> & offsets) { 
+  long int n=sizes.GetDim(0);
+  long int ntot;
+  long int first=parallel_prefix_sum(n,ntot);
+  long int totbytes;
+  long int bytes_before=parallel_prefix_sum(data.size(),totbytes);
+  Pack_buffer header;
+  configfile_header(ntot,header);
+  long int data_start=header.size()+(ntot+1)*sizeof(long int);
+
+  //The index entries of this process's walkers.  The last process also 
+  //gives the end of the last walker.
+  int last=(mpi_info.node==mpi_info.nprocs-1);
+  vector <long int> index(n+1);
+  index[0]=data_start+bytes_before;
+  for(long int i=0; i< n; i++) index[i+1]=index[i]+sizes(i);
+  if(index[n]-index[0] != long(data.size())) 
+    error("binary_configfile_part: the walker sizes don't add up");
+
+  pieces.clear();
+  offsets.clear();
+  if(mpi_info.node==0) { 
+    pieces.push_back(string(header.data(),header.size()));
+    offsets.push_back(0);
+  }
+  if(n+last > 0) { 
+    pieces.push_back(string((const char *) &index[0],(n+last)*sizeof(long int)));
+    offsets.push_back(header.size()+first*sizeof(long int));
+  }
+  pieces.push_back(string());
+  pieces.back().swap(data);
+  offsets.push_back(data_start+bytes_before);
+}
+
+//----------------------------------------------------------------------
+
+long int read_binary_configfile_header(FILE * f, const string & filename) { 
+  Pack_buffer buf;
+  configfile_header(0,buf);
+  int nheader=buf.size();
+  buf.resize(nheader);
+  if(fread(buf.data(),1,nheader,f) != size_t(nheader)) 
+    error("Couldn't read the header of ", filename);
+  string magic;
+  int version;
+  long int nwalkers;
+  buf.unpack(magic);
+  buf.unpack(version);
+  buf.unpack(nwalkers);
+  if(magic!=configfile_magic) 
+    error("Not a binary configuration file: ", filename);
+  if(version!=configfile_version) 
+    error("Can only read version ", configfile_version, 
+          " of the binary configuration format; this file is version ", version);
+  return nwalkers;
+}
+
+//----------------------------------------------------------------------
+
+void configfile_slice(long int ntot, long int & first, long int & n) { 
+  long int nper=ntot/mpi_info.nprocs;
+  long int extra=ntot%mpi_info.nprocs;
+  int node=mpi_info.node;
+  first=node*nper+min(long(node),extra);
+  n=nper+(node < extra ? 1:0);
+}
+
+//----------------------------------------------------------------------
+
+void parallel_append(const string & filename, vector <doublevar> & data) { 
+  size_t n=data.size();
+  doublevar * buf=n?&data[0]:NULL;
+#ifdef USE_MPI
+  MPI_File fh;
+  if(MPI_File_open(MPI_Comm_grp, const_cast<char *>(filename.c_str()),
+                   MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh)
+     != MPI_SUCCESS) 
+    error("Couldn't open ", filename);
+  MPI_Offset start;
+  MPI_File_get_size(fh, &start);
+  long long start_l=start;
+  MPI_Bcast(&start_l, 1, MPI_LONG_LONG, 0, MPI_Comm_grp);
+  long long nbytes=(long long)(n)*sizeof(doublevar);
+  long long offset=0;
+  MPI_Exscan(&nbytes, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_Comm_grp);
+  if(mpi_info.node==0) offset=0;
+  //The count of an MPI write is an int, so large buffers go in chunks.  
+  //The write is collective, so every process makes as many calls as the 
+  //one with the most chunks, with nothing left to write if need be.
+  const size_t max_chunk=INT_MAX;
+  long int nchunks=parallel_max(long((n+max_chunk-1)/max_chunk));
+  size_t done=0;
+  MPI_Status status;
+  for(long int c=0; c< nchunks; c++) { 
+    size_t nwrite=min(n-done,max_chunk);
+    MPI_File_write_at_all(fh, start_l+offset+done*sizeof(doublevar), 
+                          nwrite?buf+done:NULL, int(nwrite), MPI_DOUBLE, &status);
+    done+=nwrite;
+  }
+  MPI_File_close(&fh);
+#else
+  FILE * f=fopen(filename.c_str(),"a");
+  if(!f) error("Couldn't open ", filename);
+  fwrite(buf, sizeof(doublevar), n, f);
+  fclose(f);
+#endif
+}
+
+//----------------------------------------------------------------------
+
 int binary_write_checksum(Array1 <doublevar> & a, FILE * f) { 
   int n=a.GetDim(0);
   doublevar n_d=n;
@@ -23,6 +23,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 
 #include "Qmc_std.h"
+#include "Checkpoint_writer.h"
+#include "Pack_buffer.h"
 #include <iomanip>
 
 const string startsec="{";
@@ -366,17 +368,18 @@ template <class T> void read(string & s, T & t) {
 //write(ostream & os)
 //mpiSend(int node)
 //mpiReceive(int node)
+//packCheckpoint(Pack_buffer & buf) const
+//unpackCheckpoint(Pack_buffer & buf)
 //The read() function should be particularly careful not to read past the 
 //end of its section; otherwise the retrieval will not go well.
+//Every process writes its own configurations into its part of the file,
+//in node order, so nothing has to be gathered onto node 0.  writer 
+//writes the file in the background, and writer.wait() must be called 
+//before reading it.  All the processes have to call these.
 template <class ConfigType> void write_configurations(string & filename, 
-                                                      Array1 <ConfigType> & configs) { 
+                                                      Array1 <ConfigType> & configs,
+                                                      Checkpoint_writer & writer) { 
   int nconfigs=configs.GetDim(0);
-  time_t starttime;
-  time(&starttime);
-  string tmpfilename=filename; //+".qw_tomove";
-  string backfilename=filename+".backup";
-  if(mpi_info.node==0) { rename(tmpfilename.c_str(),backfilename.c_str()); }
-#ifdef USE_MPI
   stringstream os;
   os.precision(15);
   for(int i=0; i< nconfigs; i++) { 
@@ -384,48 +387,118 @@ template <class ConfigType> void write_configurations(string & filename,
      configs(i).write(os);
      os << " } \n";
   }
-  string walkstr=os.str();
-  int nthis_string=walkstr.size();
-  if(mpi_info.node==0) { 
-     ofstream os(tmpfilename.c_str());
-     os << walkstr;
-     MPI_Status status;
-     for(int i=1; i< mpi_info.nprocs; i++) { 
-        MPI_Recv(nthis_string,i);
-        char * buf=new char[nthis_string+1];
-        MPI_Recv(buf,nthis_string,MPI_CHAR, i, 0, MPI_Comm_grp, & status);
-        buf[nthis_string]='\0';
-        os << buf; 
-        delete [] buf;
-    }
-  }
-  else { 
-     MPI_Send(nthis_string,0);
-    //we know that MPI_Send obeys const-ness, but the interfaces are not clean 
-    // and so...casting!
-     MPI_Send((char *) walkstr.c_str(),nthis_string, MPI_CHAR, 0,0,MPI_Comm_grp);
-  }
-#else
-  ofstream os(tmpfilename.c_str());
-  os.precision(15);
-  for(int i=0; i< nconfigs; i++) { 
-    os << " walker { \n";
-    configs(i).write(os);
-    os << " } \n";
-  }
-  os.close();
-#endif
-  
+  vector <string> pieces(1,os.str());
+  long int totsize;
+  vector <long int> offsets(1,parallel_prefix_sum(pieces[0].size(),totsize));
+  writer.write(filename,pieces,offsets);
+}
+
+//The same, but waits for the file to be written.
+template <class ConfigType> void write_configurations(string & filename, 
+                                                      Array1 <ConfigType> & configs) { 
+  time_t starttime;
+  time(&starttime);
+  Checkpoint_writer writer;
+  write_configurations(filename,configs,writer);
+  writer.wait();
   time_t endtime;
   time(&endtime);
   if(mpi_info.node==1)
     debug_write(cout, "Write took ", difftime(endtime, starttime), " seconds\n");
 }
 
+//-----------------------------------------------------------------------------
+//The binary configuration file is a header (a magic string, the version 
+//and the number of walkers), then an index of nwalkers+1 byte offsets into 
+//the file, then each walker as written by packCheckpoint().  Using the 
+//index, every process can read only its own walkers, however many 
+//processes wrote the file.
+
+//! Whether filename starts like a binary configuration file
+int is_binary_configfile(const string & filename);
+
+/*!
+ This process's part of the binary file: sizes are the number of bytes 
+ of each of its walkers, and data is all of them together.  Gives the 
+ pieces of the file that this process writes, and where they go, for 
+ Checkpoint_writer::write().  data is emptied.  Collective.
+ */
+void binary_configfile_part(Array1 <long int> & sizes, string & data, 
+                            vector <string> & pieces, 
+                            vector <long int> & offsets);
+
+/*!
+ Reads the header and checks it; returns the number of walkers and leaves 
+ f at the start of the index.
+ */
+long int read_binary_configfile_header(FILE * f, const string & filename);
+
+/*!
+ Which of ntot walkers this process should take: they are divided as 
+ evenly as possible, in node order.
+ */
+void configfile_slice(long int ntot, long int & first, long int & n);
+
+//Writes the configurations of all the nodes into one binary file.  As with
+//the text version, each process writes its own walkers.
+template <class ConfigType> void write_binary_configurations(string & filename, 
+                                                             Array1 <ConfigType> & configs,
+                                                             Checkpoint_writer & writer) { 
+  int nconfigs=configs.GetDim(0);
+  Array1 <long int> sizes(nconfigs);
+  Pack_buffer walkers;
+  for(int i=0; i< nconfigs; i++) { 
+    int start=walkers.size();
+    configs(i).packCheckpoint(walkers);
+    sizes(i)=walkers.size()-start;
+  }
+  string data(walkers.data() ? walkers.data() : "", walkers.size());
+  vector <string> pieces;
+  vector <long int> offsets;
+  binary_configfile_part(sizes,data,pieces,offsets);
+  writer.write(filename,pieces,offsets);
+}
+
+//Each node reads its own share of the walkers from a binary file.
+template <class ConfigType> void read_binary_configurations(string & filename, 
+                                                            Array1 <ConfigType> & configs) { 
+  time_t starttime;  time(&starttime);
+  FILE * f=fopen(filename.c_str(),"rb");
+  if(!f) error("Could not open ", filename);
+  long int ntot=read_binary_configfile_header(f,filename);
+  long int index_start=ftell(f);
+  long int first, n;
+  configfile_slice(ntot,first,n);
+  vector <long int> offsets(n+1);
+  if(fseek(f,index_start+first*sizeof(long int),SEEK_SET) 
+     || fread(&offsets[0],sizeof(long int),n+1,f) != size_t(n+1)) 
+    error("Couldn't read the index of ", filename);
+  Pack_buffer all;
+  all.resize(offsets[n]-offsets[0]);
+  if(all.size() > 0 && (fseek(f,offsets[0],SEEK_SET) 
+     || fread(all.data(),1,all.size(),f) != size_t(all.size())))
+    error("Couldn't read the walkers from ", filename, "; it may be truncated");
+  fclose(f);
+
+  configs.Resize(n);
+  Pack_buffer walker;
+  for(int i=0; i< n; i++) { 
+    walker.assign(all.data()+offsets[i]-offsets[0],offsets[i+1]-offsets[i]);
+    configs(i).unpackCheckpoint(walker);
+  }
+  time_t endtime;
+  time(&endtime);
+  single_write(cout, "Read took ", difftime(endtime, starttime), " seconds\n");  
+}
+
 //Reads configurations from the file and gives an array with the configurations 
 //for this 
 template <class ConfigType> void read_configurations(string & filename, 
                                                      Array1 <ConfigType> & configs) { 
+  if(is_binary_configfile(filename)) { 
+    read_binary_configurations(filename,configs);
+    return;
+  }
   //vector <ConfigType> allconfigs; 
   time_t starttime;  time(&starttime);
   if(mpi_info.node==0) { 
@@ -443,18 +516,20 @@ template <class ConfigType> void read_configurations(string & filename,
     is.clear();
     is.seekg(0); //Go back to the beginning of the file
 
-    if(totconfs%mpi_info.nprocs != 0) {
-      error("Non-even number of walkers/node.  Change the number of processors to something that divides ",totconfs);
-    }
+    //The walkers are dealt out in turn, so the first totconfs%nprocs
+    //nodes get one more than the others.
     int n_per_node=totconfs/mpi_info.nprocs;
+    int nextra=totconfs%mpi_info.nprocs;
     //cout << mpi_info.node << ": n_per_node " << n_per_node << endl;
     //Go ahead and get the slaves to allocate their walkers.
     //(probably should be broadcast())
 #ifdef USE_MPI
-    for(int node=1; node < mpi_info.nprocs; node++) 
-      MPI_Send(&n_per_node, 1, MPI_INT,node, 0, MPI_Comm_grp);
+    for(int node=1; node < mpi_info.nprocs; node++) { 
+      int nconf_node=n_per_node+(node < nextra ? 1:0);
+      MPI_Send(&nconf_node, 1, MPI_INT,node, 0, MPI_Comm_grp);
+    }
 #endif    
-    configs.Resize(n_per_node);
+    configs.Resize(n_per_node+(nextra > 0 ? 1:0));
     int currwalker=0;
     int currwalker_node0=0;
     ConfigType tmpconf;
@@ -514,6 +589,19 @@ Returns:
   0 if not
 */
 int binary_write_checksum(Array1 <doublevar> & , FILE * f);
+
+/*!
+ Append the array to rec in the same format as binary_write_checksum, 
+ so that many arrays can be written at once.
+*/
+void binary_pack_checksum(Array1 <doublevar> & , vector <doublevar> & rec);
+
+/*!
+ Collective: every process appends its data to the end of the file, in 
+ the order of the processes.  Each process writes its own part of the 
+ file with MPI-IO, so nothing goes through the root process.
+*/
+void parallel_append(const string & filename, vector <doublevar> & data);
 /*!
  Read the binary file written by binary_write_checksum, check that the checksum matches.
  If an array was cut off (i.e. the checksum doesn't match), try to find the next array to read in.
@@ -21,11 +21,20 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "ulec.h"
 
 Random_generator rng;
+int Random_generator::use_streams=0;
+uint32_t Random_generator::stream_key[2]={0,0};
+uint32_t Random_generator::stream_epoch=0;
 
 
+//State of the generator behind unif(); each thread has its own copy,
+//seeded once in seed_thread_rng().
+static int ix=1234567;
+static bool ix_seeded=false;
+#pragma omp threadprivate(ix,ix_seeded)
+
 double unif()
 {
-  static int ix=1234567;
+  if(rng.inStream()) return rng.ulec();
   int k1=ix/127773;
   ix=16807*(ix-k1*127773)-k1*2836;
   if(ix < 0)
@@ -34,6 +43,46 @@ double unif()
 }
 
 
+//----------------------------------------------------------------------
+
+//Seed of unif() for thread t of this process.  The first thread of 
+//the first process keeps the original seed.
+static int unif_seed(int t) { 
+  uint64_t z=uint64_t(mpi_info.node)*qmc_nthreads()+t;
+  if(z==0) return 1234567;
+  z=z*0x9E3779B97F4A7C15ULL;
+  z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+  z=(z^(z>>27))*0x94D049BB133111EBULL;
+  z^=z>>31;
+  return int(z%2147483646)+1;
+}
+
+void seed_thread_rng() { 
+  int nthreads=qmc_nthreads();
+#pragma omp parallel
+  {
+    if(!ix_seeded) ix=unif_seed(qmc_thread_id());
+    ix_seeded=true;
+  }
+  if(nthreads < 2) return;
+  Array2 <long int> seeds(nthreads,2);
+  //With counter-based streams, the seeds come from a stream of their own,
+  //so the master's sequence doesn't depend on the number of threads.
+  rng.setStream(Random_generator::reservedStream(0),0);
+  for(int t=1; t< nthreads; t++) { 
+    seeds(t,0)=long(rng.ulec()*2147483500)+1;
+    seeds(t,1)=long(rng.ulec()*2147483300)+1;
+  }
+  rng.endStream();
+#pragma omp parallel
+  {
+    int t=qmc_thread_id();
+    if(t > 0) rng.seed(seeds(t,0),seeds(t,1));
+  }
+}
+
+//----------------------------------------------------------------------
+
 doublevar ranr2exponential() {
   while(1) { 
     doublevar ex=-log(rng.ulec())/.4;
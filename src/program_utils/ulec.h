@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define ULEC_H_INCLUDED
 
 #include "Qmc_std.h"
+#include <stdint.h>
 
 
 /*!
@@ -57,6 +58,7 @@ public:
     
     iset=0;
     gset=.1;
+    stream=0;
   }
 
   void seed(long int is1_,long int is2_)
@@ -82,6 +84,7 @@ public:
    */
   double ulec()
   {
+    if(stream) return stream_unif();
     long int k,iz;
     k=is1/53668;
     is1=is1-k*53668;
@@ -132,12 +135,112 @@ public:
     }
   }
 
+  /*!
+    Turn on the counter-based streams for the whole run.  The key has to
+    be the same on all processes.
+   */
+  static void setStreamKey(long int key1, long int key2) { 
+    use_streams=1;
+    stream_key[0]=uint32_t(key1);
+    stream_key[1]=uint32_t(key2);
+  }
+
+  /*!
+    Start a new run of the streams, after the run last.  Each QMC method
+    does this at its start, so that the steps of different methods, or of
+    a run restarted from a checkpoint, don't draw the same numbers.  It 
+    has to be called the same way on all processes.
+   */
+  static uint32_t newStreamEpoch(uint32_t last=0) { 
+    stream_epoch=max(stream_epoch,last)+1;
+    return stream_epoch;
+  }
+
+  /*!
+    If the streams are on, draw from the stream of (walker, step) in the
+    current run until endStream().  Each number is then a function of 
+    only the key, the run, the walker, the step, and how many numbers 
+    came before it, so it doesn't matter which process or thread moves 
+    the walker.  walker should be an id that stays with the walker for 
+    the whole run, whatever process it is on.  It can use 48 bits, and 
+    the ones with all of the top 16 bits set are kept for streams that
+    don't belong to a walker.
+   */
+  void setStream(uint64_t walker, uint32_t step) { 
+    if(!use_streams) return;
+    if(!stream) { 
+      save_iset=iset;
+      save_gset=gset;
+    }
+    stream=1;
+    counter[0]=0;
+    counter[1]=step;
+    counter[2]=uint32_t(walker);
+    counter[3]=uint32_t((walker>>32)<<16) | (stream_epoch & 0xffff);
+    nbuffer=0;
+    iset=0;
+  }
+
+  //! The id of the n'th stream that doesn't belong to a walker
+  static uint64_t reservedStream(uint32_t n) { 
+    return (uint64_t(0xffff)<<32) | n;
+  }
+
+  //! Go back to the sequential generator
+  void endStream() { 
+    if(!stream) return;
+    stream=0;
+    iset=save_iset;
+    gset=save_gset;
+  }
+
+  int inStream() { return stream; }
+
 private:
   long int is1;
   long int is2;
   int iset;
   double gset;
 
+  static int use_streams;
+  static uint32_t stream_key[2];
+  static uint32_t stream_epoch;
+  int stream;
+  uint32_t counter[4];
+  uint32_t buffer[4];
+  int nbuffer;
+  int save_iset;
+  double save_gset;
+
+  /*!
+    Philox4x32-10, from Salmon et al, "Parallel random numbers: as easy 
+    as 1, 2, 3", SC11.
+   */
+  void philox(const uint32_t * ctr, uint32_t * out) const { 
+    uint32_t c0=ctr[0], c1=ctr[1], c2=ctr[2], c3=ctr[3];
+    uint32_t k0=stream_key[0], k1=stream_key[1];
+    for(int r=0; r< 10; r++) { 
+      uint64_t p0=uint64_t(0xD2511F53)*c0;
+      uint64_t p1=uint64_t(0xCD9E8D57)*c2;
+      c0=uint32_t(p1>>32)^c1^k0;
+      c1=uint32_t(p1);
+      c2=uint32_t(p0>>32)^c3^k1;
+      c3=uint32_t(p0);
+      k0+=0x9E3779B9;
+      k1+=0xBB67AE85;
+    }
+    out[0]=c0; out[1]=c1; out[2]=c2; out[3]=c3;
+  }
+
+  double stream_unif() { 
+    if(nbuffer==0) { 
+      philox(counter,buffer);
+      counter[0]++;
+      nbuffer=4;
+    }
+    return (buffer[4-nbuffer--]+0.5)*2.3283064365386963e-10;
+  }
+
 };
 
 /*!
@@ -145,6 +248,16 @@ This is one of the few times that we actually
 _want_ a global variable...
 */
 extern Random_generator rng;
+//Each thread gets its own generator; see seed_thread_rng()
+#pragma omp threadprivate(rng)
+
+/*!
+Seed the generators of the other OpenMP threads from the master
+thread's generator.  The master thread keeps its own stream, so a
+single-threaded run draws exactly the same random numbers as before.
+unif() is seeded from the process and thread number.
+*/
+void seed_thread_rng();
 
 double unif();
 
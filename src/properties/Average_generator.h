@@ -27,10 +27,19 @@
 #include "Basis_function.h"
 #include "System.h"
 #include "Basis_function.h"
+#include "Pack_buffer.h"
 struct Properties_point;
 struct Average_return {
   string type;
   Array1 <doublevar> vals;
+  void pack(Pack_buffer & buf) const { 
+    buf.pack(type);
+    buf.pack(vals);
+  }
+  void unpack(Pack_buffer & buf) { 
+    buf.unpack(type);
+    buf.unpack(vals);
+  }
 };
 
 /*!
@@ -317,6 +317,27 @@ void One_particle_density::write() {
   
 }
 
+//----------------------------------------------------------------------
+
+void One_particle_density::makeEmptyCopy(System * sys, 
+    Local_density_accumulator *& ptr) { 
+  One_particle_density * copy=new One_particle_density(*this);
+  copy->clear();
+  ptr=copy;
+}
+
+//----------------------------------------------------------------------
+
+void One_particle_density::addAndClear(Local_density_accumulator * other) { 
+  One_particle_density * dens=dynamic_cast<One_particle_density *>(other);
+  assert(dens != NULL);
+  assert(dens->bin.GetSize()==bin.GetSize());
+  int n=bin.GetSize();
+  for(int i=0; i< n; i++) bin.v[i]+=dens->bin.v[i];
+  nsample+=dens->nsample;
+  dens->clear();
+}
+
 //######################################################################
 
 void Local_potential_density::init(vector <string> & words, 
@@ -357,6 +378,22 @@ void Local_potential_density::write() {
   density_1b.write();
 }
 
+void Local_potential_density::makeEmptyCopy(System * sys_, 
+    Local_density_accumulator *& ptr) { 
+  Local_potential_density * copy=new Local_potential_density(*this);
+  copy->sys=sys_;
+  copy->density_2b.clear();
+  copy->density_1b.clear();
+  ptr=copy;
+}
+
+void Local_potential_density::addAndClear(Local_density_accumulator * other) { 
+  Local_potential_density * dens=dynamic_cast<Local_potential_density *>(other);
+  assert(dens != NULL);
+  density_2b.addAndClear(&dens->density_2b);
+  density_1b.addAndClear(&dens->density_1b);
+}
+
 //######################################################################
 //--------------------------------------------------
 
@@ -492,6 +529,41 @@ void Properties_manager::insertPoint(int step,
 
 }
 
+//--------------------------------------------------
+
+void Properties_manager::mergeBlock(Properties_manager & other) { 
+  int n2=other.npoints_this_block;
+  if(n2==0) return;
+  if(npoints_this_block==0) { 
+    weighted_sum=other.weighted_sum;
+    sample_avg=other.sample_avg;
+    sample_var=other.sample_var;
+    energy_avg=other.energy_avg;
+    energy_var=other.energy_var;
+  }
+  else { 
+    //the sample averages are running averages of the values and their
+    //squares, so we just weight them by the number of points.
+    doublevar f1=doublevar(npoints_this_block)/(npoints_this_block+n2);
+    doublevar f2=doublevar(n2)/(npoints_this_block+n2);
+    weighted_sum.unweighted_add(other.weighted_sum);
+    for(int w=0; w< nwf; w++) { 
+      sample_avg.kinetic(w)=f1*sample_avg.kinetic(w)+f2*other.sample_avg.kinetic(w);
+      sample_var.kinetic(w)=f1*sample_var.kinetic(w)+f2*other.sample_var.kinetic(w);
+      sample_avg.potential(w)=f1*sample_avg.potential(w)+f2*other.sample_avg.potential(w);
+      sample_var.potential(w)=f1*sample_var.potential(w)+f2*other.sample_var.potential(w);
+      sample_avg.nonlocal(w)=f1*sample_avg.nonlocal(w)+f2*other.sample_avg.nonlocal(w);
+      sample_var.nonlocal(w)=f1*sample_var.nonlocal(w)+f2*other.sample_var.nonlocal(w);
+      sample_avg.weight(w)=f1*sample_avg.weight(w)+f2*other.sample_avg.weight(w);
+      sample_var.weight(w)=f1*sample_var.weight(w)+f2*other.sample_var.weight(w);
+      energy_avg(w)=f1*energy_avg(w)+f2*other.energy_avg(w);
+      energy_var(w)=f1*energy_var(w)+f2*other.energy_var(w);
+    }
+  }
+  npoints_this_block+=n2;
+  other.npoints_this_block=0;
+}
+
 
 //--------------------------------------------------
 
@@ -75,6 +75,13 @@ class Properties_manager {
                    int walker, 
                    const Properties_point & pt);
 
+  /*!
+    Add the points that other has accumulated in its current block to
+    this one's current block, and empty other's block.  Threads insert
+    into their own managers, which are merged before endBlock().
+   */
+  void mergeBlock(Properties_manager & other);
+
   void endBlock();
 
   void endBlock_per_step();
@@ -152,6 +159,15 @@ class Local_density_accumulator {
       must be called by all processes!
     */
     virtual void write()=0;
+    /*!
+      Make an empty accumulator on the same grid that a thread can 
+      accumulate into privately.  sys is that thread's System.
+    */
+    virtual void makeEmptyCopy(System * sys, Local_density_accumulator *& ptr)=0;
+    /*!
+      Add the samples from a copy made by makeEmptyCopy() and empty it.
+    */
+    virtual void addAndClear(Local_density_accumulator * other)=0;
     virtual ~Local_density_accumulator() { }
 };
 
@@ -180,6 +196,13 @@ class One_particle_density:public Local_density_accumulator {
     must be called by all processes!
    */
   void write(); 
+  void makeEmptyCopy(System * sys, Local_density_accumulator *& ptr);
+  void addAndClear(Local_density_accumulator * other);
+  //! Throw away all the samples, keeping the grid.
+  void clear() { 
+    bin=0;
+    nsample=0;
+  }
 
  protected:
   Array3 <doublevar> bin; //!< count of hits
@@ -202,6 +225,8 @@ class Local_potential_density:public Local_density_accumulator {
     void init(vector <string> &, System *, string & runid);
     void accumulate(Sample_point *, doublevar weight);
     void write();
+    void makeEmptyCopy(System * sys, Local_density_accumulator *& ptr);
+    void addAndClear(Local_density_accumulator * other);
   private:
     One_particle_density density_2b;
     One_particle_density density_1b;
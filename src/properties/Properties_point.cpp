@@ -36,40 +36,56 @@ void Properties_point::setSize(int nwf) {
 
 //---------------------------------------------------------------------
 
-void Properties_point::mpiSend(int node) {
-#ifdef USE_MPI
-  int nwf=kinetic.GetDim(0);
-
-  MPI_Send(&nwf, 1, MPI_INT, node, 0, MPI_Comm_grp);
-  MPI_Send(children.v, children.GetDim(0), MPI_INT,
-           node, 0,MPI_Comm_grp);
-  MPI_Send(&nchildren, 1, MPI_INT, node, 0, MPI_Comm_grp);
-  MPI_Send(&parent, 1, MPI_INT, node, 0, MPI_Comm_grp);
-  MPI_Send(&count, 1, MPI_INT, node, 0, MPI_Comm_grp);
-  MPI_Send(kinetic.v, kinetic.GetDim(0), MPI_DOUBLE, 
-           node, 0, MPI_Comm_grp);
-  MPI_Send(potential.v, potential.GetDim(0), MPI_DOUBLE,
-           node, 0, MPI_Comm_grp);
-  MPI_Send(nonlocal.v, nonlocal.GetDim(0), MPI_DOUBLE, 
-           node, 0, MPI_Comm_grp);
-  MPI_Send(weight.v, weight.GetDim(0), MPI_DOUBLE, node, 
-           0, MPI_Comm_grp);
-  MPI_Send(wf_val.amp.v, wf_val.amp.GetDim(0)*wf_val.amp.GetDim(1),
-           MPI_DOUBLE, node, 0, MPI_Comm_grp);
-  MPI_Send(wf_val.phase.v, wf_val.phase.GetDim(0)*wf_val.phase.GetDim(1),
-           MPI_DOUBLE, node, 0, MPI_Comm_grp);
-
-  
+void Properties_point::pack(Pack_buffer & buf) const {
+  buf.pack(children);
+  buf.pack(nchildren);
+  buf.pack(parent);
+  buf.pack(count);
+  buf.pack(kinetic);
+  buf.pack(potential);
+  buf.pack(nonlocal);
+  buf.pack(weight);
+  buf.pack(wf_val.amp);
+  buf.pack(wf_val.phase);
   int ni=avgrets.GetDim(0);
   int nj=avgrets.GetDim(1);
-  MPI_Send(ni,node);
-  MPI_Send(nj,node);
-  for(int i=0; i< ni; i++) { 
-    for(int j=0; j< nj; j++) { 
-      MPI_Send(avgrets(i,j).vals,node);
-      MPI_Send(avgrets(i,j).type,node);
-    }
-  }
+  buf.pack(ni);
+  buf.pack(nj);
+  for(int i=0; i< ni; i++) 
+    for(int j=0; j< nj; j++) 
+      avgrets(i,j).pack(buf);
+}
+
+//---------------------------------------------------------------------
+
+void Properties_point::unpack(Pack_buffer & buf) {
+  buf.unpack(children);
+  buf.unpack(nchildren);
+  buf.unpack(parent);
+  buf.unpack(count);
+  buf.unpack(kinetic);
+  buf.unpack(potential);
+  buf.unpack(nonlocal);
+  buf.unpack(weight);
+  buf.unpack(wf_val.amp);
+  buf.unpack(wf_val.phase);
+  wf_val.cvals.Resize(wf_val.amp.GetDim(0),wf_val.amp.GetDim(1));
+  int ni,nj;
+  buf.unpack(ni);
+  buf.unpack(nj);
+  avgrets.Resize(ni,nj);
+  for(int i=0; i< ni; i++) 
+    for(int j=0; j< nj; j++) 
+      avgrets(i,j).unpack(buf);
+}
+
+//---------------------------------------------------------------------
+
+void Properties_point::mpiSend(int node) {
+#ifdef USE_MPI
+  Pack_buffer buf;
+  pack(buf);
+  buf.mpiSend(node);
 #else
     error("Properties_point::mpi_send: not using MPI,"
           " this is most likely a bug");
@@ -80,43 +96,9 @@ void Properties_point::mpiSend(int node) {
 
 void Properties_point::mpiReceive(int node) {
 #ifdef USE_MPI
-  MPI_Status status;
-
-  int nwf;
-  MPI_Recv(&nwf, 1, MPI_INT, node, 0, MPI_Comm_grp, &status);
-  //cout << mpi_info.node << "  " << nwf << endl;
-
-  setSize(nwf);
-  MPI_Recv(children.v, children.GetDim(0), MPI_INT,
-           node, 0,MPI_Comm_grp, &status);
-  MPI_Recv(&nchildren, 1, MPI_INT, node, 0, MPI_Comm_grp, &status);
-  MPI_Recv(&parent, 1, MPI_INT, node, 0, MPI_Comm_grp, &status);
-
-  MPI_Recv(&count, 1, MPI_INT, node, 0, MPI_Comm_grp, &status);
-  MPI_Recv(kinetic.v, kinetic.GetDim(0), MPI_DOUBLE, 
-           node, 0, MPI_Comm_grp, & status);
-  MPI_Recv(potential.v, potential.GetDim(0), MPI_DOUBLE,
-           node, 0, MPI_Comm_grp, & status);
-
-  MPI_Recv(nonlocal.v, nonlocal.GetDim(0), MPI_DOUBLE, 
-           node, 0, MPI_Comm_grp, & status);
-  MPI_Recv(weight.v, weight.GetDim(0), MPI_DOUBLE, node, 
-           0, MPI_Comm_grp, & status);
-  MPI_Recv(wf_val.amp.v, wf_val.amp.GetDim(0)*wf_val.amp.GetDim(1),
-           MPI_DOUBLE,node, 0, MPI_Comm_grp, & status);
-  MPI_Recv(wf_val.phase.v, wf_val.phase.GetDim(0)*wf_val.phase.GetDim(1),
-           MPI_DOUBLE,node, 0, MPI_Comm_grp, & status);
-  int ni,nj;
-  MPI_Recv(ni,node);
-  MPI_Recv(nj,node);
-  avgrets.Resize(ni,nj);
-  for(int i=0; i< ni; i++) { 
-    for(int j=0; j< nj; j++) { 
-      MPI_Recv(avgrets(i,j).vals,node);
-      MPI_Recv(avgrets(i,j).type,node);
-    }
-  }
-
+  Pack_buffer buf;
+  buf.mpiReceive(node);
+  unpack(buf);
 #else
   
   error("Properties_point::mpiRecieve: not using MPI,"
@@ -49,6 +49,8 @@ struct Properties_point {
   }
   void mpiSend(int node);
   void mpiReceive(int node);
+  void pack(Pack_buffer & buf) const;
+  void unpack(Pack_buffer & buf);
   void write(string & indent, ostream & os);
   void read(istream & is);
 
@@ -0,0 +1,345 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include "Ewald_sum.h"
+#include "MatrixAlgebra.h"
+#include "qmc_io.h"
+#include <algorithm>
+
+//----------------------------------------------------------------------
+
+/*!
+  Estimated error in the real space part of the energy when the sum is
+  cut off at rc.
+ */
+static doublevar realError(doublevar qsqrd, doublevar volume,
+                           doublevar alpha, doublevar rc) {
+  doublevar ar=alpha*rc;
+  return qsqrd*sqrt(rc/(2*volume))*exp(-ar*ar)/(ar*ar);
+}
+
+/*!
+  Estimated error in the reciprocal part of the energy when the sum is
+  cut off at |g|=gc.
+ */
+static doublevar recipError(doublevar qsqrd, doublevar volume,
+                            doublevar alpha, doublevar gc) {
+  doublevar k=gc*pow(volume, 1.0/3.0)/(2*pi);
+  doublevar x=gc/(2*alpha);
+  return qsqrd*alpha/(pi*pi)*pow(k, -1.5)*exp(-x*x);
+}
+
+/*!
+  The smallest cutoff for which err(cutoff) < tolerance.  err must
+  decrease with the cutoff.
+ */
+static doublevar findCutoff(doublevar (*err)(doublevar, doublevar,
+                                             doublevar, doublevar),
+                            doublevar qsqrd, doublevar volume,
+                            doublevar alpha, doublevar tolerance,
+                            doublevar start) {
+  doublevar lo=0, hi=start;
+  while(err(qsqrd, volume, alpha, hi) > tolerance) {
+    lo=hi;
+    hi*=2;
+  }
+  for(int i=0; i< 60; i++) {
+    doublevar mid=0.5*(lo+hi);
+    if(err(qsqrd, volume, alpha, mid) > tolerance) lo=mid;
+    else hi=mid;
+  }
+  return hi;
+}
+
+//----------------------------------------------------------------------
+
+void Ewald_sum::setup(const Array2 <doublevar> & latvec, int nelectrons,
+                      int nions, doublevar qsqrd, doublevar tolerance_,
+                      int gmax) {
+  const int ndim=3;
+  tolerance=tolerance_;
+  if(tolerance <= 0)
+    error("The Ewald tolerance must be positive; got ", tolerance);
+  if(qsqrd <= 0) qsqrd=1;
+
+  //cross product:  0->1x2, 1->2x0, 2->0x1
+  Array2 <doublevar> cross(ndim, ndim);
+  for(int i=0; i< ndim; i++) {
+    int j=(i+1)%ndim, k=(i+2)%ndim;
+    cross(i,0)=latvec(j,1)*latvec(k,2)-latvec(j,2)*latvec(k,1);
+    cross(i,1)=latvec(j,2)*latvec(k,0)-latvec(j,0)*latvec(k,2);
+    cross(i,2)=latvec(j,0)*latvec(k,1)-latvec(j,1)*latvec(k,0);
+  }
+  volume=0;
+  for(int d=0; d< ndim; d++) volume+=latvec(0,d)*cross(0,d);
+  volume=fabs(volume);
+
+  recipvec.Resize(ndim, ndim);
+  Array1 <doublevar> lattice_length(ndim), plane_height(ndim);
+  height=1e99;
+  doublevar rmax=0, longest=0;
+  for(int i=0; i< ndim; i++) {
+    doublevar cross_length=0;
+    lattice_length(i)=0;
+    for(int d=0; d< ndim; d++) {
+      recipvec(i,d)=2*pi*cross(i,d)/volume;
+      cross_length+=cross(i,d)*cross(i,d);
+      lattice_length(i)+=latvec(i,d)*latvec(i,d);
+    }
+    lattice_length(i)=sqrt(lattice_length(i));
+    plane_height(i)=volume/sqrt(cross_length);
+    height=min(height, plane_height(i));
+    rmax+=lattice_length(i);
+    longest=max(longest, lattice_length(i));
+  }
+
+  //--------Choose alpha
+  //The real space part costs a table lookup for every pair that is within
+  //the cutoff of an image, and the reciprocal part a few multiplies for
+  //every electron and g point.  Scan alpha on a logarithmic grid and take
+  //the cheapest one that meets the tolerance in both parts.
+  const doublevar recip_cost=0.2;
+  doublevar npairs=0.5*nelectrons*(nelectrons-1.0)+doublevar(nelectrons)*nions;
+  doublevar cell_length=pow(volume, 1.0/3.0);
+  doublevar best_cost=1e99;
+  const int nscan=400;
+  for(int s=0; s< nscan; s++) {
+    doublevar a=0.5*pow(100.0, doublevar(s)/(nscan-1))/cell_length;
+    doublevar rc=findCutoff(realError, qsqrd, volume, a, tolerance,
+                            1.0/a);
+    doublevar gc=findCutoff(recipError, qsqrd, volume, a, tolerance,
+                            a);
+    doublevar nreal=4.0/3.0*pi*rc*rc*rc/volume;
+    doublevar nrecip=4.0/3.0*pi*gc*gc*gc*volume/(8*pi*pi*pi)/2;
+    doublevar cost=npairs*nreal+recip_cost*nelectrons*nrecip;
+    if(cost < best_cost) {
+      best_cost=cost;
+      alpha=a;
+      rcut=rc;
+      gcut=gc;
+    }
+  }
+
+  //--------g points inside the cutoff, one of each g,-g pair
+  Array1 <int> nmax(ndim);
+  int capped=0;
+  for(int i=0; i< ndim; i++) {
+    nmax(i)=int(gcut*lattice_length(i)/(2*pi));
+    if(gmax > 0 && nmax(i) > gmax) {
+      nmax(i)=gmax;
+      capped=1;
+    }
+  }
+  if(capped) {
+    //every g shorter than this has all its indices within gmax
+    gcut=min(gcut, 2*pi*(gmax+1)/longest);
+    single_write(cout, "**Warning** EWALD_GMAX limits the reciprocal Ewald sum;"
+                 " the error estimate is ", recipError(qsqrd, volume, alpha, gcut),
+                 "\n");
+  }
+  doublevar gcut2=gcut*gcut;
+
+  vector <int> gtmp;
+  for(int ig=0; ig <= nmax(0); ig++) {
+    int jgmin=-nmax(1);
+    if(ig==0) jgmin=0;
+    for(int jg=jgmin; jg <= nmax(1); jg++) {
+      int kgmin=-nmax(2);
+      if(ig==0 && jg==0) kgmin=1;
+      for(int kg=kgmin; kg <= nmax(2); kg++) {
+        doublevar gsqrd=0;
+        for(int d=0; d< ndim; d++) {
+          doublevar g=ig*recipvec(0,d)+jg*recipvec(1,d)+kg*recipvec(2,d);
+          gsqrd+=g*g;
+        }
+        if(gsqrd <= gcut2) {
+          gtmp.push_back(ig);
+          gtmp.push_back(jg);
+          gtmp.push_back(kg);
+        }
+      }
+    }
+  }
+
+  ngpoints=gtmp.size()/3;
+  gpoint.Resize(ngpoints, ndim);
+  gweight.Resize(ngpoints);
+  gindex.Resize(ngpoints, ndim);
+  gindex_max=0;
+  for(int gpt=0; gpt < ngpoints; gpt++) {
+    doublevar gsqrd=0;
+    for(int i=0; i< ndim; i++) {
+      gindex(gpt,i)=gtmp[3*gpt+i];
+      gindex_max=max(gindex_max, abs(gindex(gpt,i)));
+    }
+    for(int d=0; d< ndim; d++) {
+      gpoint(gpt,d)=0;
+      for(int i=0; i< ndim; i++) gpoint(gpt,d)+=gindex(gpt,i)*recipvec(i,d);
+      gsqrd+=gpoint(gpt,d)*gpoint(gpt,d);
+    }
+    gweight(gpt)=4.0*pi*exp(-gsqrd/(4*alpha*alpha))/(volume*gsqrd);
+  }
+
+  //--------lattice translations that can bring a difference of two
+  //positions in the cell within rcut.
+  doublevar reach=rcut+rmax;
+  Array1 <int> mmax(ndim);
+  for(int i=0; i< ndim; i++) mmax(i)=int(ceil(reach/plane_height(i)));
+  vector < pair <doublevar, int> > order;
+  vector <doublevar> imtmp;
+  for(int ii=-mmax(0); ii <= mmax(0); ii++) {
+    for(int jj=-mmax(1); jj <= mmax(1); jj++) {
+      for(int kk=-mmax(2); kk <= mmax(2); kk++) {
+        doublevar L[3];
+        doublevar len=0;
+        for(int d=0; d< ndim; d++) {
+          L[d]=ii*latvec(0,d)+jj*latvec(1,d)+kk*latvec(2,d);
+          len+=L[d]*L[d];
+        }
+        len=sqrt(len);
+        if(len <= reach) {
+          order.push_back(pair <doublevar, int> (len, imtmp.size()/3));
+          for(int d=0; d< ndim; d++) imtmp.push_back(L[d]);
+        }
+      }
+    }
+  }
+  sort(order.begin(), order.end());
+  nimages=order.size();
+  images.Resize(nimages, ndim);
+  image_length.Resize(nimages);
+  for(int i=0; i< nimages; i++) {
+    image_length(i)=order[i].first;
+    for(int d=0; d< ndim; d++) images(i,d)=imtmp[3*order[i].second+d];
+  }
+
+  rcut2=rcut*rcut;
+  buildShortRange();
+
+  real_error=realError(qsqrd, volume, alpha, rcut);
+  recip_error=recipError(qsqrd, volume, alpha, gcut);
+  debug_write(cout, "Ewald alpha ", alpha, " rcut ", rcut);
+  debug_write(cout, " gcut ", gcut, "\n");
+}
+
+//----------------------------------------------------------------------
+
+/*!
+  erf(alpha r)/r=2 alpha/sqrt(pi) sum_n (-alpha^2 r^2)^n/(n!(2n+1)) is
+  smooth in r^2, and its fourth derivative is at most 2 alpha^9/(9 sqrt(pi)),
+  which sets the spacing of the table for an error of about 1e-11.
+ */
+void Ewald_sum::buildShortRange() {
+  const doublevar table_error=1e-11;
+  const int max_points=1<<16;
+  doublevar a2=alpha*alpha;
+  doublevar d4=2*pow(alpha, 9)/(9*sqrt(pi));
+  doublevar spacing=pow(table_error*384/(5*d4), 0.25);
+  int npoints=int(rcut2/spacing)+2;
+  if(npoints > max_points) npoints=max_points;
+  spacing=rcut2/(npoints-1);
+
+  Array1 <doublevar> x(npoints), y(npoints);
+  for(int i=0; i< npoints; i++) {
+    x(i)=i*spacing;
+    if(i==0) y(i)=2*alpha/sqrt(pi);
+    else y(i)=erf(alpha*sqrt(x(i)))/sqrt(x(i));
+  }
+  doublevar yp1=-2*a2*alpha/(3*sqrt(pi));
+  doublevar ypn=alpha*exp(-a2*rcut2)/(sqrt(pi)*rcut2)-y(npoints-1)/(2*rcut2);
+  short_range.splinefit(x, y, yp1, ypn);
+}
+
+//----------------------------------------------------------------------
+
+doublevar Ewald_sum::realSum(const Array1 <doublevar> & r) {
+  doublevar rr2=r(0)*r(0)+r(1)*r(1)+r(2)*r(2);
+  doublevar sum=0;
+  if(rr2 < rcut2) sum=shortRange(rr2);
+
+  //|r+L| >= |L|-|r|, so once the images are that far out, we're done.
+  doublevar reach=rcut+sqrt(rr2);
+  for(int i=1; i< nimages && image_length(i) < reach; i++) {
+    doublevar x=r(0)+images(i,0), y=r(1)+images(i,1), z=r(2)+images(i,2);
+    doublevar r2=x*x+y*y+z*z;
+    if(r2 < rcut2) sum+=shortRange(r2);
+  }
+  return sum;
+}
+
+//----------------------------------------------------------------------
+
+doublevar Ewald_sum::selfImages() {
+  doublevar sum=0;
+  for(int i=1; i< nimages && image_length(i) < rcut; i++) {
+    sum+=shortRange(image_length(i)*image_length(i));
+  }
+  return sum;
+}
+
+//----------------------------------------------------------------------
+
+void Ewald_sum::phases(const Array1 <doublevar> & r,
+                       Array1 <doublevar> & cs,
+                       Array1 <doublevar> & sn) {
+  const int nmax=gindex_max;
+  const int ntab=2*nmax+1;
+  //tab_cos(i,nmax+n)=cos(n b_i.r), likewise for sin
+  Array2 <doublevar> tab_cos(3,ntab), tab_sin(3,ntab);
+  for(int i=0; i< 3; i++) {
+    doublevar theta=0;
+    for(int d=0; d< 3; d++) theta+=recipvec(i,d)*r(d);
+    doublevar c1=cos(theta), s1=sin(theta);
+    tab_cos(i,nmax)=1.0;
+    tab_sin(i,nmax)=0.0;
+    for(int n=1; n<= nmax; n++) {
+      doublevar c=tab_cos(i,nmax+n-1), s=tab_sin(i,nmax+n-1);
+      tab_cos(i,nmax+n)=c*c1-s*s1;
+      tab_sin(i,nmax+n)=s*c1+c*s1;
+      tab_cos(i,nmax-n)=tab_cos(i,nmax+n);
+      tab_sin(i,nmax-n)=-tab_sin(i,nmax+n);
+    }
+  }
+
+  for(int gpt=0; gpt < ngpoints; gpt++) {
+    int a=nmax+gindex(gpt,0), b=nmax+gindex(gpt,1), c=nmax+gindex(gpt,2);
+    doublevar cab=tab_cos(0,a)*tab_cos(1,b)-tab_sin(0,a)*tab_sin(1,b);
+    doublevar sab=tab_sin(0,a)*tab_cos(1,b)+tab_cos(0,a)*tab_sin(1,b);
+    cs(gpt)=cab*tab_cos(2,c)-sab*tab_sin(2,c);
+    sn(gpt)=sab*tab_cos(2,c)+cab*tab_sin(2,c);
+  }
+}
+
+//----------------------------------------------------------------------
+
+int Ewald_sum::showinfo(string & indent, ostream & os) {
+  os << indent << "Ewald sum" << endl;
+  os << indent << "  tolerance " << tolerance << endl;
+  os << indent << "  alpha " << alpha << endl;
+  os << indent << "  real space cutoff " << rcut << " ("
+     << nimages << " lattice translations)" << endl;
+  os << indent << "  reciprocal cutoff " << gcut << " ("
+     << ngpoints << " g points)" << endl;
+  os << indent << "  estimated error: real space " << real_error
+     << "  reciprocal " << recip_error << endl;
+  return 1;
+}
+
+//----------------------------------------------------------------------
@@ -0,0 +1,122 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef EWALD_SUM_H_INCLUDED
+#define EWALD_SUM_H_INCLUDED
+
+#include "Qmc_std.h"
+#include "Array.h"
+#include "Spline_fitter.h"
+
+/*!
+\brief
+The splitting and the lattice sums of the Ewald interaction in one cell.
+
+setup() chooses the Ewald parameter alpha, the real space cutoff and the
+reciprocal space cutoff so that the estimated error of each part
+(Kolafa and Perram, Mol. Sim. 9, 351 (1992)) is below the requested
+tolerance, and of those choices takes the one with the least work.  The
+real space part of a pair is then summed only over the lattice
+translations that can bring it within the cutoff, and the reciprocal
+part over the g points inside the cutoff sphere, one of each g,-g pair.
+*/
+class Ewald_sum {
+public:
+  Ewald_sum():alpha(0), rcut(0), gcut(0), ngpoints(0) {}
+
+  /*!
+    Choose the parameters and build the g point and lattice translation
+    lists.  latvec(i,d) is component d of lattice vector i, qsqrd the sum
+    of the squared charges, and gmax, if positive, caps the g points at
+    that many reciprocal lattice vectors in each direction.
+   */
+  void setup(const Array2 <doublevar> & latvec, int nelectrons, int nions,
+             doublevar qsqrd, doublevar tolerance, int gmax=-1);
+
+  /*!
+    Real space part erfc(alpha |r+L|)/|r+L| of two unit charges
+    separated by r, summed over the lattice translations L.  r must be
+    the difference of two positions in the cell, or anything shorter.
+    erfc(alpha r)/r is evaluated as 1/r less a spline of erf(alpha r)/r
+    in r^2, so each image costs a table lookup instead of an erfc.
+   */
+  doublevar realSum(const Array1 <doublevar> & r);
+
+  /*!
+    The real space interaction of a unit charge with its own images,
+    sum over L != 0 of erfc(alpha |L|)/|L|.
+   */
+  doublevar selfImages();
+
+  /*!
+    cos(g.r) and sin(g.r) for all the g points, built from the phases
+    along the three reciprocal lattice vectors, so that only three
+    sin/cos pairs are evaluated per position.
+   */
+  void phases(const Array1 <doublevar> & r, Array1 <doublevar> & cs,
+              Array1 <doublevar> & sn);
+
+  int showinfo(string & indent, ostream & os);
+
+  doublevar getAlpha() { return alpha; }
+  int nGpoints() { return ngpoints; }
+  /*!
+    The g points and their weights
+    \f$4\pi exp(-|g|^2/4 \alpha^2) \over V_{cell}|g|^2\f$
+   */
+  void getGpoints(Array2 <doublevar> & gpoint_, Array1 <doublevar> & gweight_) {
+    gpoint_=gpoint;
+    gweight_=gweight;
+  }
+
+private:
+  /*!
+    erfc(alpha r)/r for r2=r^2 < rcut^2
+   */
+  doublevar shortRange(doublevar r2) {
+    int i=short_range.getInterval(r2);
+    return 1.0/sqrt(r2)-short_range.getVal(r2,i);
+  }
+  void buildShortRange();
+
+  doublevar alpha; //!< the Ewald parameter
+  doublevar rcut;  //!< real space cutoff
+  doublevar gcut;  //!< reciprocal space cutoff
+  doublevar rcut2;
+  Spline_fitter short_range; //!< erf(alpha r)/r as a function of r^2, out to rcut
+  doublevar real_error, recip_error; //!< estimated errors in the energy
+  doublevar tolerance;
+  doublevar height; //!< smallest distance between lattice planes
+  doublevar volume;
+
+  int ngpoints;
+  Array2 <doublevar> gpoint;
+  Array1 <doublevar> gweight;
+  Array2 <int> gindex; //!< g points in units of the reciprocal lattice vectors
+  int gindex_max; //!< largest |component| of gindex
+  Array2 <doublevar> recipvec; //!< reciprocal lattice vectors, times 2 pi
+
+  Array2 <doublevar> images; //!< lattice translations, shortest first; 0 is the origin
+  Array1 <doublevar> image_length;
+  int nimages;
+};
+
+#endif //EWALD_SUM_H_INCLUDED
+//----------------------------------------------------------------------
@@ -232,6 +232,9 @@ void HEG_sample::init(System * sys) {
   elecDistStale.Resize(nelectrons);
   elecDistStale=1;
 
+  rho_pos.Resize(nelectrons, 3);
+  rho_nupdates=-1;
+
   tmplat.Resize(26,3);
   int counter=0;
   for(int aa=-1; aa <= 1; aa++) {
@@ -318,6 +321,22 @@ void HEG_sample::setElectronPos(const int e,
 }
 
 
+void HEG_sample::translationPhase(const int e, const Array1 <doublevar> & trans,
+                                  doublevar & sign, doublevar & phase) {
+  Array1 <doublevar> temp(3);
+  for(int d=0; d< 3; d++) 
+    temp(d)=elecpos(e,d)+trans(d);
+  Array1<int> nshift;
+  parent->enforcePbc(temp, nshift);
+  doublevar kdotr=0;
+  for(int d=0; d< 3; d++) 
+    kdotr+=parent->kpt(d)*nshift(d);
+  sign=update_overall_sign?cos(pi*kdotr):1.0;
+  phase=-pi*kdotr;
+}
+
+//----------------------------------------------------------------------
+
 void HEG_sample::translateElectron(const int e, const Array1 <doublevar> & trans) {
   Array1 <doublevar> temp(trans.GetDim(0));
   
@@ -395,3 +414,72 @@ void HEG_sample::rawInput(istream & is)
 }
 
 //-------------------------------------------------------------------------
+
+void HEG_sample::updateRho() {
+  int ngpoints=parent->ngpoints;
+  Array1 <int> moved;
+  int nmoved=findMoved(elecpos, rho_pos, moved);
+  if(nmoved==0 && rho_nupdates >= 0) return;
+
+  Array1 <doublevar> r(3), cs(ngpoints), sn(ngpoints);
+  //When most of the electrons moved, it's as cheap to start over, and 
+  //we also do that every so often so that rounding errors don't pile up.
+  if(rho_nupdates < 0 || 4*nmoved > nelectrons 
+     || rho_nupdates+nmoved > nelectrons) {
+    rho_cos.Resize(ngpoints);
+    rho_sin.Resize(ngpoints);
+    rho_cos=0;
+    rho_sin=0;
+    for(int e=0; e< nelectrons; e++) {
+      for(int d=0; d< 3; d++) r(d)=rho_pos(e,d)=elecpos(e,d);
+      parent->ewald.phases(r, cs, sn);
+      for(int g=0; g< ngpoints; g++) {
+        rho_cos(g)+=cs(g);
+        rho_sin(g)+=sn(g);
+      }
+    }
+    rho_nupdates=0;
+    return;
+  }
+
+  for(int e=0; e< nelectrons; e++) {
+    if(!moved(e)) continue;
+    for(int d=0; d< 3; d++) r(d)=rho_pos(e,d);
+    parent->ewald.phases(r, cs, sn);
+    for(int g=0; g< ngpoints; g++) {
+      rho_cos(g)-=cs(g);
+      rho_sin(g)-=sn(g);
+    }
+    for(int d=0; d< 3; d++) r(d)=rho_pos(e,d)=elecpos(e,d);
+    parent->ewald.phases(r, cs, sn);
+    for(int g=0; g< ngpoints; g++) {
+      rho_cos(g)+=cs(g);
+      rho_sin(g)+=sn(g);
+    }
+    rho_nupdates++;
+  }
+}
+
+//-------------------------------------------------------------------------
+
+int HEG_sample::saveState(Sample_state * & state) { 
+  if(state==NULL) state=new HEG_sample_state;
+  HEG_sample_state * store;
+  recast(state, store);
+  array_cp(store->rho_cos, rho_cos);
+  array_cp(store->rho_sin, rho_sin);
+  array_cp(store->rho_pos, rho_pos);
+  store->rho_nupdates=rho_nupdates;
+  return sizeof(doublevar)*(2*parent->ngpoints + 3*nelectrons);
+}
+
+void HEG_sample::restoreState(Sample_state * state) { 
+  HEG_sample_state * store;
+  recast(state, store);
+  array_cp(rho_cos, store->rho_cos);
+  array_cp(rho_sin, store->rho_sin);
+  array_cp(rho_pos, store->rho_pos);
+  rho_nupdates=store->rho_nupdates;
+}
+
+//-------------------------------------------------------------------------
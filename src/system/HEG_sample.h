@@ -29,6 +29,18 @@ class Wavefunction;
 
 class Sample_storage;
 
+/*!
+  The structure factor of one walker; see HEG_sample::saveState().
+*/
+class HEG_sample_state : public Sample_state
+{
+private:
+  friend class HEG_sample;
+  Array1 <doublevar> rho_cos, rho_sin;
+  Array2 <doublevar> rho_pos;
+  int rho_nupdates;
+};
+
 /*!
  
 */
@@ -74,6 +86,8 @@ public:
   */
   void setElectronPos(const int e,const Array1 <doublevar> & position);
   void translateElectron(const int e, const Array1 <doublevar> & trans);
+  void translationPhase(const int e, const Array1 <doublevar> & trans,
+                        doublevar & sign, doublevar & phase);
   
   void getElectronPos(const int e, Array1 <doublevar> & R)
   {
@@ -161,7 +175,18 @@ public:
    */
   doublevar overallSign() { return overall_sign; }
   doublevar overallPhase() { return overall_phase; }
+
+  /*!
+    Bring the structure factor rho(g) up to date with the electron 
+    positions.  Only the electrons that moved since the last call are
+    taken out at their old position and put back at the new one.
+   */
+  void updateRho();
+
+  int saveState(Sample_state * & state);
+  void restoreState(Sample_state * state);
 private:
+  friend class HEG_system;
 
   int nelectrons;
 
@@ -173,6 +198,10 @@ private:
   Array2 <doublevar> tmplat; // auxiliary array used in Lucas' updateEEDist()
   Array2 <doublevar> elecpos_lc;   // elecpos in lattice coordinates
 
+  Array1 <doublevar> rho_cos, rho_sin; //!< sum over electrons of cos(g.r) and sin(g.r)
+  Array2 <doublevar> rho_pos; //!< the electron positions that rho was built from
+  int rho_nupdates; //!< electron moves since rho was last rebuilt; -1 if never built
+
   doublevar overall_sign;
   doublevar overall_phase;
   // false for complex-valued wavefunctions, i.e., for non-integer k-points
@@ -99,8 +99,8 @@ int HEG_system::showinfo(ostream & os)
     os << "Interaction between unlike spins switched off." << endl << endl;
 
   if ( eeModel == 1 ) {
-    os << "total number of points in reciprocal ewald sum: "
-       << ngpoints << endl;
+    string indent="";
+    ewald.showinfo(indent, os);
     os << "Self e-e " << self_ee << endl;
     os << "xc correction " << xc_correction << endl;
   }
@@ -214,6 +214,8 @@ int HEG_system::read(vector <string> & words,
     if( haskeyword(interactiontxt, pos=0, "EWALD") ) {
       calcLocChoice=&HEG_system::calcLocEwald;
       eeModel=1;
+      if(!readvalue(interactiontxt, pos=0, ewald_tolerance, "TOLERANCE"))
+        ewald_tolerance=1e-10;
     }
     if( haskeyword(interactiontxt, pos=0, "TRUNCCOUL") ) {
       calcLocChoice=&HEG_system::calcLocTrunc;
@@ -325,84 +327,12 @@ int HEG_system::setupEwald(Array2 <doublevar> & crossProduct) {
   }
   debug_write(cout, "elsu ", smallestheight,"\n");
 
-  // We want only the simulation cell and its nearest neighbours
-  // to contribute into the real-space part of Ewald sum; alpha
-  // has to be chosen so that there are no contributions from distances
-  // larger than smallestheight, i.e., we want
-  //   erfc(alpha*smallestheight) \sim 0
-  // note: erfc(5)=1.5e-12, erfc(6)=2.2e-17, erfc(6.5)=3.8e-20
-  // ---
-  // 5.0 chosen in PERIODIC system seems to be large enough; change
-  // from 5.0 to 6.5 doubles the number of g-points 
-  alpha=5.0/smallestheight;
-
+  ewald.setup(latVec, totnelectrons, 0, totnelectrons, ewald_tolerance);
+  alpha=ewald.getAlpha();
+  ngpoints=ewald.nGpoints();
+  ewald.getGpoints(gpoint, gweight);
   debug_write(cout, "alpha ", alpha, "\n");
-
-  const int gmax=24;  //Could make this an option.
-  const double qweight_cut=1e-18;
-
-  ngpoints=(gmax+1)*(2*gmax+1)*(2*gmax+1)-gmax*(2*gmax+1)-gmax;
-  Array2 <doublevar> gpointtemp(ngpoints,3);
-  Array1 <doublevar> gweighttemp(ngpoints);
-  int currgpt=0;
-  int totgpt=0;
-  int smallgpt=0;
-
-  for(int ig=0; ig <= gmax; ig++) {
-    int jgmin=-gmax;
-    if(ig==0) jgmin=0;
-    for(int jg=jgmin; jg <= gmax; jg++) {
-      int kgmin=-gmax;
-      if(ig==0 && jg==0) kgmin=0;
-      for(int kg=kgmin; kg <= gmax; kg++) {
-        totgpt++;
-        for(int i=0; i< ndim; i++) {
-          gpointtemp(currgpt, i)=2*pi*(ig*recipLatVec(0,i)
-              +jg*recipLatVec(1,i)
-              +kg*recipLatVec(2,i));
-        }
-        doublevar gsqrd=0;  // |g|^2
-        for(int i=0; i< ndim; i++) {
-          gsqrd+=gpointtemp(currgpt,i)*gpointtemp(currgpt,i);
-        }
-
-        if(gsqrd > 1e-8) {  // throw away (0,0,0)
-          gweighttemp(currgpt)=4.0 * pi*exp(-gsqrd/(4*alpha*alpha))
-            /(cellVolume*gsqrd);
-
-
-          if(gweighttemp(currgpt) > qweight_cut) {
-            currgpt++;
-          }
-        } else {
-          smallgpt++;
-        }
-      }
-    }
-  }
-  if ( ngpoints != totgpt ) {
-    error("Wrong number of g-points while setting up Ewald summation.");
-  }
-  if ( smallgpt != 1 ) {
-    error("More than 1 g-point detected as 0.");
-  }
-  if ( currgpt+smallgpt >= totgpt ) {
-    error("Increase gmax in HEG_system.cpp, current value is too small.");
-  }
-  cout << "Reciprocal Ewald will use " << currgpt << " g-points out of "
-       << totgpt << " examined." << endl;
-
-  //Adjust to the correct number of kpoints..
-  ngpoints=currgpt;
-  gpoint.Resize(ngpoints, 3);
-  gweight.Resize(ngpoints);
-
-  for(int i=0; i< ngpoints; i++) {
-    for(int d=0; d< ndim; d++) {
-      gpoint(i,d)=gpointtemp(i,d);
-    }
-    gweight(i)=gweighttemp(i);
-  }
+  single_write(cout, "Reciprocal Ewald will use ", ngpoints, " g-points.\n");
 
   constEwald();
 
@@ -607,33 +537,10 @@ doublevar HEG_system::calcLocGauss(Sample_point * sample)
 
 void HEG_system::constEwald() {
 
-  // that extra term not included in PERIODIC system;
-  // contribution of the tripple loop seems to be essentially zero as
-  // it should be due to our choice of alpha
-  doublevar xi=0;
-  int nlatvec=1;
-  for (int i=-nlatvec; i <= nlatvec; i++) {
-    for (int j=-nlatvec; j <= nlatvec; j++) {
-      for (int k=-nlatvec; k <= nlatvec; k++) {
-	if ( i==0 && j==0 && k==0 ) break;
-	doublevar pos;
-	doublevar pos2=0;
-	for (int d=0; d < 3; d++) {
-	  pos=i*latVec(0,d)+j*latVec(1,d)+k*latVec(2,d);
-	  pos2+=pos*pos;
-	}
-	doublevar dxi=erfcm(alpha*sqrt(pos2))/sqrt(pos2);
-	xi+=dxi;
-      }
-    }
-  }
   // half of the self-interaction belongs to the simulation cell and
   // half to the given periodic image
-  xi/=2;  
+  doublevar xi=ewald.selfImages()/2;
   xi-=alpha/sqrt(pi);
-	
-  cout << "correction in constEwald" << endl;
-  cout << xi << " instead of " << -alpha/sqrt(pi) << endl;
 
   self_ee=-0.5*totnelectrons*totnelectrons*pi/(cellVolume*alpha*alpha)
     +totnelectrons*xi;
@@ -654,56 +561,29 @@ void HEG_system::constEwald() {
 //----------------------------------------------------------------------
 
 doublevar HEG_system::ewaldElectron(Sample_point * sample) {
+  HEG_sample * hsample;
+  recast(sample, hsample);
   sample->updateEEDist();
-
-  const int nlatvec=1;
-  Array1 <doublevar> r1(3), r2(3);
-  Array1 <doublevar> eidist(5);
+  hsample->updateRho();
 
   //-------------Electron-electron real-space part (pairs only,
   //   no self-interaction)         
 
+  Array1 <doublevar> r1(3);
   doublevar elecElec_real=0;
 
   for(int e1=0; e1< totnelectrons; e1++) {
     for(int e2 =e1+1; e2 < totnelectrons; e2++) {
-      sample->getEEDist(e1,e2, eidist);
-      for(int d=0; d< 3; d++) r1(d)=eidist(d+2);
-
-      //----over  lattice vectors
-      for(int kk=-nlatvec; kk <=nlatvec; kk++) {
-        for(int jj=-nlatvec; jj <=nlatvec; jj++) {
-          for(int ii=-nlatvec; ii <=nlatvec; ii++) {
-            for(int d=0; d< 3; d++) {
-              r2(d)=r1(d)+kk*latVec(0,d)+jj*latVec(1,d)+ii*latVec(2,d);
-            }
-            doublevar r=sqrt(r2(0)*r2(0)+r2(1)*r2(1)+r2(2)*r2(2));
-
-            elecElec_real+=erfcm(alpha*r)/r;
-          }
-        }
-      }
-      //----done lattice vectors
+      for(int d=0; d< 3; d++) r1(d)=hsample->pointdist(e1,e2,d+2);
+      elecElec_real+=ewald.realSum(r1);
     }
   }
 
   //---------electron reciprocal part (this DOES include the self-interaction)
 
-  doublevar rdotg;
-  Array2 <doublevar> elecpos(totnelectrons, 3);
-  sample->getAllElectronPos(elecpos);
   doublevar elecElec_recip=0;
   for(int gpt=0; gpt < ngpoints; gpt++) {
-    doublevar sum_sin=0, sum_cos=0;
-    for(int e=0; e< totnelectrons; e++) {
-      rdotg=gpoint(gpt, 0)*elecpos(e,0)
-            +gpoint(gpt, 1)*elecpos(e,1)
-            +gpoint(gpt, 2)*elecpos(e,2);
-
-      sum_sin+=sin(rdotg);
-      sum_cos+=cos(rdotg);
-
-    }
+    doublevar sum_cos=hsample->rho_cos(gpt), sum_sin=hsample->rho_sin(gpt);
     // NOTE: 1/2 from \sum_{e != e'} is cancelled with the fact that
     // we use only one g-point from g,-g pair
     elecElec_recip+=(sum_cos*sum_cos + sum_sin*sum_sin)*gweight(gpt);
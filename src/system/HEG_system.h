@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "System.h"
 #include "Particle_set.h"
 #include "Pbc_enforcer.h"
+#include "Ewald_sum.h"
 class HEG_sample;
 
 /*!
@@ -35,8 +36,8 @@ as a simplification of crystalline Periodic_system.
 Keyword: HEG
 
 There are two choices for Coulomb e-e interaction:
-\li Ewald \n
-       <tt>interaction { Ewald }</tt>
+\li Ewald, optionally with the accuracy of the sum (default 1e-10) \n
+       <tt>interaction { Ewald tolerance 1e-8 }</tt>
 \li truncated Coulomb a.k.a. MPC [Fraser et al., PRB 53, 1814 (1994)] \n
        <tt>interaction { truncCoul }</tt>
   
@@ -140,6 +141,8 @@ private:
   doublevar smallestheight;       //!< smallest distance that spans the cell
   doublevar cellVolume;           //!< Simulation cell volume
 
+  Ewald_sum ewald;                //!< splitting, cutoffs and lattice sums of the Ewald interaction
+  doublevar ewald_tolerance;      //!< requested accuracy of the Ewald sum
   Array2 <doublevar> gpoint;      //!< A list of non-zero g points in the Ewald sum
   Array1 <doublevar> gweight;
   //!< A list of the weights(\f$4\pi exp(|g|^2/4 \alpha^2) \over V_{cell}|g|^2\f$)
@@ -221,21 +224,5 @@ private:
 
 
 
-/*!
-  \brief
-  An approximation to erfc(complimentary error function).  
-
-  Supposedly has an absolute error of less than 1.5e-07.
- */
-#ifndef PERIODIC_SYSTEM_H_INCLUDED
-inline doublevar erfcm(doublevar x) {
-  const doublevar p=.3275911, a=.254829592, b=-.284496736, c=1.421413741;
-  const doublevar d=-1.453152027, e=1.061405429;
-
-  doublevar y=1./(1.+p*x);
-  return y*(a+y*(b+y*(c+y*(d+y*e))))*exp(-x*x);
-}
-#endif //PERIODIC_SYSTEM_H_INCLUDED
-
 #endif //HEG_SYSTEM_H_INCLUDED
 //----------------------------------------------------------------------
@@ -44,6 +44,8 @@ public:
     atomLabels=sys.atomLabels;
     bounding_box=sys.bounding_box;
     use_bounding_box=sys.use_bounding_box;
+    electric_field=sys.electric_field;
+    inirange=sys.inirange;
   }
 
   void notify(change_type, int);
@@ -146,6 +146,125 @@ void Periodic_sample::minDist(Array1 <doublevar> pos1 , Array1 <doublevar> pos2,
   //cout << "done" << endl;
 }
 
+//----------------------------------------------------------------------
+
+void Periodic_sample::updateEwald() {
+  Array1 <int> stale;
+  int nstale=findMoved(elecpos, ewald_pos, stale);
+  if(ewald_nupdates < 0) { 
+    stale=1;
+    nstale=nelectrons;
+  }
+  if(nstale==0) return;
+
+  updateEEDist();
+  updateEIDist();
+  int ngpoints=parent->ngpoints;
+  int nions=parent->ions.size();
+  Array1 <doublevar> r(3), cs(ngpoints), sn(ngpoints);
+
+  //When many electrons have moved, it's cheaper to recompute
+  //everything, since then each pair is visited once.
+  int rebuild=nstale > nelectrons/4;
+
+  for(int e=0; e< nelectrons; e++) {
+    if(!stale(e)) continue;
+    for(int d=0; d< 3; d++) r(d)=ewald_pos(e,d)=elecpos(e,d);
+    parent->ewald.phases(r, cs, sn);
+    for(int g=0; g< ngpoints; g++) {
+      if(!rebuild) {
+        rho_cos(g)+=cs(g)-ewald_cos(e,g);
+        rho_sin(g)+=sn(g)-ewald_sin(e,g);
+      }
+      ewald_cos(e,g)=cs(g);
+      ewald_sin(e,g)=sn(g);
+    }
+
+    ewald_ei(e)=0;
+    for(int ion=0; ion < nions; ion++) {
+      for(int d=0; d< 3; d++) r(d)=iondist(ion,e,d+2);
+      ewald_ei(e)-=parent->ions.charge(ion)*parent->ewald.realSum(r);
+    }
+
+    if(!rebuild) {
+      doublevar sum=0;
+      for(int j=0; j< nelectrons; j++) {
+        if(j==e) continue;
+        for(int d=0; d< 3; d++) 
+          r(d)=(j < e)?pointdist(j,e,d+2):pointdist(e,j,d+2);
+        doublevar f=parent->ewald.realSum(r);
+        ewald_ee_sum(j)+=f-ewald_ee(e,j);
+        ewald_ee(e,j)=ewald_ee(j,e)=f;
+        sum+=f;
+      }
+      ewald_ee_sum(e)=sum;
+      ewald_nupdates++;
+    }
+  }
+
+  if(rebuild) {
+    for(int e1=0; e1 < nelectrons; e1++) {
+      for(int e2=e1+1; e2 < nelectrons; e2++) {
+        for(int d=0; d< 3; d++) r(d)=pointdist(e1,e2,d+2);
+        ewald_ee(e1,e2)=ewald_ee(e2,e1)=parent->ewald.realSum(r);
+      }
+    }
+  }
+  if(rebuild || ewald_nupdates >= nelectrons) ewaldSums();
+}
+
+void Periodic_sample::ewaldSums() {
+  int ngpoints=parent->ngpoints;
+  rho_cos=0.0;
+  rho_sin=0.0;
+  for(int e=0; e< nelectrons; e++) {
+    for(int g=0; g< ngpoints; g++) {
+      rho_cos(g)+=ewald_cos(e,g);
+      rho_sin(g)+=ewald_sin(e,g);
+    }
+  }
+  for(int e=0; e< nelectrons; e++) {
+    doublevar sum=0;
+    for(int j=0; j< nelectrons; j++) sum+=ewald_ee(e,j);
+    ewald_ee_sum(e)=sum;
+  }
+  ewald_nupdates=0;
+}
+
+//----------------------------------------------------------------------
+
+int Periodic_sample::saveState(Sample_state * & state) { 
+  if(state==NULL) state=new Periodic_sample_state;
+  Periodic_sample_state * store;
+  recast(state, store);
+  array_cp(store->ewald_cos, ewald_cos);
+  array_cp(store->ewald_sin, ewald_sin);
+  array_cp(store->ewald_ee, ewald_ee);
+  array_cp(store->ewald_pos, ewald_pos);
+  array_cp(store->rho_cos, rho_cos);
+  array_cp(store->rho_sin, rho_sin);
+  array_cp(store->ewald_ee_sum, ewald_ee_sum);
+  array_cp(store->ewald_ei, ewald_ei);
+  store->ewald_nupdates=ewald_nupdates;
+  int ngpoints=parent->ngpoints;
+  return sizeof(doublevar)*(2*nelectrons*ngpoints + nelectrons*nelectrons
+                            + 5*nelectrons + 2*ngpoints);
+}
+
+void Periodic_sample::restoreState(Sample_state * state) { 
+  Periodic_sample_state * store;
+  recast(state, store);
+  array_cp(ewald_cos, store->ewald_cos);
+  array_cp(ewald_sin, store->ewald_sin);
+  array_cp(ewald_ee, store->ewald_ee);
+  array_cp(ewald_pos, store->ewald_pos);
+  array_cp(rho_cos, store->rho_cos);
+  array_cp(rho_sin, store->rho_sin);
+  array_cp(ewald_ee_sum, store->ewald_ee_sum);
+  array_cp(ewald_ei, store->ewald_ei);
+  ewald_nupdates=store->ewald_nupdates;
+}
+
 //----------------------------------------------------------------------
 void Periodic_sample::updateECDist() {
   //cout << "periodic_sample::updateECDist() " << endl;
@@ -198,6 +317,18 @@ void Periodic_sample::init(System * sys) {
   elecDistStale=1;
   ionDistStale=1;
 
+  int ngpoints=parent->ngpoints;
+  ewald_cos.Resize(nelectrons, ngpoints);
+  ewald_sin.Resize(nelectrons, ngpoints);
+  rho_cos.Resize(ngpoints);
+  rho_sin.Resize(ngpoints);
+  ewald_ee.Resize(nelectrons, nelectrons);
+  ewald_ee=0.0;
+  ewald_ee_sum.Resize(nelectrons);
+  ewald_ei.Resize(nelectrons);
+  ewald_pos.Resize(nelectrons, 3);
+  ewald_nupdates=-1;
+
   // update_overall_sign is false for complex-valued wavefunctions,
   // i.e., for non-integer k-points
   update_overall_sign=true;
@@ -385,6 +516,23 @@ void Periodic_sample::setElectronPos(const int e,
 }
 
 
+void Periodic_sample::translationPhase(const int e, 
+                                       const Array1 <doublevar> & trans,
+                                       doublevar & sign, doublevar & phase) {
+  Array1 <doublevar> temp(3);
+  for(int d=0; d< 3; d++) 
+    temp(d)=elecpos(e,d)+trans(d);
+  Array1<int> nshift;
+  parent->enforcePbc(temp, nshift);
+  doublevar kdotr=0;
+  for(int d=0; d< 3; d++) 
+    kdotr+=parent->kpt(d)*nshift(d);
+  sign=update_overall_sign?cos(pi*kdotr):1.0;
+  phase=-pi*kdotr;
+}
+
+//----------------------------------------------------------------------
+
 void Periodic_sample::translateElectron(const int e, const Array1 <doublevar> & trans) {
   Array1 <doublevar> temp(trans.GetDim(0));
   
@@ -465,6 +613,7 @@ void Periodic_sample::moveIon(const int ion, const Array1 <doublevar> & r) {
   ionDistStale=1;
   elecDistStale=1;
   cenDistStale=1;
+  ewald_nupdates=-1; //the electron-ion terms all change
 
   //cout << "notify " << endl;
   if(wfObserver)
@@ -29,6 +29,19 @@ class Wavefunction;
 
 class Sample_storage;
 
+/*!
+  The electron part of the Ewald sum of one walker; see 
+  Periodic_sample::saveState().
+*/
+class Periodic_sample_state : public Sample_state
+{
+private:
+  friend class Periodic_sample;
+  Array2 <doublevar> ewald_cos, ewald_sin, ewald_ee, ewald_pos;
+  Array1 <doublevar> rho_cos, rho_sin, ewald_ee_sum, ewald_ei;
+  int ewald_nupdates;
+};
+
 /*!
  
 */
@@ -76,6 +89,8 @@ public:
   void setElectronPosNoNotify(const int e, const Array1 <doublevar> & position);
 
   void translateElectron(const int e, const Array1 <doublevar> & trans);
+  void translationPhase(const int e, const Array1 <doublevar> & trans,
+                        doublevar & sign, doublevar & phase);
   
   void getElectronPos(const int e, Array1 <doublevar> & R)
   {
@@ -162,7 +177,23 @@ public:
    */
   doublevar overallSign() { return overall_sign; }
   doublevar overallPhase() { return overall_phase; }
+
+  /*!
+    Bring the ewald terms of the electrons that have moved up to date.
+    Periodic_system calls this before it uses them.
+   */
+  void updateEwald();
+
+  int saveState(Sample_state * & state);
+  void restoreState(Sample_state * state);
 private:
+  friend class Periodic_system;
+
+  /*!
+    Rebuild the structure factor and the pair sums from the
+    per-electron terms, so roundoff from the updates doesn't accumulate.
+   */
+  void ewaldSums();
 
 
   doublevar minimum_image(Array1 <doublevar> & r) ;
@@ -181,6 +212,16 @@ private:
   //the lower is currently wasted
   Array2 <doublevar> lattice_basis; //the basis we search over for interparticle distances
 
+  //The electron part of the ewald sum, kept for this walker so that
+  //moving one electron costs O(G+N) to update instead of O(NG+N^2).
+  Array2 <doublevar> ewald_cos, ewald_sin; //!< cos(g.r_e) and sin(g.r_e), (e,g)
+  Array1 <doublevar> rho_cos, rho_sin; //!< sums over electrons of ewald_cos and ewald_sin
+  Array2 <doublevar> ewald_ee; //!< real space ewald term of each pair of electrons
+  Array1 <doublevar> ewald_ee_sum; //!< sum of ewald_ee over the partners of each electron
+  Array1 <doublevar> ewald_ei; //!< real space electron-ion ewald term of each electron
+  Array2 <doublevar> ewald_pos; //!< the electron positions that the terms were computed at
+  int ewald_nupdates; //!< single-electron updates since ewaldSums(); -1 if never built
+
   doublevar overall_sign;
   doublevar overall_phase;
   // false for complex-valued wavefunctions, i.e., for non-integer k-points
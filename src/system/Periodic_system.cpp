@@ -64,8 +64,8 @@ int Periodic_system::showinfo(ostream & os)
     }
     os << endl;
   }
-  os << "total number of points in reciprocal ewald sum: "
-  << ngpoints << endl;
+  string indent="";
+  ewald.showinfo(indent, os);
 
   os << "Self e-i " << self_ei << endl;
   os << "Self e-e " << self_ee << endl;
@@ -181,6 +181,8 @@ int Periodic_system::read(vector <string> & words,
 
   int ewald_gmax=200;
   readvalue(words, pos=0, ewald_gmax,"EWALD_GMAX");
+  doublevar ewald_tolerance=1e-10;
+  readvalue(words, pos=0, ewald_tolerance, "EWALD_TOLERANCE");
 
   Array2 <doublevar> atompos(natoms, 3);
   for(int i=0; i< natoms; i++) {
@@ -346,89 +348,16 @@ int Periodic_system::read(vector <string> & words,
   }
   debug_write(cout, "elsu ", smallestheight,"\n");
 
-  alpha=5.0/smallestheight; //Heuristic?  Stolen from Lubos's code.
-
+  doublevar qsqrd=totnelectrons;
+  for(int at=0; at < natoms; at++) qsqrd+=ions.charge(at)*ions.charge(at);
+  ewald.setup(latVec, totnelectrons, natoms, qsqrd, ewald_tolerance, 
+              ewald_gmax);
+  alpha=ewald.getAlpha();
+  ngpoints=ewald.nGpoints();
+  ewald.getGpoints(gpoint, gweight);
   debug_write(cout, "alpha ", alpha, "\n");
-
-  ///--------------------------------------------
-  // Finding the g-points for the Ewald sum
-  //
- //  ngpoints=27*ewald_gmax*ewald_gmax*ewald_gmax ;
-  ngpoints=0;
-  for(int ig=0; ig <= ewald_gmax; ig++) {
-    int jgmin=-ewald_gmax;
-    if(ig==0) jgmin=0;
-    for(int jg=jgmin; jg <= ewald_gmax; jg++) {
-      int kgmin=-ewald_gmax;
-      if(ig==0 && jg==0) kgmin=0;
-      for(int kg=kgmin; kg <= ewald_gmax; kg++) {
-        doublevar gsqrd=0;
-        for(int i=0; i< ndim; i++) {
-          doublevar tmp=2*pi*(ig*recipLatVec(0,i)
-                                       +jg*recipLatVec(1,i)
-                                       +kg*recipLatVec(2,i));
-          gsqrd+=tmp*tmp;
-        }
-        if(4.0 * pi*exp(-gsqrd/(4*alpha*alpha))
-                               /(cellVolume*gsqrd) > 1e-10) ngpoints++;
-      }
-    }
-  }
-         
-  //Array2 <doublevar> gpointtemp(ngpoints,3);
-  //Array1 <doublevar> gweighttemp(ngpoints);
-  gpoint.Resize(ngpoints, 3);
-  gweight.Resize(ngpoints);
-  
-  int currgpt=0;
-
-  for(int ig=0; ig <= ewald_gmax; ig++) {
-    int jgmin=-ewald_gmax;
-    if(ig==0) jgmin=0;
-    for(int jg=jgmin; jg <= ewald_gmax; jg++) {
-      int kgmin=-ewald_gmax;
-      if(ig==0 && jg==0) kgmin=0;
-      for(int kg=kgmin; kg <= ewald_gmax; kg++) {
-        for(int i=0; i< ndim; i++) {
-          gpoint(currgpt, i)=2*pi*(ig*recipLatVec(0,i)
-                                       +jg*recipLatVec(1,i)
-                                       +kg*recipLatVec(2,i));
-        }
-        //cout << "there" << endl;
-        doublevar gsqrd=0; //|g|^2
-        for(int i=0; i< ndim; i++) {
-          gsqrd+=gpoint(currgpt,i)*gpoint(currgpt,i);
-        }
-
-        if(gsqrd > 1e-8) {
-          gweight(currgpt)=4.0 * pi*exp(-gsqrd/(4*alpha*alpha))
-                               /(cellVolume*gsqrd);
-          if(gweight(currgpt) > 1e-10) { //
-            currgpt++;
-          }
-        }
-      }
-    }
-  }
   single_write(cout,"Ewald sum using ",ngpoints," reciprocal points\n");
-  //Done finding the g-points.
-  //---------------------------------------
-
-  //Adjust to the correct number of kpoints..
-  /*
-  ngpoints=currgpt;
-  gpoint.Resize(ngpoints, 3);
-  gweight.Resize(ngpoints);
-
 
-
-  for(int i=0; i< ngpoints; i++) {
-    for(int d=0; d< ndim; d++) {
-      gpoint(i,d)=gpointtemp(i,d);
-    }
-    gweight(i)=gweighttemp(i);
-  }
-*/
   //Resize the stored ion variables
   ion_sin.Resize(ngpoints);
   ion_cos.Resize(ngpoints);
@@ -597,24 +526,29 @@ doublevar Periodic_system::calcLoc(Sample_point * sample)
 
 void Periodic_system::calcLocSeparated(Sample_point * sample, Array1 <doublevar> & totalv)
 {
-  //  cout << "Not implemented" << endl; 
-  //  doublevar ewalde=ewaldElectron(sample);
-  
-  //cout << "ion_ewald " << ion_ewald << " self_ii " << self_ii
-  //     << " self_ee " << self_ee << " self_ei " << self_ei << endl;
-  //cout << " ewalde " << ewalde << " xc_correction " << xc_correction << endl;
+  Periodic_sample * psample;
+  recast(sample, psample);
+  psample->updateEwald();
   //we do not want the xc_correction in the total energy in order to compare 
   //to all other qmc codes, it is still printed out so can be added by hand 
   for (int e=0; e<totnelectrons; e++) {
-    totalv(e) = self_e_single + ewalde_separated(e); 
+    doublevar elecIon_recip=0, elecElec_recip=0;
+    for(int gpt=0; gpt < ngpoints; gpt++) {
+      doublevar cs=psample->ewald_cos(e,gpt), sn=psample->ewald_sin(e,gpt);
+      elecIon_recip-=(ion_cos(gpt)*cs+ion_sin(gpt)*sn)*gweight(gpt);
+      elecElec_recip+=(psample->rho_cos(gpt)*cs+psample->rho_sin(gpt)*sn-0.5)
+                      *gweight(gpt);
+      //the -0.5 removes the self interaction of electron e
+    }
+    totalv(e) = self_e_single + psample->ewald_ee_sum(e) + psample->ewald_ei(e)
+                + 2.0*(elecIon_recip + elecElec_recip); 
   }
-    //  return ion_ewald+self_ii+self_ee+self_ei+ewalde; //+xc_correction;
 }
 
 //----------------------------------------------------------------------
 /*!
-\todo
-Add in the correction terms for summing over non-zero l
+The self term includes the interaction of each charge with its own
+images inside the real space cutoff.
  */
 
 void Periodic_system::constEwald() {
@@ -644,7 +578,8 @@ void Periodic_system::constEwald() {
     ionSum2+=ions.charge(ion)*ions.charge(ion);
   }
 
-  doublevar squareconst=-.5*(2*alpha/sqrt(pi)+pi/(cellVolume*alpha*alpha));
+  doublevar squareconst=-.5*(2*alpha/sqrt(pi)+pi/(cellVolume*alpha*alpha)
+                             -ewald.selfImages());
   doublevar ijconst=-pi/(cellVolume*alpha*alpha);
   self_ii=ionIonSum*ijconst+ionSum2*squareconst;
   self_ei=ionElecSum*ijconst; // I guess this term is the charge+ and charge- background interactions
@@ -680,9 +615,7 @@ doublevar Periodic_system::ewaldIon() {
 
 
   int nions=ions.size();
-  const int nlatvec=2;  //Number of lattice vectors to iterate over
-
-  Array1 <doublevar> r1(3), r2(3);
+  Array1 <doublevar> r1(3);
   doublevar IonIon=0;
   for(int i=0; i< nions; i++)
   {
@@ -691,23 +624,7 @@ doublevar Periodic_system::ewaldIon() {
       for(int d=0; d< 3; d++) {
         r1(d)=ions.r(d,i)-ions.r(d,j);
       }
-
-
-      //----over 2 lattice vectors
-      for(int kk=-nlatvec; kk <=nlatvec; kk++) {
-        for(int jj=-nlatvec; jj <=nlatvec; jj++) {
-          for(int ii=-nlatvec; ii <=nlatvec; ii++) {
-            for(int d=0; d< 3; d++) {
-              r2(d)=r1(d)+kk*latVec(0,d)+jj*latVec(1,d)+ii*latVec(2,d);
-            }
-            doublevar r=sqrt(r2(0)*r2(0)+r2(1)*r2(1)+r2(2)*r2(2));
-
-            IonIon+=ions.charge(i)*ions.charge(j)*erfcm(alpha*r)/r;
-//            cout << "r " << r << "  ionion " << IonIon << " i " << i << " j " << j << endl;
-          }
-        }
-      }
-      //----done lattice vectors
+      IonIon+=ions.charge(i)*ions.charge(j)*ewald.realSum(r1);
     }
   }
 
@@ -752,15 +669,15 @@ doublevar Periodic_system::ewaldIon() {
 
 
 void Periodic_system::calcLocWithTestPos(Sample_point * sample, Array1 <doublevar> &tpos, Array1<doublevar> & Vtest) {
-  sample->updateEEDist();
-  sample->updateEIDist();
+  Periodic_sample * psample;
+  recast(sample, psample);
+  psample->updateEwald();
   Array1 <int> nshift; 
   if(enforcePbc(tpos, nshift))  { 
     cout <<"Warning, tpos is not in the cell" << endl; 
   }
   int nions=ions.size();
-  int nlatvec=1;
-  Array1 <doublevar> r1(3), r2(3), eidist(5), eedist(5);
+  Array1 <doublevar> r1(3);
   Vtest.Resize(totnelectrons+1);
   for (int e=0; e<totnelectrons; e++) {
     Vtest(e) = ijbg; 
@@ -768,210 +685,73 @@ void Periodic_system::calcLocWithTestPos(Sample_point * sample, Array1 <doubleva
   Vtest(totnelectrons) = self_e_single_test; 
   
   Array1 <doublevar> rion(3); 
-  Array1 <doublevar> oldpos(3); 
-  //  sample->getElectronPos(0, oldpos);
-  //sample->setElectronPosNoNotify(0, tpos);
-  //sample->updateEIDist(); 
   for(int ion=0; ion < nions; ion++) {
     sample->getIonPos(ion, rion); 
-    //sample->getEIDist(0, ion, eidist); 
     sample->minDist(tpos, rion, r1); //the minimum distance between ion and the test electron
-    //----over  lattice vectors
-    //for (int d=0; d<3; d++) {
-    //  r1(d) = eidist(d+2); 
-    //}
-    for(int kk=-nlatvec; kk <=nlatvec; kk++) {
-      for(int jj=-nlatvec; jj <=nlatvec; jj++) {
-	for(int ii=-nlatvec; ii <=nlatvec; ii++) {
-	  for(int d=0; d< 3; d++) {
-	    r2(d)=r1(d)+kk*latVec(0,d)+jj*latVec(1,d)+ii*latVec(2,d);
-	  }
-	  doublevar r=sqrt(r2(0)*r2(0)+r2(1)*r2(1)+r2(2)*r2(2));
-	  Vtest(totnelectrons) -= ions.charge(ion)*erfcm(alpha*r)/r;
-	  //            elecIon_real-=ions.charge(ion)*erfcm(alpha*r)/r;
-	}
-      }
-    }
-      //----done lattice vectors
+    Vtest(totnelectrons) -= ions.charge(ion)*ewald.realSum(r1);
   }
 
-  //cout << "electron-electron " << endl;
   //-------------Electron-electron real part
-  //sample->updateEEDist(); 
-  
-  Array2 <doublevar> elecpos(totnelectrons, 3);
-  sample->getAllElectronPos(elecpos);
   for(int e =0; e < totnelectrons; e++) {
-    //sample->getEEDist(0, e, eedist); 
-    //for (int d=0; d<3; d++) r1(d)=eedist(d+2); 
-    for (int d=0; d<3; d++) rion(d) = elecpos(e, d); 
+    sample->getElectronPos(e, rion); 
     sample->minDist(tpos, rion, r1); 
-    //----over  lattice vectors
-    for(int kk=-nlatvec; kk <=nlatvec; kk++) {
-      for(int jj=-nlatvec; jj <=nlatvec; jj++) {
-	for(int ii=-nlatvec; ii <=nlatvec; ii++) {
-	  for(int d=0; d< 3; d++) {
-	    r2(d)=r1(d)+kk*latVec(0,d)+jj*latVec(1,d)+ii*latVec(2,d);
-	  }
-	  doublevar r=sqrt(r2(0)*r2(0)+r2(1)*r2(1)+r2(2)*r2(2));
-	  Vtest(e) += erfcm(alpha*r)/r;
-	}
-      }
-    }
-    //----done lattice vectors
+    Vtest(e) += ewald.realSum(r1);
   }
 
-  //cout << "electron recip " << endl;
-  
   //---------electron reciprocal part
-  
-  
-  doublevar rdotg;
-
+  //The electron phases are kept by the sample, so only the test
+  //position needs new ones.
+  Array1 <doublevar> test_cos(ngpoints), test_sin(ngpoints);
+  ewald.phases(tpos, test_cos, test_sin);
   for(int gpt=0; gpt < ngpoints; gpt++) {
-    rdotg = gpoint(gpt, 0)*tpos(0)
-            +gpoint(gpt, 1)*tpos(1)
-            +gpoint(gpt, 2)*tpos(2);
-    doublevar test_sin = sin(rdotg);
-    doublevar test_cos = cos(rdotg);
-    Vtest(totnelectrons) += 2.0*(-ion_cos(gpt)*test_cos - ion_sin(gpt)*test_sin + 0.5)*gweight(gpt);
-    for(int e=0; e< totnelectrons; e++) {
-      rdotg=gpoint(gpt, 0)*elecpos(e,0)
-            +gpoint(gpt, 1)*elecpos(e,1)
-            +gpoint(gpt, 2)*elecpos(e,2);
-      Vtest(e) += 2.0*(test_cos*cos(rdotg) + test_sin*sin(rdotg))*gweight(gpt);
+    Vtest(totnelectrons) += 2.0*(-ion_cos(gpt)*test_cos(gpt) 
+                                 - ion_sin(gpt)*test_sin(gpt) + 0.5)*gweight(gpt);
+  }
+  for(int e=0; e< totnelectrons; e++) {
+    doublevar recip=0;
+    for(int gpt=0; gpt < ngpoints; gpt++) {
+      recip += (test_cos(gpt)*psample->ewald_cos(e,gpt) 
+                + test_sin(gpt)*psample->ewald_sin(e,gpt))*gweight(gpt);
     }
+    Vtest(e) += 2.0*recip;
   }
 }
 
+//----------------------------------------------------------------------
 
+/*!
+  The per-electron terms are kept up to date by Periodic_sample::updateEwald(),
+  so this only sums them and combines the electron structure factor 
+  with the ionic one.
+ */
 doublevar Periodic_system::ewaldElectron(Sample_point * sample) {
-  //cout << sample << endl;
-  sample->updateEEDist();
-  //cout << "updateEIDIST" << endl;
-  sample->updateEIDist();
-  //cout << "done updatedist" << endl;
+  Periodic_sample * psample;
+  recast(sample, psample);
+  psample->updateEwald();
 
-  Array1 <doublevar> eidist(5);
-  int nions=ions.size();
-  int nlatvec=1;
-  Array1 <doublevar> r1(3), r2(3);
-
-  //cout << "electron-ion " << endl;
-  //-------------Electron-ion real part
-  doublevar elecIon_real=0;
-  Array1<doublevar> elecIon_real_separated(totnelectrons); 
-  elecIon_real_separated = 0.0; 
+  //-------------real space parts
+  doublevar elecIon_real=0, elecElec_real=0;
   for(int e=0; e< totnelectrons; e++) {
-    for(int ion=0; ion < nions; ion++) {
-
-      sample->getEIDist(e,ion, eidist);
-      for(int d=0; d< 3; d++) r1(d)=eidist(d+2);
-
-      //----over  lattice vectors
-      for(int kk=-nlatvec; kk <=nlatvec; kk++) {
-        for(int jj=-nlatvec; jj <=nlatvec; jj++) {
-          for(int ii=-nlatvec; ii <=nlatvec; ii++) {
-            for(int d=0; d< 3; d++) {
-              r2(d)=r1(d)+kk*latVec(0,d)+jj*latVec(1,d)+ii*latVec(2,d);
-            }
-            doublevar r=sqrt(r2(0)*r2(0)+r2(1)*r2(1)+r2(2)*r2(2));
-	    elecIon_real_separated(e) -= ions.charge(ion)*erfcm(alpha*r)/r;
-            elecIon_real-=ions.charge(ion)*erfcm(alpha*r)/r;
-          }
-        }
-      }
-      //----done lattice vectors
-    }
-  }
-  //cout << "electron-electron " << endl;
-  //-------------Electron-electron real part
-
-  doublevar elecElec_real=0;
-  Array1 <doublevar> elecElec_real_separated(totnelectrons); 
-  elecElec_real_separated = 0.0; 
-  for(int e1=0; e1< totnelectrons; e1++) {
-    for(int e2 =e1+1; e2 < totnelectrons; e2++) {
-      sample->getEEDist(e1,e2, eidist);
-      for(int d=0; d< 3; d++) r1(d)=eidist(d+2);
-
-      //----over  lattice vectors
-      for(int kk=-nlatvec; kk <=nlatvec; kk++) {
-        for(int jj=-nlatvec; jj <=nlatvec; jj++) {
-          for(int ii=-nlatvec; ii <=nlatvec; ii++) {
-            for(int d=0; d< 3; d++) {
-              r2(d)=r1(d)+kk*latVec(0,d)+jj*latVec(1,d)+ii*latVec(2,d);
-            }
-            doublevar r=sqrt(r2(0)*r2(0)+r2(1)*r2(1)+r2(2)*r2(2));
-
-            elecElec_real+=erfcm(alpha*r)/r;
-	    elecElec_real_separated(e1) += erfcm(alpha*r)/r;
-	    elecElec_real_separated(e2) += erfcm(alpha*r)/r;
-          }
-        }
-      }
-      //----done lattice vectors
-    }
+    elecIon_real+=psample->ewald_ei(e);
+    elecElec_real+=psample->ewald_ee_sum(e);
   }
-
-  //cout << "electron recip " << endl;
+  elecElec_real*=.5; //each pair was counted twice
 
   //---------electron reciprocal part
-
-
-  doublevar rdotg;
-  Array2 <doublevar> elecpos(totnelectrons, 3);
-  sample->getAllElectronPos(elecpos);
   doublevar elecIon_recip=0, elecElec_recip=0;
-  Array1 <doublevar> elecIon_recip_separated(totnelectrons), 
-    elecElec_recip_separated(totnelectrons);
-  elecIon_recip_separated = 0.0; 
-  elecElec_recip_separated = 0.0; 
   for(int gpt=0; gpt < ngpoints; gpt++) {
-    doublevar sum_sin=0, sum_cos=0;
-    Array1<doublevar> sn(totnelectrons); 
-    Array1<doublevar> cs(totnelectrons); 
-    
-    for(int e=0; e< totnelectrons; e++) {
-      rdotg=gpoint(gpt, 0)*elecpos(e,0)
-            +gpoint(gpt, 1)*elecpos(e,1)
-            +gpoint(gpt, 2)*elecpos(e,2);
-      sn(e) = sin(rdotg); 
-      cs(e) = cos(rdotg);
-      sum_sin += sn(e); 
-      sum_cos += cs(e); 
-    }
+    doublevar sum_cos=psample->rho_cos(gpt), sum_sin=psample->rho_sin(gpt);
     elecIon_recip-=(ion_cos(gpt)*sum_cos + ion_sin(gpt)*sum_sin)*gweight(gpt);
     elecElec_recip+=(sum_cos*sum_cos + sum_sin*sum_sin)*gweight(gpt)/2;
-    for (int e=0; e<totnelectrons; e++) {
-      elecIon_recip_separated(e) -= (ion_cos(gpt)*cs(e) 
-				     + ion_sin(gpt)*sn(e))*gweight(gpt);
-      elecElec_recip_separated(e) += (sum_cos*cs(e) + sum_sin*sn(e)-0.5)*gweight(gpt);
-      // this term is essentially the contribution from 
-    }
   }
 
   elecIon_recip*=2;
   elecElec_recip*=2;
-  //cout << "done " << endl;
-
   //cout << "elecElec_real " << elecElec_real << endl;
   //cout << "elecIon_real " << elecIon_real << endl;
   //cout << "elecElec_recip " << elecElec_recip << endl;
   //cout << "elecIon_recip " << elecIon_recip << endl;
-  ewalde_separated.Resize(totnelectrons); 
-  doublevar cc; 
-  for (int e=0; e<totnelectrons; e++) {
-    ewalde_separated(e) = elecElec_real_separated(e) + elecIon_real_separated(e)
-         + 2.0*(elecIon_recip_separated(e) + elecElec_recip_separated(e)); 
-    //
-    //ewalde_separated(e) = elecElec_real_separated(e) 
-    //  + 2.0*(elecElec_recip_separated(e)); 
-        //noted that the elecElec_recip_separated term already removed the self interaction term; 
-  }
   return elecElec_real + elecIon_real + elecElec_recip+elecIon_recip;
 }
 
-//------------------------------------------------------------------------
-
-
+//----------------------------------------------------------------------
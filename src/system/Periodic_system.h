@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "Pseudopotential.h"
 #include "Particle_set.h"
 #include "Pbc_enforcer.h"
+#include "Ewald_sum.h"
 class Periodic_sample;
 
 /*!
@@ -45,6 +46,9 @@ V=.5 \sum_{l}\sum_{i \ne j} q_i q_j \frac{erfc(\alpha |{\bf r_{ij}+l}|)}{r_{ij}}
 
 \f]
 
+\f$\alpha\f$ and the cutoffs of both sums are chosen by Ewald_sum to 
+meet EWALD_TOLERANCE at the least cost.
+
 \todo
 Stop using Particle_set for the ion positions.  Use Pbc_enforcer instead of 
 having the member function.
@@ -169,6 +173,7 @@ private:
   Array2 <doublevar> normVec;  //!< normal vectors to the sides, pointing out
   Array2 <doublevar> corners; //!< the position of the corner by moving one lattice vector
 
+  Ewald_sum ewald; //!< splitting, cutoffs and lattice sums of the ewald interaction
   Array2 <doublevar> gpoint; //!< A list of non-zero g points in the ewald sum
   Array1 <doublevar> gweight;
   //!< A list of the weights(\f$4\pi exp(|g|^2/4 \alpha^2) \over V_{cell}|g|^2\f$)
@@ -188,7 +193,6 @@ private:
   doublevar self_ee; //!< self electron-electron energy
   doublevar xc_correction; //!<exchange-correlation correction
   //  Array1 <doublevar> self_ee_separated; 
-  Array1 <doublevar> ewalde_separated; 
   doublevar self_e_single; 
   doublevar self_e_single_test; 
   doublevar ijbg; 
@@ -206,25 +210,10 @@ private:
     electron-ion interaction and electron-electron interaction
    */
   doublevar ewaldElectron(Sample_point * sample);
+
   doublevar minDistance(Array1 <doublevar> pos1, Array1 <doublevar> pos2, Array1 <doublevar> &rmin ); 
   Array1 <doublevar> ion_polarization;
 };
 
-
-
-/*!
-  \brief
-  An approximation to erfc(complimentary error function).  
-
-  Supposedly has an absolute error of less than 1.5e-07.
- */
-inline doublevar erfcm(doublevar x) {
-  const doublevar p=.3275911, a=.254829592, b=-.284496736, c=1.421413741;
-  const doublevar d=-1.453152027, e=1.061405429;
-
-  doublevar y=1./(1.+p*x);
-  return y*(a+y*(b+y*(c+y*(d+y*e))))*exp(-x*x);
-}
-
 #endif //PERIODIC_SYSTEM_H_INCLUDED
 //----------------------------------------------------------------------
@@ -77,11 +77,30 @@ doublevar legendre_der(doublevar x, int n) {
 
 
 Pseudopotential::~Pseudopotential()  {
+  if(!owns_radial_basis) return;
   for(int i=0; i< radial_basis.GetDim(0); i++)
     for(int j=0; j < radial_basis.GetDim(1); j++)  
       if(radial_basis(i,j)) delete radial_basis(i,j);
 }
 
+//----------------------------------------------------------------------
+
+void Pseudopotential::makeCopy(Pseudopotential *& ptr) { 
+  ptr=new Pseudopotential;
+  ptr->deterministic=deterministic;
+  ptr->numL=numL;
+  ptr->nelectrons=nelectrons;
+  ptr->aip=aip;
+  ptr->integralpt=integralpt;
+  ptr->integralpt_orig=integralpt_orig;
+  ptr->integralweight=integralweight;
+  ptr->cutoff=cutoff;
+  ptr->atomnames=atomnames;
+  ptr->addzeff=addzeff;
+  ptr->radial_basis=radial_basis;
+  ptr->owns_radial_basis=0;
+}
+
 /*
 
 int Pseudopotential::initializeStatic(Wavefunction_data *wfdata,
@@ -631,6 +650,12 @@ void Pseudopotential::calcNonlocWithAllvariables(Wavefunction_data * wfdata,
     base_deriv.need_hessian=0;
     wf->getParmDeriv(wfdata, sample, base_deriv);
   }
+  //Without parameter derivatives nothing needs the moved sample, so 
+  //the wave function can give the ratios at all the quadrature points 
+  //of an atom at once.
+  int batch=!parm_derivatives && wfdata->supports(test_ratios);
+  Array1 <doublevar> trans_sign(maxaip), trans_phase(maxaip);
+  Array1 <Wf_return> ratio;
   int accept_counter=0;
   //deriv.Resize(natoms, 3);
   //deriv=0;
@@ -687,7 +712,52 @@ void Pseudopotential::calcNonlocWithAllvariables(Wavefunction_data * wfdata,
         }
       
 
-        if(accept)  {
+        if(accept && batch) { 
+          //the same translations as in the loop below
+          Array2 <doublevar> testpos(aip(at),3);
+          for(int i=0; i< aip(at); i++) { 
+            rDotR(i)=0;
+            for(int d=0; d < 3; d++) { 
+              newpos(d)=integralpt(at,i,d)*olddist(0)-olddist(d+2);
+              testpos(i,d)=oldpos(d)+newpos(d);
+              rDotR(i)+=integralpt(at,i,d)*olddist(d+2);
+            }
+            rDotR(i)/=olddist(0);
+            sample->translationPhase(e, newpos, trans_sign(i), trans_phase(i));
+          }
+          wfStore.saveUpdate(sample, e);
+          wf->testRatios(wfdata, sample, e, testpos, ratio);
+          wfStore.restoreUpdate(sample, e);
+
+          for(int i=0; i< aip(at); i++) { 
+            for(int w=0; w< nwf; w++) {
+              integralpts(w,i)=exp(ratio(i).amp(w,0))*integralweight(at, i);
+              if ( ratio(i).is_complex==1 ) 
+                integralpts(w,i)*=cos(ratio(i).phase(w,0)+trans_phase(i));
+              else 
+                integralpts(w,i)*=ratio(i).sign(w)*trans_sign(i);
+            }
+            for(int w=0; w< nwf; w++)  {
+              doublevar tempsum=0;
+              for(int l=0; l< numL(at)-1; l++) {
+                tempsum+=(2*l+1)*v_l(l)*legendre(rDotR(i), l);
+              }
+              doublevar vxx=tempsum*integralpts(w,i);
+              if(do_tmoves==Tmoves::no_tmove || w!=0 || (do_tmoves==Tmoves::negative_tmove && vxx >= 0.0) ) { 
+                nonlocal(w)+=vxx;
+              }
+              else { 
+                Tmove nwtmove; nwtmove.pos.Resize(3);
+                for(int d=0; d< 3; d++) 
+                  nwtmove.pos(d)=testpos(i,d)-oldpos(d);
+                nwtmove.e=e;
+                nwtmove.vxx=vxx;
+                tmoves.push_back(nwtmove);
+              }
+            }
+          }
+        }
+        else if(accept)  {
           wfStore.saveUpdate(sample, wf, e);
           Wf_return  oldWfVal(nwf,2);
           wf->getVal(wfdata, e,oldWfVal);
@@ -73,7 +73,7 @@ class Pseudopotential
 {
 public:
   Pseudopotential():maxaip(85)
-  {deterministic=0;}
+  {deterministic=0; owns_radial_basis=1;}
   
 
 
@@ -229,6 +229,16 @@ public:
 		    Array1 <doublevar> & r, Array1 <doublevar> & v_l) {
     getRadial(at, spin, sample, r, v_l);//This is completely the same with getRadial. we redefine this so as not to mix with the original private one.
   }
+  /*!
+    \brief
+    Make a copy for use by another thread.
+
+    The quadrature and the wave function storage are private to the copy,
+    so it can be randomized and evaluated independently.  The radial 
+    functions are shared with this object, which must outlive the copy.
+   */
+  void makeCopy(Pseudopotential *& ptr);
+
   ~Pseudopotential();
 
  private:
@@ -252,6 +262,7 @@ public:
   Storage_container wfStore;
   
   Array2 <Basis_function *> radial_basis;
+  int owns_radial_basis; //!< zero for copies made by makeCopy()
   
 };
 
@@ -84,35 +84,43 @@ void Config_save_point::restorePos(Sample_point * sample) {
     sample->setElectronPos(i,electronpos(i));
 }
 
-void Config_save_point::mpiReceive(int node) {
-#ifdef USE_MPI
-  MPI_Status status;
-  int nelectrons;
-  MPI_Recv(&nelectrons,1, MPI_INT, node, 0, MPI_Comm_grp,
-           &status);
-  electronpos.Resize(nelectrons);
+void Config_save_point::pack(Pack_buffer & buf) const {
+  int nelectrons=electronpos.GetDim(0);
   Array2 <doublevar> epos(nelectrons,3);
-  MPI_Recv(epos.v,3*nelectrons,MPI_DOUBLE,node,0,MPI_Comm_grp,&status);
+  for(int e=0; e< nelectrons; e++) {
+    for(int d=0; d< 3; d++) epos(e,d)=electronpos(e)(d);
+  }
+  buf.pack(epos);
+}
+
+//----------------------------------------------------------------------
 
+void Config_save_point::unpack(Pack_buffer & buf) {
+  Array2 <doublevar> epos;
+  buf.unpack(epos);
+  int nelectrons=epos.GetDim(0);
+  electronpos.Resize(nelectrons);
   for(int e=0; e< nelectrons; e++) {
     electronpos(e).Resize(3);
     for(int d=0; d < 3; d++) electronpos(e)(d)=epos(e,d);
-   // MPI_Recv(electronpos(e).v, 3, MPI_DOUBLE,
-   //     node, 0, MPI_Comm_grp, &status);
   }
+}
+
+//----------------------------------------------------------------------
+
+void Config_save_point::mpiReceive(int node) {
+#ifdef USE_MPI
+  Pack_buffer buf;
+  buf.mpiReceive(node);
+  unpack(buf);
 #endif
 }
 
 void Config_save_point::mpiSend(int node) {
 #ifdef USE_MPI
-  int nelectrons=electronpos.GetDim(0);
-  MPI_Send(&nelectrons,1, MPI_INT, node, 0, MPI_Comm_grp);
-  Array2 <doublevar> epos(nelectrons,3);
-  for(int e=0; e< nelectrons; e++) {
-    for(int d=0; d< 3; d++) epos(e,d)=electronpos(e)(d);
-  }
-  MPI_Send(epos.v, 3*nelectrons, MPI_DOUBLE,
-        node, 0, MPI_Comm_grp);
+  Pack_buffer buf;
+  pack(buf);
+  buf.mpiSend(node);
 #endif
 }
 
@@ -148,14 +156,12 @@ void Config_save_point::write(ostream & os) {
 }
 #include "qmc_io.h"
 //----------------------------------------------------------------------
-int Config_save_point::writeBinary(FILE * f,doublevar weight) { 
-  //for(int e=0; e< electronpos.GetDim(0); e++) { 
-  //  fwrite(electronpos(e).v, sizeof(doublevar),3, f);
-  //}
-
+//positions followed by the weight
+static void binary_array(Array1 <Array1 <doublevar> > & electronpos, doublevar weight,
+                  Array1 <doublevar> & a) { 
   int ndim=electronpos(0).GetDim(0);
   int ne=electronpos.GetDim(0);
-  Array1<doublevar> a(ne*ndim+1);
+  a.Resize(ne*ndim+1);
   int count=0;
   for(int e=0; e< ne; e++) { 
     for(int d=0; d< ndim; d++) {
@@ -163,10 +169,27 @@ int Config_save_point::writeBinary(FILE * f,doublevar weight) {
     }
   }
   a(count)=weight;
+}
+
+int Config_save_point::writeBinary(FILE * f,doublevar weight) { 
+  //for(int e=0; e< electronpos.GetDim(0); e++) { 
+  //  fwrite(electronpos(e).v, sizeof(doublevar),3, f);
+  //}
+
+  Array1<doublevar> a;
+  binary_array(electronpos,weight,a);
   binary_write_checksum(a,f);
   
   return 1;
 }
+
+//----------------------------------------------------------------------
+
+void Config_save_point::packBinary(vector <doublevar> & rec, doublevar weight) { 
+  Array1<doublevar> a;
+  binary_array(electronpos,weight,a);
+  binary_pack_checksum(a,rec);
+}
 //----------------------------------------------------------------------
 int Config_save_point::readBinary(FILE * f,int nelec, int ndim, doublevar & weight) { 
   Array1 <doublevar> a;
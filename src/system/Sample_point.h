@@ -23,10 +23,22 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define SAMPLE_POINT_H_INCLUDED
 
 #include "Qmc_std.h"
+#include "Pack_buffer.h"
 class Wavefunction;
 class Sample_storage;
 class System;
 
+/*!
+  What a Sample_point keeps about a walker besides the positions; see
+  Sample_point::saveState().
+ */
+class Sample_state
+{
+public:
+  virtual ~Sample_state()
+  {}
+};
+
 
 /*!
 \brief
@@ -107,6 +119,18 @@ public:
     setElectronPos(e,pos);
   }
    
+  /*!
+    \brief
+    The factor that translateElectron(e,trans) would multiply 
+    overallSign() by, and the amount it would add to overallPhase(),
+    without moving the electron.
+   */
+  virtual void translationPhase(const int e, const Array1 <doublevar> & trans,
+                                doublevar & sign, doublevar & phase) {
+    sign=1.0;
+    phase=0.0;
+  }
+
   /*!
   return any prefactor due to k-point sampling or some such thing
    */
@@ -242,8 +266,50 @@ public:
   virtual void saveUpdate(int e, Sample_storage *)=0;
   virtual void restoreUpdate(int e, Sample_storage *)=0;
 
+  /*!
+    \brief
+    Save the quantities that are built up from the positions of the 
+    current walker, such as the electron part of the Ewald sum, so that
+    they can be put back with restoreState() when we come back to it 
+    instead of being rebuilt.
+
+    state is allocated if it is NULL.  Returns the approximate number of
+    bytes stored, or zero if there is nothing to keep.
+   */
+  virtual int saveState(Sample_state * & state) 
+  { return 0; }
+
+  /*!
+    \brief
+    Restore a state saved by saveState().  Whatever has moved since then
+    is brought up to date the next time it's needed.
+   */
+  virtual void restoreState(Sample_state * state) 
+  { }
+
 protected:
   Wavefunction * wfObserver;
+
+  /*!
+    Mark in moved the electrons whose position in pos differs from the
+    one in ref, which some quantity was last computed from, and return 
+    how many there are.  Periodic_sample and HEG_sample find what is out 
+    of date in their Ewald sums this way, so it doesn't matter how the 
+    electrons were moved or put back.
+   */
+  static int findMoved(const Array2 <doublevar> & pos, 
+                       const Array2 <doublevar> & ref, Array1 <int> & moved) {
+    int n=pos.GetDim(0);
+    int nmoved=0;
+    moved.Resize(n);
+    for(int e=0; e< n; e++) { 
+      moved(e)=0;
+      for(int d=0; d< pos.GetDim(1); d++) 
+        if(pos(e,d)!=ref(e,d)) moved(e)=1;
+      nmoved+=moved(e);
+    }
+    return nmoved;
+  }
 };
 
 
@@ -283,6 +349,11 @@ class Config_save_point {
   void restorePos(Sample_point * sample);
   void mpiSend(int node);
   void mpiReceive(int node);
+  void pack(Pack_buffer & buf) const;
+  void unpack(Pack_buffer & buf);
+  //! What goes into a binary configuration file; see write_binary_configurations()
+  void packCheckpoint(Pack_buffer & buf) const { pack(buf); }
+  void unpackCheckpoint(Pack_buffer & buf) { unpack(buf); }
   void getPos(int e, Array1 <doublevar> & r) { 
     r=electronpos(e);
   }
@@ -293,6 +364,8 @@ class Config_save_point {
   //write fairly efficiently.
   int writeBinary(FILE * f, doublevar weight=1.0);
   int readBinary(FILE * f,int nelec, int ndim,doublevar & weight);
+  //! Append what writeBinary() would write to rec
+  void packBinary(vector <doublevar> & rec, doublevar weight=1.0);
 
  private:
   Array1 <Array1 <doublevar> > electronpos;
@@ -507,7 +507,13 @@ void BCS_wf::calcLap(Sample_point * sample)
   jast.updateLap(&parent->jastdata,sample);
   jast.get_twobody(twobody);
   jast.get_onebody_save(onebody);
-  
+  fillMatrix(onebody);
+}
+
+//------------------------------------------------------------------------
+
+//! The determinants, inverses and derivatives from twobody
+void BCS_wf::fillMatrix(const Array2 <doublevar> & onebody) { 
   int maxmatsize=max(nelectrons(0),nelectrons(1));
   Array2 <doublevar> modet(maxmatsize, maxmatsize);
   modet=0;
@@ -613,6 +619,294 @@ void BCS_wf::updateLap(int e, Sample_point * sample ) {
 
 //----------------------------------------------------------------------
 
+/*!
+The new row (spin up) or column (spin down) of the pair matrix is made from
+the Jastrow's proposal, and the ratio and derivatives come from the old 
+inverse, since the update only divides that row or column of the inverse 
+by the ratio.
+*/
+void BCS_wf::proposeLap(Wavefunction_data * wfdata, Sample_point * sample,
+                        int e, Wf_return & lap) { 
+  int s=spin(e);
+  int nup=nelectrons(0);
+  int tote=nelectrons(0)+nelectrons(1);
+  sample->updateEIDist();
+
+  //twobody is only scratch space, so it's refreshed here
+  Wf_return jast_lap(1,5);
+  jast.proposeLap(&parent->jastdata,sample,e,jast_lap);
+  Array1 <doublevar> one;
+  Array2 <doublevar> two_e, two_others, onebody;
+  jast.get_proposed_save(one,two_e,two_others);
+  jast.get_twobody(twobody);
+  jast.get_onebody_save(onebody);
+  for(int d=0; d< 5; d++) 
+    onebody(e,d)=one(d);
+  for(int i=0; i< tote; i++) { 
+    for(int d=0; d< 5; d++) { 
+      twobody(e,i,d)=two_e(i,d);
+      twobody(i,e,d)=two_others(i,d);
+    }
+  }
+
+  prop_full=!(abs(detVal(0))>0);
+  if(prop_full) { 
+    //Same as updateLap(), which starts over at a zero determinant
+    prop_inverse=inverse;
+    prop_detVal=detVal;
+    prop_derivatives_all=derivatives;
+    fillMatrix(onebody);
+    getLap(wfdata,e,lap);
+    return;
+  }
+
+  prop_ratio.Resize(ndet);
+  prop_detUpdate.Resize(nup);
+  prop_derivatives.Resize(2,nup,4);
+  Array2 <doublevar> ugrad;
+  doublevar funcval=0;
+  Array1 <doublevar> grad(5,0.0);
+  for(int det=0; det < ndet; det++ ) {
+    doublevar ratio=0;
+    if(s==0) { 
+      for(int j=0; j< nelectrons(1); j++) {
+        jastcof->valGradLap(twobody,onebody,e,nup+j,ugrad);
+        prop_detUpdate(j)=parent->magnification_factor*ugrad(0,0);
+        for(int d=0; d< 4; d++) {
+          prop_derivatives(0,j,d)=ugrad(0,d+1);
+          prop_derivatives(1,j,d)=ugrad(1,d+1);
+        }
+        ratio+=inverse(det)(e,j)*prop_detUpdate(j);
+      }
+      for(int d=1; d< 5; d++) { 
+        doublevar temp=0;
+        for(int j=0; j< nelectrons(1); j++) 
+          temp+=prop_derivatives(0,j,d-1)*inverse(det)(e,j);
+        if(ndet > 1) error("update BCS::getLap() for ndet > 1");
+        grad(d)=parent->magnification_factor*temp/ratio;
+      }
+    }
+    else { 
+      int edown=e-nup;
+      for(int i=0; i< nup; i++) {
+        jastcof->valGradLap(twobody,onebody,i,e,ugrad);
+        prop_detUpdate(i)=parent->magnification_factor*ugrad(0,0);
+        for(int d=0; d< 4; d++) {
+          prop_derivatives(0,i,d)=ugrad(0,d+1);
+          prop_derivatives(1,i,d)=ugrad(1,d+1);
+        }
+        ratio+=inverse(det)(i,edown)*prop_detUpdate(i);
+      }
+      for(int d=1; d< 5; d++) { 
+        doublevar temp=0;
+        for(int i=0; i< nup; i++) 
+          temp+=prop_derivatives(1,i,d-1)*inverse(det)(i,edown);
+        grad(d)=parent->magnification_factor*temp/ratio;
+      }
+    }
+    prop_ratio(det)=ratio;
+    funcval+=detVal(det)*ratio;
+  }
+
+  if(fabs(funcval) > 0)
+    lap.amp(0,0)=log(fabs(funcval));
+  else lap.amp(0,0)=-1e3;
+  if(sign(funcval)>0)
+    lap.phase(0,0)=0;
+  else lap.phase(0,0)=pi;
+  for(int d=1; d< 5; d++) {
+    lap.amp(0,d)=grad(d);
+    lap.phase(0,d)=0.0;
+  }
+}
+
+//----------------------------------------------------------------------
+
+void BCS_wf::acceptMove(Wavefunction_data * wfdata, Sample_point * sample,
+                        int e) { 
+  jast.acceptMove(&parent->jastdata,sample,e);
+  if(!prop_full) { 
+    int nup=nelectrons(0);
+    for(int det=0; det < ndet; det++) { 
+      if(spin(e)==0) { 
+        for(int j=0; j< nelectrons(1); j++) {
+          for(int d=0; d< 4; d++) {
+            derivatives(e,j,d)=prop_derivatives(0,j,d);
+            derivatives(e+nup,j,d)=prop_derivatives(1,j,d);
+          }
+        }
+        detVal(det)/=InverseUpdateColumn(inverse(det),prop_detUpdate,e,nup);
+      }
+      else { 
+        int edown=e-nup;
+        for(int i=0; i< nup; i++) {
+          for(int d=0; d< 4; d++) {
+            derivatives(i,edown,d)=prop_derivatives(0,i,d);
+            derivatives(i+nup,edown,d)=prop_derivatives(1,i,d);
+          }
+        }
+        detVal(det)/=InverseUpdateRow(inverse(det),prop_detUpdate,edown,nup);
+      }
+    }
+  }
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//----------------------------------------------------------------------
+
+void BCS_wf::rejectMove(Sample_point * sample, int e) { 
+  jast.rejectMove(sample,e);
+  if(prop_full) { 
+    inverse=prop_inverse;
+    detVal=prop_detVal;
+    derivatives=prop_derivatives_all;
+  }
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//----------------------------------------------------------------------
+
+/*!
+The Jastrow's proposal at pos gives the new pair orbitals of electron e 
+with the other electrons, which are the new row (spin up) or column (spin 
+down) of the pair matrix, and the ratio is its product with the old 
+inverse, as in proposeLap().  A zero determinant has no inverse, so then 
+the whole matrix is made and its determinant taken.  two and onebody are 
+the Jastrow's current pair and one-body values; they are changed for e 
+while the value is computed and then put back.  The electron's distances 
+are left at the test position.  Returns the value of the wave function.
+*/
+doublevar BCS_wf::testValue(Sample_point * sample, int e, 
+                            const Array1 <doublevar> & pos,
+                            Array3 <doublevar> & two, 
+                            Array2 <doublevar> & onebody) { 
+  int nup=nelectrons(0);
+  int tote=nelectrons(0)+nelectrons(1);
+  Wf_return jast_lap(1,5);
+  Array1 <doublevar> one, oldone(5), oldpos(ndim);
+  Array2 <doublevar> two_e, two_others, oldtwo(2*tote,5);
+  Array2 <doublevar> ugrad;
+  Array2 <doublevar> modet;
+  int full=!(abs(detVal(0))>0);
+  sample->getElectronPos(e,oldpos);
+  sample->setElectronPosNoNotify(e,pos);
+  sample->updateEIDist();
+  jast.proposeLap(&parent->jastdata,sample,e,jast_lap);
+  jast.get_proposed_save(one,two_e,two_others);
+  jast.rejectMove(sample,e);
+  sample->setElectronPosNoNotify(e,oldpos);
+  for(int d=0; d< 5; d++) { 
+    oldone(d)=onebody(e,d);
+    onebody(e,d)=one(d);
+  }
+  for(int i=0; i< tote; i++) { 
+    for(int d=0; d< 5; d++) { 
+      oldtwo(i,d)=two(e,i,d);
+      oldtwo(tote+i,d)=two(i,e,d);
+      two(e,i,d)=two_e(i,d);
+      two(i,e,d)=two_others(i,d);
+    }
+  }
+
+  doublevar funcval=0;
+  for(int det=0; det < ndet; det++) { 
+    if(full) { 
+      modet.Resize(nup,nup);
+      for(int i=0; i< nup; i++) {
+        for(int j=0; j< nelectrons(1); j++) {
+          jastcof->valGradLap(two,onebody,i,nup+j,ugrad);
+          modet(i,j)=parent->magnification_factor*ugrad(0,0);
+        }
+      }
+      funcval+=Determinant(modet,nup);
+      continue;
+    }
+    doublevar ratio=0;
+    if(spin(e)==0) { 
+      for(int j=0; j< nelectrons(1); j++) {
+        jastcof->valGradLap(two,onebody,e,nup+j,ugrad);
+        ratio+=inverse(det)(e,j)*parent->magnification_factor*ugrad(0,0);
+      }
+    }
+    else { 
+      int edown=e-nup;
+      for(int i=0; i< nup; i++) {
+        jastcof->valGradLap(two,onebody,i,e,ugrad);
+        ratio+=inverse(det)(i,edown)*parent->magnification_factor*ugrad(0,0);
+      }
+    }
+    funcval+=detVal(det)*ratio;
+  }
+
+  for(int d=0; d< 5; d++) 
+    onebody(e,d)=oldone(d);
+  for(int i=0; i< tote; i++) { 
+    for(int d=0; d< 5; d++) { 
+      two(e,i,d)=oldtwo(i,d);
+      two(i,e,d)=oldtwo(tote+i,d);
+    }
+  }
+  return funcval;
+}
+
+//----------------------------------------------------------------------
+
+void BCS_wf::evalTestPos(Array1 <doublevar> & pos, Sample_point * sample,
+                         Array1 <Wf_return> & wf) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  Array3 <doublevar> two;
+  Array2 <doublevar> onebody;
+  jast.get_twobody(two);
+  jast.get_onebody_save(onebody);
+
+  wf.Resize(tote);
+  for(int e=0; e< tote; e++) { 
+    doublevar funcval=testValue(sample,e,pos,two,onebody);
+    wf(e).Resize(1,1);
+    if(fabs(funcval) > 0)
+      wf(e).amp(0,0)=log(fabs(funcval));
+    else wf(e).amp(0,0)=-1e3;
+    if(sign(funcval)>0)
+      wf(e).phase(0,0)=0;
+    else wf(e).phase(0,0)=pi;
+  }
+  sample->updateEIDist();
+  sample->updateEEDist();
+}
+
+//----------------------------------------------------------------------
+
+void BCS_wf::testRatios(Wavefunction_data * wfdata, Sample_point * sample,
+                        int e, const Array2 <doublevar> & pos,
+                        Array1 <Wf_return> & ratio) { 
+  Array3 <doublevar> two;
+  Array2 <doublevar> onebody;
+  jast.get_twobody(two);
+  jast.get_onebody_save(onebody);
+  doublevar oldval=0;
+  for(int det=0; det < ndet; det++) 
+    oldval += detVal(det);
+  doublevar oldlog=fabs(oldval) > 0 ? log(fabs(oldval)) : -1e3;
+
+  int npos=pos.GetDim(0);
+  ratio.Resize(npos);
+  Array1 <doublevar> newpos(ndim);
+  Array1 <doublevar> si(1, 0.0);
+  Array2 <doublevar> vals(1,1,0.0);
+  for(int k=0; k< npos; k++) { 
+    for(int d=0; d< ndim; d++) newpos(d)=pos(k,d);
+    doublevar funcval=testValue(sample,e,newpos,two,onebody);
+    vals(0,0)=(fabs(funcval) > 0 ? log(fabs(funcval)) : -1e3)-oldlog;
+    si(0)=sign(funcval)*sign(oldval);
+    ratio(k).Resize(1,1);
+    ratio(k).setVals(vals, si);
+  }
+}
+
+//----------------------------------------------------------------------
+
 /*!
  */
 
@@ -106,6 +106,15 @@ public:
   virtual void saveUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
   virtual void restoreUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
 
+  virtual void proposeLap(Wavefunction_data *, Sample_point *, int e, Wf_return &);
+  virtual void acceptMove(Wavefunction_data *, Sample_point *, int e);
+  virtual void rejectMove(Sample_point *, int e);
+
+  virtual void evalTestPos(Array1 <doublevar> & pos, Sample_point *, 
+                           Array1 <Wf_return> & wf);
+  virtual void testRatios(Wavefunction_data *, Sample_point *, int e,
+                          const Array2 <doublevar> & pos, 
+                          Array1 <Wf_return> & ratio);
 
   virtual int getParmDeriv(Wavefunction_data *, 
 			   Sample_point *,
@@ -130,7 +139,11 @@ private:
 
 
   void calcLap(Sample_point *);
+  void fillMatrix(const Array2 <doublevar> & onebody);
   void updateLap(int e, Sample_point *);
+  //! The value of the wave function with electron e moved to pos
+  doublevar testValue(Sample_point *, int e, const Array1 <doublevar> & pos,
+                      Array3 <doublevar> & two, Array2 <doublevar> & onebody);
   Array1 <int> electronIsStaleVal;
   Array1 <int> electronIsStaleLap;
   int updateEverythingVal;
@@ -164,6 +177,15 @@ private:
   Array1 <int> nelectrons; //!< 2 elements, for spin up and down
   Array1 <int> spin;       //!< lookup table for the spin of a given electron
 
+  //Scratch for proposeLap()
+  int prop_full; //!< the proposal recomputed everything
+  Array1 <doublevar> prop_ratio; //!< (det) new/old determinant
+  Array1 <doublevar> prop_detUpdate; //!< new row or column of the matrix
+  Array3 <doublevar> prop_derivatives; //!< (2, electron, grad lap)
+  Array1 < Array2 <doublevar> > prop_inverse;
+  Array1 <doublevar> prop_detVal;
+  Array3 <doublevar> prop_derivatives_all;
+
   Jastrow2_wf jast;
   BCS_jastrow_cofactor * jastcof;
   
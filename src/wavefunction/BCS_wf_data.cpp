@@ -92,6 +92,10 @@ int BCS_wf_data::supports(wf_support_type support) {
   case parameter_derivatives:
     return jastdata.supports(support);
     //return 0;
+  case move_proposal:
+    return 1;
+  case test_ratios:
+    return 1;
   default:
     return 0;
   }
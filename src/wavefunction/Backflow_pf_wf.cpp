@@ -18,6 +18,12 @@ void Backflow_pf_wf::generateStorage(Wavefunction_storage * & wfstore)
   recast(wfstore, store);
   store->gradlap=gradlap;
   store->pfaffVal=pfaffVal;
+  array_cp(store->moVal,moVal);
+  store->inverse=inverse;
+  array_cp(store->coor_grad,coor_grad);
+  array_cp(store->coor_lap,coor_lap);
+  store->neighbor=neighbor;
+  store->rowIsStaleLap=rowIsStaleLap;
 }
 
 
@@ -81,8 +87,13 @@ void Backflow_pf_wf::init(Wavefunction_data * wfdata)
   coor_lap.Resize(tote,tote,ndim);
 
   gradlap.Resize(tote,5);
+  neighbor.Resize(tote,tote);
+  neighbor=1;
+  rowIsStaleLap.Resize(tote);
+  rowIsStaleLap=0;
 
   jast.init(&parent->bfwrapper.jdata);
+  if(temp_samp==NULL) parent->bfwrapper.generateSample(temp_samp);
   jast.keep_ion_dep();
 }
 
@@ -146,7 +157,12 @@ void Backflow_pf_wf::saveUpdate(Sample_point * sample, int e,
   recast(wfstore, store);
   store->gradlap=gradlap;
   store->pfaffVal=pfaffVal;
-	
+  array_cp(store->moVal,moVal);
+  store->inverse=inverse;
+  array_cp(store->coor_grad,coor_grad);
+  array_cp(store->coor_lap,coor_lap);
+  store->neighbor=neighbor;
+  store->rowIsStaleLap=rowIsStaleLap;
 }
 
 //----------------------------------------------------------------------
@@ -158,6 +174,12 @@ void Backflow_pf_wf::restoreUpdate(Sample_point * sample, int e,
   recast(wfstore, store);
   gradlap=store->gradlap;
   pfaffVal=store->pfaffVal;
+  array_cp(moVal,store->moVal);
+  inverse=store->inverse;
+  array_cp(coor_grad,store->coor_grad);
+  array_cp(coor_lap,store->coor_lap);
+  neighbor=store->neighbor;
+  rowIsStaleLap=store->rowIsStaleLap;
 	  
   electronIsStaleLap=0;
   electronIsStaleVal=0;
@@ -167,6 +189,11 @@ void Backflow_pf_wf::restoreUpdate(Sample_point * sample, int e,
 
 //----------------------------------------------------------------------
 
+/*!
+As in Backflow_wf, only the electrons whose quasi-particle coordinates
+moved are redone, here with one row and column update of the inverse of 
+the pairing matrix for each of them.
+*/
 void Backflow_pf_wf::updateVal(Wavefunction_data * wfdata,
                         Sample_point * sample)
 {
@@ -174,26 +201,36 @@ void Backflow_pf_wf::updateVal(Wavefunction_data * wfdata,
   assert(sampleAttached);
   assert(dataAttached);
 
-  Backflow_pf_wf_data * pfaffdata;
-  recast(wfdata, pfaffdata);
-
+  int tote=nelectrons(0)+nelectrons(1);
   if(updateEverythingVal){ 
     calcVal(sample);
     updateEverythingVal=0;
     electronIsStaleVal=0;
+    return;
+  }
+
+  int moved=0;
+  for(int e=0; e< tote; e++) 
+    if(electronIsStaleVal(e)) moved=1;
+  if(!moved) return;
+
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+  Array1 <int> rows;
+  int nrows=findStaleRows(jast_corr,rows);
+  if(2*nrows > tote) { 
+    calcVal(sample);
+    //we no longer know which rows moved
+    updateEverythingLap=1;
   }
   else { 
-    for(int e=0; e< nelectrons(0)+nelectrons(1); e++) {
-      if(electronIsStaleVal(e)) {
-	calcVal(sample);
-	//updateVal(e,sample);
-	electronIsStaleVal=0;
-      }
-    }
+    updatePfaffians(sample,jast_corr,onebody,rows,nrows);
+    for(int r=0; r< nrows; r++) 
+      rowIsStaleLap(rows(r))=1;
   }
-  
-  assert(sampleAttached);
-  assert(dataAttached);
+  electronIsStaleVal=0;
 }
 
 //----------------------------------------------------------------------
@@ -204,27 +241,50 @@ void Backflow_pf_wf::updateLap( Wavefunction_data * wfdata,
   assert(sampleAttached);
   assert(dataAttached);
 
-
-
+  int tote=nelectrons(0)+nelectrons(1);
   if(updateEverythingLap==1) {
     calcLap(sample);
     updateEverythingVal=0;
     updateEverythingLap=0;
     electronIsStaleLap=0;
     electronIsStaleVal=0;
+    rowIsStaleLap=0;
+    return;
   }
-  else {
-    for(int e=0; e< nelectrons(0)+nelectrons(1); e++) {
-      if(electronIsStaleLap(e)) {
-	calcLap(sample);
-	electronIsStaleLap(e)=0;
-	electronIsStaleVal(e)=0;
-      }
+
+  int moved=0, valmoved=0;
+  for(int e=0; e< tote; e++) { 
+    if(electronIsStaleLap(e)) moved=1;
+    if(electronIsStaleVal(e)) valmoved=1;
+  }
+  if(!moved) return;
+
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateLap(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+
+  //moves that updateVal() has already taken care of are in rowIsStaleLap
+  Array1 <int> rows;
+  int nrows=0;
+  if(valmoved) nrows=findStaleRows(jast_corr,rows);
+  if(2*nrows > tote) { 
+    calcLap(sample);
+  }
+  else { 
+    updatePfaffians(sample,jast_corr,onebody,rows,nrows);
+    for(int r=0; r< nrows; r++) 
+      rowIsStaleLap(rows(r))=1;
+    for(int e=0; e< tote; e++) { 
+      if(rowIsStaleLap(e)) 
+        updateRowLap(sample,jast_corr,onebody,e);
     }
-    
+    calcGradLap();
   }
-
-
+  updateEverythingVal=0;
+  electronIsStaleLap=0;
+  electronIsStaleVal=0;
+  rowIsStaleLap=0;
 }
 
 
@@ -239,46 +299,186 @@ int Backflow_pf_wf::getParmDeriv(Wavefunction_data *  wfdata,
 
 //------------------------------------------------------------------------
 
-void Backflow_pf_wf::updateVal(int e, Sample_point * sample) { 
-  int nlist; Array1 <int> list;
-  parent->bfwrapper.getNeighbors(sample,jast,e,list,nlist);
-  cout << "nlist " << nlist << endl;
-  calcVal(sample);
+void Backflow_pf_wf::updateRowVal(Sample_point * sample, 
+                                  const Array3 <doublevar> & jast_corr,
+                                  const Array3 <doublevar> & onebody, int e) { 
+  parent->bfwrapper.updateVal(sample,jast_corr,onebody,e,0,
+                              updatedMoVal,temp_samp,mo_ws);
+  for(int i=0; i< updatedMoVal.GetDim(0); i++) 
+    moVal(0,e,i)=updatedMoVal(i,0);
 }
 
-void Backflow_pf_wf::calcVal(Sample_point * sample)
-{
+//------------------------------------------------------------------------
+
+void Backflow_pf_wf::updateRowLap(Sample_point * sample, 
+                                  const Array3 <doublevar> & jast_corr,
+                                  const Array3 <doublevar> & onebody, int e) { 
   int tote=nelectrons(0)+nelectrons(1);
+  Array3 <doublevar> temp_der;
+  Array2 <doublevar> temp_lap;
+  parent->bfwrapper.updateLap(sample,jast_corr,onebody,e,0,updatedMoVal,
+                              temp_der,temp_lap,temp_samp,mo_ws);
+  for(int i=0; i< updatedMoVal.GetDim(0); i++) {
+    for(int d=0; d< 10; d++) 
+      moVal(d,e,i)=updatedMoVal(i,d);
+  }
+  for(int i=0; i< tote; i++) { 
+    for(int a=0; a< 3; a++) {
+      for(int b=0; b < 3; b++) 
+        coor_grad(e,i,a,b)=temp_der(i,a,b);
+      coor_lap(e,i,a)=temp_lap(i,a);
+    }
+  }
+}
 
+//------------------------------------------------------------------------
+
+void Backflow_pf_wf::setNeighbors(const Array3 <doublevar> & jast_corr) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  Array1 <int> list;
+  int nlist;
+  neighbor=0;
   for(int e=0; e< tote; e++) { 
-    //int s=spin(e);
-    sample->updateEIDist();
-    parent->bfwrapper.updateVal(sample,jast, e, 0, updatedMoVal);
-    for(int i=0; i< updatedMoVal.GetDim(0); i++) {
-      for(int d=0; d< 1; d++) { 
-        moVal(d,e,i)=updatedMoVal(i,d);
-      }
+    parent->bfwrapper.getNeighbors(jast_corr,e,list,nlist);
+    for(int i=0; i< nlist; i++) 
+      neighbor(e,list(i))=neighbor(list(i),e)=1;
+  }
+}
+
+//------------------------------------------------------------------------
+
+/*!
+needed(j,k) is 1 when quasi-particles j and k are both neighbors of some 
+electron.
+*/
+void Backflow_pf_wf::findNeededPairs(Array2 <int> & needed) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  needed.Resize(tote,tote);
+  needed=0;
+  Array1 <int> list(tote);
+  for(int i=0; i< tote; i++) { 
+    int nlist=0;
+    for(int j=0; j< tote; j++) 
+      if(neighbor(j,i)) list(nlist++)=j;
+    for(int j=0; j< nlist; j++) 
+      for(int k=0; k< nlist; k++) needed(list(j),list(k))=1;
+  }
+}
+
+//------------------------------------------------------------------------
+
+/*!
+Put the quasi-particles that the moved electrons (electronIsStaleVal) 
+affect into rows and return how many there are: the moved electrons 
+themselves and their neighbors before and after the move.  neighbor is
+updated to the new positions.
+*/
+int Backflow_pf_wf::findStaleRows(const Array3 <doublevar> & jast_corr, 
+                                  Array1 <int> & rows) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  Array1 <int> stale(tote);
+  stale=0;
+  Array1 <int> list;
+  int nlist;
+  for(int e=0; e< tote; e++) { 
+    if(!electronIsStaleVal(e)) continue;
+    for(int j=0; j< tote; j++) { 
+      if(neighbor(e,j)) stale(j)=1;
+      neighbor(e,j)=neighbor(j,e)=0;
     }
+    parent->bfwrapper.getNeighbors(jast_corr,e,list,nlist);
+    for(int i=0; i< nlist; i++) { 
+      stale(list(i))=1;
+      neighbor(e,list(i))=neighbor(list(i),e)=1;
+    }
+  }
+  rows.Resize(tote);
+  int nrows=0;
+  for(int e=0; e< tote; e++) 
+    if(stale(e)) rows(nrows++)=e;
+  return nrows;
+}
 
-  } 
+//------------------------------------------------------------------------
 
-  //cout << "doing pfaffian " << endl;
-  for (int pf=0;pf<npf;pf++){
-    FillPfaffianMatrix( mopfaff_tot(pf),
-                        moVal, 
-                        parent->pfkeeper.occupation_pos,
-                        parent->pfkeeper.npairs,
-                        parent->pfkeeper.order_in_pfaffian(pf),
-                        parent->pfkeeper.tripletorbuu, 
-                        parent->pfkeeper.tripletorbdd,
-                        parent->pfkeeper.singletorb,
-                        parent->pfkeeper.unpairedorb,
-                        parent->pfkeeper.normalization,
-                        coef_eps
-                        );
-    pfaffVal(pf) = PfaffianInverseMatrix(mopfaff_tot(pf), inverse(pf));
-    //cout << "Pfaffian value:             "<< pfaffVal(pf) << endl;
+void Backflow_pf_wf::invertPfaffian(int pf) { 
+  FillPfaffianMatrix( mopfaff_tot(pf),
+                      moVal, 
+                      parent->pfkeeper.occupation_pos,
+                      parent->pfkeeper.npairs,
+                      parent->pfkeeper.order_in_pfaffian(pf),
+                      parent->pfkeeper.tripletorbuu, 
+                      parent->pfkeeper.tripletorbdd,
+                      parent->pfkeeper.singletorb,
+                      parent->pfkeeper.unpairedorb,
+                      parent->pfkeeper.normalization,
+                      coef_eps
+                      );
+  pfaffVal(pf) = PfaffianInverseMatrix(mopfaff_tot(pf), inverse(pf));
+}
+
+//------------------------------------------------------------------------
+
+/*!
+Evaluate the orbitals at the new quasi-particle coordinates of rows and
+replace them one at a time in the inverses, so that each row of the 
+pairing matrix is computed with the rows before it already moved.  A 
+Pfaffian whose ratio gets close to zero along the way is recalculated.
+*/
+void Backflow_pf_wf::updatePfaffians(Sample_point * sample, 
+                                     const Array3 <doublevar> & jast_corr,
+                                     const Array3 <doublevar> & onebody, 
+                                     const Array1 <int> & rows, int nrows) { 
+  if(nrows==0) return;
+  sample->updateEIDist();
+  Array1 <doublevar> mopfaff_row(npairs), mopfaff_column(npairs);
+  Array1 <int> singular(npf);
+  singular=0;
+  for(int r=0; r< nrows; r++) { 
+    int e=rows(r);
+    updateRowVal(sample,jast_corr,onebody,e);
+    for(int pf=0; pf< npf; pf++) { 
+      if(singular(pf)) continue;
+      UpdatePfaffianRowVal(mopfaff_row, 
+                           e,  
+                           moVal,
+                           parent->pfkeeper.occupation_pos,
+                           parent->pfkeeper.npairs,
+                           parent->pfkeeper.order_in_pfaffian(pf),
+                           parent->pfkeeper.tripletorbuu, 
+                           parent->pfkeeper.tripletorbdd,
+                           parent->pfkeeper.singletorb,
+                           parent->pfkeeper.unpairedorb,
+                           parent->pfkeeper.normalization,
+                           coef_eps
+                           );
+      doublevar ratio=UpdateInversePfaffianMatrix(inverse(pf), mopfaff_row, 
+                                                  mopfaff_column, e);
+      if(!(fabs(ratio) > 1e-10)) singular(pf)=1;
+      else pfaffVal(pf)*=ratio;
+    }
   }
+  for(int pf=0; pf< npf; pf++) 
+    if(singular(pf)) invertPfaffian(pf);
+}
+
+//------------------------------------------------------------------------
+
+void Backflow_pf_wf::calcVal(Sample_point * sample)
+{
+  int tote=nelectrons(0)+nelectrons(1);
+
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+  sample->updateEIDist();
+  for(int e=0; e< tote; e++) 
+    updateRowVal(sample,jast_corr,onebody,e);
+  setNeighbors(jast_corr);
+
+  for (int pf=0;pf<npf;pf++)
+    invertPfaffian(pf);
 }
 
 //------------------------------------------------------------------------
@@ -317,6 +517,157 @@ void Backflow_pf_wf::getSymmetricVal(Wavefunction_data * wfdata,
   val.setVals(vals, si);
 } 
 
+//----------------------------------------------------------------------
+
+/*!
+The rows of electron e and its neighbors are redone at the test position
+and replaced one at a time as in updatePfaffians(), but in a copy of the
+inverse, and the last row only needs its ratio 
+\f$ \sum_j r_j A^{-1}_{je} \f$, so a move that touches only the electron
+itself needs no copy at all.  The rows, the Jastrow and the electron are 
+put back afterwards, but the electron's distances are left at the test 
+position.  Returns the value of the wave function.
+*/
+doublevar Backflow_pf_wf::testValue(Sample_point * sample, int e,
+                                    const Array1 <doublevar> & pos) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  int nmo_e=moVal.GetDim(2);
+  Array3 <doublevar> jast_corr, onebody;
+  Array1 <doublevar> oldpos(ndim);
+  Array1 <int> stale(tote), rows(tote), list;
+  Array2 <doublevar> savedrows(tote,nmo_e);
+  Array1 <doublevar> mopfaff_row(npairs), mopfaff_column(npairs);
+  Array1 < Array2 <doublevar> > inv(npf);
+  Array1 <doublevar> newpfaff(npf);
+  Array1 <int> singular(npf);
+  Array2 <doublevar> fullmat;
+  int nlist;
+  sample->getElectronPos(e,oldpos);
+  sample->setElectronPosNoNotify(e,pos);
+  jast.notify(electron_move,e);
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+
+  //the neighbors before and after the move
+  for(int j=0; j< tote; j++) stale(j)=neighbor(e,j);
+  parent->bfwrapper.getNeighbors(jast_corr,e,list,nlist);
+  for(int i=0; i< nlist; i++) stale(list(i))=1;
+  int nrows=0;
+  for(int j=0; j< tote; j++) 
+    if(stale(j)) rows(nrows++)=j;
+
+  for(int pf=0; pf< npf; pf++) { 
+    newpfaff(pf)=pfaffVal(pf);
+    singular(pf)=(pfaffVal(pf)==0);
+    if(nrows > 1 && !singular(pf)) inv(pf)=inverse(pf);
+  }
+  sample->updateEIDist();
+  for(int r=0; r< nrows; r++) { 
+    int row=rows(r);
+    for(int i=0; i< nmo_e; i++) savedrows(r,i)=moVal(0,row,i);
+    updateRowVal(sample,jast_corr,onebody,row);
+    for(int pf=0; pf< npf; pf++) { 
+      if(singular(pf)) continue;
+      UpdatePfaffianRowVal(mopfaff_row, row, moVal,
+                           parent->pfkeeper.occupation_pos,
+                           parent->pfkeeper.npairs,
+                           parent->pfkeeper.order_in_pfaffian(pf),
+                           parent->pfkeeper.tripletorbuu, 
+                           parent->pfkeeper.tripletorbdd,
+                           parent->pfkeeper.singletorb,
+                           parent->pfkeeper.unpairedorb,
+                           parent->pfkeeper.normalization,
+                           coef_eps);
+      doublevar ratio=0;
+      if(r < nrows-1) 
+        ratio=UpdateInversePfaffianMatrix(inv(pf), mopfaff_row, 
+                                          mopfaff_column, row);
+      else { 
+        Array2 <doublevar> & lastinv(nrows > 1 ? inv(pf) : inverse(pf));
+        for(int j=0; j< npairs; j++) 
+          ratio+=mopfaff_row(j)*lastinv(j,row);
+      }
+      if(!(fabs(ratio) > 1e-10)) singular(pf)=1;
+      else newpfaff(pf)*=ratio;
+    }
+  }
+  for(int pf=0; pf< npf; pf++) { 
+    if(!singular(pf)) continue;
+    fullmat.Resize(npairs,npairs);
+    FillPfaffianMatrix(fullmat, moVal, 
+                       parent->pfkeeper.occupation_pos,
+                       parent->pfkeeper.npairs,
+                       parent->pfkeeper.order_in_pfaffian(pf),
+                       parent->pfkeeper.tripletorbuu, 
+                       parent->pfkeeper.tripletorbdd,
+                       parent->pfkeeper.singletorb,
+                       parent->pfkeeper.unpairedorb,
+                       parent->pfkeeper.normalization,
+                       coef_eps);
+    newpfaff(pf)=Pfaffian_blocked(fullmat);
+  }
+
+  for(int r=0; r< nrows; r++) 
+    for(int i=0; i< nmo_e; i++) moVal(0,rows(r),i)=savedrows(r,i);
+  sample->setElectronPosNoNotify(e,oldpos);
+  jast.notify(electron_move,e);
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+
+  doublevar funcval=0;
+  for(int pf=0; pf< npf; pf++) 
+    funcval += parent->pfkeeper.pfwt(pf)*newpfaff(pf);
+  return funcval;
+}
+
+//----------------------------------------------------------------------
+
+void Backflow_pf_wf::evalTestPos(Array1 <doublevar> & pos, 
+                                 Sample_point * sample, 
+                                 Array1 <Wf_return> & wf) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  wf.Resize(tote);
+  Array1 <doublevar> si(1, 0.0);
+  Array2 <doublevar> vals(1,1,0.0);
+  for(int e=0; e< tote; e++) { 
+    doublevar funcval=testValue(sample,e,pos);
+    if(fabs(funcval) > 0)
+      vals(0,0)=log(fabs(funcval));
+    else 
+      vals(0,0)=-1e3;
+    si(0)=sign(funcval);
+    wf(e).Resize(1,1);
+    wf(e).setVals(vals, si);
+  }
+  sample->updateEIDist();
+}
+
+//----------------------------------------------------------------------
+
+void Backflow_pf_wf::testRatios(Wavefunction_data * wfdata, 
+                                Sample_point * sample, int e, 
+                                const Array2 <doublevar> & pos,
+                                Array1 <Wf_return> & ratio) { 
+  doublevar oldval=0;
+  for(int pf=0; pf< npf; pf++) 
+    oldval += parent->pfkeeper.pfwt(pf)*pfaffVal(pf);
+  doublevar oldlog=fabs(oldval) > 0 ? log(fabs(oldval)) : -1e3;
+
+  int npos=pos.GetDim(0);
+  ratio.Resize(npos);
+  Array1 <doublevar> newpos(ndim);
+  Array1 <doublevar> si(1, 0.0);
+  Array2 <doublevar> vals(1,1,0.0);
+  for(int k=0; k< npos; k++) { 
+    for(int d=0; d< ndim; d++) newpos(d)=pos(k,d);
+    doublevar funcval=testValue(sample,e,newpos);
+    vals(0,0)=(fabs(funcval) > 0 ? log(fabs(funcval)) : -1e3)-oldlog;
+    si(0)=sign(funcval)*sign(oldval);
+    ratio(k).Resize(1,1);
+    ratio(k).setVals(vals, si);
+  }
+}
+
 
 
 //----------------------------------------------------------------------------
@@ -325,57 +676,39 @@ void Backflow_pf_wf::getSymmetricVal(Wavefunction_data * wfdata,
 //this is to make the updates a bit more convienent.
 void Backflow_pf_wf::calcLap(Sample_point * sample)
 {
-
-  //cout <<"Start Backflow_pf_wf::calcLap"<<endl;
   int tote=nelectrons(0)+nelectrons(1);
-  Array3 <doublevar> temp_der;
-  Array2 <doublevar> temp_lap;
-  Array3 <doublevar> moVal_gradonly;
-  moVal_gradonly.Resize(3,tote,updatedMoVal.GetDim(0)); 
-  for(int e=0; e< tote; e++) { 
-    //int s=spin(e);
-    sample->updateEIDist();
-    parent->bfwrapper.updateLap(sample,jast,e,0,updatedMoVal,
-				temp_der, temp_lap);
-    
-    for(int i=0; i< updatedMoVal.GetDim(0); i++) {
-      for(int d=0; d< 10; d++) { 
-        moVal(d,e,i)=updatedMoVal(i,d);
-	if(d>0 && d<4)
-	  moVal_gradonly(d-1,e,i)=moVal(d,e,i);
-      }
-    }
 
-    
-    for(int i=0; i< tote; i++) { 
-      for(int a=0; a< 3; a++) {
-	for(int b=0; b < 3; b++) { 
-	  coor_grad(e,i,a,b)=temp_der(i,a,b);
-	}
-	coor_lap(e,i,a)=temp_lap(i,a);
-      }
-    }
-  } 
-     
-  //cout << "doing pfaffian " << endl;
-  for (int pf=0;pf<npf;pf++){
-    FillPfaffianMatrix( mopfaff_tot(pf),
-                        moVal, 
-                        parent->pfkeeper.occupation_pos,
-                        parent->pfkeeper.npairs,
-                        parent->pfkeeper.order_in_pfaffian(pf),
-                        parent->pfkeeper.tripletorbuu, 
-                        parent->pfkeeper.tripletorbdd,
-                        parent->pfkeeper.singletorb,
-                        parent->pfkeeper.unpairedorb,
-                        parent->pfkeeper.normalization,
-                        coef_eps
-                        );
-    pfaffVal(pf) = PfaffianInverseMatrix(mopfaff_tot(pf), inverse(pf));
-    //cout << "Pfaffian value:             "<< pfaffVal(pf) << endl;
-  }
-  //cout << "done pfaffian" << endl;
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateLap(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+  sample->updateEIDist();
+  for(int e=0; e< tote; e++) 
+    updateRowLap(sample,jast_corr,onebody,e);
+  setNeighbors(jast_corr);
+
+  for (int pf=0;pf<npf;pf++)
+    invertPfaffian(pf);
+
+  calcGradLap();
+}
 
+//----------------------------------------------------------------------------
+
+/*!
+The gradient and laplacian of every electron from moVal, coor_grad, 
+coor_lap, and the inverses.  coor_grad(j,i) and coor_lap(j,i) are zero 
+unless i and j are neighbors, so those are the only ones summed over.
+F(i,j) and H(i,j) are only used when i and j are neighbors of the same 
+electron, so only those are computed.
+*/
+void Backflow_pf_wf::calcGradLap() { 
+  int tote=nelectrons(0)+nelectrons(1);
+  Array3 <doublevar> moVal_gradonly(3,tote,updatedMoVal.GetDim(0));
+  for(int d=0; d< 3; d++) 
+    for(int e=0; e< tote; e++) 
+      for(int i=0; i< updatedMoVal.GetDim(0); i++) 
+        moVal_gradonly(d,e,i)=moVal(d+1,e,i);
 
   gradlap=0;
   Array1 <doublevar> gradmod2(tote);
@@ -388,6 +721,8 @@ void Backflow_pf_wf::calcLap(Sample_point * sample)
   Array1 < Array1 < Array1 < Array2 <doublevar> >  > > mopfaff_row_hess;
   mopfaff_row.Resize(npf);
   mopfaff_row_hess.Resize(npf);
+  Array2 <int> needed;
+  findNeededPairs(needed);
 
   //cout <<"Getting all pairing orbital derivatives"<<endl;
   for(int pf=0;pf<npf;pf++){
@@ -447,16 +782,27 @@ void Backflow_pf_wf::calcLap(Sample_point * sample)
       Array3 <doublevar> & fref(F(pf));
       Array4 <doublevar> & href(H(pf));
 
+      //inverse times the derivatives of the rows first, so that H is
+      //O(n^3) instead of O(n^4)
+      Array3 <doublevar> invrow(tote,npairs,ndim);
+      invrow=0;
+      for(int j=0; j< tote; j++) 
+        for(int k=0; k< npairs; k++) 
+          for(int l=0; l< npairs; l++) { 
+            doublevar inv=inverse(pf)(k,l);
+            for(int b=0;b < ndim; b++) 
+              invrow(j,k,b)+=inv*mopfaff_row(pf)(j)(l)(b+1);
+          }
+
       for(int i=0; i<tote; i++)
 	for(int j=0; j< tote; j++) {
+          if(!needed(i,j)) continue;
 	  for(int k=0; k< npairs; k++){
 	    for(int a=0;a < ndim; a++) { 
 	      fref(i,j,a)+=mopfaff_row(pf)(j)(k)(a+1)*inverse(pf)(k,i);
-	      for(int l=0; l< npairs; l++){
-		for(int b=0;b < ndim; b++) { 
-		  href(i,j,a,b)+=mopfaff_row(pf)(i)(k)(a+1)*mopfaff_row(pf)(j)(l)(b+1)*inverse(pf)(k,l);
-		}
-	      }
+              for(int b=0;b < ndim; b++) { 
+                href(i,j,a,b)+=mopfaff_row(pf)(i)(k)(a+1)*invrow(j,k,b);
+              }
 	    }
 	  }
 	}
@@ -471,6 +817,7 @@ void Backflow_pf_wf::calcLap(Sample_point * sample)
       
       for(int i=0; i< tote; i++) { 
 	for(int j=0; j< tote; j++) { 
+          if(!neighbor(j,i)) continue;
 	  for(int a=0; a< ndim; a++) { 
 	    for(int b=0; b< ndim; b++) { 
 	      grad(i,a)+=fref(j,j,b)*coor_grad(j,i,a,b);
@@ -523,6 +870,7 @@ void Backflow_pf_wf::calcLap(Sample_point * sample)
       doublevar lap=0;
       if(pfaffVal(pf)!=0){
 	for(int j=0; j< tote; j++) { 
+          if(!neighbor(j,i)) continue;
 	  for(int a=0; a< ndim; a++) { 
 	    lap+=fref(j,j,a)*coor_lap(j,i,a);
 	  }
@@ -532,11 +880,13 @@ void Backflow_pf_wf::calcLap(Sample_point * sample)
 	//cout << "lap1 " << lap << endl;
 	
 	for(int j=0; j < tote; j++) { 
+          if(!neighbor(j,i)) continue;
 	  for(int k=0; k < npairs; k++) {
+            int knear=k<tote && neighbor(k,i);
 	    for(int a=0; a< ndim; a++) { 
 	      for(int b=0; b< ndim; b++) { 
 		for(int g=0; g< ndim; g++) { 
-		  if(k<tote){
+		  if(knear){
 		    lap-=coor_grad(j,i,a,b)*coor_grad(k,i,a,g)*
 		      (fref(k,j,b)*fref(j,k,g)-
 		       (href(j,k,b,g)+mopfaff_row_hess(pf)(j)(k)(b,g))*invref(k,j));
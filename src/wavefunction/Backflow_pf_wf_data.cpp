@@ -1153,6 +1153,8 @@ int Backflow_pf_wf_data::supports(wf_support_type support) {
     return 0;
   case parameter_derivatives:
     return 0;
+  case test_ratios:
+    return 1;
   default:
     return 0;
   }
@@ -18,6 +18,12 @@ void Backflow_wf::generateStorage(Wavefunction_storage * & wfstore)
   recast(wfstore, store);
   store->gradlap=gradlap;
   store->detVal=detVal;
+  array_cp(store->moVal,moVal);
+  store->inverse=inverse;
+  array_cp(store->coor_grad,coor_grad);
+  array_cp(store->coor_lap,coor_lap);
+  store->neighbor=neighbor;
+  store->rowIsStaleLap=rowIsStaleLap;
 }
 
 
@@ -77,8 +83,13 @@ void Backflow_wf::init(Wavefunction_data * wfdata)
   coor_lap.Resize(tote,tote,ndim);
 
   gradlap.Resize(tote,5);
+  neighbor.Resize(tote,tote);
+  neighbor=1;
+  rowIsStaleLap.Resize(tote);
+  rowIsStaleLap=0;
 
   jast.init(&parent->bfwrapper.jdata);
+  if(temp_samp==NULL) parent->bfwrapper.generateSample(temp_samp);
   jast.keep_ion_dep();
 }
 
@@ -142,7 +153,12 @@ void Backflow_wf::saveUpdate(Sample_point * sample, int e,
   recast(wfstore, store);
   store->gradlap=gradlap;
   store->detVal=detVal;
-	
+  array_cp(store->moVal,moVal);
+  store->inverse=inverse;
+  array_cp(store->coor_grad,coor_grad);
+  array_cp(store->coor_lap,coor_lap);
+  store->neighbor=neighbor;
+  store->rowIsStaleLap=rowIsStaleLap;
 }
 
 //----------------------------------------------------------------------
@@ -154,6 +170,12 @@ void Backflow_wf::restoreUpdate(Sample_point * sample, int e,
   recast(wfstore, store);
   gradlap=store->gradlap;
   detVal=store->detVal;
+  array_cp(moVal,store->moVal);
+  inverse=store->inverse;
+  array_cp(coor_grad,store->coor_grad);
+  array_cp(coor_lap,store->coor_lap);
+  neighbor=store->neighbor;
+  rowIsStaleLap=store->rowIsStaleLap;
 	  
   electronIsStaleLap=0;
   electronIsStaleVal=0;
@@ -163,6 +185,12 @@ void Backflow_wf::restoreUpdate(Sample_point * sample, int e,
 
 //----------------------------------------------------------------------
 
+/*!
+A move of one electron only changes the quasi-particle coordinates of the 
+electron and of its neighbors, so only those rows of the determinants are 
+redone, and the inverses get a low-rank update.  When more than half of the
+electrons are affected, everything is recalculated.
+*/
 void Backflow_wf::updateVal(Wavefunction_data * wfdata,
                         Sample_point * sample)
 {
@@ -170,24 +198,39 @@ void Backflow_wf::updateVal(Wavefunction_data * wfdata,
   assert(sampleAttached);
   assert(dataAttached);
 
-  Backflow_wf_data * slatdata;
-  recast(wfdata, slatdata);
-
+  int tote=nelectrons(0)+nelectrons(1);
   if(updateEverythingVal){ 
     calcVal(sample);
     updateEverythingVal=0;
     electronIsStaleVal=0;
+    return;
   }
-  else {
-    for(int e=0; e< nelectrons(0)+nelectrons(1); e++) {
-      if(electronIsStaleVal(e)) {
-        calcVal(sample);
-        //updateVal(e,sample);
-        electronIsStaleVal=0;
-      }
+
+  int moved=0;
+  for(int e=0; e< tote; e++) 
+    if(electronIsStaleVal(e)) moved=1;
+  if(!moved) return;
+
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+  Array1 <int> rows;
+  int nrows=findStaleRows(jast_corr,rows);
+  if(2*nrows > tote) { 
+    calcVal(sample);
+    //we no longer know which rows moved
+    updateEverythingLap=1;
+  }
+  else { 
+    sample->updateEIDist();
+    for(int r=0; r< nrows; r++) { 
+      updateRowVal(sample,jast_corr,onebody,rows(r));
+      rowIsStaleLap(rows(r))=1;
     }
+    updateInverses(rows,nrows);
   }
-
+  electronIsStaleVal=0;
 }
 
 //----------------------------------------------------------------------
@@ -198,27 +241,51 @@ void Backflow_wf::updateLap( Wavefunction_data * wfdata,
   assert(sampleAttached);
   assert(dataAttached);
 
-
-
+  int tote=nelectrons(0)+nelectrons(1);
   if(updateEverythingLap==1) {
     calcLap(sample);
     updateEverythingVal=0;
     updateEverythingLap=0;
     electronIsStaleLap=0;
     electronIsStaleVal=0;
+    rowIsStaleLap=0;
+    return;
   }
-  else {
-    for(int e=0; e< nelectrons(0)+nelectrons(1); e++) {
-      if(electronIsStaleLap(e)) {
-        calcLap(sample);
-        electronIsStaleLap(e)=0;
-        electronIsStaleVal(e)=0;
-      }
+
+  int moved=0, valmoved=0;
+  for(int e=0; e< tote; e++) { 
+    if(electronIsStaleLap(e)) moved=1;
+    if(electronIsStaleVal(e)) valmoved=1;
+  }
+  if(!moved) return;
+
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateLap(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+
+  //moves that updateVal() has already taken care of are in rowIsStaleLap
+  Array1 <int> rows;
+  int nrows=0;
+  if(valmoved) nrows=findStaleRows(jast_corr,rows);
+  if(2*nrows > tote) { 
+    calcLap(sample);
+  }
+  else { 
+    sample->updateEIDist();
+    for(int r=0; r< nrows; r++) 
+      rowIsStaleLap(rows(r))=1;
+    for(int e=0; e< tote; e++) { 
+      if(rowIsStaleLap(e)) 
+        updateRowLap(sample,jast_corr,onebody,e);
     }
-    
+    updateInverses(rows,nrows);
+    calcGradLap();
   }
-
-
+  updateEverythingVal=0;
+  electronIsStaleLap=0;
+  electronIsStaleVal=0;
+  rowIsStaleLap=0;
 }
 
 
@@ -235,55 +302,194 @@ int Backflow_wf::getParmDeriv(Wavefunction_data *  wfdata,
 
 //------------------------------------------------------------------------
 
-void Backflow_wf::updateVal(int e, Sample_point * sample) { 
-  int nlist; Array1 <int> list;
-  parent->bfwrapper.getNeighbors(sample,jast,e,list,nlist);
-  cout << "nlist " << nlist << endl;
-  calcVal(sample);
+void Backflow_wf::updateRowVal(Sample_point * sample, 
+                               const Array3 <doublevar> & jast_corr,
+                               const Array3 <doublevar> & onebody, int e) { 
+  parent->bfwrapper.updateVal(sample,jast_corr,onebody,e,spin(e),
+                              updatedMoVal,temp_samp,mo_ws);
+  for(int i=0; i< updatedMoVal.GetDim(0); i++) 
+    moVal(e,i,0)=updatedMoVal(i,0);
 }
 
-void Backflow_wf::calcVal(Sample_point * sample)
-{
+//------------------------------------------------------------------------
+
+void Backflow_wf::updateRowLap(Sample_point * sample, 
+                               const Array3 <doublevar> & jast_corr,
+                               const Array3 <doublevar> & onebody, int e) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  Array3 <doublevar> temp_der;
+  Array2 <doublevar> temp_lap;
+  parent->bfwrapper.updateLap(sample,jast_corr,onebody,e,spin(e),
+                              updatedMoVal,temp_der,temp_lap,temp_samp,mo_ws);
+  for(int i=0; i< updatedMoVal.GetDim(0); i++) {
+    for(int d=0; d< 10; d++) 
+      moVal(e,i,d)=updatedMoVal(i,d);
+  }
+  for(int i=0; i< tote; i++) { 
+    for(int a=0; a< 3; a++) {
+      for(int b=0; b < 3; b++) 
+        coor_grad(e,i,a,b)=temp_der(i,a,b);
+      coor_lap(e,i,a)=temp_lap(i,a);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+
+void Backflow_wf::setNeighbors(const Array3 <doublevar> & jast_corr) { 
   int tote=nelectrons(0)+nelectrons(1);
+  Array1 <int> list;
+  int nlist;
+  neighbor=0;
+  for(int e=0; e< tote; e++) { 
+    parent->bfwrapper.getNeighbors(jast_corr,e,list,nlist);
+    for(int i=0; i< nlist; i++) 
+      neighbor(e,list(i))=neighbor(list(i),e)=1;
+  }
+}
+
+//------------------------------------------------------------------------
+
+/*!
+needed(j,k) is 1 when quasi-particles j and k are both neighbors of some 
+electron, and nneeded counts those pairs within each spin.
+*/
+void Backflow_wf::findNeededPairs(Array2 <int> & needed, 
+                                  Array1 <int> & nneeded) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  needed.Resize(tote,tote);
+  needed=0;
+  Array1 <int> list(tote);
+  for(int i=0; i< tote; i++) { 
+    int nlist=0;
+    for(int j=0; j< tote; j++) 
+      if(neighbor(j,i)) list(nlist++)=j;
+    for(int j=0; j< nlist; j++) 
+      for(int k=0; k< nlist; k++) needed(list(j),list(k))=1;
+  }
+  nneeded.Resize(2);
+  nneeded=0;
+  for(int j=0; j< tote; j++) 
+    for(int k=0; k< tote; k++) 
+      if(needed(j,k) && spin(j)==spin(k)) nneeded(spin(j))++;
+}
 
+//------------------------------------------------------------------------
+
+/*!
+Put the quasi-particles that the moved electrons (electronIsStaleVal) 
+affect into rows and return how many there are: the moved electrons 
+themselves and their neighbors before and after the move.  neighbor is
+updated to the new positions.
+*/
+int Backflow_wf::findStaleRows(const Array3 <doublevar> & jast_corr, 
+                               Array1 <int> & rows) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  Array1 <int> stale(tote);
+  stale=0;
+  Array1 <int> list;
+  int nlist;
   for(int e=0; e< tote; e++) { 
-    int s=spin(e);
-    sample->updateEIDist();
-    parent->bfwrapper.updateVal(sample,jast, e,s,updatedMoVal);
-    for(int i=0; i< updatedMoVal.GetDim(0); i++) {
-      for(int d=0; d< 1; d++) { 
-        moVal(e,i,d)=updatedMoVal(i,d);
-	//if(s==1) cout << "moval " << i << " d " << d 
-	//	      << "   " << updatedMoVal(i,d) << endl;
-      }
+    if(!electronIsStaleVal(e)) continue;
+    for(int j=0; j< tote; j++) { 
+      if(neighbor(e,j)) stale(j)=1;
+      neighbor(e,j)=neighbor(j,e)=0;
     }
+    parent->bfwrapper.getNeighbors(jast_corr,e,list,nlist);
+    for(int i=0; i< nlist; i++) { 
+      stale(list(i))=1;
+      neighbor(e,list(i))=neighbor(list(i),e)=1;
+    }
+  }
+  rows.Resize(tote);
+  int nrows=0;
+  for(int e=0; e< tote; e++) 
+    if(stale(e)) rows(nrows++)=e;
+  return nrows;
+}
 
-  } 
-     
+//------------------------------------------------------------------------
 
-  int maxmatsize=max(nelectrons(0),nelectrons(1));
-  Array2 <doublevar> modet(maxmatsize, maxmatsize);
-  //cout << "doing determinant " << endl;
-  for(int det=0; det < ndet; det++ ) {
-    for(int s=0; s< 2; s++ ) {
-      
-      
-      for(int e=0; e< nelectrons(s); e++) {
-	int curre=s*nelectrons(0)+e;
-	for(int i=0; i< nelectrons(s); i++) {
-	  modet(e,i)=moVal(curre, parent->occupation(det,s)(i),0);
-	}
+void Backflow_wf::invertDeterminant(int det, int s) { 
+  int n=nelectrons(s);
+  Array2 <doublevar> modet(n,n);
+  for(int e=0; e< n; e++) {
+    int curre=s*nelectrons(0)+e;
+    for(int i=0; i< n; i++) 
+      modet(e,i)=moVal(curre, parent->occupation(det,s)(i),0);
+  }
+  log_real_value tmp=TransposeInverseMatrix(modet,inverse(det,s), n);
+  detVal(det,s)=tmp.val();
+}
+
+//------------------------------------------------------------------------
+
+/*!
+The rows of the orbital matrix in rows have been replaced in moVal.  With
+the k changed rows R of the matrix A and the new rows U,
+\f[ A'^{-1}=A^{-1}-A^{-1}_R S^{-1} (U A^{-1}-I_R), \quad S=(UA^{-1})_R \f]
+where \f$ A^{-1}_R \f$ are the columns R of the inverse and \f$ \det S \f$
+is the ratio of the determinants.  This is O(kn^2) instead of O(n^3).  
+If S is close to singular the inverse is recalculated instead.
+*/
+void Backflow_wf::updateInverses(const Array1 <int> & rows, int nrows) { 
+  for(int s=0; s< 2; s++) { 
+    int n=nelectrons(s);
+    Array1 <int> R(nrows);
+    int k=0;
+    for(int r=0; r< nrows; r++) { 
+      if(spin(rows(r))==s) R(k++)=rows(r)-s*nelectrons(0);
+    }
+    if(k==0) continue;
+    Array2 <doublevar> U(k,n), G(k,n), S(k,k), sinvt(k,k), 
+      H(k,n), invrows(k,n), gt(n,k);
+    for(int det=0; det < ndet; det++) { 
+      Array2 <doublevar> & inv(inverse(det,s));
+      for(int a=0; a< k; a++) { 
+        int curre=R(a)+s*nelectrons(0);
+        for(int i=0; i< n; i++) 
+          U(a,i)=moVal(curre,parent->occupation(det,s)(i),0);
       }
-      log_real_value tmp=TransposeInverseMatrix(modet,inverse(det,s), nelectrons(s));
-      detVal(det,s)=tmp.val();
+      //inverse(det,s) holds the transpose of the inverse
+      gemm_rowmajor(1,k,n,n,1.0,U.v,n,inv.v,n,0.0,G.v,n);
+      for(int a=0; a< k; a++) 
+        for(int b=0; b< k; b++) S(a,b)=G(a,R(b));
+      doublevar ratio=TransposeInverseMatrix(S,sinvt,k).val();
+      if(!(fabs(ratio) > 1e-10)) { 
+        invertDeterminant(det,s);
+        continue;
+      }
+      for(int a=0; a< k; a++) { 
+        G(a,R(a))-=1.0;
+        for(int i=0; i< n; i++) invrows(a,i)=inv(R(a),i);
+      }
+      gemm_rowmajor(0,k,n,k,1.0,sinvt.v,k,invrows.v,n,0.0,H.v,n);
+      for(int i=0; i< n; i++) 
+        for(int a=0; a< k; a++) gt(i,a)=G(a,i);
+      gemm_rowmajor(0,n,n,k,-1.0,gt.v,k,H.v,n,1.0,inv.v,n);
+      detVal(det,s)*=ratio;
     }
   }
 }
 
 //------------------------------------------------------------------------
-/*!
 
-*/
+void Backflow_wf::calcVal(Sample_point * sample)
+{
+  int tote=nelectrons(0)+nelectrons(1);
+
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+  sample->updateEIDist();
+  for(int e=0; e< tote; e++) 
+    updateRowVal(sample,jast_corr,onebody,e);
+  setNeighbors(jast_corr);
+
+  for(int det=0; det < ndet; det++ ) 
+    for(int s=0; s< 2; s++ ) invertDeterminant(det,s);
+}
 
 //------------------------------------------------------------------------
 
@@ -327,6 +533,138 @@ void Backflow_wf::getSymmetricVal(Wavefunction_data * wfdata,
 } 
 
 
+//----------------------------------------------------------------------
+
+/*!
+Moving one electron only changes the quasi-particle coordinates of it and 
+its neighbors, so those rows are redone at the test position and the 
+ratio is \f$ \det S \f$ of updateInverses(), without updating the 
+inverses.  The rows, the Jastrow and the electron are put back 
+afterwards, but the electron's distances are left at the test position.
+Returns the value of the wave function.
+*/
+doublevar Backflow_wf::testValue(Sample_point * sample, int e,
+                                 const Array1 <doublevar> & pos) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  int nmo_e=moVal.GetDim(1);
+  Array3 <doublevar> jast_corr, onebody;
+  Array1 <doublevar> oldpos(ndim);
+  Array1 <int> stale(tote), rows(tote), list;
+  Array2 <doublevar> savedrows(tote,nmo_e);
+  Array2 <doublevar> newdet(ndet,2);
+  Array2 <doublevar> U, G, S, modet;
+  int nlist;
+  sample->getElectronPos(e,oldpos);
+  sample->setElectronPosNoNotify(e,pos);
+  jast.notify(electron_move,e);
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+
+  //the neighbors before and after the move
+  for(int j=0; j< tote; j++) stale(j)=neighbor(e,j);
+  parent->bfwrapper.getNeighbors(jast_corr,e,list,nlist);
+  for(int i=0; i< nlist; i++) stale(list(i))=1;
+  int nrows=0;
+  for(int j=0; j< tote; j++) 
+    if(stale(j)) rows(nrows++)=j;
+
+  sample->updateEIDist();
+  for(int r=0; r< nrows; r++) { 
+    for(int i=0; i< nmo_e; i++) savedrows(r,i)=moVal(rows(r),i,0);
+    updateRowVal(sample,jast_corr,onebody,rows(r));
+  }
+
+  for(int s=0; s< 2; s++) { 
+    int n=nelectrons(s);
+    Array1 <int> R(nrows);
+    int k=0;
+    for(int r=0; r< nrows; r++) 
+      if(spin(rows(r))==s) R(k++)=rows(r)-s*nelectrons(0);
+    for(int det=0; det < ndet; det++) { 
+      if(k==0) { 
+        newdet(det,s)=detVal(det,s);
+        continue;
+      }
+      if(detVal(det,s)==0) { 
+        modet.Resize(n,n);
+        for(int a=0; a< n; a++) {
+          int curre=s*nelectrons(0)+a;
+          for(int i=0; i< n; i++) 
+            modet(a,i)=moVal(curre, parent->occupation(det,s)(i),0);
+        }
+        newdet(det,s)=Determinant(modet,n);
+        continue;
+      }
+      U.Resize(k,n); G.Resize(k,n); S.Resize(k,k);
+      for(int a=0; a< k; a++) { 
+        int curre=R(a)+s*nelectrons(0);
+        for(int i=0; i< n; i++) 
+          U(a,i)=moVal(curre,parent->occupation(det,s)(i),0);
+      }
+      gemm_rowmajor(1,k,n,n,1.0,U.v,n,inverse(det,s).v,n,0.0,G.v,n);
+      for(int a=0; a< k; a++) 
+        for(int b=0; b< k; b++) S(a,b)=G(a,R(b));
+      newdet(det,s)=detVal(det,s)*Determinant(S,k);
+    }
+  }
+
+  for(int r=0; r< nrows; r++) 
+    for(int i=0; i< nmo_e; i++) moVal(rows(r),i,0)=savedrows(r,i);
+  sample->setElectronPosNoNotify(e,oldpos);
+  jast.notify(electron_move,e);
+  jast.updateVal(&parent->bfwrapper.jdata,sample);
+
+  doublevar funcval=0;
+  for(int det=0; det < ndet; det++) 
+    funcval += parent->dkeeper.detwt(det)*newdet(det,0)*newdet(det,1);
+  return funcval;
+}
+
+//----------------------------------------------------------------------
+
+void Backflow_wf::evalTestPos(Array1 <doublevar> & pos, Sample_point * sample,
+                              Array1 <Wf_return> & wf) { 
+  int tote=nelectrons(0)+nelectrons(1);
+  wf.Resize(tote);
+  for(int e=0; e< tote; e++) { 
+    doublevar funcval=testValue(sample,e,pos);
+    wf(e).Resize(1,1);
+    if(fabs(funcval) > 0)
+      wf(e).amp(0,0)=log(fabs(funcval));
+    else wf(e).amp(0,0)=-1e3;
+    if(sign(funcval)>0) 
+      wf(e).phase(0,0)=0;
+    else wf(e).phase(0,0)=pi;
+  }
+  sample->updateEIDist();
+}
+
+//----------------------------------------------------------------------
+
+void Backflow_wf::testRatios(Wavefunction_data * wfdata, Sample_point * sample,
+                             int e, const Array2 <doublevar> & pos,
+                             Array1 <Wf_return> & ratio) { 
+  doublevar oldval=0;
+  for(int det=0; det < ndet; det++) 
+    oldval += parent->dkeeper.detwt(det)*detVal(det,0)*detVal(det,1);
+  doublevar oldlog=fabs(oldval) > 0 ? log(fabs(oldval)) : -1e3;
+
+  int npos=pos.GetDim(0);
+  ratio.Resize(npos);
+  Array1 <doublevar> newpos(ndim);
+  Array1 <doublevar> si(1, 0.0);
+  Array2 <doublevar> vals(1,1,0.0);
+  for(int k=0; k< npos; k++) { 
+    for(int d=0; d< ndim; d++) newpos(d)=pos(k,d);
+    doublevar funcval=testValue(sample,e,newpos);
+    vals(0,0)=(fabs(funcval) > 0 ? log(fabs(funcval)) : -1e3)-oldlog;
+    si(0)=sign(funcval)*sign(oldval);
+    ratio(k).Resize(1,1);
+    ratio(k).setVals(vals, si);
+  }
+}
+
 //----------------------------------------------------------------------
 
 void Backflow_wf::getDensity(Wavefunction_data * wfdata, int e,
@@ -342,62 +680,44 @@ void Backflow_wf::getDensity(Wavefunction_data * wfdata, int e,
 //this is to make the updates a bit more convienent.
 void Backflow_wf::calcLap(Sample_point * sample)
 {
+  int tote=nelectrons(0)+nelectrons(1);
 
+  Array3 <doublevar> jast_corr, onebody;
+  jast.updateLap(&parent->bfwrapper.jdata,sample);
+  jast.get_twobody(jast_corr);
+  jast.get_onebody(onebody);
+  sample->updateEIDist();
+  for(int e=0; e< tote; e++) 
+    updateRowLap(sample,jast_corr,onebody,e);
+  setNeighbors(jast_corr);
 
-  
+  for(int det=0; det < ndet; det++ ) 
+    for(int s=0; s< 2; s++ ) invertDeterminant(det,s);
 
-  int tote=nelectrons(0)+nelectrons(1);
-  Array3 <doublevar> temp_der;
-  Array2 <doublevar> temp_lap;
-  for(int e=0; e< tote; e++) { 
-    int s=spin(e);
-    sample->updateEIDist();
-    parent->bfwrapper.updateLap(sample,jast,e,s,updatedMoVal,
-				temp_der, temp_lap);
-    for(int i=0; i< updatedMoVal.GetDim(0); i++) {
-      for(int d=0; d< 10; d++) { 
-        moVal(e,i,d)=updatedMoVal(i,d);
-	//if(s==1) cout << "moval " << i << " d " << d 
-	//	      << "   " << updatedMoVal(i,d) << endl;
-      }
-    }
-
-    for(int i=0; i< tote; i++) { 
-      for(int a=0; a< 3; a++) {
-	for(int b=0; b < 3; b++) { 
-	  coor_grad(e,i,a,b)=temp_der(i,a,b);
-	}
-	coor_lap(e,i,a)=temp_lap(i,a);
-      }
-    }
-  } 
-     
-
-  int maxmatsize=max(nelectrons(0),nelectrons(1));
-  Array2 <doublevar> modet(maxmatsize, maxmatsize);
-  //cout << "doing determinant " << endl;
-  for(int det=0; det < ndet; det++ ) {
-    for(int s=0; s< 2; s++ ) {
-      
-      
-      for(int e=0; e< nelectrons(s); e++) {
-	int curre=s*nelectrons(0)+e;
-	for(int i=0; i< nelectrons(s); i++) {
-	  modet(e,i)=moVal(curre, parent->occupation(det,s)(i),0);
-	}
-      }
-      log_real_value tmp=TransposeInverseMatrix(modet,inverse(det,s), nelectrons(s));
-      detVal(det,s)=tmp.val();
-    }
-  }
+  calcGradLap();
+}
 
+//----------------------------------------------------------------------------
 
+/*!
+The gradient and laplacian of every electron from moVal, coor_grad, 
+coor_lap, and the inverses.  coor_grad(j,i) and coor_lap(j,i) are zero 
+unless i and j are neighbors, so those are the only ones summed over.
+F(j,k) is only used when j and k are neighbors of the same electron, so 
+when those pairs are less than half of a spin's, only they are computed.
+*/
+void Backflow_wf::calcGradLap() { 
+  int tote=nelectrons(0)+nelectrons(1);
   gradlap=0;
   Array1 <doublevar> gradmod2(tote);
   Array2 <Array3 <doublevar> > F(ndet,2); //(det,spin)
   doublevar funcval=0;
   gradmod2=0;
   Array2 <doublevar> grad(tote,ndim);
+
+  Array2 <int> needed(tote,tote);
+  Array1 <int> nneeded(2);
+  findNeededPairs(needed,nneeded);
   for(int det=0;det<ndet;det++){
     grad=0;
     //cout << "detVal "<<detVal(det,0)<<"  "<<detVal(det,1)<<endl;
@@ -409,20 +729,39 @@ void Backflow_wf::calcLap(Sample_point * sample)
     if(detVal(det,0)*detVal(det,1)!=0){
       for(int s=0; s< 2; s++) { 
 	Array3 <doublevar> & fref(F(det,s));
-	for(int i=0; i< nelectrons(s); i++) { 
-	  for(int j=0; j< nelectrons(s); j++) { 
-	    int jp=j+s*nelectrons(0);
-	    for(int a=0;a < ndim; a++) { 
-	      for(int k=0; k< nelectrons(s);k++) 
-		fref(i,j,a)+=inverse(det,s)(i,k)*
-		moVal(jp,parent->occupation(det,s)(k),a+1);
-	    }
-	  }
-	}
+        int n=nelectrons(s);
+        //fref(i,j,a)=sum_k inverse(i,k) d_a orbital k at j
+        if(2*nneeded(s) < n*n) { 
+          Array2 <doublevar> & invref(inverse(det,s));
+          for(int i=0; i< n; i++) { 
+            for(int j=0; j< n; j++) { 
+              int jp=j+s*nelectrons(0);
+              if(!needed(i+s*nelectrons(0),jp)) continue;
+              for(int a=0; a< ndim; a++) { 
+                doublevar f=0;
+                for(int k=0; k< n; k++) 
+                  f+=invref(i,k)*moVal(jp,parent->occupation(det,s)(k),a+1);
+                fref(i,j,a)=f;
+              }
+            }
+          }
+          continue;
+        }
+        Array2 <doublevar> dmo(n,n), fa(n,n);
+        for(int a=0;a < ndim; a++) { 
+          for(int j=0; j< n; j++) { 
+            int jp=j+s*nelectrons(0);
+            for(int k=0; k< n; k++) 
+              dmo(j,k)=moVal(jp,parent->occupation(det,s)(k),a+1);
+          }
+          gemm_rowmajor(1,n,n,n,1.0,inverse(det,s).v,n,dmo.v,n,0.0,fa.v,n);
+          for(int i=0; i< n; i++) 
+            for(int j=0; j< n; j++) fref(i,j,a)=fa(i,j);
+        }
       }
       for(int i=0; i< tote; i++) { 
-	int ir=i-spin(i)*nelectrons(0);
 	for(int j=0; j< tote; j++) { 
+          if(!neighbor(j,i)) continue;
 	  int s=spin(j);
 	  Array3 <doublevar> & fref(F(det,s));
 	  int jr=j-s*nelectrons(0);
@@ -474,6 +813,7 @@ void Backflow_wf::calcLap(Sample_point * sample)
       doublevar lap=0;
       if(detVal(det,0)*detVal(det,1)!=0){
 	for(int j=0; j< tote; j++) { 
+          if(!neighbor(j,i)) continue;
 	  int s=spin(j);
 	  Array3 <doublevar> & fref(F(det,s));
 	  int jr=j-s*nelectrons(0);
@@ -490,8 +830,10 @@ void Backflow_wf::calcLap(Sample_point * sample)
 	  Array3 <doublevar> & fref(F(det,s));
 	  for(int jr=0; jr < nelectrons(s); jr++) { 
 	    int j=jr+s*nelectrons(0);
+            if(!neighbor(j,i)) continue;
 	    for(int kr=0; kr < nelectrons(s); kr++) { 
 	      int k=kr+s*nelectrons(0);
+              if(!neighbor(k,i)) continue;
 	      for(int a=0; a< ndim; a++) { 
 		for(int b=0; b< ndim; b++) { 
 		  for(int g=0; g< ndim; g++) { 
@@ -519,6 +861,7 @@ void Backflow_wf::calcLap(Sample_point * sample)
 	  Array2 <doublevar> & invref(inverse(det,s));
 	  for(int jr=0; jr < nelectrons(s); jr++) { 
 	    int j=jr+s*nelectrons(0);
+            if(!neighbor(j,i)) continue;
 	    for(int mr=0; mr < nelectrons(s); mr++) { 
 	      int m=mr+s*nelectrons(0);
 	      int occ=parent->occupation(det,s)(mr);
@@ -10,6 +10,7 @@
 #include "Array.h"
 #include "Wavefunction.h"
 #include "Jastrow2_wf.h"
+#include "MO_matrix.h"
 class Wavefunction_data;
 class Backflow_wf_data;
 class System;
@@ -25,7 +26,12 @@ private:
 
    Array2 <doublevar> gradlap;
   Array2 <doublevar> detVal;
-
+  Array3 <doublevar> moVal;
+  Array2 < Array2 <doublevar> > inverse;
+  Array4 <doublevar> coor_grad;
+  Array3 <doublevar> coor_lap;
+  Array2 <int> neighbor;
+  Array1 <int> rowIsStaleLap;
 };
 
 
@@ -41,7 +47,11 @@ class Backflow_wf : public  Wavefunction
 public:
 
   Backflow_wf()
-  {}
+  { temp_samp=NULL; }
+
+  ~Backflow_wf() { 
+    if(temp_samp) delete temp_samp;
+  }
 
 
   virtual int nfunc() {
@@ -70,6 +80,12 @@ public:
 			       int, 
 			       Wf_return &);
 
+  virtual void evalTestPos(Array1 <doublevar> & pos, Sample_point *, 
+                           Array1 <Wf_return> & wf);
+  virtual void testRatios(Wavefunction_data *, Sample_point *, int e,
+                          const Array2 <doublevar> & pos, 
+                          Array1 <Wf_return> & ratio);
+
   void generateStorage(Wavefunction_storage * & wfstore);
 
 
@@ -81,7 +97,18 @@ private:
 
   void calcVal(Sample_point *);
   void calcLap(Sample_point *);
-  void updateVal(int e, Sample_point *);
+  void updateRowVal(Sample_point *, const Array3 <doublevar> & jast_corr,
+                    const Array3 <doublevar> & onebody, int e);
+  void updateRowLap(Sample_point *, const Array3 <doublevar> & jast_corr,
+                    const Array3 <doublevar> & onebody, int e);
+  void setNeighbors(const Array3 <doublevar> & jast_corr);
+  void findNeededPairs(Array2 <int> & needed, Array1 <int> & nneeded);
+  int findStaleRows(const Array3 <doublevar> & jast_corr, Array1 <int> & rows);
+  void invertDeterminant(int det, int s);
+  void updateInverses(const Array1 <int> & rows, int nrows);
+  void calcGradLap();
+  //! The value of the wave function with electron e moved to pos
+  doublevar testValue(Sample_point *, int e, const Array1 <doublevar> & pos);
   Array1 <int> electronIsStaleVal;
   Array1 <int> electronIsStaleLap;
   int updateEverythingVal;
@@ -94,6 +121,8 @@ private:
   //Saved variables for electron updates
   Array3 <doublevar>  moVal;//(electron,mo,[val grad hess])
   Array2 <doublevar> updatedMoVal;//(mo,[val grad hess])
+  Sample_point * temp_samp; //!< backflow coordinates for the orbitals
+  MO_workspace <doublevar> mo_ws;
   Array2 < Array2 <doublevar> > inverse;
   //!<inverse of the value part of the mo_values array transposed
   //(det,spin)(elec,elec)
@@ -118,6 +147,13 @@ private:
   Array2 <doublevar> gradlap;
   //!< (elec,[grad lap])
 
+  Array2 <int> neighbor;
+  //!< (i,j) is 1 if the quasi-particle coordinate of i depends on the 
+  //position of j or the other way around.  Symmetric, and 1 on the diagonal.
+  Array1 <int> rowIsStaleLap;
+  //!< quasi-particles that updateVal() moved, but whose derivatives 
+  //haven't been redone
+
 
   int nmo;        //!<Number of molecular orbitals
   int ndet;       //!<Number of determinants
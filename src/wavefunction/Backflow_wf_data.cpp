@@ -11,9 +11,9 @@
 
 void backflow_config(Sample_point * sample, 
 		     int e,
-		     Array3 <doublevar> & corr,
-		     Array3 <doublevar> & onebody,
-		     Array3 <doublevar> & threebody_diffspin,
+		     const Array3 <doublevar> & corr,
+		     const Array3 <doublevar> & onebody,
+		     const Array3 <doublevar> & threebody_diffspin,
 		     Sample_point * temp_samp) {
   //cout << "bfconfig " << endl;
   int nelectrons=sample->electronSize();
@@ -127,48 +127,62 @@ void Backflow_wrapper::updateVal(Sample_point * sample,
 				 Jastrow2_wf & jast,
 				 int e,
 				 int listnum, 
-				 Array2 <doublevar> & newvals) { 
+				 Array2 <doublevar> & newvals,
+				 Sample_point * temp_samp,
+				 MO_workspace <doublevar> & ws) { 
 
-  int nelectrons=sample->electronSize();
   Array3<doublevar> jast_corr;
   jast.updateVal(&jdata,sample);
   jast.get_twobody(jast_corr);
   Array3 <doublevar> onebody;
   jast.get_onebody(onebody);
+  updateVal(sample,jast_corr,onebody,e,listnum,newvals,temp_samp,ws);
+}
+
+void Backflow_wrapper::updateVal(Sample_point * sample, 
+				 const Array3 <doublevar> & jast_corr,
+				 const Array3 <doublevar> & onebody,
+				 int e,
+				 int listnum, 
+				 Array2 <doublevar> & newvals,
+				 Sample_point * temp_samp,
+				 MO_workspace <doublevar> & ws) { 
   //start: added for ei back-flow
   Array3 <doublevar> threebody_diffspin;
   updateValjastgroup(sample,e,threebody_diffspin);
   //end: added for ei back-flow
   backflow_config(sample,e,jast_corr,onebody,threebody_diffspin,temp_samp);
   temp_samp->updateEIDist();
-  molecorb->updateVal(temp_samp,0,listnum,newvals);
+  molecorb->updateVal(temp_samp,0,listnum,newvals,ws);
 }
 
-void Backflow_wrapper::getNeighbors(Sample_point * sample,
-				    Jastrow2_wf & jast, 
+void Backflow_wrapper::getNeighbors(const Array3 <doublevar> & jast_corr,
 				    int e, Array1 <int> & list, 
 				    int & nlist) {
 
-  //needs to be changed in the future
-  //does not check for neighbors of ei back-flow term: threebody_diffspin.
-  //which in principle is using different ee, ei basis.
-  nlist=0;
-  int nelectrons=sample->electronSize();
+  //the ei back-flow term (threebody_diffspin) moves every electron
+  //with every other one
+  int nelectrons=jast_corr.GetDim(0);
   list.Resize(nelectrons);
-  Array3 <doublevar> jast_corr;
-  jast.updateLap(&jdata,sample);
-  jast.get_twobody(jast_corr);
-  doublevar threshold=1e-10;
-  for(int j=0; j< 3; j++) { 
-    if(fabs(jast_corr(j,e,0)) > threshold) { 
+  nlist=0;
+  if(has_electron_ion_bf) { 
+    for(int j=0; j< nelectrons; j++) 
       list(nlist++)=j;
-    }
+    return;
   }
-  list(nlist++)=e;
-  for(int k=e+1; k< nelectrons; k++) { 
-    if(fabs(jast_corr(e,k,0)) > threshold) { 
-      list(nlist++)=k;
+
+  //Only the value is updated by Jastrow2_wf::updateVal(), so a stale 
+  //derivative can add a neighbor, but never lose one.  Outside the 
+  //cutoffs all of them are exactly zero.
+  for(int j=0; j< nelectrons; j++) { 
+    if(j==e) { 
+      list(nlist++)=e;
+      continue;
     }
+    int isnear=jast_corr(min(j,e),max(j,e),0)!=0.0;
+    for(int d=1; d< 5; d++) 
+      isnear=isnear || jast_corr(j,e,d)!=0.0 || jast_corr(e,j,d)!=0.0;
+    if(isnear) list(nlist++)=j;
   }
 }
 
@@ -181,19 +195,37 @@ void Backflow_wrapper::updateLap(Sample_point * sample,
 				 //!<(mo,[val,grad,hess])
 				 Array3 <doublevar>& coor_deriv, 
 				 //!< (i,alpha,beta)
-				 Array2 <doublevar> & coor_laplacian 
+				 Array2 <doublevar> & coor_laplacian, 
 				 //!< (i,alpha)
+				 Sample_point * temp_samp,
+				 MO_workspace <doublevar> & ws
 				 ) { 
 
-  //cout << "Backflow_wrapper: updateLap " << endl;
-  int nelectrons=sample->electronSize();
-  int natoms=sample->ionSize();
-  
   Array3 <doublevar> jast_corr;
   jast.updateLap(&jdata,sample);
   jast.get_twobody(jast_corr);
   Array3 <doublevar> onebody;
   jast.get_onebody(onebody);
+  updateLap(sample,jast_corr,onebody,e,listnum,newvals,coor_deriv,
+            coor_laplacian,temp_samp,ws);
+}
+
+void Backflow_wrapper::updateLap(Sample_point * sample, 
+				 const Array3 <doublevar> & jast_corr,
+				 const Array3 <doublevar> & onebody,
+				 int e, 
+				 int listnum, 
+				 Array2 <doublevar> & newvals, 
+				 Array3 <doublevar>& coor_deriv, 
+				 Array2 <doublevar> & coor_laplacian, 
+				 Sample_point * temp_samp,
+				 MO_workspace <doublevar> & ws
+				 ) { 
+
+  //cout << "Backflow_wrapper: updateLap " << endl;
+  int nelectrons=sample->electronSize();
+  int natoms=sample->ionSize();
+  
   //start: added for ei back-flow
   Array3 <doublevar> threebody_diffspin;
   updateLapjastgroup(sample,e,threebody_diffspin);
@@ -206,7 +238,7 @@ void Backflow_wrapper::updateLap(Sample_point * sample,
   //cout <<"xyz: "<<tmp_pos(0)<<",  "<<tmp_pos(1)<<",  "<<tmp_pos(2)<<endl;
 
   temp_samp->updateEIDist();
-  molecorb->updateHessian(temp_samp,0,listnum,newvals);
+  molecorb->updateHessian(temp_samp,0,listnum,newvals,ws);
  
   coor_deriv.Resize(nelectrons,3,3);
   coor_laplacian.Resize(nelectrons,3);
@@ -365,7 +397,7 @@ void Backflow_wrapper::init(System * sys,
   //allocate(mowords,sys, molecorb);
 
   molecorb->buildLists(totoccupation);
-  sys->generateSample(temp_samp);
+  this->sys=sys;
 
   vector <string> jwords;
   if(!readsection(words,pos=0,jwords, "EE_BF"))
@@ -656,6 +688,8 @@ int Backflow_wf_data::supports(wf_support_type support) {
     return 0;
   case parameter_derivatives:
     return 0;
+  case test_ratios:
+    return 1;
   default:
     return 0;
   }
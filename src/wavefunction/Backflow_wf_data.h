@@ -15,13 +15,36 @@
 
 class Backflow_wrapper {
  public:
+  /*!
+    temp_samp (from generateSample()) and ws are scratch space owned by
+    the calling wave function, so the wrapper can be shared by threads.
+   */
   void updateVal(Sample_point * sample, Jastrow2_wf & jast,int e, 
-		 int listnum, Array2 <doublevar> & newvals);
+		 int listnum, Array2 <doublevar> & newvals,
+		 Sample_point * temp_samp, MO_workspace <doublevar> & ws);
   //first index is mo#, then derivatives
   void updateLap(Sample_point * sample, Jastrow2_wf & jast,int e, 
 		 int listnum, Array2 <doublevar> & newvals, //!<(mo,[val,grad,hess])
 		 Array3 <doublevar>& coor_deriv, //!< (i,alpha,beta)
-		 Array2 <doublevar> & coor_laplacian //!< (i,alpha)
+		 Array2 <doublevar> & coor_laplacian, //!< (i,alpha)
+		 Sample_point * temp_samp, MO_workspace <doublevar> & ws
+		 );
+
+  /*!
+    The same as above, but with the correlation functions already taken
+    from jast with get_twobody() and get_onebody(), so that the quasi-particle
+    coordinates of several electrons can be built from one copy.
+   */
+  void updateVal(Sample_point * sample, const Array3 <doublevar> & jast_corr,
+                 const Array3 <doublevar> & onebody, int e, 
+		 int listnum, Array2 <doublevar> & newvals,
+		 Sample_point * temp_samp, MO_workspace <doublevar> & ws);
+  void updateLap(Sample_point * sample, const Array3 <doublevar> & jast_corr,
+                 const Array3 <doublevar> & onebody, int e, 
+		 int listnum, Array2 <doublevar> & newvals,
+		 Array3 <doublevar>& coor_deriv, 
+		 Array2 <doublevar> & coor_laplacian,
+		 Sample_point * temp_samp, MO_workspace <doublevar> & ws
 		 );
 
   //start: added for ei back-flow
@@ -49,17 +72,26 @@ class Backflow_wrapper {
   int nmo(){ return molecorb->getNmo(); } 
   void showinfo(ostream & os);
   void writeinput(string & indent, ostream & os);
+  //! Make a sample to hold the backflow coordinates of one electron
+  void generateSample(Sample_point *& samp) { 
+    assert(sys!=NULL);
+    sys->generateSample(samp);
+  }
   ~Backflow_wrapper() { 
-    if(temp_samp != NULL) delete temp_samp;
     if(molecorb != NULL) delete molecorb;
   }
   Backflow_wrapper() { 
-    temp_samp=NULL;
+    sys=NULL;
     molecorb=NULL;
   }
 
-  void getNeighbors(Sample_point * sample,
-		    Jastrow2_wf & jast,
+  /*!
+    The electrons whose quasi-particle coordinates depend on the position
+    of e, and so the ones whose coordinates e depends on, including e itself.
+    jast_corr is from Jastrow2_wf::get_twobody().  With electron-ion 
+    backflow every electron is a neighbor.
+   */
+  void getNeighbors(const Array3 <doublevar> & jast_corr,
 		    int e, Array1 <int> & list,
 		    int & nlist);
 
@@ -70,16 +102,16 @@ class Backflow_wrapper {
   int has_electron_ion_bf;
   //end: added for ei back-flow
  private:
-  Sample_point * temp_samp;
+  System * sys;
   MO_matrix * molecorb;
 
   
 };
 void backflow_config(Sample_point * sample, 
 		     int e,
-		     Array3 <doublevar> & corr,
-		     Array3 <doublevar> & onebody,
-		     Array3 <doublevar> & threebody_diffspin,
+		     const Array3 <doublevar> & corr,
+		     const Array3 <doublevar> & onebody,
+		     const Array3 <doublevar> & threebody_diffspin,
 		     Sample_point * temp_samp);
 
 //######################################################################
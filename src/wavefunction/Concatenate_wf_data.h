@@ -15,6 +15,7 @@ public:
   }
 
   int supports(wf_support_type support){
+    if(support==move_proposal || support==test_ratios) return 0;
     for(int i=0;i<wf_datas.size();i++){
       if(!wf_datas[i]->supports(support))
         return 0;
@@ -0,0 +1,399 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef DELAYED_INVERSE_H_INCLUDED
+#define DELAYED_INVERSE_H_INCLUDED
+
+#include "Qmc_std.h"
+#include "Array.h"
+#include "MatrixAlgebra.h"
+
+//----------------------------------------------------------------------
+
+/*!
+\brief
+Delayed Sherman-Morrison updates of a determinant inverse.
+
+Slat_wf keeps the inverse \f$ A^{-1} \f$ of the matrix whose columns are
+the orbitals evaluated at each electron.  Instead of a rank-1 update for
+every accepted move, up to nmax moves are held here as the new columns C
+and the electrons E that they replace.  The current inverse is then
+\f[ A'^{-1}=A^{-1}-(A^{-1}C-E) S^{-1} E^T A^{-1}, \quad S=E^TA^{-1}C \f]
+so ratios only need the stale inverse and the small matrix S.  When the
+list is full, flush() folds the moves into the inverse with matrix-matrix
+products, which run much closer to peak than the rank-1 updates.
+
+Any code that changes the stored inverse other than through update()
+must call reset().
+*/
+template <class T> class Delayed_inverse {
+ public:
+  Delayed_inverse():nmax(1),n(0),npending(0),nchanges(0) { }
+
+  //! Hold up to nmax_ moves for an n_ by n_ matrix
+  void init(int nmax_, int n_) {
+    nmax=max(nmax_,1);
+    n=n_;
+    npending=0;
+    cols.Resize(nmax);
+    slot.Resize(n);
+    slot=-1;
+    newcols.Resize(nmax,n);
+    sinv.Resize(nmax,nmax);
+  }
+
+  int pending() const { return npending; }
+  //! How many more moves can be held before the inverse is updated
+  int room() const { return nmax-npending; }
+  //! Changes every time the stored inverse does
+  int changes() const { return nchanges; }
+
+  //! Forget the pending moves, after the inverse was recomputed
+  void reset() {
+    for(int a=0; a< npending; a++) slot(cols(a))=-1;
+    npending=0;
+    nchanges++;
+  }
+
+  /*!
+    Prepare a new column c so that ratio() can give
+    \f$ (A'^{-1}c)_e \f$ for any e in O(n).
+   */
+  void correctColumn(const Array2 <T> & inverse, const Array1 <T> & c,
+                     Array1 <T> & cc, Array1 <T> & y);
+
+  //! \f$ (A'^{-1}c)_e \f$, with cc and y from correctColumn()
+  T ratio(const Array2 <T> & inverse, const Array1 <T> & cc,
+          const Array1 <T> & y, int e) const {
+    T r=T(0.0);
+    for(int j=0; j< n; j++) r+=inverse(e,j)*cc(j);
+    if(slot(e) >= 0) r+=y(slot(e));
+    return r;
+  }
+
+  /*!
+    The ratio of determinants if column e were replaced by c,
+    which is also \f$ (A'^{-1}c)_e \f$ for the derivatives of c.
+   */
+  T getRatio(const Array2 <T> & inverse, const Array1 <T> & c, int e) {
+    correctColumn(inverse,c,work_cc,work_y);
+    return ratio(inverse,work_cc,work_y,e);
+  }
+
+  /*!
+    Replace column e with c, and return the ratio of the new determinant
+    to the old one.  The inverse is only changed if there is no room left.
+   */
+  T update(Array2 <T> & inverse, const Array1 <T> & c, int e);
+
+  //! Apply all the pending moves to the inverse
+  void flush(Array2 <T> & inverse);
+
+ private:
+  int nmax, n, npending;
+  int nchanges;
+  Array1 <int> cols;   //!< (pending) electron of each move
+  Array1 <int> slot;   //!< (electron) its pending move, or -1
+  Array2 <T> newcols;  //!< (pending, orbital) the new columns C
+  //! inverse of S(a,b)=(row cols(a) of the inverse).(newcols(b)), kept 
+  //! up to date as moves are added, so it's never factorized.
+  Array2 <T> sinv;
+  Array1 <T> work_q, work_c, work_w, work_cc, work_y;
+};
+
+//----------------------------------------------------------------------
+
+template <class T> inline void Delayed_inverse<T>::correctColumn(
+    const Array2 <T> & inverse, const Array1 <T> & c,
+    Array1 <T> & cc, Array1 <T> & y) {
+  cc.Resize(n);
+  y.Resize(npending);
+  //q=E^T A^{-1} c, y=S^{-1} q, cc=c-C y
+  Array1 <T> & q(work_q);
+  q.Resize(npending);
+  for(int b=0; b< npending; b++) {
+    q(b)=T(0.0);
+    for(int j=0; j< n; j++) q(b)+=inverse(cols(b),j)*c(j);
+  }
+  for(int a=0; a< npending; a++) {
+    y(a)=T(0.0);
+    for(int b=0; b< npending; b++) y(a)+=sinv(a,b)*q(b);
+  }
+  for(int j=0; j< n; j++) cc(j)=c(j);
+  for(int a=0; a< npending; a++) {
+    for(int j=0; j< n; j++) cc(j)-=y(a)*newcols(a,j);
+  }
+}
+
+//----------------------------------------------------------------------
+
+template <class T> inline T Delayed_inverse<T>::update(Array2 <T> & inverse,
+    const Array1 <T> & c, int e) {
+  int a=slot(e);
+  if(a < 0 && npending==nmax) flush(inverse);
+  Array1 <T> & y(work_y);
+  correctColumn(inverse,c,work_cc,y);
+  T r=ratio(inverse,work_cc,y,e);
+  
+  if(a >= 0) {
+    //The electron already has a move: column a of S becomes q, and 
+    //S^{-1} gets a rank-1 update.
+    T ya=y(a);
+    Array1 <T> & rowa(work_w);
+    rowa.Resize(npending);
+    for(int j=0; j< npending; j++) rowa(j)=sinv(a,j);
+    for(int i=0; i< npending; i++) {
+      T f=(i==a?y(i)-T(1.0):y(i))/ya;
+      for(int j=0; j< npending; j++) sinv(i,j)-=f*rowa(j);
+    }
+  }
+  else {
+    //S grows by the column q, the row cvec, and d=inverse(e,:).c; the
+    //inverse of the bordered matrix needs z=S^{-1}q=y, w=cvec S^{-1}, and
+    //d-cvec.z, which is the ratio r.
+    a=npending;
+    Array1 <T> & cvec(work_c);
+    cvec.Resize(a);
+    for(int b=0; b< a; b++) {
+      cvec(b)=T(0.0);
+      for(int j=0; j< n; j++) cvec(b)+=inverse(e,j)*newcols(b,j);
+    }
+    Array1 <T> & w(work_w);
+    w.Resize(a);
+    for(int j=0; j< a; j++) {
+      w(j)=T(0.0);
+      for(int b=0; b< a; b++) w(j)+=cvec(b)*sinv(b,j);
+    }
+    T rinv=T(1.0)/r;
+    for(int i=0; i< a; i++) {
+      for(int j=0; j< a; j++) sinv(i,j)+=y(i)*w(j)*rinv;
+      sinv(i,a)=-y(i)*rinv;
+      sinv(a,i)=-w(i)*rinv;
+    }
+    sinv(a,a)=rinv;
+    cols(a)=e;
+    slot(e)=a;
+    npending++;
+  }
+  for(int j=0; j< n; j++) newcols(a,j)=c(j);
+  return r;
+}
+
+//----------------------------------------------------------------------
+
+template <class T> inline void Delayed_inverse<T>::flush(Array2 <T> & inverse) {
+  if(npending==0) return;
+  int k=npending;
+  int ld=inverse.GetDim(1);
+  //X=A^{-1}C-E
+  Array2 <T> X(n,k);
+  gemm_rowmajor(1,n,k,n,T(1.0),inverse.v,ld,newcols.v,n,T(0.0),X.v,k);
+  for(int a=0; a< k; a++) X(cols(a),a)-=T(1.0);
+  //W=X S^{-1}
+  Array2 <T> W(n,k);
+  gemm_rowmajor(0,n,k,k,T(1.0),X.v,k,sinv.v,nmax,T(0.0),W.v,k);
+  //A^{-1} -= W E^T A^{-1}
+  Array2 <T> R(k,n);
+  for(int b=0; b< k; b++)
+    for(int j=0; j< n; j++) R(b,j)=inverse(cols(b),j);
+  gemm_rowmajor(0,n,n,k,T(-1.0),W.v,k,R.v,n,T(1.0),inverse.v,ld);
+  reset();
+}
+
+//----------------------------------------------------------------------
+
+/*!
+\brief
+Delayed updates of the inverse of a skew-symmetric Pfaffian matrix.
+
+Moving electron e replaces row e of the matrix A by r and column e by 
+\f$ -r \f$, which is \f$ A+e_eu^T-ue_e^T \f$ with u the change in the row.
+After k moves, \f$ A'=A+XCX^T \f$, where X holds the pairs \f$ (e_e,u) \f$
+and C is block diagonal with blocks \f$ ((0,1),(-1,0)) \f$.  With 
+\f$ W=A^{-1}X \f$ and \f$ S=C^{-1}+X^TW \f$, 
+\f[ A'^{-1}=A^{-1}+WS^{-1}W^T, \f]
+so a column of the current inverse costs O(nk) and the Pfaffian ratio for
+a new row is its dot product with that column.  Each move still needs one
+matrix-vector product for \f$ A^{-1}u \f$, but the inverse is only written
+in flush(), with one matrix-matrix product.
+
+update() keeps the matrix itself up to date, since u needs the old row.
+Any code that changes the stored inverse other than through update() must
+call reset().
+*/
+class Delayed_pfaffian_inverse {
+ public:
+  Delayed_pfaffian_inverse():nmax(1),n(0),npending(0),nchanges(0) { }
+
+  //! Hold up to nmax_ moves for an n_ by n_ matrix
+  void init(int nmax_, int n_) {
+    nmax=max(nmax_,1);
+    n=n_;
+    npending=0;
+    W.Resize(n,2*nmax);
+    smat.Resize(2*nmax,2*nmax);
+    sinv.Resize(2*nmax,2*nmax);
+  }
+
+  int pending() const { return npending; }
+  //! How many more moves can be held before the inverse is updated
+  int room() const { return nmax-npending; }
+  //! Changes every time the stored inverse does
+  int changes() const { return nchanges; }
+
+  //! Forget the pending moves, after the inverse was recomputed
+  void reset() {
+    npending=0;
+    nchanges++;
+  }
+
+  //! Column e of the current inverse
+  void column(const Array2 <doublevar> & inverse, int e, 
+              Array1 <doublevar> & col);
+
+  //! The ratio of Pfaffians if row e were replaced by row
+  doublevar getRatio(const Array2 <doublevar> & inverse, 
+                     const Array1 <doublevar> & row, int e) {
+    column(inverse,e,work_col);
+    doublevar r=0.0;
+    for(int j=0; j< n; j++) r+=row(j)*work_col(j);
+    return r;
+  }
+
+  /*!
+    Replace row e of mat with row and column e with -row, and return the
+    ratio of the new Pfaffian to the old one.  The inverse is only changed
+    if there is no room left.
+   */
+  doublevar update(Array2 <doublevar> & inverse, Array2 <doublevar> & mat,
+                   const Array1 <doublevar> & row, int e);
+
+  //! Apply all the pending moves to the inverse
+  void flush(Array2 <doublevar> & inverse);
+
+ private:
+  int nmax, n, npending;
+  int nchanges;
+  Array2 <doublevar> W;    //!< (row, 2*move) \f$ A^{-1}X \f$
+  Array2 <doublevar> smat; //!< S
+  Array2 <doublevar> sinv; //!< its inverse
+  Array1 <doublevar> work_col, work_t, work_u;
+};
+
+//----------------------------------------------------------------------
+
+inline void Delayed_pfaffian_inverse::column(const Array2 <doublevar> & inverse,
+                                             int e, Array1 <doublevar> & col) {
+  int k=2*npending;
+  col.Resize(n);
+  //The inverse is skew-symmetric, so its column e is minus row e
+  for(int j=0; j< n; j++) col(j)=-inverse(e,j);
+  if(k==0) return;
+  Array1 <doublevar> & t(work_t);
+  t.Resize(k);
+  for(int p=0; p< k; p++) {
+    t(p)=0.0;
+    for(int q=0; q< k; q++) t(p)+=sinv(p,q)*W(e,q);
+  }
+  for(int j=0; j< n; j++) {
+    doublevar sum=0.0;
+    for(int p=0; p< k; p++) sum+=W(j,p)*t(p);
+    col(j)+=sum;
+  }
+}
+
+//----------------------------------------------------------------------
+
+inline doublevar Delayed_pfaffian_inverse::update(Array2 <doublevar> & inverse,
+    Array2 <doublevar> & mat, const Array1 <doublevar> & row, int e) {
+  if(npending==nmax) flush(inverse);
+  doublevar r=getRatio(inverse,row,e);
+
+  Array1 <doublevar> & u(work_u);
+  u.Resize(n);
+  for(int j=0; j< n; j++) {
+    u(j)=row(j)-mat(e,j);
+    mat(e,j)=row(j);
+    mat(j,e)=-row(j);
+  }
+  u(e)=0.0;
+  mat(e,e)=0.0;
+
+  if(r==0.0) { 
+    //S would be singular; do what UpdateInversePfaffianMatrix() does
+    flush(inverse);
+    Array1 <doublevar> rowcopy(row), column(n);
+    return UpdateInversePfaffianMatrix(inverse,rowcopy,column,e);
+  }
+
+  //New columns of W: A^{-1}e_e and A^{-1}u
+  int a=2*npending, b=a+1;
+  int ld=inverse.GetDim(1);
+  for(int j=0; j< n; j++) W(j,a)=-inverse(e,j);
+#ifdef USE_BLAS
+  cblas_dgemv(CblasRowMajor,CblasNoTrans,n,n,1.0,inverse.v,ld,u.v,1,
+              0.0,W.v+b,2*nmax);
+#else
+  for(int i=0; i< n; i++) {
+    doublevar sum=0.0;
+    const doublevar * invi=inverse.v+i*ld;
+    for(int j=0; j< n; j++) sum+=invi[j]*u(j);
+    W(i,b)=sum;
+  }
+#endif
+
+  //S=C^{-1}+X^TW is skew-symmetric; fill in the new rows and columns
+  for(int q=0; q<= b; q++) {
+    doublevar sb=0.0;
+    for(int j=0; j< n; j++) sb+=u(j)*W(j,q);
+    smat(a,q)=W(e,q);
+    smat(b,q)=sb;
+    smat(q,a)=-smat(a,q);
+    smat(q,b)=-sb;
+  }
+  smat(a,a)=smat(b,b)=0.0;
+  smat(a,b)-=1.0;
+  smat(b,a)+=1.0;
+  npending++;
+  int k=2*npending;
+  Array2 <doublevar> stmp(k,k), sinvtmp(k,k);
+  for(int p=0; p< k; p++)
+    for(int q=0; q< k; q++) stmp(p,q)=smat(p,q);
+  InvertMatrix(stmp,sinvtmp,k);
+  for(int p=0; p< k; p++)
+    for(int q=0; q< k; q++) sinv(p,q)=sinvtmp(p,q);
+  return r;
+}
+
+//----------------------------------------------------------------------
+
+inline void Delayed_pfaffian_inverse::flush(Array2 <doublevar> & inverse) {
+  if(npending==0) return;
+  int k=2*npending;
+  int ld=inverse.GetDim(1);
+  //A^{-1} += (W S^{-1}) W^T
+  Array2 <doublevar> Z(n,k);
+  gemm_rowmajor(0,n,k,k,1.0,W.v,2*nmax,sinv.v,2*nmax,0.0,Z.v,k);
+  gemm_rowmajor(1,n,n,k,1.0,Z.v,k,W.v,2*nmax,1.0,inverse.v,ld);
+  reset();
+}
+
+#endif //DELAYED_INVERSE_H_INCLUDED
+//----------------------------------------------------------------------
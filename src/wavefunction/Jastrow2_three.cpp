@@ -24,6 +24,150 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "Sample_point.h"
 #include "Jastrow2_three.h"
 #include "Jastrow2_one.h"
+#include "MatrixAlgebra.h"
+
+//--------------------------------------------------------  
+
+void Jastrow_threebody_matrices::set(const Array2 <doublevar> & parms, 
+                                     const Array1 <int> & nparms,
+                                     const Array2 <int> & klm, int nee) {
+  int np=parms.GetDim(0);
+  nbasis.Resize(np);
+  nbasis=0;
+  int maxb=0;
+  for(int p=0; p< np; p++) { 
+    for(int i=0; i< nparms(p); i++) { 
+      if(nbasis(p) <= klm(i,0)) nbasis(p)=klm(i,0)+1;
+      if(nbasis(p) <= klm(i,1)) nbasis(p)=klm(i,1)+1;
+    }
+    if(maxb < nbasis(p)) maxb=nbasis(p);
+  }
+  coeff.Resize(np,maxb,maxb,nee);
+  coeff=0.0;
+  for(int p=0; p< np; p++) { 
+    for(int i=0; i< nparms(p); i++) { 
+      int k=klm(i,0), l=klm(i,1), m=klm(i,2);
+      coeff(p,k,l,m)+=parms(p,i);
+      coeff(p,l,k,m)+=parms(p,i);
+    }
+  }
+}
+
+//--------------------------------------------------------  
+
+/*!
+Find the atoms where the e-i basis of e isn't zero, and fill
+W(d,m,q)=sum_k a_{at,k}(r_e,d) C_p(k,l,m) for d < nd, where the column q
+is the basis function l on atom at.  Returns the number of columns.
+*/
+int Jastrow_threebody_matrices::nearBasis(int e, int nd, 
+    const Array1 <int> & parm_centers, const Array4 <doublevar> & eibasis, 
+    Array1 <int> & atq, Array1 <int> & lq, Array3 <doublevar> & W) const { 
+  const doublevar tiny=1e-14;
+  int natoms=parm_centers.GetDim(0);
+  int nee=coeff.GetDim(3);
+  int nq=0;
+  atq.Resize(eibasis.GetDim(1)*eibasis.GetDim(2));
+  lq.Resize(atq.GetDim(0));
+  for(int at=0; at< natoms; at++) { 
+    int p=parm_centers(at);
+    bool near=false;
+    for(int l=0; l< nbasis(p); l++) 
+      if(fabs(eibasis(e,at,l,0)) > tiny) near=true;
+    if(!near) continue;
+    for(int l=0; l< nbasis(p); l++) { 
+      atq(nq)=at;
+      lq(nq++)=l;
+    }
+  }
+  W.Resize(nd,nee,nq);
+  for(int q=0; q< nq; q++) { 
+    int at=atq(q), l=lq(q), p=parm_centers(at);
+    for(int d=0; d< nd; d++) { 
+      for(int m=0; m< nee; m++) { 
+        doublevar sum=0;
+        for(int k=0; k< nbasis(p); k++) 
+          sum+=eibasis(e,at,k,d)*coeff(p,k,l,m);
+        W(d,m,q)=sum;
+      }
+    }
+  }
+  return nq;
+}
+
+//--------------------------------------------------------  
+
+void Jastrow_threebody_matrices::updateVal(int e, int j0, int j1,
+    const Array1 <int> & parm_centers, const Array4 <doublevar> & eibasis,
+    const Array3 <doublevar> & eebasis, Array1 <doublevar> & val) const { 
+  int n=j1-j0;
+  int nee=coeff.GetDim(3);
+  Array1 <int> atq, lq;
+  Array3 <doublevar> W;
+  int nq=nearBasis(e,1,parm_centers,eibasis,atq,lq,W);
+  if(nq==0 || n <= 0) return;
+
+  Array2 <doublevar> A(nq,n);
+  for(int q=0; q< nq; q++) 
+    for(int j=0; j< n; j++) A(q,j)=eibasis(j0+j,atq(q),lq(q),0);
+
+  //X(m,j)=sum_q W(m,q) a_q(r_j)
+  Array2 <doublevar> X(nee,n);
+  gemm_rowmajor(0,nee,n,nq,1.0,W.v,nq,A.v,n,0.0,X.v,n);
+  for(int j=0; j< n; j++) { 
+    if(j0+j==e) continue;
+    for(int m=0; m< nee; m++) 
+      val(j0+j)+=X(m,j)*eebasis(j0+j,m,0);
+  }
+}
+
+//--------------------------------------------------------  
+
+/*!
+The same as eval_threebody_derivative(), summed over the terms.  The
+derivatives with respect to r_e of the e-i part are X(d,m,j)=W(d,m)a(r_j),
+and the ones with respect to r_j are Y(m,d,j)=W(0,m)a(r_j,d).
+*/
+void Jastrow_threebody_matrices::updateLap(int e, int j0, int j1,
+    const Array1 <int> & parm_centers, const Array4 <doublevar> & eibasis,
+    const Array3 <doublevar> & eebasis, Array3 <doublevar> & lap) const { 
+  int n=j1-j0;
+  int nee=coeff.GetDim(3);
+  Array1 <int> atq, lq;
+  Array3 <doublevar> W;
+  int nq=nearBasis(e,5,parm_centers,eibasis,atq,lq,W);
+  if(nq==0 || n <= 0) return;
+
+  Array3 <doublevar> A(nq,5,n);
+  for(int q=0; q< nq; q++) 
+    for(int d=0; d< 5; d++) 
+      for(int j=0; j< n; j++) A(q,d,j)=eibasis(j0+j,atq(q),lq(q),d);
+
+  Array3 <doublevar> X(5,nee,n), Y(nee,4,n);
+  gemm_rowmajor(0,5*nee,n,nq,1.0,W.v,nq,A.v,5*n,0.0,X.v,n);
+  gemm_rowmajor(0,nee,4*n,nq,1.0,W.v,nq,A.v+n,5*n,0.0,Y.v,4*n);
+
+  for(int j=0; j< n; j++) { 
+    int jj=j0+j;
+    if(jj==e) continue;
+    doublevar sign=jj > e?-1:1;
+    for(int m=0; m< nee; m++) { 
+      doublevar vkl=X(0,m,j);
+      doublevar ee0=eebasis(jj,m,0);
+      doublevar dot_e=0, dot_j=0;
+      lap(0,jj,0)+=vkl*ee0;
+      for(int d=1; d< 4; d++) { 
+        doublevar ee=eebasis(jj,m,d);
+        lap(0,jj,d)+=X(d,m,j)*ee0-sign*vkl*ee;
+        lap(1,jj,d)+=Y(m,d-1,j)*ee0+sign*vkl*ee;
+        dot_e+=X(d,m,j)*ee;
+        dot_j+=Y(m,d-1,j)*ee;
+      }
+      lap(0,jj,4)+=vkl*eebasis(jj,m,4)+X(4,m,j)*ee0-2*sign*dot_e;
+      lap(1,jj,4)+=vkl*eebasis(jj,m,4)+Y(m,3,j)*ee0+2*sign*dot_j;
+    }
+  }
+}
 
 //--------------------------------------------------------  
 
@@ -90,6 +234,7 @@ void Jastrow_threebody_piece::set_up(vector <string> & words,
   }
 
   freeze=haskeyword(words, pos=0, "FREEZE");
+  matrices.set(unique_parameters,_nparms,klm,eebasis_max);
 
 }
 //--------------------------------------------------------------------------
@@ -202,170 +347,12 @@ void Jastrow_threebody_piece::updateLap(int e,
                  const Array4 <doublevar> & eibasis,
                  const Array3 <doublevar> & eebasis,
                  Array3 <doublevar> & lap) {
-  //cout << "Jastrow_threebody_piece::updateLap" << endl;
   assert(lap.GetDim(2) >= 5);
   assert(lap.GetDim(0) >=2);
-  
   assert(eibasis.GetDim(1) >= parm_centers.GetDim(0));
-  int natoms=parm_centers.GetDim(0);
   int nelectrons=eebasis.GetDim(0);
   assert(lap.GetDim(1) >= nelectrons);
-  Array1 <doublevar> vkl_e(5); //derivative wrt e of a_e a_j + a_j a_e
-  Array1 <doublevar> vkl_j(5); //wrt j
-
-  const doublevar tiny=1e-14;
-  //cout << "updateLap " << endl;
-
-  //Find electrons with non-zero basis
-  int nelectrons_nonzero=0;
-  Array1 <int> electrons_nonzero(nelectrons);
-  for(int j=0; j< nelectrons; j++) { 
-    bool in_range=false;
-    for(int m=0; m < eebasis.GetDim(1); m++) { 
-      if(fabs(eebasis(j,m,0)) > tiny) {
-        in_range=true;
-      }
-    }
-    if(in_range and e!=j) {
-      electrons_nonzero(nelectrons_nonzero++)=j;
-    }
-  }
-  //cout << nelectrons << " " << nelectrons_nonzero << endl;
-
-
-  int ei_nb=eibasis.GetDim(2);
-  int ee_nb=eebasis.GetDim(1);
-  int nd=5;
-  //Scaling factors for the electron-ion basis
-  int ei_s1=eibasis.GetDim(1)*eibasis.GetDim(2)*eibasis.GetDim(3);
-  int ei_s2=eibasis.GetDim(2)*eibasis.GetDim(3);
-  int ei_s3=eibasis.GetDim(3);
-
-  for(int at=0; at < natoms; at++) {
-    int p=parm_centers(at);
-
-    for(int i=0; i< _nparms(p); i++) {
-      doublevar parm=unique_parameters(p,i);
-      int k=klm(i,0), el=klm(i,1), m=klm(i,2);
-      if(fabs(eibasis(e,at,k,0)) > tiny
-          || fabs(eibasis(e,at,el,0)) > tiny) { 
-        
-        //lap=0;
-        
-        for(int jj=0; jj< nelectrons_nonzero; jj++) {
-          int j=electrons_nonzero(jj);
-          double sign=1;
-          if( j> e) sign=-1;
-          eval_threebody_derivative(parm,
-              eibasis.v+ e*ei_s1 + at*ei_s2 + k *ei_s3,
-              eibasis.v+ e*ei_s1 + at*ei_s2 + el*ei_s3,
-              eibasis.v+ j*ei_s1 + at*ei_s2 + k *ei_s3,
-              eibasis.v+ j*ei_s1 + at*ei_s2 + el*ei_s3,
-              eebasis.v+ j*ee_nb*nd + m*nd,
-              sign,
-              lap.v+j*nd,
-              lap.v+nelectrons*nd+j*nd);
-        }
-        
-        
-
-        //for(int j=0; j < nelectrons; j++) { 
-        //  cout << "new lap ";
-        //  for(int d=0; d< 5; d++) 
-        //    cout << lap(0,j,d) << " ";
-        //  cout << endl;
-        //}
-        
-          
-//------------        
-      //lap=0;
-      
-        /*
-      for(int j=0; j< e; j++) { 
-        doublevar vkl=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-            +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-
-
-          for(int d=1; d< 5; d++) {
-            vkl_e[d]=parm*(eibasis(e,at,k,d)*eibasis(j,at,el,0)
-                +eibasis(j,at,k,0)*eibasis(e,at,el,d));
-            vkl_j[d]=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,d)
-                +eibasis(j,at,k,d)*eibasis(e,at,el,0));
-          } 
-          lap(0,j,0)+=vkl*eebasis(j,m,0);
-          doublevar dot_e=0, dot_j=0;
-          for(int d=1; d< 4; d++) {
-            lap(0,j,d)+=vkl_e[d]*eebasis(j,m,0);
-            lap(0,j,d)-=vkl*eebasis(j,m,d);
-            lap(1,j,d)+=vkl_j[d]*eebasis(j,m,0);
-            lap(1,j,d)+=vkl*eebasis(j,m,d);
-
-            dot_e+=vkl_e[d]*eebasis(j,m,d);
-            dot_j+=vkl_j[d]*eebasis(j,m,d);
-          }
-
-          //cout << "old: vkl " << vkl << endl;
-          //cout << "old: dot_e " << dot_e <<  "dot_j " << dot_j << endl;
-          
-
-          lap(0,j,4)+=vkl*eebasis(j,m,4);
-          lap(1,j,4)+=vkl*eebasis(j,m,4);
-
-          lap(0,j,4)+=vkl_e[4]*eebasis(j,m,0);
-          lap(1,j,4)+=vkl_j[4]*eebasis(j,m,0);
-
-          lap(0,j,4)-=2*dot_e;
-          lap(1,j,4)+=2*dot_j;
-        }
-        
-        
-        for(int j=e+1; j< nelectrons; j++) {
-          doublevar vkl=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-              +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-          for(int d=1; d< 5; d++) {
-            vkl_e[d]=parm*(eibasis(e,at,k,d)*eibasis(j,at,el,0)
-                +eibasis(j,at,k,0)*eibasis(e,at,el,d));
-            vkl_j[d]=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,d)
-                +eibasis(j,at,k,d)*eibasis(e,at,el,0));
-          } 
-
-          lap(0,j,0)+=vkl*eebasis(j,m,0);
-          doublevar dot_e=0, dot_j=0;
-          for(int d=1; d< 4; d++) {
-            lap(0,j,d)+=vkl_e[d]*eebasis(j,m,0);
-            lap(0,j,d)+=vkl*eebasis(j,m,d);
-            lap(1,j,d)+=vkl_j[d]*eebasis(j,m,0);
-            lap(1,j,d)-=vkl*eebasis(j,m,d);
-
-            dot_e+=vkl_e[d]*eebasis(j,m,d);
-            dot_j+=vkl_j[d]*eebasis(j,m,d);
-          }
-          //cout << "old: vkl " << vkl << endl;
-          //cout << "old: dot_e " << dot_e <<  "dot_j " << dot_j << endl;
-          
-          lap(0,j,4)+=vkl*eebasis(j,m,4);
-          lap(1,j,4)+=vkl*eebasis(j,m,4);
-
-          lap(0,j,4)+=vkl_e[4]*eebasis(j,m,0);
-          lap(1,j,4)+=vkl_j[4]*eebasis(j,m,0);
-
-          lap(0,j,4)+=2*dot_e;
-          lap(1,j,4)-=2*dot_j;
-        }
-      */
-        //for(int j=0; j < nelectrons; j++) { 
-        //  cout << "old lap ";
-        //  for(int d=0; d< 5; d++) 
-         //   cout << lap(0,j,d) << " ";
-         // cout << endl;
-        //}
-        
-        
-      }
-    }
-  }
-  
-  
+  matrices.updateLap(e,0,nelectrons,parm_centers,eibasis,eebasis,lap);
 }
 
 //-----------------------------------------------------------
@@ -373,37 +360,12 @@ void Jastrow_threebody_piece::updateVal(int e,
                                          const Array4 <doublevar> & eibasis,
                                          const Array3 <doublevar> & eebasis,
                                          Array1 <doublevar> & updated_val) {
-
   assert(eibasis.GetDim(1) >= parm_centers.GetDim(0));
-  int natoms=parm_centers.GetDim(0);
   int nelectrons=eebasis.GetDim(0);
-
-  const doublevar tiny=1e-14;
-  //cout << "updateLap " << endl;
-  for(int at=0; at < natoms; at++) {
-    int p=parm_centers(at);
-    for(int i=0; i< _nparms(p); i++) {
-      doublevar parm=unique_parameters(p,i);
-      int k=klm(i,0), el=klm(i,1), m=klm(i,2);
-      if(fabs(eibasis(e,at,k,0)) > tiny
-          || fabs(eibasis(e,at,el,0)) > tiny) { 
-        for(int j=0; j< e; j++) {
-
-          doublevar vkl=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-              +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-          updated_val(j)+=vkl*eebasis(j,m,0);
-        }
-        for(int j=e+1; j< nelectrons; j++) {
-          doublevar vkl=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-              +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-          updated_val(j)+=vkl*eebasis(j,m,0);
-        }
-      }
-    }
-  } 
+  matrices.updateVal(e,0,nelectrons,parm_centers,eibasis,eebasis,
+                     updated_val);
 }
 
-
 //-----------------------------------------------------------
 
 void Jastrow_threebody_piece::getParmDeriv(const Array3 <doublevar> & eibasis,
@@ -557,6 +519,7 @@ void Jastrow_threebody_piece::setParms(Array1 <doublevar> & parms) {
       //cout << "set one-body " << unique_parameters(i,j) << endl;
     }
   }
+  matrices.set(unique_parameters,_nparms,klm,eebasis_max);
 }
 
 //--------------------------------------------------------------------------
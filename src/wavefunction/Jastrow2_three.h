@@ -24,6 +24,49 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "Array45.h"
 #include "Jastrow2_one.h"
 
+/*!
+\brief
+The three-body sum for one electron as dense matrix products.
+
+The terms with the same e-e basis function m are gathered into
+C_p(k,l,m)=c_klm+c_lkm for each set p of atom coefficients, so that the
+sum for the pair (e,j) is
+
+  sum_m b_m(r_ej) sum_{at,l} W(m,at,l) a_{at,l}(r_j), with
+  W(m,at,l)=sum_k a_{at,k}(r_e) C_{p(at)}(k,l,m).
+
+W and its derivatives only depend on e, so the sums for all j are
+products of W with the matrix of e-i basis values of the other
+electrons.  Only the atoms within reach of e enter the products.
+*/
+class Jastrow_threebody_matrices {
+public:
+  //! Gather parms(p,i), the coefficient of the term klm(i) on p
+  void set(const Array2 <doublevar> & parms, const Array1 <int> & nparms,
+           const Array2 <int> & klm, int nee);
+
+  //! Add the values for the pairs (e,j) with j0 <= j < j1 to val(j)
+  void updateVal(int e, int j0, int j1, const Array1 <int> & parm_centers,
+                 const Array4 <doublevar> & eibasis,
+                 const Array3 <doublevar> & eebasis,
+                 Array1 <doublevar> & val) const;
+
+  //! Add the derivatives with respect to e (lap(0,j,d)) and to j
+  //! (lap(1,j,d)) for the pairs (e,j) with j0 <= j < j1
+  void updateLap(int e, int j0, int j1, const Array1 <int> & parm_centers,
+                 const Array4 <doublevar> & eibasis,
+                 const Array3 <doublevar> & eebasis,
+                 Array3 <doublevar> & lap) const;
+
+private:
+  int nearBasis(int e, int nd, const Array1 <int> & parm_centers,
+                const Array4 <doublevar> & eibasis, Array1 <int> & atq,
+                Array1 <int> & lq, Array3 <doublevar> & W) const;
+
+  Array4 <doublevar> coeff; //!< C_p(k,l,m) as (p,k,l,m)
+  Array1 <int> nbasis;      //!< (p): e-i basis functions used by p
+};
+
 /*!
 
 \brief 
@@ -119,6 +162,7 @@ private:
 
   
   Array2 <int> klm; //!< which basis functions to use for each parameter in the list(parm#, klm);
+  Jastrow_threebody_matrices matrices;
 };
 
 
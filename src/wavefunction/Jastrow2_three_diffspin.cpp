@@ -186,6 +186,8 @@ void Jastrow_threebody_piece_diffspin::set_up(vector <string> & words,
   freeze=haskeyword(words, pos=0, "FREEZE");
   nspin_up=sys->nelectrons(0);
   nelectrons=sys->nelectrons(0)+sys->nelectrons(1);
+  for(int s=0; s< unique_parameters_spin.GetSize(); s++) 
+    matrices_spin[s].set(unique_parameters_spin(s),_nparms,klm,eebasis_max);
   //cout <<"End Jastrow_threebody_piece_diffspin::set_up"<<endl;  
 
 }
@@ -252,100 +254,17 @@ void Jastrow_threebody_piece_diffspin::updateLap(int e,
                  const Array4 <doublevar> & eibasis,
                  const Array3 <doublevar> & eebasis,
                  Array3 <doublevar> & lap) {
-  //cout << "Jastrow_threebody_piece::updateLap" << endl;
   assert(lap.GetDim(2) >= 5);
   assert(lap.GetDim(0) >=2);
-  
   assert(eibasis.GetDim(1) >= parm_centers.GetDim(0));
-  int natoms=parm_centers.GetDim(0);
   int nelectrons=eebasis.GetDim(0);
   assert(lap.GetDim(1) >= nelectrons);
-  Array1 <doublevar> vkl_e(5); //derivative wrt e of a_e a_j + a_j a_e
-  Array1 <doublevar> vkl_j(5); //wrt j
-  
-  int s;
-  const doublevar tiny=1e-14;
-  //cout << "updateLap " << endl;
-  for(int at=0; at < natoms; at++) {
-    int p=parm_centers(at);
-    
-    for(int i=0; i< _nparms(p); i++) {
-      doublevar parm;
-      int k=klm(i,0), el=klm(i,1), m=klm(i,2);
-      if(fabs(eibasis(e,at,k,0)) > tiny
-	 || fabs(eibasis(e,at,el,0)) > tiny) { 
-	for(int j=0; j< e; j++) {
-	  s=(j < nspin_up) != (e < nspin_up);
-	  parm=unique_parameters_spin(s)(p,i);
-	  doublevar vkl=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-			      +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-	  
-	  
-	  for(int d=1; d< 5; d++) {
-	    vkl_e[d]=parm*(eibasis(e,at,k,d)*eibasis(j,at,el,0)
-			   +eibasis(j,at,k,0)*eibasis(e,at,el,d));
-	    vkl_j[d]=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,d)
-			   +eibasis(j,at,k,d)*eibasis(e,at,el,0));
-	  } 
-	  lap(0,j,0)+=vkl*eebasis(j,m,0);
-	  doublevar dot_e=0, dot_j=0;
-	  for(int d=1; d< 4; d++) {
-	    lap(0,j,d)+=vkl_e[d]*eebasis(j,m,0);
-	    lap(0,j,d)-=vkl*eebasis(j,m,d);
-	    lap(1,j,d)+=vkl_j[d]*eebasis(j,m,0);
-	    lap(1,j,d)+=vkl*eebasis(j,m,d);
-	    
-	    dot_e+=vkl_e[d]*eebasis(j,m,d);
-	    dot_j+=vkl_j[d]*eebasis(j,m,d);
-	  }
-	  
-	  
-	  lap(0,j,4)+=vkl*eebasis(j,m,4);
-	  lap(1,j,4)+=vkl*eebasis(j,m,4);
-	  
-	  lap(0,j,4)+=vkl_e[4]*eebasis(j,m,0);
-	  lap(1,j,4)+=vkl_j[4]*eebasis(j,m,0);
-	  
-	  lap(0,j,4)-=2*dot_e;
-	  lap(1,j,4)+=2*dot_j;
-	}
-	for(int j=e+1; j< nelectrons; j++) {
-	  s=(j < nspin_up) != (e < nspin_up);
-	  parm=unique_parameters_spin(s)(p,i);
-	  doublevar vkl=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-			      +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-	  for(int d=1; d< 5; d++) {
-	    vkl_e[d]=parm*(eibasis(e,at,k,d)*eibasis(j,at,el,0)
-			   +eibasis(j,at,k,0)*eibasis(e,at,el,d));
-	    vkl_j[d]=parm*(eibasis(e,at,k,0)*eibasis(j,at,el,d)
-			   +eibasis(j,at,k,d)*eibasis(e,at,el,0));
-	  } 
-	  
-	  lap(0,j,0)+=vkl*eebasis(j,m,0);
-	  doublevar dot_e=0, dot_j=0;
-	  for(int d=1; d< 4; d++) {
-	    lap(0,j,d)+=vkl_e[d]*eebasis(j,m,0);
-	    lap(0,j,d)+=vkl*eebasis(j,m,d);
-	    lap(1,j,d)+=vkl_j[d]*eebasis(j,m,0);
-	    lap(1,j,d)-=vkl*eebasis(j,m,d);
-	    
-	    dot_e+=vkl_e[d]*eebasis(j,m,d);
-	    dot_j+=vkl_j[d]*eebasis(j,m,d);
-	  }
-	  lap(0,j,4)+=vkl*eebasis(j,m,4);
-	  lap(1,j,4)+=vkl*eebasis(j,m,4);
-	  
-	  lap(0,j,4)+=vkl_e[4]*eebasis(j,m,0);
-	  lap(1,j,4)+=vkl_j[4]*eebasis(j,m,0);
-	  
-	  lap(0,j,4)+=2*dot_e;
-	  lap(1,j,4)-=2*dot_j;
-	}
-      }
-    }
-  }
-  
-  
+  //the up electrons have the same spin as e if e is up
+  int se=e < nspin_up;
+  matrices_spin[se?0:1].updateLap(e,0,nspin_up,parm_centers,
+                                  eibasis,eebasis,lap);
+  matrices_spin[se?1:0].updateLap(e,nspin_up,nelectrons,parm_centers,
+                                  eibasis,eebasis,lap);
 }
 
 //-----------------------------------------------------------
@@ -353,35 +272,13 @@ void Jastrow_threebody_piece_diffspin::updateVal(int e,
                                          const Array4 <doublevar> & eibasis,
                                          const Array3 <doublevar> & eebasis,
                                          Array1 <doublevar> & updated_val) {
-  
   assert(eibasis.GetDim(1) >= parm_centers.GetDim(0));
-  int natoms=parm_centers.GetDim(0);
   int nelectrons=eebasis.GetDim(0);
-  int s;
-
-  const doublevar tiny=1e-14;
-  //cout << "updateLap " << endl;
-  for(int at=0; at < natoms; at++) {
-    int p=parm_centers(at);
-    for(int i=0; i< _nparms(p); i++) {
-      int k=klm(i,0), el=klm(i,1), m=klm(i,2);
-      if(fabs(eibasis(e,at,k,0)) > tiny
-	 || fabs(eibasis(e,at,el,0)) > tiny) { 
-	for(int j=0; j< e; j++) {
-	  s=(j < nspin_up) != (e < nspin_up); 
-	  doublevar vkl=unique_parameters_spin(s)(p,i)*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-			      +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-	  updated_val(j)+=vkl*eebasis(j,m,0);
-	}
-	for(int j=e+1; j< nelectrons; j++) {
-	  s=(j < nspin_up) != (e < nspin_up);
-	  doublevar vkl=unique_parameters_spin(s)(p,i)*(eibasis(e,at,k,0)*eibasis(j,at,el,0)
-			      +eibasis(j,at,k,0)*eibasis(e,at,el,0));
-	  updated_val(j)+=vkl*eebasis(j,m,0);
-	}
-      }
-    }
-  } 
+  int se=e < nspin_up;
+  matrices_spin[se?0:1].updateVal(e,0,nspin_up,parm_centers,
+                                  eibasis,eebasis,updated_val);
+  matrices_spin[se?1:0].updateVal(e,nspin_up,nelectrons,parm_centers,
+                                  eibasis,eebasis,updated_val);
 }
 
 
@@ -624,6 +521,8 @@ void Jastrow_threebody_piece_diffspin::setParms(Array1 <doublevar> & parms) {
       }
     }
   }
+  for(int s=0; s< unique_parameters_spin.GetSize(); s++) 
+    matrices_spin[s].set(unique_parameters_spin(s),_nparms,klm,eebasis_max);
 }
 
 //--------------------------------------------------------------------------
@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "Qmc_std.h"
 #include "Array45.h"
 #include "Jastrow2_one.h"
+#include "Jastrow2_three.h"
 
 /*!
 
@@ -133,6 +134,7 @@ private:
   
   
   Array2 <int> klm; //!< which basis functions to use for each parameter in the list(parm#, klm);
+  Jastrow_threebody_matrices matrices_spin[2]; //!< like and unlike spins
 };
 
 
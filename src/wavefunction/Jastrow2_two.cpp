@@ -133,6 +133,44 @@ void Jastrow_twobody_piece::updateVal(int e, const Array3 <doublevar> & eebasis,
 }
 //----------------------------------------------------------------------
 
+void Jastrow_twobody_piece::updateLapColumns(int e, 
+    const Array3 <doublevar> & eecols, Array2 <doublevar> & lap) {
+  assert(parameters.GetDim(0)<= eecols.GetDim(0));
+  int nelectrons=lap.GetDim(0);
+  int np=parameters.GetDim(0);
+  int ld=eecols.GetDim(2);
+  Array1 <doublevar> sum(nelectrons);
+  for(int d=0; d< 5; d++) { 
+    sum=0.0;
+    for(int p=0; p < np; p++) { 
+      doublevar c=parameters(p);
+      const doublevar * col=eecols.v+(p*5+d)*ld;
+      for(int j=0; j< nelectrons; j++) sum(j)+=c*col[j];
+    }
+    for(int j=0; j< e; j++) lap(j,d)+=sum(j);
+    for(int j=e+1; j< nelectrons; j++) lap(j,d)+=sum(j);
+  }
+}
+
+//----------------------------------------------------------------------
+
+void Jastrow_twobody_piece::updateValColumns(int e, 
+    const Array3 <doublevar> & eecols, Array1 <doublevar> & val) {
+  int nelectrons=val.GetDim(0);
+  int np=parameters.GetDim(0);
+  int ld=eecols.GetDim(2);
+  Array1 <doublevar> sum(nelectrons,0.0);
+  for(int p=0; p < np; p++) { 
+    doublevar c=parameters(p);
+    const doublevar * col=eecols.v+p*5*ld;
+    for(int j=0; j< nelectrons; j++) sum(j)+=c*col[j];
+  }
+  for(int j=0; j< e; j++) val(j)+=sum(j);
+  for(int j=e+1; j< nelectrons; j++) val(j)+=sum(j);
+}
+
+//----------------------------------------------------------------------
+
 
 void Jastrow_twobody_piece::getParmDeriv(const Array3 <doublevar> & eebasis,
                                          Parm_deriv_return & parm_ret) { 
@@ -349,6 +387,54 @@ void Jastrow_twobody_piece_diffspin::updateVal(int e, const Array3 <doublevar> &
 
 //----------------------------------------------------------------------
 
+/*!
+The parameters only depend on whether the spins are the same, which
+splits the electrons into two ranges.
+*/
+void Jastrow_twobody_piece_diffspin::updateLapColumns(int e, 
+    const Array3 <doublevar> & eecols, Array2 <doublevar> & lap) {
+  assert(spin_parms.GetDim(1) <= eecols.GetDim(0));
+  int nelectrons=lap.GetDim(0);
+  int np=spin_parms.GetDim(1);
+  int ld=eecols.GetDim(2);
+  int se=e < nspin_up;
+  Array1 <doublevar> sum(nelectrons);
+  for(int d=0; d< 5; d++) { 
+    sum=0.0;
+    for(int p=0; p < np; p++) { 
+      const doublevar * col=eecols.v+(p*5+d)*ld;
+      doublevar c=spin_parms(se?0:1,p);
+      for(int j=0; j< nspin_up; j++) sum(j)+=c*col[j];
+      c=spin_parms(se?1:0,p);
+      for(int j=nspin_up; j< nelectrons; j++) sum(j)+=c*col[j];
+    }
+    for(int j=0; j< e; j++) lap(j,d)+=sum(j);
+    for(int j=e+1; j< nelectrons; j++) lap(j,d)+=sum(j);
+  }
+}
+
+//----------------------------------------------------------------------
+
+void Jastrow_twobody_piece_diffspin::updateValColumns(int e, 
+    const Array3 <doublevar> & eecols, Array1 <doublevar> & val) {
+  int nelectrons=val.GetDim(0);
+  int np=spin_parms.GetDim(1);
+  int ld=eecols.GetDim(2);
+  int se=e < nspin_up;
+  Array1 <doublevar> sum(nelectrons,0.0);
+  for(int p=0; p < np; p++) { 
+    const doublevar * col=eecols.v+p*5*ld;
+    doublevar c=spin_parms(se?0:1,p);
+    for(int j=0; j< nspin_up; j++) sum(j)+=c*col[j];
+    c=spin_parms(se?1:0,p);
+    for(int j=nspin_up; j< nelectrons; j++) sum(j)+=c*col[j];
+  }
+  for(int j=0; j< e; j++) val(j)+=sum(j);
+  for(int j=e+1; j< nelectrons; j++) val(j)+=sum(j);
+}
+
+//----------------------------------------------------------------------
+
 void Jastrow_twobody_piece_diffspin::getParms(Array1 <doublevar> & parms) {
   if(freeze) parms.Resize(0);
   else {
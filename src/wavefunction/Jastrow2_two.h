@@ -110,6 +110,16 @@ public:
                  const Array3 <doublevar> & eebasis,
                  Array1 <doublevar> & val);
 
+  /*!
+    updateLap() and updateVal() with the basis in the layout of
+    Jastrow_group::updateEEBasis(e,dist,eecols), (function, [val grad lap],
+    electron), so that the sum over the parameters runs down whole columns.
+   */
+  virtual void updateLapColumns(int e, const Array3 <doublevar> & eecols,
+                                Array2 <doublevar> & lap);
+  virtual void updateValColumns(int e, const Array3 <doublevar> & eecols,
+                                Array1 <doublevar> & val);
+
   virtual void getParmDeriv(const Array3 <doublevar> & eebasis, //expects in form i,j,basis, with i<j
                             Parm_deriv_return &);
   virtual void getParmDeriv(const Array4 <doublevar> & eebasis,Parm_deriv_return & parm_ret);
@@ -162,6 +172,11 @@ public:
                  const Array3 <doublevar> & eebasis,
                  Array1 <doublevar> & val);
 
+  virtual void updateLapColumns(int e, const Array3 <doublevar> & eecols,
+                                Array2 <doublevar> & lap);
+  virtual void updateValColumns(int e, const Array3 <doublevar> & eecols,
+                                Array1 <doublevar> & val);
+
   virtual void getParmDeriv(const Array3 <doublevar> & eebasis, //expects in form i,j,basis, with i<j
                             Parm_deriv_return &);
   virtual void getParmDeriv(const Array4 <doublevar> & eebasis,
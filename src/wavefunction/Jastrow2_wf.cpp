@@ -263,70 +263,77 @@ void Jastrow_group::updateEIBasis(int e, Sample_point * sample,
 
 //----------------------------------------------------------------------
 
-void Jastrow_group::updateEEBasis(int e, Sample_point * sample,
-                                  Array3 <doublevar> & eesave) {
-  //cout << "updateEEBasis" << endl;
+void Jastrow_group::eeDistances(int e, Sample_point * sample,
+                                Array2 <doublevar> & dist) {
+  int nelec=sample->electronSize();
+  dist.Resize(5,nelec);
+  sample->updateEEDist();
   Array1 <doublevar> R(5);
-  Array2 <doublevar> lap(maxeebasis, 5);
+  for(int i=0; i< nelec; i++) { 
+    if(i < e) sample->getEEDist(i,e,R);
+    else if(i > e) sample->getEEDist(e,i,R);
+    else { 
+      //a harmless distance, so that the functions stay finite
+      R=0.0;
+      R(0)=R(1)=R(2)=1.0;
+    }
+    for(int d=0; d< 5; d++) dist(d,i)=R(d);
+  }
+}
+
+//----------------------------------------------------------------------
 
+void Jastrow_group::updateEEBasis(int e, const Array2 <doublevar> & dist,
+                                  Array3 <doublevar> & eecols) {
   int neebasis=eebasis.GetDim(0);
+  int n=dist.GetDim(1);
+  int ld=eecols.GetDim(2);
+  assert(eecols.GetDim(0) >= n_eebasis);
+  assert(ld >= n);
+  Array3 <doublevar> lap(maxeebasis,5,n);
+  const doublevar * r=dist.v;
   int counter=0;
-  sample->updateEEDist();
-
-  //for(int i=0; i< nelectrons; i++) { 
-  //  eesave(i,counter,0)=1;
-  //  for(int d=1; d< 5; d++)
-  //    eesave(i,counter,d)=0;
-  //}
-  //counter++;
-
   for(int b=0; b< neebasis; b++) {
     doublevar cutoff=0;
-    for(int n=0; n< nfunc_eeb(b); n++) {
-      if(cutoff < eebasis(b)->cutoff(n)) cutoff=eebasis(b)->cutoff(n);
-    }
-
-    for(int i=0; i< e; i++) {
-      sample->getEEDist(i,e,R);
-      if(R(0) < cutoff) {
-        eebasis(b)->calcLap(R,lap);
-        for(int n=0; n< nfunc_eeb(b); n++) {
-          for(int d=0; d< 5; d++) {
-            eesave(i,counter+n, d)=lap(n,d);
-            //if(R(0) > cutoff) 
-            //  cout << "beyond " << eesave(i,counter+n, d) << endl;
-          }
-        }
-      }
-      else {
-        for(int n=0; n< nfunc_eeb(b); n++) {
-          for(int d=0; d< 5; d++)
-            eesave(i,counter+n, d)=0;
-        }
-      }
+    for(int f=0; f< nfunc_eeb(b); f++) {
+      if(cutoff < eebasis(b)->cutoff(f)) cutoff=eebasis(b)->cutoff(f);
     }
-    for(int j=e+1; j< nelectrons; j++) {
-      sample->getEEDist(e,j,R);
-      if(R(0) < cutoff) { 
-        eebasis(b)->calcLap(R,lap);
-        for(int n=0; n< nfunc_eeb(b); n++) {
-          for(int d=0; d< 5; d++) { 
-            eesave(j,counter+n, d)=lap(n,d);
-          }
+    eebasis(b)->calcLapMany(dist,n,lap);
+    for(int f=0; f< nfunc_eeb(b); f++) { 
+      for(int d=0; d< 5; d++) { 
+        const doublevar * from=lap.v+(f*5+d)*n;
+        doublevar * to=eecols.v+((counter+f)*5+d)*ld;
+        for(int k=0; k< n; k++) { 
+          doublevar v=from[k];
+          to[k]=r[k] < cutoff?v:0.0;
         }
       }
-      else { 
-        for(int n=0; n< nfunc_eeb(b); n++) {
-          for(int d=0; d< 5; d++)
-            eesave(j,counter+n, d)=0;
-        }        
-      }
     }
     counter+=nfunc_eeb(b);
   }
-  //cout << "done" << endl;
+}
 
+//----------------------------------------------------------------------
 
+void Jastrow_group::pairsFromColumns(int e, const Array3 <doublevar> & eecols,
+                                     Array3 <doublevar> & eesave) {
+  int n=eesave.GetDim(0);
+  for(int i=0; i< n; i++) { 
+    if(i==e) continue;
+    for(int f=0; f< n_eebasis; f++) 
+      for(int d=0; d< 5; d++) eesave(i,f,d)=eecols(f,d,i);
+  }
+}
+
+//----------------------------------------------------------------------
+
+void Jastrow_group::updateEEBasis(int e, Sample_point * sample,
+                                  Array3 <doublevar> & eesave) {
+  Array2 <doublevar> dist;
+  eeDistances(e,sample,dist);
+  Array3 <doublevar> eecols(n_eebasis,5,dist.GetDim(1));
+  updateEEBasis(e,dist,eecols);
+  pairsFromColumns(e,eecols,eesave);
 }
 
 //----------------------------------------------------------------------
@@ -668,6 +675,10 @@ int Jastrow2_wf_data::supports(wf_support_type support) {
       }
     }
     return 1;
+  case move_proposal:
+    return 1;
+  case test_ratios:
+    return 1;
   default:
     return 0;
   }
@@ -891,6 +902,10 @@ void Jastrow2_wf::updateVal(Wavefunction_data * wfdata, Sample_point * sample){
       newval_ei=0;
 
       Array3 <doublevar> eebasis(nelectrons, maxeebasis, 5);
+      Array3 <doublevar> eecols(maxeebasis,5,nelectrons);
+      Array2 <doublevar> eedist;
+      if(maxeebasis > 0) 
+        Jastrow_group::eeDistances(e,sample,eedist);
 
       doublevar old_eval=0;
       for(int i=0; i< e; i++)
@@ -922,10 +937,12 @@ void Jastrow2_wf::updateVal(Wavefunction_data * wfdata, Sample_point * sample){
         
 
         if(parent->group(g).hasTwoBody() || parent->group(g).hasThreeBody() || parent->group(g).hasThreeBodySpin())
-          parent->group(g).updateEEBasis(e,sample, eebasis);
+          parent->group(g).updateEEBasis(e,eedist, eecols);
+        if(parent->group(g).hasThreeBody() || parent->group(g).hasThreeBodySpin())
+          parent->group(g).pairsFromColumns(e,eecols,eebasis);
         
         if(parent->group(g).hasTwoBody())
-          parent->group(g).two_body->updateVal(e,eebasis, newval_ee);
+          parent->group(g).two_body->updateValColumns(e,eecols, newval_ee);
 
 
         if(parent->group(g).hasThreeBody()) 
@@ -992,169 +1009,387 @@ void Jastrow2_wf::updateLap(Wavefunction_data * wfdata, Sample_point * sample){
     updateEverythingLap=0;
   }
 
-  int ngroups=parent->group.GetDim(0);
-  Array3 <doublevar> eibasis(parent->natoms, maxeibasis ,5);
   update_eibasis_save(wfdata,sample);
 
+  Array1 <doublevar> one(5);
+  Array2 <doublevar> two_e(nelectrons,5), two_others(nelectrons,5);
   for(int e=0; e < nelectrons; e++) {
     if(electronIsStaleLap(e)) {
-      //Array3 <doublevar> eibasis(parent->natoms, maxeibasis ,5);
-      Array3 <doublevar> eebasis(nelectrons, maxeebasis, 5);
+      electronLap(e,sample,one,two_e,two_others);
+      storeElectron(e,one,two_e,two_others);
+      electronIsStaleLap(e)=0;
+    }
+  }
 
-      Array1 <doublevar> newlap_ei(5);
-      newlap_ei=0;
-      Array2 <doublevar> newlap_ee(nelectrons, 5);
-      newlap_ee=0;
-      
-      Array3 <doublevar> newlap_eei(2,nelectrons,5,0.0);
+  //for(int i=0; i< nelectrons; i++) {
+  //  for(int j=i+1; j< nelectrons; j++) {
+  //    cout << "pair " << i << "   " << j
+  //         << " driftion " << two_body_save(i,j,4) << endl;
+  //  }
+  //}
 
-      newlap_eei=0;
+  electronIsStaleVal=0;
+  updateEverythingVal=0;
+  //cout << "Jastrow2_wf::updateLap done" << endl;
 
-      if(keep_ion_dependent) { 
-        for(int a=0; a< parent->natoms; a++) { 
-          for(int d=0; d< 5; d++)
-            one_body_ion(e,a,d)=0;
-        }
-      }
+}
 
+//----------------------------------------------------------
 
-      doublevar old_eval=0;
-      for(int i=0; i< e; i++)
-        old_eval+=two_body_save(i,e,0);
-      for(int j=e+1; j< nelectrons; j++)
-        old_eval+=two_body_save(e,j,0);
+/*!
+The one-body part and the row and column of two_body_save for electron e
+at its current position in the sample.  Entries of the two-body row and 
+column that aren't recalculated are copied from two_body_save, so that 
+storeElectron() can write them all back.  Like updateLap(), this updates 
+eibasis_save and one_body_ion for e.
+*/
+void Jastrow2_wf::electronLap(int e, Sample_point * sample, 
+                              Array1 <doublevar> & one,
+                              Array2 <doublevar> & two_e,
+                              Array2 <doublevar> & two_others) { 
+  int ngroups=parent->group.GetDim(0);
+  Array3 <doublevar> eibasis(parent->natoms, maxeibasis ,5);
+  //Array3 <doublevar> eibasis(parent->natoms, maxeibasis ,5);
+  Array3 <doublevar> eebasis(nelectrons, maxeebasis, 5);
+  Array3 <doublevar> eecols(maxeebasis,5,nelectrons);
+  Array2 <doublevar> eedist;
+  if(maxeebasis > 0) 
+    Jastrow_group::eeDistances(e,sample,eedist);
+
+  Array1 <doublevar> newlap_ei(5);
+  newlap_ei=0;
+  Array2 <doublevar> newlap_ee(nelectrons, 5);
+  newlap_ee=0;
+  
+  Array3 <doublevar> newlap_eei(2,nelectrons,5,0.0);
 
-      for(int g=0; g< ngroups; g++) {
-        if(parent->group(g).hasOneBody() || parent->group(g).hasThreeBody()
-            || parent->group(g).hasThreeBodySpin() )
-          parent->group(g).updateEIBasis(e,sample,eibasis);
+  newlap_eei=0;
 
-        if(parent->group(g).hasOneBody()) {
-          parent->group(g).one_body.updateLap(e, eibasis,newlap_ei);
-          if(keep_ion_dependent) { 
-            parent->group(g).one_body.updateLap_ion(e, eibasis,one_body_ion);
-          }
-        }
+  if(keep_ion_dependent) { 
+    for(int a=0; a< parent->natoms; a++) { 
+      for(int d=0; d< 5; d++)
+        one_body_ion(e,a,d)=0;
+    }
+  }
+
+  for(int g=0; g< ngroups; g++) {
+    if(parent->group(g).hasOneBody() || parent->group(g).hasThreeBody()
+        || parent->group(g).hasThreeBodySpin() )
+      parent->group(g).updateEIBasis(e,sample,eibasis);
 
+    if(parent->group(g).hasOneBody()) {
+      parent->group(g).one_body.updateLap(e, eibasis,newlap_ei);
+      if(keep_ion_dependent) { 
+        parent->group(g).one_body.updateLap_ion(e, eibasis,one_body_ion);
+      }
+    }
 
-        if(parent->group(g).hasTwoBody() || parent->group(g).hasThreeBody() 
-            || parent->group(g).hasThreeBodySpin())
-          parent->group(g).updateEEBasis(e,sample, eebasis);
-        
-        if(parent->group(g).hasTwoBody())
-          parent->group(g).two_body->updateLap(e,eebasis, newlap_ee);
 
-          
-        if(parent->group(g).hasThreeBody()) { 
-          for(int i=0; i< parent->natoms; i++) {
-            for(int j=0; j< maxeibasis; j++) {
-              for(int d=0; d< 5; d++) {
-                eibasis_save(g)(e,i,j,d)=eibasis(i,j,d);
-              }
-            }
+    if(parent->group(g).hasTwoBody() || parent->group(g).hasThreeBody() 
+        || parent->group(g).hasThreeBodySpin())
+      parent->group(g).updateEEBasis(e,eedist, eecols);
+    //the three-body pieces still take the basis pair by pair
+    if(parent->group(g).hasThreeBody() || parent->group(g).hasThreeBodySpin())
+      parent->group(g).pairsFromColumns(e,eecols,eebasis);
+    
+    if(parent->group(g).hasTwoBody())
+      parent->group(g).two_body->updateLapColumns(e,eecols, newlap_ee);
+
+      
+    if(parent->group(g).hasThreeBody()) { 
+      for(int i=0; i< parent->natoms; i++) {
+        for(int j=0; j< maxeibasis; j++) {
+          for(int d=0; d< 5; d++) {
+            eibasis_save(g)(e,i,j,d)=eibasis(i,j,d);
           }
-          parent->group(g).three_body.updateLap(e,eibasis_save(g),eebasis,newlap_eei);
         }
+      }
+      parent->group(g).three_body.updateLap(e,eibasis_save(g),eebasis,newlap_eei);
+    }
 
-        if(parent->group(g).hasThreeBodySpin()) { 
-          for(int i=0; i< parent->natoms; i++) {
-            for(int j=0; j< maxeibasis; j++) {
-              for(int d=0; d< 5; d++) {
-                eibasis_save(g)(e,i,j,d)=eibasis(i,j,d);
-              }
-            }
+    if(parent->group(g).hasThreeBodySpin()) { 
+      for(int i=0; i< parent->natoms; i++) {
+        for(int j=0; j< maxeibasis; j++) {
+          for(int d=0; d< 5; d++) {
+            eibasis_save(g)(e,i,j,d)=eibasis(i,j,d);
           }
-          parent->group(g).three_body_diffspin.updateLap(e,eibasis_save(g),eebasis,newlap_eei);
         }
-
       }
+      parent->group(g).three_body_diffspin.updateLap(e,eibasis_save(g),eebasis,newlap_eei);
+    }
+
+  }
 
 
-      for(int d=0; d< 5; d++)
-        one_body_save(e,d)=newlap_ei(d);
+  for(int d=0; d< 5; d++)
+    one(d)=newlap_ei(d);
+  
+  for(int i=0; i< nelectrons; i++) { 
+    for(int d=0; d< 5; d++) { 
+      two_e(i,d)=two_body_save(e,i,d);
+      two_others(i,d)=two_body_save(i,e,d);
+    }
+  }
+
+  for(int i=0; i< e; i++) {
+    for(int d=0; d< 5; d++) 
+      two_others(i,d)=newlap_ee(i,d);
+
+    two_others(i,0)+=newlap_eei(0,i,0);
+    for(int d=1; d < 5; d++) 
+      two_others(i,d)+=newlap_eei(1,i,d);
+    
+  }
+  for(int i=0; i< e; i++) {
+   for(int d=1; d< 4; d++)
+      two_e(i,d)= -newlap_ee(i,d);
+    two_e(i,4)=newlap_ee(i,4);
+    
+    for(int d=1; d< 5; d++) 
+      two_e(i,d)+=newlap_eei(0,i,d);
+  }
+
+  for(int j=e+1; j< nelectrons; j++) {
+    for(int d=0; d< 5; d++) 
+      two_e(j,d)=newlap_ee(j,d);
       
+    two_e(j,0)+=newlap_eei(0,j,0);
+    
+    for(int d=1; d< 5; d++) 
+      two_e(j,d)+=newlap_eei(0,j,d);
+    
+    
+  }
+  for(int j=e+1; j< nelectrons; j++) {
+    for(int d=1; d< 4; d++)
+      two_others(j,d)= -newlap_ee(j,d);
+    two_others(j,4)=newlap_ee(j,4);
+    
+    for(int d=1; d< 5; d++) 
+      two_others(j,d)+=newlap_eei(1,j,d);
 
-      for(int i=0; i< e; i++) {
-        for(int d=0; d< 5; d++) 
-          two_body_save(i,e,d)=newlap_ee(i,d);
+  }
+}
 
-        two_body_save(i,e,0)+=newlap_eei(0,i,0);
-        for(int d=1; d < 5; d++) 
-          two_body_save(i,e,d)+=newlap_eei(1,i,d);
-        
-      }
-      for(int i=0; i< e; i++) {
-       for(int d=1; d< 4; d++)
-          two_body_save(e,i,d)= -newlap_ee(i,d);
-        two_body_save(e,i,4)=newlap_ee(i,4);
-        
-        for(int d=1; d< 5; d++) 
-          two_body_save(e,i,d)+=newlap_eei(0,i,d);
-      }
+//----------------------------------------------------------
 
-      for(int j=e+1; j< nelectrons; j++) {
-        for(int d=0; d< 5; d++) 
-          two_body_save(e,j,d)=newlap_ee(j,d);
-          
-        two_body_save(e,j,0)+=newlap_eei(0,j,0);
-        
-        for(int d=1; d< 5; d++) 
-          two_body_save(e,j,d)+=newlap_eei(0,j,d);
-        
-        
-      }
-      for(int j=e+1; j< nelectrons; j++) {
-        for(int d=1; d< 4; d++)
-          two_body_save(j,e,d)= -newlap_ee(j,d);
-        two_body_save(j,e,4)=newlap_ee(j,4);
-        
-        for(int d=1; d< 5; d++) 
-          two_body_save(j,e,d)+=newlap_eei(1,j,d);
+void Jastrow2_wf::storeElectron(int e, const Array1 <doublevar> & one,
+                                const Array2 <doublevar> & two_e,
+                                const Array2 <doublevar> & two_others) { 
+  doublevar old_eval=0;
+  for(int i=0; i< e; i++)
+    old_eval+=two_body_save(i,e,0);
+  for(int j=e+1; j< nelectrons; j++)
+    old_eval+=two_body_save(e,j,0);
+
+  for(int d=0; d< 5; d++)
+    one_body_save(e,d)=one(d);
+  for(int i=0; i< nelectrons; i++) { 
+    if(i==e) continue;
+    for(int d=0; d< 5; d++) { 
+      two_body_save(e,i,d)=two_e(i,d);
+      two_body_save(i,e,d)=two_others(i,d);
+    }
+  }
+
+  doublevar new_eval=0;
+  for(int i=0; i< e; i++)
+    new_eval+=two_body_save(i,e,0);
+  for(int j=e+1; j< nelectrons; j++)
+    new_eval+=two_body_save(e,j,0);
 
+  u_twobody+=new_eval-old_eval;
+  
+  /*
+  for(int d=0; d< 1; d++) { 
+    cout << "updated two_body_save: " << d << endl;
+    for(int i=0; i < nelectrons; i++) {
+      for(int j=0; j< nelectrons; j++) {
+        cout << two_body_save(i,j,d) << "  ";
       }
-      
+      cout << endl;
+    }
+  }
+  
+  
 
-      doublevar new_eval=0;
-      for(int i=0; i< e; i++)
-        new_eval+=two_body_save(i,e,0);
-      for(int j=e+1; j< nelectrons; j++)
-        new_eval+=two_body_save(e,j,0);
+  cout << "u " << u_twobody << "  new_eval " << new_eval << "  old_eval " << old_eval << endl;
+  */
+}
 
-      u_twobody+=new_eval-old_eval;
+//----------------------------------------------------------
 
-      
-      /*
-      for(int d=0; d< 1; d++) { 
-        cout << "updated two_body_save: " << d << endl;
-        for(int i=0; i < nelectrons; i++) {
-          for(int j=0; j< nelectrons; j++) {
-            cout << two_body_save(i,j,d) << "  ";
-          }
-          cout << endl;
+/*!
+The new row and column of the two-body part are kept in prop_*, so
+a rejection only has to put back electron e's row of eibasis_save.
+*/
+void Jastrow2_wf::proposeLap(Wavefunction_data * wfdata, Sample_point * sample,
+                             int e, Wf_return & lap) { 
+  if(keep_ion_dependent) 
+    error("Jastrow2_wf: move proposals aren't supported with per-ion terms");
+  int ngroups=parent->group.GetDim(0);
+  Array3 <doublevar> eibasis(parent->natoms, maxeibasis ,5);
+  prop_eibasis.Resize(ngroups);
+  for(int g=0; g< ngroups; g++) { 
+    prop_eibasis(g).Resize(parent->natoms,maxeibasis,5);
+    parent->group(g).updateEIBasis(e,sample,eibasis);
+    for(int i=0; i< parent->natoms; i++) {
+      for(int j=0; j< maxeibasis; j++) {
+        for(int d=0; d< 5; d++) {
+          prop_eibasis(g)(i,j,d)=eibasis_save(g)(e,i,j,d);
+          eibasis_save(g)(e,i,j,d)=eibasis(i,j,d);
         }
       }
-      
-      
+    }
+  }
+  prop_one.Resize(5);
+  prop_two_e.Resize(nelectrons,5);
+  prop_two_others.Resize(nelectrons,5);
+  electronLap(e,sample,prop_one,prop_two_e,prop_two_others);
 
-      cout << "u " << u_twobody << "  new_eval " << new_eval << "  old_eval " << old_eval << endl;
-      */
-      
-      electronIsStaleLap(e)=0;
+  //getLap() as it would be after storeElectron()
+  lap.amp=0;
+  lap.phase=0;
+  doublevar u=u_twobody;
+  for(int i=0; i< nelectrons; i++) 
+    u+=(i==e)?prop_one(0):one_body_save(i,0);
+  for(int i=0; i< e; i++)
+    u+=prop_two_others(i,0)-two_body_save(i,e,0);
+  for(int j=e+1; j< nelectrons; j++)
+    u+=prop_two_e(j,0)-two_body_save(e,j,0);
+  lap.amp(0,0)=u;
+  lap.cvals(0,0)=u;
+
+  doublevar dotproduct=0;
+  for(int d=1; d< 4; d++) {
+    lap.amp(0, d)+=prop_one(d);
+    for(int i=0; i< nelectrons; i++) {
+      lap.amp(0,d)+=(i==e)?two_body_save(e,e,d):prop_two_e(i,d);
     }
+    dotproduct+=lap.amp(0,d)*lap.amp(0,d);
   }
+  for(int i=0; i< nelectrons; i++) {
+    lap.amp(0,4)+=(i==e)?two_body_save(e,e,4):prop_two_e(i,4);
+  }
+  lap.amp(0,4)+=prop_one(4)+dotproduct;
 
-  //for(int i=0; i< nelectrons; i++) {
-  //  for(int j=i+1; j< nelectrons; j++) {
-  //    cout << "pair " << i << "   " << j
-  //         << " driftion " << two_body_save(i,j,4) << endl;
-  //  }
-  //}
+  for(int i=1; i< 5; i++) 
+    lap.cvals(0,i)=lap.amp(0,i);
+}
 
-  electronIsStaleVal=0;
-  updateEverythingVal=0;
-  //cout << "Jastrow2_wf::updateLap done" << endl;
+//----------------------------------------------------------
+
+void Jastrow2_wf::acceptMove(Wavefunction_data * wfdata, Sample_point * sample,
+                             int e) { 
+  storeElectron(e,prop_one,prop_two_e,prop_two_others);
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//----------------------------------------------------------
+
+void Jastrow2_wf::rejectMove(Sample_point * sample, int e) { 
+  for(int g=0; g< eibasis_save.GetDim(0); g++) {
+    for(int i=0; i< parent->natoms; i++) {
+      for(int j=0; j< maxeibasis; j++) {
+        for(int d=0; d< 5; d++) {
+          eibasis_save(g)(e,i,j,d)=prop_eibasis(g)(i,j,d);
+        }
+      }
+    }
+  }
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//----------------------------------------------------------
+
+/*!
+The same per-electron sums as updateVal(), with electron e at each test 
+position in turn and nothing stored.  The three-body terms read e's row of
+eibasis_save, so that row is swapped for the test position's while they 
+are evaluated.
+*/
+void Jastrow2_wf::testRatios(Wavefunction_data * wfdata, Sample_point * sample,
+                             int e, const Array2 <doublevar> & pos,
+                             Array1 <Wf_return> & ratio) { 
+  int ngroups=parent->group.GetDim(0);
+  int npos=pos.GetDim(0);
+  Array3 <doublevar> eibasis(parent->natoms, maxeibasis ,5);
+  Array3 <doublevar> eibasis_tmp(parent->natoms, maxeibasis ,5);
+  Array3 <doublevar> eebasis(nelectrons, maxeebasis, 5);
+  Array3 <doublevar> eecols(maxeebasis,5,nelectrons);
+  Array2 <doublevar> eedist;
+  Array1 <doublevar> newval_ee(nelectrons);
+  Array1 <doublevar> oldpos(3), newpos(3);
 
+  doublevar old_eval=0;
+  for(int i=0; i< e; i++)
+    old_eval+=two_body_save(i,e,0);
+  for(int j=e+1; j< nelectrons; j++)
+    old_eval+=two_body_save(e,j,0);
+
+  ratio.Resize(npos);
+  sample->getElectronPos(e,oldpos);
+  for(int k=0; k< npos; k++) { 
+    for(int d=0; d< 3; d++) newpos(d)=pos(k,d);
+    sample->setElectronPosNoNotify(e,newpos);
+    if(maxeebasis > 0) 
+      Jastrow_group::eeDistances(e,sample,eedist);
+
+    doublevar newval_ei=0;
+    newval_ee=0;
+    for(int g=0; g< ngroups; g++) {
+      int three=parent->group(g).hasThreeBody() 
+        || parent->group(g).hasThreeBodySpin();
+      if(parent->group(g).hasOneBody() || three)
+        parent->group(g).updateEIBasis(e,sample,eibasis);
+      if(parent->group(g).hasOneBody()) 
+        parent->group(g).one_body.updateVal(e,eibasis,newval_ei);
+
+      if(parent->group(g).hasTwoBody() || three)
+        parent->group(g).updateEEBasis(e,eedist,eecols);
+      if(parent->group(g).hasTwoBody())
+        parent->group(g).two_body->updateValColumns(e,eecols,newval_ee);
+
+      if(three) { 
+        parent->group(g).pairsFromColumns(e,eecols,eebasis);
+        for(int i=0; i< parent->natoms; i++) { 
+          for(int j=0; j< maxeibasis; j++) { 
+            for(int d=0; d< 5; d++) { 
+              eibasis_tmp(i,j,d)=eibasis_save(g)(e,i,j,d);
+              eibasis_save(g)(e,i,j,d)=eibasis(i,j,d);
+            }
+          }
+        }
+        if(parent->group(g).hasThreeBody()) 
+          parent->group(g).three_body.updateVal(e,eibasis_save(g), 
+              eebasis, newval_ee);
+        if(parent->group(g).hasThreeBodySpin()) 
+          parent->group(g).three_body_diffspin.updateVal(e,eibasis_save(g), 
+              eebasis, newval_ee);
+        for(int i=0; i< parent->natoms; i++) { 
+          for(int j=0; j< maxeibasis; j++) { 
+            for(int d=0; d< 5; d++) { 
+              eibasis_save(g)(e,i,j,d)=eibasis_tmp(i,j,d);
+            }
+          }
+        }
+      }
+    }
+
+    doublevar new_eval=0;
+    for(int i=0; i< nelectrons; i++) 
+      if(i!=e) new_eval+=newval_ee(i);
+    doublevar du=new_eval-old_eval+newval_ei-one_body_save(e,0);
+    ratio(k).Resize(1,1);
+    ratio(k).amp(0,0)=du;
+    ratio(k).phase(0,0)=0;
+    ratio(k).cvals(0,0)=du;
+  }
+  sample->setElectronPosNoNotify(e,oldpos);
 }
+
 //----------------------------------------------------------
 void Jastrow2_wf::updateForceBias(Wavefunction_data * wfdata,
                                   Sample_point * sample){
@@ -1479,6 +1714,50 @@ void Jastrow2_wf::restoreUpdate(Sample_point * sample, int e1, int e2, Wavefunct
   u_twobody+=new_eval-old_eval;
 	
 }
+
+//----------------------------------------------------------------------
+
+int Jastrow2_wf::saveState(Wavefunction_storage * & wfstate) { 
+  if(wfstate==NULL) wfstate=new Jastrow2_state;
+  Jastrow2_state * state;
+  recast(wfstate, state);
+  state->electronIsStaleVal=electronIsStaleVal;
+  state->electronIsStaleLap=electronIsStaleLap;
+  state->updateEverythingVal=updateEverythingVal;
+  state->updateEverythingLap=updateEverythingLap;
+  state->one_body_save=one_body_save;
+  state->u_twobody=u_twobody;
+  array_cp(state->two_body_save,two_body_save);
+  state->eibasis_save.Resize(eibasis_save.GetDim(0));
+  int bytes=sizeof(doublevar)*(one_body_save.GetSize()+two_body_save.GetSize());
+  for(int g=0; g< eibasis_save.GetDim(0); g++) { 
+    array_cp(state->eibasis_save(g),eibasis_save(g));
+    bytes+=sizeof(doublevar)*eibasis_save(g).GetSize();
+  }
+  if(keep_ion_dependent) { 
+    array_cp(state->one_body_ion,one_body_ion);
+    bytes+=sizeof(doublevar)*one_body_ion.GetSize();
+  }
+  return bytes;
+}
+
+//----------------------------------------------------------------------
+
+void Jastrow2_wf::restoreState(Wavefunction_storage * wfstate) { 
+  Jastrow2_state * state;
+  recast(wfstate, state);
+  electronIsStaleVal=state->electronIsStaleVal;
+  electronIsStaleLap=state->electronIsStaleLap;
+  updateEverythingVal=state->updateEverythingVal;
+  updateEverythingLap=state->updateEverythingLap;
+  one_body_save=state->one_body_save;
+  u_twobody=state->u_twobody;
+  array_cp(two_body_save,state->two_body_save);
+  for(int g=0; g< eibasis_save.GetDim(0); g++) 
+    array_cp(eibasis_save(g),state->eibasis_save(g));
+  if(keep_ion_dependent) 
+    array_cp(one_body_ion,state->one_body_ion);
+}
 //----------------------------------------------------------
 
 
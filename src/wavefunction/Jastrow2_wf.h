@@ -62,8 +62,22 @@ public:
 
   void set_up(vector <string> & words, System * sys);
   void updateEIBasis(int e, Sample_point * sample, Array3 <doublevar> & );
+  //! The basis as eesave(electron, function, [val grad lap]), zero for
+  //! the other electrons beyond the cutoff; element e isn't touched
   void updateEEBasis(int e, Sample_point * sample, Array3 <doublevar> & );
 
+  //! Distances of all the electrons to e, as dist([r r^2 x y z], electron)
+  //! in the order and sign of eesave
+  static void eeDistances(int e, Sample_point * sample, 
+                          Array2 <doublevar> & dist);
+  //! The basis as eecols(function, [val grad lap], electron), for the 
+  //! distances from eeDistances().  Column e is meaningless.
+  void updateEEBasis(int e, const Array2 <doublevar> & dist, 
+                     Array3 <doublevar> & eecols);
+  //! Copy the output of updateEEBasis(e,dist,eecols) to the eesave layout
+  void pairsFromColumns(int e, const Array3 <doublevar> & eecols,
+                        Array3 <doublevar> & eesave);
+
   int maxEIBasis() { return maxbasis_on_center; }
   int nEEBasis() { return n_eebasis; }
 
@@ -184,6 +198,25 @@ class Jastrow2_storage : public Wavefunction_storage {
 
 //######################################################################
 
+/*!
+The complete state of a Jastrow2_wf, for Jastrow2_wf::saveState()
+*/
+class Jastrow2_state : public Wavefunction_storage {
+  private:
+    friend class Jastrow2_wf;
+    Array1 <int> electronIsStaleVal;
+    Array1 <int> electronIsStaleLap;
+    int updateEverythingVal;
+    int updateEverythingLap;
+    Array2 <doublevar> one_body_save;
+    Array3 <doublevar> two_body_save;
+    doublevar u_twobody;
+    Array1 < Array4 <doublevar> > eibasis_save;
+    Array3 <doublevar> one_body_ion;
+};
+
+//######################################################################
+
 class Jastrow2_wf : public Wavefunction {
 public:
 
@@ -209,6 +242,16 @@ public:
 
   virtual void saveUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
   virtual void restoreUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
+
+  virtual void proposeLap(Wavefunction_data *, Sample_point *, int e, Wf_return &);
+  virtual void acceptMove(Wavefunction_data *, Sample_point *, int e);
+  virtual void rejectMove(Sample_point *, int e);
+  virtual void testRatios(Wavefunction_data *, Sample_point *, int e,
+                          const Array2 <doublevar> & pos, 
+                          Array1 <Wf_return> & ratio);
+
+  virtual int saveState(Wavefunction_storage * & wfstate);
+  virtual void restoreState(Wavefunction_storage * wfstate);
  
   virtual int getParmDeriv(Wavefunction_data *, Sample_point *,
                            Parm_deriv_return & );
@@ -249,6 +292,15 @@ public:
     onebody=one_body_save;
   }
 
+  //! one_body_save(e,:), and the row two_body_save(e,i,:) and column 
+  //! two_body_save(i,e,:), for the electron given to proposeLap()
+  void get_proposed_save(Array1 <doublevar> & one, Array2 <doublevar> & two_e, 
+                         Array2 <doublevar> & two_others) { 
+    one=prop_one;
+    two_e=prop_two_e;
+    two_others=prop_two_others;
+  }
+
   
 
 private:
@@ -272,10 +324,21 @@ private:
   doublevar u_twobody;
   //!< save for the total value of the two-body terms
   void update_eibasis_save(Wavefunction_data * wfdata, Sample_point * sample);
+  void electronLap(int e, Sample_point * sample, Array1 <doublevar> & one,
+                   Array2 <doublevar> & two_e, Array2 <doublevar> & two_others);
+  void storeElectron(int e, const Array1 <doublevar> & one,
+                     const Array2 <doublevar> & two_e, 
+                     const Array2 <doublevar> & two_others);
 
   Array1 <  Array4 <doublevar> > eibasis_save; 
   //!< first array is group, 4d array is (electron, ion, basis#, valgradlap)
   
+  //Scratch for proposeLap(), see electronLap()
+  Array1 <doublevar> prop_one;
+  Array2 <doublevar> prop_two_e;
+  Array2 <doublevar> prop_two_others;
+  Array1 < Array3 <doublevar> > prop_eibasis; //!< old rows of eibasis_save
+  
 
 
   //These are for backflow, which needs per-ion information
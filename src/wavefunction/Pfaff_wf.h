@@ -9,6 +9,8 @@
 #include "Qmc_std.h"
 #include "Array.h"
 #include "Wavefunction.h"
+#include "MO_matrix.h"
+#include "Delayed_inverse.h"
 class Wavefunction_data;
 class Pfaff_wf_data;
 class System;
@@ -16,6 +18,20 @@ class System;
 
 
 
+void UpdatePfaffianRowVal(Array1 <doublevar> & mopfaff_row, 
+                          int & e,  
+                          const Array3 <doublevar> &  moVal, 
+                          const Array1 < Array1 <int> > & occupation_pos,
+                          const Array1 <int> & npairs, 
+                          const Array2 <int> & order_in_pfaffian,
+                          const Array1 < Array1 <doublevar> > & tripletorbuu,
+			  const Array1 < Array1 <doublevar> > & tripletorbdd,
+                          const Array1 < Array1 <doublevar> > & singletorb,
+                          const Array1 < Array1 <doublevar> > & unpairedorb,
+                          const Array1 < Array1 <doublevar> > & normalization,
+                          doublevar coef_eps
+                          );
+
 void UpdatePfaffianRowLap( Array1 < Array1 <doublevar> > & mopfaff_row, 
                            int & e,  
                            const Array3 <doublevar> &  moVal, 
@@ -69,6 +85,8 @@ private:
   Array2 <doublevar>  moVal_temp;
   Array1 < Array2 <doublevar> >  inverse_temp;
   Array1 <doublevar> pfaffVal_temp;
+  Array1 <Delayed_pfaffian_inverse> delayed_temp;
+  Array2 <doublevar> matrow_temp; //!< (pf, j) row e of the Pfaffian matrix
 
 };
 
@@ -102,6 +120,9 @@ public:
   virtual void saveUpdate(Sample_point *, int e, Wavefunction_storage *);
   virtual void restoreUpdate(Sample_point *, int e, Wavefunction_storage *);
 
+  virtual void proposeLap(Wavefunction_data *, Sample_point *, int e, Wf_return &);
+  virtual void acceptMove(Wavefunction_data *, Sample_point *, int e);
+  virtual void rejectMove(Sample_point *, int e);
 
 
   virtual int getParmDeriv(Wavefunction_data *, 
@@ -112,6 +133,12 @@ public:
 			       int, 
 			       Wf_return &);
 
+  virtual void evalTestPos(Array1 <doublevar> & pos, Sample_point *, 
+                           Array1 <Wf_return> & wf);
+  virtual void testRatios(Wavefunction_data *, Sample_point *, int e,
+                          const Array2 <doublevar> & pos, 
+                          Array1 <Wf_return> & ratio);
+
   void generateStorage(Wavefunction_storage * & wfstore);
 
 
@@ -127,6 +154,15 @@ private:
   void updateVal(Pfaff_wf_data *, Sample_point *, int);
   void calcLap(Pfaff_wf_data *, Sample_point *);
   void updateLap(Pfaff_wf_data *, Sample_point *, int);
+  //! Replace row e of Pfaffian pf, and return the ratio of Pfaffians
+  doublevar updateInverse(int pf, Array1 <doublevar> & row, int e);
+  //! Column e of the current inverse of Pfaffian pf
+  void inverseColumn(int pf, int e, Array1 <doublevar> & col);
+  //! Bring the inverses up to date, if the updates are delayed
+  void flushDelayed();
+  //! The value of the wave function with row e of the orbitals replaced
+  //! by testmo
+  doublevar testValue(int e, const Array2 <doublevar> & testmo);
 
   Array1 <doublevar> electronIsStaleVal;
   Array1 <doublevar> electronIsStaleLap;
@@ -142,12 +178,27 @@ private:
   Array3 <doublevar> moVal;
 
   Array2 <doublevar> updatedMoVal;
+  MO_workspace <doublevar> mo_ws; //!< scratch space for the orbitals
 
   Array1 < Array2 <doublevar> > inverse;
   //!<inverse of the value part of the mo_values array transposed
 
   Array1 <doublevar> pfaffVal;
 
+  //! whether accepted moves are held in delayed instead of updating
+  //! the inverses right away.  mopfaff_tot is then kept up to date too.
+  int use_delay;
+  Array1 <Delayed_pfaffian_inverse> delayed; //!< (pf)
+
+  //Scratch for proposeLap()
+  Array2 <doublevar> prop_moVal; //!< old moVal(d,e,:) of the moved electron
+  Array1 < Array1 <doublevar> > prop_row; //!< new Pfaffian row for each pf
+  //! the proposal recomputed everything, so these are the old values
+  int prop_full;
+  Array1 < Array2 <doublevar> > prop_inverse;
+  Array1 <doublevar> prop_pfaffVal;
+  Array1 < Array2 <doublevar> > prop_mopfaff;
+
   //Variables for a static(electrons not moving) calculation
   Array3 <doublevar> saved_laplacian;
   //!<Saved laplacian for a static calculation (electron, function, [val grad lap])
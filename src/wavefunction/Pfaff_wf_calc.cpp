@@ -20,6 +20,8 @@ void Pfaff_wf::generateStorage(Wavefunction_storage * & wfstore)
   
   store->inverse_temp.Resize(npf);
   store->pfaffVal_temp.Resize(npf);
+  store->delayed_temp.Resize(npf);
+  store->matrow_temp.Resize(npf,npairs);
   
   for (int pf=0;pf<npf;pf++){
     store->inverse_temp(pf).Resize(npairs, npairs);
@@ -79,6 +81,16 @@ void Pfaff_wf::init(Wavefunction_data * wfdata)
                        upuppairs+downdownpairs+nopairs);
   }
 
+  //By default, only large Pfaffians are delayed; below that the rank-2
+  //updates are usually faster.
+  int ndelay=dataptr->delayed_updates;
+  if(ndelay < 0) ndelay=npairs > 256?16:1;
+  ndelay=min(ndelay,npairs);
+  use_delay=ndelay > 1;
+  delayed.Resize(npf);
+  for(int pf=0; pf< npf; pf++) 
+    delayed(pf).init(ndelay,npairs);
+
   electronIsStaleVal.Resize(tote);
   electronIsStaleLap.Resize(tote);
 
@@ -169,7 +181,15 @@ void Pfaff_wf::saveUpdate(Sample_point * sample, int e,
   recast(wfstore, store);
   
   for (int pf=0;pf<npf;pf++){
-    store->inverse_temp(pf)=inverse(pf);
+    if(use_delay) { 
+      //Delayed moves leave the inverse alone, so only the moves and the
+      //row of the matrix are saved
+      if(delayed(pf).room() < 1) delayed(pf).flush(inverse(pf));
+      store->delayed_temp(pf)=delayed(pf);
+      for(int j=0; j< npairs; j++) 
+        store->matrow_temp(pf,j)=mopfaff_tot(pf)(e,j);
+    }
+    else store->inverse_temp(pf)=inverse(pf);
     store->pfaffVal_temp(pf)=pfaffVal(pf);
   }   
   
@@ -196,7 +216,21 @@ void Pfaff_wf::restoreUpdate(Sample_point * sample, int e,
   }
   
   for (int pf=0;pf<npf;pf++){
-    inverse(pf)=store->inverse_temp(pf);
+    if(use_delay) { 
+      if(delayed(pf).changes()==store->delayed_temp(pf).changes()) 
+        delayed(pf)=store->delayed_temp(pf);
+      else { 
+        //The inverse itself changed since saveUpdate(), so the saved 
+        //moves don't apply to it any more.  Start over.
+        updateEverythingVal=1;
+        updateEverythingLap=1;
+      }
+      for(int j=0; j< npairs; j++) { 
+        mopfaff_tot(pf)(e,j)=store->matrow_temp(pf,j);
+        mopfaff_tot(pf)(j,e)=-store->matrow_temp(pf,j);
+      }
+    }
+    else inverse(pf)=store->inverse_temp(pf);
     pfaffVal(pf)=store->pfaffVal_temp(pf);
   }
   electronIsStaleVal(e)=0;
@@ -205,6 +239,158 @@ void Pfaff_wf::restoreUpdate(Sample_point * sample, int e,
 
 //----------------------------------------------------------------------
 
+doublevar Pfaff_wf::updateInverse(int pf, Array1 <doublevar> & row, int e) { 
+  if(use_delay) 
+    return delayed(pf).update(inverse(pf),mopfaff_tot(pf),row,e);
+  Array1 <doublevar> column(npairs);
+  return UpdateInversePfaffianMatrix(inverse(pf),row,column,e);
+}
+
+//----------------------------------------------------------------------
+
+void Pfaff_wf::inverseColumn(int pf, int e, Array1 <doublevar> & col) { 
+  if(use_delay) { 
+    delayed(pf).column(inverse(pf),e,col);
+    return;
+  }
+  col.Resize(npairs);
+  for(int j=0; j< npairs; j++) col(j)=inverse(pf)(j,e);
+}
+
+//----------------------------------------------------------------------
+
+void Pfaff_wf::flushDelayed() { 
+  if(use_delay) 
+    for(int pf=0; pf< npf; pf++) delayed(pf).flush(inverse(pf));
+}
+
+//----------------------------------------------------------------------
+
+/*!
+Ratios come from the old inverse: for a new row \f$ r \f$ of the Pfaffian 
+matrix, the new Pfaffian is \f$ Pf \sum_j r_j A^{-1}_{je} \f$, and
+UpdateInversePfaffianMatrix() divides row and column e of the inverse by 
+that ratio, so the gradient and laplacian follow without changing it.
+*/
+void Pfaff_wf::proposeLap(Wavefunction_data * wfdata, Sample_point * sample,
+                          int e, Wf_return & lap) { 
+  Pfaff_wf_data * dataptr;
+  recast(wfdata, dataptr);
+  int nrow=npairs;
+  int nmo_e=moVal.GetDim(2);
+  prop_moVal.Resize(5,nmo_e);
+  for(int d=0; d< 5; d++)
+    for(int i=0; i< nmo_e; i++)
+      prop_moVal(d,i)=moVal(d,e,i);
+
+  prop_full=0;
+  for(int pf=0; pf< npf; pf++)
+    if(pfaffVal(pf)==0) prop_full=1;
+  if(prop_full) { 
+    //Same as updateLap(), which starts over at a zero Pfaffian
+    flushDelayed();
+    prop_inverse=inverse;
+    prop_pfaffVal=pfaffVal;
+    if(use_delay) prop_mopfaff=mopfaff_tot;
+    calcLap(dataptr,sample);
+    getLap(wfdata,e,lap);
+    return;
+  }
+
+  if(updateMoLap==1) { 
+    sample->updateEIDist();
+    dataptr->molecorb->updateLap(sample,e,0,updatedMoVal,mo_ws);
+    for(int d=0; d< 5; d++)
+      for(int i=0; i< nmo_e; i++)
+        moVal(d,e,i)=updatedMoVal(i,d);
+  }
+
+  Array1 < Array1 <doublevar> > row_lap;
+  Array1 <doublevar> invcol;
+  Array1 <doublevar> newpfaff(npf);
+  Array2 <doublevar> ders(npf,5);
+  prop_row.Resize(npf);
+  for(int pf=0; pf< npf; pf++) { 
+    prop_row(pf).Resize(nrow);
+    UpdatePfaffianRowVal(prop_row(pf), e, moVal, dataptr->occupation_pos,
+                         dataptr->npairs, dataptr->order_in_pfaffian(pf),
+                         dataptr->tripletorbuu, dataptr->tripletorbdd,
+                         dataptr->singletorb, dataptr->unpairedorb,
+                         dataptr->normalization, coef_eps);
+    UpdatePfaffianRowLap(row_lap, e, moVal, dataptr->occupation_pos,
+                         dataptr->npairs, dataptr->order_in_pfaffian(pf),
+                         dataptr->tripletorbuu, dataptr->tripletorbdd,
+                         dataptr->singletorb, dataptr->unpairedorb,
+                         dataptr->normalization, coef_eps);
+    inverseColumn(pf,e,invcol);
+    doublevar ratio=0.0;
+    for(int j=0; j< nrow; j++) ratio+=prop_row(pf)(j)*invcol(j);
+    if(ratio==0) ratio=1e-20; //as in UpdateInversePfaffianMatrix()
+    newpfaff(pf)=pfaffVal(pf)*ratio;
+    for(int d=1; d< 5; d++) { 
+      doublevar temp=0.0;
+      for(int j=0; j< nrow; j++) 
+        temp+=row_lap(j)(d)*invcol(j);
+      ders(pf,d)=temp/ratio;
+    }
+  }
+
+  //getLap() with the updated inverse and Pfaffians
+  Array1 <doublevar> si(1, 0.0);
+  Array2 <doublevar> vals(1,5,0.0);
+  doublevar funcval=0;
+  for(int pf=0; pf< npf; pf++)
+    funcval+=dataptr->pfwt(pf)*newpfaff(pf);
+  si(0)=sign(funcval);
+  if(fabs(funcval) > 0)
+    vals(0,0)=log(fabs(funcval));
+  else vals(0,0)=-1e3;
+  for(int d=1; d< 5; d++) { 
+    for(int pf=0; pf< npf; pf++) { 
+      doublevar temp=ders(pf,d);
+      if(dataptr->pfwt(pf)==0)
+        temp=0.0;
+      if(npf > 1)
+        temp*=dataptr->pfwt(pf)*newpfaff(pf);
+      vals(0,d)+=temp;
+    }
+    if(funcval==0)
+      vals(0,d)=0;
+    else if(npf > 1)
+      vals(0,d)/=funcval;
+  }
+  lap.setVals(vals, si);
+}
+
+//----------------------------------------------------------------------
+
+void Pfaff_wf::acceptMove(Wavefunction_data * wfdata, Sample_point * sample,
+                          int e) { 
+  if(!prop_full) { 
+    for(int pf=0; pf< npf; pf++) 
+      pfaffVal(pf)*=updateInverse(pf, prop_row(pf), e);
+  }
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//----------------------------------------------------------------------
+
+void Pfaff_wf::rejectMove(Sample_point * sample, int e) { 
+  for(int d=0; d< 5; d++)
+    for(int i=0; i< moVal.GetDim(2); i++)
+      moVal(d,e,i)=prop_moVal(d,i);
+  if(prop_full) { 
+    inverse=prop_inverse;
+    pfaffVal=prop_pfaffVal;
+    if(use_delay) mopfaff_tot=prop_mopfaff;
+  }
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//----------------------------------------------------------------------
+
 void Pfaff_wf::updateVal(Wavefunction_data * wfdata,
                         Sample_point * sample)
 {
@@ -1323,6 +1509,7 @@ int Pfaff_wf::getParmDeriv(Wavefunction_data *  wfdata,
 
   derivatives.gradient.Resize(nparms);
   derivatives.hessian.Resize(nparms, nparms);
+  flushDelayed();
  
   if(parent->optimize_pf){
 
@@ -1605,7 +1792,7 @@ void Pfaff_wf::updateVal(Pfaff_wf_data * dataptr, Sample_point * sample, int e)
     //update all the mo's that we will be using.
     dataptr->molecorb->updateVal(sample, e,
 				 0,
-				 updatedMoVal);
+				 updatedMoVal, mo_ws);
     
     //  for(int i=0; i< updatedMoVal.GetDim(0); i++) {
     //  cout << "updatedMoVal " << updatedMoVal(i,0) << endl;
@@ -1619,7 +1806,6 @@ void Pfaff_wf::updateVal(Pfaff_wf_data * dataptr, Sample_point * sample, int e)
 
    
   Array1 <doublevar> mopfaff_row(upuppairs+downdownpairs+nopairs);
-  Array1 <doublevar> mopfaff_column(upuppairs+downdownpairs+nopairs);
 
   
 
@@ -1642,7 +1828,7 @@ void Pfaff_wf::updateVal(Pfaff_wf_data * dataptr, Sample_point * sample, int e)
    
     //cout <<" After Update e-th row& column for pfaffian"<<endl;
 
-    ratio= UpdateInversePfaffianMatrix(inverse(pf), mopfaff_row, mopfaff_column, e);
+    ratio=updateInverse(pf, mopfaff_row, e);
   
     // cout << "Pfaffval before " << pfaffVal << "ratio " << ratio << endl;
     //update detVal
@@ -1697,6 +1883,123 @@ void Pfaff_wf::getSymmetricVal(Wavefunction_data * wfdata,
   val.setVals(vals, si);
 } 
 
+//----------------------------------------------------------------------
+
+/*!
+Row e of moVal is replaced by the orbitals at the test position, testmo, 
+and electron e then only needs its new row of the Pfaffian matrix; the 
+ratio is \f$ \sum_j r_j A^{-1}_{je} \f$ as in proposeLap().  A zero 
+Pfaffian has no inverse, so that one is recalculated from scratch.  
+Returns the value of the wave function.
+*/
+doublevar Pfaff_wf::testValue(int e, const Array2 <doublevar> & testmo) { 
+  Pfaff_wf_data * dataptr=parent;
+  int nmo_e=moVal.GetDim(2);
+  Array1 <doublevar> row(npairs), invcol, savedmo(nmo_e);
+  Array2 <doublevar> fullmat;
+  for(int i=0; i< nmo_e; i++) { 
+    savedmo(i)=moVal(0,e,i);
+    moVal(0,e,i)=testmo(i,0);
+  }
+  doublevar funcval=0;
+  for(int pf=0; pf< npf; pf++) { 
+    doublevar newpfaff;
+    if(pfaffVal(pf)==0) { 
+      fullmat.Resize(npairs,npairs);
+      FillPfaffianMatrix(fullmat, moVal, dataptr->occupation_pos,
+                         dataptr->npairs, dataptr->order_in_pfaffian(pf),
+                         dataptr->tripletorbuu, dataptr->tripletorbdd,
+                         dataptr->singletorb, dataptr->unpairedorb,
+                         dataptr->normalization, coef_eps);
+      newpfaff=Pfaffian_blocked(fullmat);
+    }
+    else { 
+      UpdatePfaffianRowVal(row, e, moVal, dataptr->occupation_pos,
+                           dataptr->npairs, dataptr->order_in_pfaffian(pf),
+                           dataptr->tripletorbuu, dataptr->tripletorbdd,
+                           dataptr->singletorb, dataptr->unpairedorb,
+                           dataptr->normalization, coef_eps);
+      inverseColumn(pf,e,invcol);
+      doublevar ratio=0.0;
+      for(int j=0; j< npairs; j++) ratio+=row(j)*invcol(j);
+      newpfaff=pfaffVal(pf)*ratio;
+    }
+    funcval+=dataptr->pfwt(pf)*newpfaff;
+  }
+  for(int i=0; i< nmo_e; i++) 
+    moVal(0,e,i)=savedmo(i);
+  return funcval;
+}
+
+//----------------------------------------------------------------------
+
+/*!
+The orbitals at pos are the same for every electron, so they are 
+evaluated once.
+*/
+void Pfaff_wf::evalTestPos(Array1 <doublevar> & pos, Sample_point * sample,
+                           Array1 <Wf_return> & wf) { 
+  Pfaff_wf_data * dataptr=parent;
+  int nmo_e=moVal.GetDim(2);
+  Array2 <doublevar> testmo(nmo_e,1);
+  Array1 <doublevar> oldpos(3);
+  sample->getElectronPos(0,oldpos);
+  sample->setElectronPosNoNotify(0,pos);
+  sample->updateEIDist();
+  dataptr->molecorb->updateVal(sample,0,0,testmo,mo_ws);
+  sample->setElectronPosNoNotify(0,oldpos);
+  sample->updateEIDist();
+
+  int tote=nelectrons(0)+nelectrons(1);
+  wf.Resize(tote);
+  Array1 <doublevar> si(1, 0.0);
+  Array2 <doublevar> vals(1,1,0.0);
+  for(int e=0; e< tote; e++) { 
+    doublevar funcval=testValue(e,testmo);
+    si(0)=sign(funcval);
+    if(fabs(funcval) > 0)
+      vals(0,0)=log(fabs(funcval));
+    else
+      vals(0,0)=-1e3;
+    wf(e).Resize(1,1);
+    wf(e).setVals(vals, si);
+  }
+}
+
+//----------------------------------------------------------------------
+
+/*!
+The orbitals at all the test positions are evaluated in one batch.
+*/
+void Pfaff_wf::testRatios(Wavefunction_data * wfdata, Sample_point * sample,
+                          int e, const Array2 <doublevar> & pos,
+                          Array1 <Wf_return> & ratio) { 
+  //updateVal() only brings the Pfaffians up to date when they're 
+  //optimized, so make sure they are current here
+  updateLap(wfdata,sample);
+  Pfaff_wf_data * dataptr=parent;
+  doublevar oldval=0;
+  for(int pf=0; pf< npf; pf++) 
+    oldval+=dataptr->pfwt(pf)*pfaffVal(pf);
+  doublevar oldlog=fabs(oldval) > 0 ? log(fabs(oldval)) : -1e3;
+
+  int npos=pos.GetDim(0);
+  int nmo_e=moVal.GetDim(2);
+  Array1 <Array2 <doublevar> > testmo(npos);
+  for(int k=0; k< npos; k++) testmo(k).Resize(nmo_e,1);
+  dataptr->molecorb->updateValBatch(sample,e,pos,0,testmo,mo_ws);
+
+  ratio.Resize(npos);
+  Array1 <doublevar> si(1, 0.0);
+  Array2 <doublevar> vals(1,1,0.0);
+  for(int k=0; k< npos; k++) { 
+    doublevar funcval=testValue(e,testmo(k));
+    vals(0,0)=(fabs(funcval) > 0 ? log(fabs(funcval)) : -1e3)-oldlog;
+    si(0)=sign(funcval)*sign(oldval);
+    ratio(k).Resize(1,1);
+    ratio(k).setVals(vals, si);
+  }
+}
 
 //----------------------------------------------------------------------
 
@@ -1723,7 +2026,7 @@ void Pfaff_wf::calcLap(Pfaff_wf_data * dataptr, Sample_point * sample)
 
       dataptr->molecorb->updateLap(sample, e,
                                    0,
-                                   updatedMoVal);
+                                   updatedMoVal, mo_ws);
       
 
       //   for(int i=0; i< updatedMoVal.GetDim(0); i++) {
@@ -1789,6 +2092,7 @@ void Pfaff_wf::calcLap(Pfaff_wf_data * dataptr, Sample_point * sample)
     // cout << "Sqrt of Pfaffian matrix is: "
     //	 <<sqrt(Determinant(mopfaff_tot,mopfaff_tot.GetDim(0)))<<endl;
     pfaffVal(pf) = PfaffianInverseMatrix(mopfaff_tot(pf), inverse(pf));
+    if(use_delay) delayed(pf).reset();
     //cout << "Pfaffian value:             "<< pfaffVal(pf) << endl;
 
     
@@ -1861,13 +2165,16 @@ void Pfaff_wf::getLap(Wavefunction_data * wfdata,
                          coef_eps
                          );
   }
+  Array1 < Array1 <doublevar> > invcol(npf);
+  for (int pf=0;pf<npf;pf++)
+    inverseColumn(pf,e,invcol(pf));
   // cout.setf(ios::scientific| ios:: showpos);
   for(int d=1; d< 5; d++){
     vals(shiftf,d)=0.0;
     for (int pf=0;pf<npf;pf++){
       doublevar temp=0.0;
       for(int j=0; j<upuppairs+downdownpairs+nopairs; j++){
-        temp+=mopfaff_row(pf)(j)(d)*inverse(pf)(j,e);
+        temp+=mopfaff_row(pf)(j)(d)*invcol(pf)(j);
         //updated row*inverse matrix;
       }
       if(dataptr->pfwt(pf)==0)
@@ -1929,7 +2236,7 @@ void Pfaff_wf::updateLap(
     //update all the mo's that we will be using.
     dataptr->molecorb->updateLap(sample, e,
                                  0,
-                                 updatedMoVal);
+                                 updatedMoVal, mo_ws);
   
 
   // sample->getElectronPos(e, elecpos);
@@ -1951,7 +2258,6 @@ void Pfaff_wf::updateLap(
   //cout << "moVal(0,0,2) "<<moVal(0,0,2);
 
   Array1 <doublevar> mopfaff_row(upuppairs+downdownpairs+nopairs);
-  Array1 <doublevar> mopfaff_column(upuppairs+downdownpairs+nopairs);
  
   for (int pf=0;pf<npf;pf++){
     UpdatePfaffianRowVal(mopfaff_row, 
@@ -1969,7 +2275,7 @@ void Pfaff_wf::updateLap(
                          );
   
     //ratio pf(new)/pf(old);
-    ratio= UpdateInversePfaffianMatrix(inverse(pf), mopfaff_row, mopfaff_column, e);
+    ratio=updateInverse(pf, mopfaff_row, e);
   
     //cout << "Pfaffval before# " << pfaffVal << "  ratio#  " << ratio << endl;
 
@@ -72,6 +72,13 @@ void Pfaff_wf_data::read(vector <string> & words, unsigned int & pos,
        cout<<"Using treshold = "<<coef_eps<<" for pairing coeficients"<<endl;
   }
 
+  //-1 lets Pfaff_wf decide by the size of the Pfaffian matrix
+  if(readvalue(words,pos=startpos,delayed_updates,"DELAYED_UPDATES")) { 
+    if(delayed_updates < 1) 
+      error("DELAYED_UPDATES must be at least 1");
+  }
+  else delayed_updates=-1;
+
   vector <string> str_order;
   pos=startpos;
   int max=0;
@@ -841,6 +848,10 @@ int Pfaff_wf_data::supports(wf_support_type support) {
     return 1;
   case parameter_derivatives:
     return 1;
+  case move_proposal:
+    return 1;
+  case test_ratios:
+    return 1;
   default:
     return 0;
   }
@@ -1053,6 +1064,8 @@ int Pfaff_wf_data::writeinput(string & indent, ostream & os)
   os << "}" << endl;
   if (optimize_pfwt)
     os << indent << "OPTIMIZE_PFWT" <<endl;
+  if(delayed_updates > 0)
+    os << indent << "DELAYED_UPDATES " << delayed_updates << endl;
 
   os << indent << "ORBITAL_ORDER {  "<<endl;
   for(int pf=0;pf<npf;pf++){
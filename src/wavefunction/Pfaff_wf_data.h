@@ -123,6 +123,8 @@ private:
   int optimize_pf; //!< whether to optimize Pairing orbitals
   int optimize_pfwt; //!< whether to optimize pfaffian weights
   int check_pfwt_sign; //!< whether to check sign of weihght of multipfaffian
+  //! accepted moves to hold before updating the inverses; -1 for the default
+  int delayed_updates;
   Array1 < Array1 <string>  > optimize_string; //!<acctually counts all the coeficients to be optimized
   Array1 < Array1 < Array1 <int> > > optimize_total; //! optimize_total(pf)(uu,dd,singlet,unpaired,alpha)(poss)=1/0;
   //Array1 <int> optimize_bonds; //! optimize_bonds(....,1,...,2,....,2,...,1,...,3,3,3,3....) each ineteger connects one bond
@@ -0,0 +1,160 @@
+/*
+
+Copyright (C) 2007 Lucas K. Wagner
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef SINGLE_INVERSE_H_INCLUDED
+#define SINGLE_INVERSE_H_INCLUDED
+
+#include "Qmc_std.h"
+#include "Array.h"
+
+//! The single precision type that stands in for T
+template <class T> struct Single_precision { typedef float type; };
+template <> struct Single_precision<dcomplex> {
+  typedef complex<float> type;
+};
+
+//y=a x and then a+=alpha u v^T, all row-major n by n
+inline void single_gemv(int n, const float * a, int lda, const float * x,
+                        float * y) {
+#ifdef USE_BLAS
+  cblas_sgemv(CblasRowMajor,CblasNoTrans,n,n,1.0f,a,lda,x,1,0.0f,y,1);
+#else
+  for(int i=0; i< n; i++) {
+    float sum=0.0f;
+    for(int j=0; j< n; j++) sum+=a[i*lda+j]*x[j];
+    y[i]=sum;
+  }
+#endif
+}
+
+inline void single_ger(int n, float alpha, const float * u, const float * v,
+                       float * a, int lda) {
+#ifdef USE_BLAS
+  cblas_sger(CblasRowMajor,n,n,alpha,u,1,v,1,a,lda);
+#else
+  for(int i=0; i< n; i++) {
+    float au=alpha*u[i];
+    for(int j=0; j< n; j++) a[i*lda+j]+=au*v[j];
+  }
+#endif
+}
+
+inline void single_gemv(int n, const complex<float> * a, int lda,
+                        const complex<float> * x, complex<float> * y) {
+#ifdef USE_BLAS
+  complex<float> one(1.0f), zero(0.0f);
+  cblas_cgemv(CblasRowMajor,CblasNoTrans,n,n,&one,a,lda,x,1,&zero,y,1);
+#else
+  for(int i=0; i< n; i++) {
+    complex<float> sum=0.0f;
+    for(int j=0; j< n; j++) sum+=a[i*lda+j]*x[j];
+    y[i]=sum;
+  }
+#endif
+}
+
+inline void single_ger(int n, complex<float> alpha, const complex<float> * u,
+                       const complex<float> * v, complex<float> * a,
+                       int lda) {
+#ifdef USE_BLAS
+  cblas_cgeru(CblasRowMajor,n,n,&alpha,u,1,v,1,a,lda);
+#else
+  for(int i=0; i< n; i++) {
+    complex<float> au=alpha*u[i];
+    for(int j=0; j< n; j++) a[i*lda+j]+=au*v[j];
+  }
+#endif
+}
+
+//----------------------------------------------------------------------
+
+/*!
+\brief
+A determinant inverse kept in single precision between double precision
+recomputations.
+
+Slat_wf inverts the matrix in double precision and load()s the result.
+The Sherman-Morrison updates after that are done on the single precision
+copy, which halves the memory traffic of the O(n^2) updates and ratios.
+The rounding errors pile up with each update, so the caller recomputes
+the inverse after some number of updates(), or sooner if the row of the
+inverse of an electron no longer gives a ratio of one with its own
+orbitals.  Dot products are summed in double precision.
+*/
+template <class T> class Single_inverse {
+ public:
+  typedef typename Single_precision<T>::type S;
+
+  Single_inverse():n(0),nupdates(0) { }
+
+  //! Round a freshly computed inverse to single precision
+  void load(const Array2 <T> & inverse) {
+    n=inverse.GetDim(0);
+    inv.Resize(n,n);
+    for(int i=0; i< n; i++)
+      for(int j=0; j< n; j++) inv(i,j)=S(inverse(i,j));
+    nupdates=0;
+  }
+
+  //! Copy back to double precision, for code that needs the full inverse
+  void store(Array2 <T> & inverse) const {
+    for(int i=0; i< n; i++)
+      for(int j=0; j< n; j++) inverse(i,j)=T(inv(i,j));
+  }
+
+  //! Number of updates since the last load()
+  int updates() const { return nupdates; }
+
+  //! The ratio of determinants if column e were replaced by c
+  T ratio(const Array1 <T> & c, int e) const {
+    T r=T(0.0);
+    for(int j=0; j< n; j++) r+=T(inv(e,j))*c(j);
+    return r;
+  }
+
+  /*!
+    Replace column e with c, and return the ratio of the new determinant
+    to the old one.
+   */
+  T update(const Array1 <T> & c, int e) {
+    T r=ratio(c,e);
+    cs.Resize(n);
+    rowe.Resize(n);
+    prod.Resize(n);
+    for(int j=0; j< n; j++) {
+      cs(j)=S(c(j));
+      rowe(j)=inv(e,j);
+    }
+    single_gemv(n,inv.v,n,cs.v,prod.v);
+    S rinv=S(T(1.0)/r);
+    single_ger(n,-rinv,prod.v,rowe.v,inv.v,n);
+    for(int j=0; j< n; j++) inv(e,j)=rinv*rowe(j);
+    nupdates++;
+    return r;
+  }
+
+ private:
+  int n, nupdates;
+  Array2 <S> inv;
+  Array1 <S> cs, rowe, prod;
+};
+
+#endif //SINGLE_INVERSE_H_INCLUDED
+//----------------------------------------------------------------------
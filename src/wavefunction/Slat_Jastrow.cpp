@@ -96,6 +96,29 @@ void Slat_Jastrow::restoreUpdate(Sample_point * sample, int e1, int e2, Wavefunc
   jastrow_wf->restoreUpdate(sample, e1, e2, store->jast_store);
 }
 
+//----------------------------------------------------------------------
+
+int Slat_Jastrow::saveState(Wavefunction_storage * & wfstate)
+{
+  if(wfstate==NULL) wfstate=new Slat_Jastrow_storage;
+  Slat_Jastrow_storage * store;
+  recast(wfstate, store);
+  int slat_bytes=slater_wf->saveState(store->slat_store);
+  int jast_bytes=jastrow_wf->saveState(store->jast_store);
+  if(slat_bytes==0 || jast_bytes==0) return 0;
+  return slat_bytes+jast_bytes;
+}
+
+//----------------------------------------------------------------------
+
+void Slat_Jastrow::restoreState(Wavefunction_storage * wfstate)
+{
+  Slat_Jastrow_storage * store;
+  recast(wfstate, store);
+  slater_wf->restoreState(store->slat_store);
+  jastrow_wf->restoreState(store->jast_store);
+}
+
 
 
 void Slat_Jastrow::getVal(Wavefunction_data * wfdata,
@@ -326,7 +349,13 @@ void Slat_Jastrow::getLap(Wavefunction_data * wfdata, int e,
 
   slater_wf->getLap(dataptr->slater, e, slat_lap);
   jastrow_wf->getLap(dataptr->jastrow, e, jast_lap);
+  combineLap(slat_lap,jast_lap,lap);
+}
+
+//----------------------------------------------------------------------
 
+void Slat_Jastrow::combineLap(Wf_return & slat_lap, Wf_return & jast_lap,
+                              Wf_return & lap) { 
   if ( slat_lap.is_complex==1 || jast_lap.is_complex==1 )
     lap.is_complex=1;
 
@@ -357,6 +386,63 @@ void Slat_Jastrow::getLap(Wavefunction_data * wfdata, int e,
   }
 }
 
+//----------------------------------------------------------------------
+
+void Slat_Jastrow::proposeLap(Wavefunction_data * wfdata, Sample_point * sample,
+                              int e, Wf_return & lap) { 
+  Slat_Jastrow_data * dataptr;
+  recast(wfdata, dataptr);
+  assert(dataptr != NULL);
+
+  Wf_return slat_lap(nfunc_,5);
+  Wf_return jast_lap(nfunc_,5);
+  slater_wf->proposeLap(dataptr->slater, sample, e, slat_lap);
+  jastrow_wf->proposeLap(dataptr->jastrow, sample, e, jast_lap);
+  combineLap(slat_lap,jast_lap,lap);
+}
+
+//----------------------------------------------------------------------
+
+void Slat_Jastrow::acceptMove(Wavefunction_data * wfdata, Sample_point * sample,
+                              int e) { 
+  Slat_Jastrow_data * dataptr;
+  recast(wfdata, dataptr);
+  assert(dataptr != NULL);
+  slater_wf->acceptMove(dataptr->slater, sample, e);
+  jastrow_wf->acceptMove(dataptr->jastrow, sample, e);
+}
+
+//----------------------------------------------------------------------
+
+void Slat_Jastrow::rejectMove(Sample_point * sample, int e) { 
+  slater_wf->rejectMove(sample,e);
+  jastrow_wf->rejectMove(sample,e);
+}
+
+//----------------------------------------------------------------------
+
+void Slat_Jastrow::testRatios(Wavefunction_data * wfdata, Sample_point * sample,
+                              int e, const Array2 <doublevar> & pos,
+                              Array1 <Wf_return> & ratio) { 
+  Slat_Jastrow_data * dataptr;
+  recast(wfdata, dataptr);
+  assert(dataptr != NULL);
+
+  Array1 <Wf_return> slat_ratio, jast_ratio;
+  slater_wf->testRatios(dataptr->slater, sample, e, pos, slat_ratio);
+  jastrow_wf->testRatios(dataptr->jastrow, sample, e, pos, jast_ratio);
+  int npos=pos.GetDim(0);
+  ratio.Resize(npos);
+  for(int k=0; k< npos; k++) { 
+    ratio(k).Resize(nfunc_,1);
+    ratio(k).is_complex=slat_ratio(k).is_complex || jast_ratio(k).is_complex;
+    //the Jastrow factor is one function, shared by all of them
+    for(int w=0; w< nfunc_; w++) { 
+      ratio(k).amp(w,0)=slat_ratio(k).amp(w,0)+jast_ratio(k).amp(0,0);
+      ratio(k).phase(w,0)=slat_ratio(k).phase(w,0)+jast_ratio(k).phase(0,0);
+    }
+  }
+}
 
 //----------------------------------------------------------------------
 
@@ -96,6 +96,16 @@ public:
   virtual void saveUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
   virtual void restoreUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
 
+  virtual void proposeLap(Wavefunction_data *, Sample_point *, int e, Wf_return &);
+  virtual void acceptMove(Wavefunction_data *, Sample_point *, int e);
+  virtual void rejectMove(Sample_point *, int e);
+  virtual void testRatios(Wavefunction_data *, Sample_point *, int e,
+                          const Array2 <doublevar> & pos, 
+                          Array1 <Wf_return> & ratio);
+
+  virtual int saveState(Wavefunction_storage * & wfstate);
+  virtual void restoreState(Wavefunction_storage * wfstate);
+
   
   virtual int getParmDeriv(Wavefunction_data *, 
 			    Sample_point *,
@@ -111,6 +121,7 @@ public:
 			       string );
 
 private:
+  void combineLap(Wf_return & slat_lap, Wf_return & jast_lap, Wf_return & lap);
   friend class Slat_Jastrow_data;
   Wavefunction * slater_wf;
   Wavefunction * jastrow_wf;
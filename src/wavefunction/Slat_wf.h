@@ -28,6 +28,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "MatrixAlgebra.h"
 #include "MO_matrix.h"
 #include "clark_updates.h"
+#include "Delayed_inverse.h"
+#include "Single_inverse.h"
 class Wavefunction_data;
 class Slat_wf_data;
 class System;
@@ -49,12 +51,43 @@ private:
   // Added by Matous
   Array2 <T>  moVal_temp_2;
  
-  Array3 < Array2 <T> > inverse_temp;
+  Array3 < Array2 <T> > inverse_temp; //!< (function, string, spin)
   Array3 <log_value<T> > detVal_temp;
+  Array1 < Array2 <T> > table_temp; //!< (spin)
+  Array3 < Delayed_inverse<T> > delayed_temp;
+  Array3 < Single_inverse<T> > single_temp;
 
 };
 
 
+/*!
+The complete state of a Slat_wf, for Slat_wf::saveState()
+*/
+template <class T> class Slat_wf_state : public Wavefunction_storage
+{
+public:
+  virtual ~Slat_wf_state()
+  {}
+private:
+  friend class Slat_wf<T>;
+  Array1 <int> electronIsStaleVal;
+  Array1 <int> electronIsStaleLap;
+  int updateEverythingVal;
+  int updateEverythingLap;
+  int inverseStale;
+  int lastValUpdate;
+  Array3 <log_value<T> > lastDetVal;
+  Array3 <T> moVal;
+  Array3 < Array2 <T> > inverse;
+  Array3 <log_value<T> > detVal;
+  Array1 < Array2 <T> > table;
+  Array3 < Delayed_inverse<T> > delayed;
+  Array3 < Single_inverse<T> > single;
+};
+
+
+//----------------------------------------------------------------------
+
 /*!
 A slater wavefunction; \f$\Psi=\sum_i det_i(\Phi_1\Phi_2...)\f$
 where the \f$\Phi\f$'s are one-particle molecular orbitals.
@@ -90,6 +123,16 @@ public:
   // Added by Matous
   virtual void saveUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
   virtual void restoreUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *);
+
+  virtual void proposeLap(Wavefunction_data *, Sample_point *, int e, Wf_return &);
+  virtual void acceptMove(Wavefunction_data *, Sample_point *, int e);
+  virtual void rejectMove(Sample_point *, int e);
+  virtual void testRatios(Wavefunction_data *, Sample_point *, int e,
+                          const Array2 <doublevar> & pos, 
+                          Array1 <Wf_return> & ratio);
+
+  virtual int saveState(Wavefunction_storage * & wfstate);
+  virtual void restoreState(Wavefunction_storage * wfstate);
   
 
   virtual int getParmDeriv(Wavefunction_data *, 
@@ -119,6 +162,31 @@ private:
   void calcLap(Slat_wf_data *, Sample_point *);
   void updateLap(Slat_wf_data *, Sample_point *, int);
   void getDetLap(int e, Array3<log_value <T> > & vals );
+  //! Build table(s) from scratch, from inverse(0,0,s) and moVal
+  void buildTable(int s);
+  //! Bring all the inverses up to date, if the updates are delayed or
+  //! kept in single precision
+  void flushDelayed();
+  //! Number of unique occupations of spin s in function f
+  int nstrings(int f, int s) { return parent->string_det(f,s).GetDim(0); }
+  //! The unique occupation of spin s that determinant det uses
+  int str(int f, int det, int s) { return parent->spin_string(f,det,s); }
+  //! Save the delayed updates of spin s, making room for nmove more moves
+  void saveDelayed(int s, int nmove, Slat_wf_storage<T> * store);
+  void restoreDelayed(int s, Slat_wf_storage<T> * store);
+  //! Invert the matrix of string u of spin s in function f from scratch
+  void recalcInverse(int f, int u, int s);
+  //! The ratio if electron e's column of string u were replaced by c,
+  //! from the Sherman-Morrison inverse
+  T inverseRatio(int f, int u, int s, const Array1 <T> & c, int e) {
+    if(use_single(s)) return single(f,u,s).ratio(c,rede(e));
+    T ratio=0;
+    for(int j=0; j< nelectrons(s); j++) ratio+=c(j)*inverse(f,u,s)(rede(e),j);
+    return ratio;
+  }
+  //! How far the single precision inverse of a string is from the 
+  //! inverse, judged by one electron's ratio with itself
+  doublevar singleError(int f, int u, int s);
   
 
   Array1 <int> electronIsStaleVal;
@@ -139,11 +207,30 @@ private:
   Array3 <T>  moVal;
 
   Array2 <T> updatedMoVal;
+  Array2 <T> proposedMoVal; //!< (MO, [val grad lap]) from proposeLap()
+  MO_workspace <T> mo_ws; //!< scratch space for molecorb
 
+  //Determinants that share the occupation of a spin share its inverse
+  //and value, so these are indexed by the unique occupations (strings) of 
+  //Slat_wf_data::find_spin_strings().  A determinant's value is 
+  //detVal(f,str(f,det,0),0)*detVal(f,str(f,det,1),1).
   Array3 < Array2 <T> > inverse;
   //!<inverse of the value part of the mo_values array transposed
 
-  Array3 <log_value<T> > detVal; //function #, determinant #, spin
+  Array3 <log_value<T> > detVal; //function #, string #, spin
+
+  //! (spin) table of the Excitation_list, if use_clark_updates
+  Array1 < Array2 <T> > table;
+
+  //! (spin) whether accepted moves are held in delayed instead of 
+  //! updating the inverse
+  Array1 <int> use_delay;
+  Array3 < Delayed_inverse<T> > delayed; //!< (function, string, spin)
+  //! (spin) whether the inverses are kept in single, instead of inverse,
+  //! and how many updates they get before they're recomputed
+  Array1 <int> use_single;
+  Array1 <int> refresh;
+  Array3 < Single_inverse<T> > single; //!< (function, string, spin)
 
 
   int nmo;        //!<Number of molecular orbitals
@@ -200,17 +287,21 @@ inline void Slat_wf<T>::generateStorage(Wavefunction_storage * & wfstore)
   // Added by Matous
   store->moVal_temp_2.Resize (5,   nmo);
 
-  store->detVal_temp.Resize(nfunc_, ndet, 2);
-  store->inverse_temp.Resize(nfunc_, ndet, 2);
+  int maxstrings=parent->maxstrings;
+  store->detVal_temp.Resize(nfunc_, maxstrings, 2);
+  store->inverse_temp.Resize(nfunc_, maxstrings, 2);
+  store->table_temp.Resize(2);
+  store->delayed_temp.Resize(nfunc_, maxstrings, 2);
+  store->single_temp.Resize(nfunc_, maxstrings, 2);
   for(int i=0; i< nfunc_; i++)
   {
-    for(int det=0; det < ndet; det++)
+    for(int s=0; s<2; s++)
     {
-      for(int s=0; s<2; s++)
+      for(int u=0; u < nstrings(i,s); u++)
       {
-        store->inverse_temp(i,det,s).Resize(nelectrons(s), nelectrons(s));
-        store->inverse_temp(i,det,s)=0;
-        //store->detVal_temp(i,det,s)=1;
+        store->inverse_temp(i,u,s).Resize(nelectrons(s), nelectrons(s));
+        store->inverse_temp(i,u,s)=0;
+        //store->detVal_temp(i,u,s)=1;
       }
     }
   }
@@ -252,21 +343,47 @@ template <class T> inline void Slat_wf<T>::init(Wavefunction_data * wfdata,
   //Properties and intermediate calculation storage.
   moVal.Resize(5,   tote, nmo);
   updatedMoVal.Resize(nmo,5);
-
-  detVal.Resize (nfunc_, ndet, 2);
-  inverse.Resize(nfunc_, ndet, 2);
+  proposedMoVal.Resize(nmo,5);
+
+  int maxstrings=dataptr->maxstrings;
+  detVal.Resize (nfunc_, maxstrings, 2);
+  inverse.Resize(nfunc_, maxstrings, 2);
+  table.Resize(2);
+  //The table method updates only the reference inverse, so it doesn't
+  //delay anything.  By default, only large determinants are delayed; 
+  //for small ones the bookkeeping costs more than it saves.
+  use_delay.Resize(2);
+  delayed.Resize(nfunc_, maxstrings, 2);
+  Array1 <int> ndelay(2);
+  for(int s=0; s< 2; s++) { 
+    ndelay(s)=parent->delayed_updates;
+    if(ndelay(s) < 0) ndelay(s)=nelectrons(s) > 256?16:1;
+    ndelay(s)=min(ndelay(s),nelectrons(s));
+    use_delay(s)=!parent->use_clark_updates && ndelay(s) > 1;
+  }
+  use_single.Resize(2);
+  refresh.Resize(2);
+  single.Resize(nfunc_, maxstrings, 2);
+  for(int s=0; s< 2; s++) { 
+    use_single(s)=parent->single_inverse && !use_delay(s);
+    refresh(s)=parent->refresh_inverse;
+    if(refresh(s) < 0) refresh(s)=4*nelectrons(s);
+  }
 
   for(int i=0; i< nfunc_; i++) {
-    for(int det=0; det < ndet; det++) {
-      for(int s=0; s<2; s++) {
-        inverse(i,det,s).Resize(nelectrons(s), nelectrons(s));
-        inverse(i,det,s)=0;
+    for(int s=0; s<2; s++) {
+      for(int u=0; u < nstrings(i,s); u++) {
+        inverse(i,u,s).Resize(nelectrons(s), nelectrons(s));
+        inverse(i,u,s)=0;
         for(int e=0; e< nelectrons(s); e++) {
-          inverse(i,det,s)(e,e)=1;
-          inverse(i,det,s)(e,e)=1;
+          inverse(i,u,s)(e,e)=1;
+          inverse(i,u,s)(e,e)=1;
         }
 
-        detVal(i,det,s)=T(1.0);
+        detVal(i,u,s)=T(1.0);
+        delayed(i,u,s).init(ndelay(s),
+                              nelectrons(s));
+        single(i,u,s).load(inverse(i,u,s));
       }
     }
   }
@@ -325,6 +442,57 @@ template<class T> inline void Slat_wf<T>::notify(change_type change, int num)
 }
 
 
+//----------------------------------------------------------------------
+
+template<class T> inline int Slat_wf<T>::saveState(Wavefunction_storage * & wfstate) { 
+  if(wfstate==NULL) wfstate=new Slat_wf_state<T>;
+  Slat_wf_state<T> * state;
+  recast(wfstate, state);
+  state->electronIsStaleVal=electronIsStaleVal;
+  state->electronIsStaleLap=electronIsStaleLap;
+  state->updateEverythingVal=updateEverythingVal;
+  state->updateEverythingLap=updateEverythingLap;
+  state->inverseStale=inverseStale;
+  state->lastValUpdate=lastValUpdate;
+  array_cp(state->lastDetVal,lastDetVal);
+  array_cp(state->moVal,moVal);
+  array_cp(state->inverse,inverse);
+  array_cp(state->detVal,detVal);
+  state->table.Resize(2);
+  for(int s=0; s< 2; s++) array_cp(state->table(s),table(s));
+  array_cp(state->delayed,delayed);
+  array_cp(state->single,single);
+
+  int bytes=sizeof(T)*moVal.GetSize()
+    +2*sizeof(log_value<T>)*detVal.GetSize()
+    +sizeof(T)*(table(0).GetSize()+table(1).GetSize());
+  for(int i=0; i< inverse.GetDim(0); i++) 
+    for(int j=0; j< inverse.GetDim(1); j++) 
+      for(int k=0; k< inverse.GetDim(2); k++) 
+        bytes+=sizeof(T)*inverse(i,j,k).GetSize();
+  return bytes;
+}
+
+//----------------------------------------------------------------------
+
+template<class T> inline void Slat_wf<T>::restoreState(Wavefunction_storage * wfstate) { 
+  Slat_wf_state<T> * state;
+  recast(wfstate, state);
+  electronIsStaleVal=state->electronIsStaleVal;
+  electronIsStaleLap=state->electronIsStaleLap;
+  updateEverythingVal=state->updateEverythingVal;
+  updateEverythingLap=state->updateEverythingLap;
+  inverseStale=state->inverseStale;
+  lastValUpdate=state->lastValUpdate;
+  array_cp(lastDetVal,state->lastDetVal);
+  array_cp(moVal,state->moVal);
+  array_cp(inverse,state->inverse);
+  array_cp(detVal,state->detVal);
+  for(int s=0; s< 2; s++) array_cp(table(s),state->table(s));
+  array_cp(delayed,state->delayed);
+  array_cp(single,state->single);
+}
+
 //----------------------------------------------------------------------
 
 template<class T>inline void Slat_wf<T>::saveUpdate(Sample_point * sample, int e,
@@ -342,16 +510,21 @@ template<class T>inline void Slat_wf<T>::saveUpdate(Sample_point * sample, int e
   }
   int s=spin(e);
   
-  int ndet_save=ndet;
-  if(parent->use_clark_updates) ndet_save=1;
+  //Delayed moves leave the inverses alone, so only the moves are saved
+  if(use_delay(s)) saveDelayed(s,1,store);
   for(int f=0; f< nfunc_; f++) {
-    for(int det=0; det<ndet_save; det++) {
-      store->inverse_temp(f,det,s)=inverse(f,det,s);
+    int nsave=nstrings(f,s);
+    if(parent->use_clark_updates) nsave=1;
+    if(use_delay(s)) nsave=0;
+    for(int u=0; u<nsave; u++) {
+      if(use_single(s)) store->single_temp(f,u,s)=single(f,u,s);
+      else store->inverse_temp(f,u,s)=inverse(f,u,s);
     }
-    for(int det=0; det < ndet; det++) {
-      store->detVal_temp(f,det,s)=detVal(f,det,s);
+    for(int u=0; u < nstrings(f,s); u++) {
+      store->detVal_temp(f,u,s)=detVal(f,u,s);
     }
   }
+  if(parent->use_clark_updates) array_cp(store->table_temp(s),table(s));
   
   
   int norb=moVal.GetDim(2);
@@ -379,17 +552,21 @@ template<class T>inline void Slat_wf<T>::restoreUpdate(Sample_point * sample, in
       moVal(j,e,i)=store->moVal_temp(j,i);
     }
   }
-  int ndet_save=ndet;
-  if(parent->use_clark_updates) ndet_save=1;
+  if(use_delay(s)) restoreDelayed(s,store);
   
   for(int f=0; f< nfunc_; f++) {
-    for(int det=0; det < ndet_save; det++) {
-      inverse(f,det,s)=store->inverse_temp(f,det,s);
+    int nsave=nstrings(f,s);
+    if(parent->use_clark_updates) nsave=1;
+    if(use_delay(s)) nsave=0;
+    for(int u=0; u < nsave; u++) {
+      if(use_single(s)) single(f,u,s)=store->single_temp(f,u,s);
+      else inverse(f,u,s)=store->inverse_temp(f,u,s);
     }
-    for(int det=0; det < ndet; det++) {
-      detVal(f,det,s)=store->detVal_temp(f,det,s);
+    for(int u=0; u < nstrings(f,s); u++) {
+      detVal(f,u,s)=store->detVal_temp(f,u,s);
     }
   }
+  if(parent->use_clark_updates) array_cp(table(s),store->table_temp(s));
   //It seems to be faster to update the inverse than to save it and
   //recover it.  However, it complicates the implementation too much.
   //For now, we'll disable it.
@@ -419,20 +596,22 @@ template <class T>inline void Slat_wf<T>::saveUpdate(Sample_point * sample, int
   
   int s1=spin(e1), s2=spin(e2);
   
+  if(use_delay(s1)) saveDelayed(s1,s1==s2?2:1,store);
+  if(s1!=s2 && use_delay(s2)) saveDelayed(s2,1,store);
   for(int f=0; f< nfunc_; f++) {
-    for(int det=0; det<ndet; det++) {
-      if ( s1 == s2 ) {
-        store->inverse_temp(f,det,s1)=inverse(f,det,s1);
-        store->detVal_temp(f,det,s1)=detVal(f,det,s1);
-      }
-      else {
-        store->inverse_temp(f,det,s1)=inverse(f,det,s1);
-        store->inverse_temp(f,det,s2)=inverse(f,det,s2);
-        store->detVal_temp(f,det,s1)=detVal(f,det,s1);
-        store->detVal_temp(f,det,s2)=detVal(f,det,s2);
+    for(int s=0; s< 2; s++) { 
+      if(s!=s1 && s!=s2) continue;
+      for(int u=0; u<nstrings(f,s); u++) {
+        if(use_single(s)) store->single_temp(f,u,s)=single(f,u,s);
+        else if(!use_delay(s)) store->inverse_temp(f,u,s)=inverse(f,u,s);
+        store->detVal_temp(f,u,s)=detVal(f,u,s);
       }
     }
   }
+  if(parent->use_clark_updates) { 
+    array_cp(store->table_temp(s1),table(s1));
+    array_cp(store->table_temp(s2),table(s2));
+  }
   
   
   for(int d=0; d< 5; d++) {
@@ -464,20 +643,22 @@ template<class T> inline void Slat_wf<T>::restoreUpdate(Sample_point * sample, i
       moVal(j,e2,i)=store->moVal_temp_2(j,i);
     }
   }
+  if(use_delay(s1)) restoreDelayed(s1,store);
+  if(s1!=s2 && use_delay(s2)) restoreDelayed(s2,store);
   for(int f=0; f< nfunc_; f++) {
-    for(int det=0; det < ndet; det++) {
-      if ( s1 == s2 ) {
-		      inverse(f,det,s1)=store->inverse_temp(f,det,s1);
-		      detVal(f,det,s1)=store->detVal_temp(f,det,s1);
-      }
-      else {
-		      inverse(f,det,s1)=store->inverse_temp(f,det,s1);
-		      inverse(f,det,s2)=store->inverse_temp(f,det,s2);
-		      detVal(f,det,s1)=store->detVal_temp(f,det,s1);
-		      detVal(f,det,s2)=store->detVal_temp(f,det,s2);
+    for(int s=0; s< 2; s++) { 
+      if(s!=s1 && s!=s2) continue;
+      for(int u=0; u < nstrings(f,s); u++) {
+        if(use_single(s)) single(f,u,s)=store->single_temp(f,u,s);
+        else if(!use_delay(s)) inverse(f,u,s)=store->inverse_temp(f,u,s);
+        detVal(f,u,s)=store->detVal_temp(f,u,s);
       }
     }
   }
+  if(parent->use_clark_updates) { 
+    array_cp(table(s1),store->table_temp(s1));
+    array_cp(table(s2),store->table_temp(s2));
+  }
   
   electronIsStaleVal(e1)=0;
   electronIsStaleLap(e1)=0;
@@ -488,6 +669,47 @@ template<class T> inline void Slat_wf<T>::restoreUpdate(Sample_point * sample, i
 
 //----------------------------------------------------------------------
 
+template <class T> inline void Slat_wf<T>::saveDelayed(int s, int nmove,
+    Slat_wf_storage<T> * store) { 
+  for(int f=0; f< nfunc_; f++) { 
+    for(int u=0; u < nstrings(f,s); u++) { 
+      if(delayed(f,u,s).room() < nmove) 
+        delayed(f,u,s).flush(inverse(f,u,s));
+      store->delayed_temp(f,u,s)=delayed(f,u,s);
+    }
+  }
+}
+
+//----------------------------------------------------------------------
+
+template <class T> inline void Slat_wf<T>::restoreDelayed(int s,
+    Slat_wf_storage<T> * store) { 
+  for(int f=0; f< nfunc_; f++) { 
+    for(int u=0; u < nstrings(f,s); u++) { 
+      if(delayed(f,u,s).changes()==store->delayed_temp(f,u,s).changes()) 
+        delayed(f,u,s)=store->delayed_temp(f,u,s);
+      else { 
+        //The inverse itself changed since saveDelayed(), so the saved 
+        //moves don't apply to it any more.  Start over.
+        updateEverythingVal=1;
+        updateEverythingLap=1;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------
+
+template <class T> inline void Slat_wf<T>::flushDelayed() { 
+  for(int f=0; f< nfunc_; f++) 
+    for(int s=0; s< 2; s++) 
+      for(int u=0; u < nstrings(f,s); u++) 
+        if(use_delay(s)) delayed(f,u,s).flush(inverse(f,u,s));
+        else if(use_single(s)) single(f,u,s).store(inverse(f,u,s));
+}
+
+//----------------------------------------------------------------------
+
 template <class T> inline void Slat_wf<T>::updateVal(Wavefunction_data * wfdata,
                         Sample_point * sample)
 {
@@ -562,6 +784,7 @@ template <> inline int Slat_wf<doublevar>::getParmDeriv(Wavefunction_data *  wfd
     updateInverse(parent, lastValUpdate);
     inverseStale=0;
   }
+  flushDelayed();
   
   int nparms=parent->nparms();
   int tote=nelectrons(0)+nelectrons(1);
@@ -580,6 +803,8 @@ template <> inline int Slat_wf<doublevar>::getParmDeriv(Wavefunction_data *  wfd
     }
   }
   
+  //With OPTIMIZE_MO no strings are shared, so inverse and detVal are
+  //indexed by determinant as Orbital_rotation expects.
   if(parent->optimize_mo && !parent->optimize_det) {
     parent->orbrot->getParmDeriv<doublevar>(parent->detwt,moVal,inverse, detVal, derivatives);
     derivatives.hessian=0;
@@ -592,7 +817,8 @@ template <> inline int Slat_wf<doublevar>::getParmDeriv(Wavefunction_data *  wfd
     Array3 <log_value <doublevar> > detgrads(ndet,tote,5);
     Array2 <log_value <doublevar> > totgrads(tote,5);
     for(int det=0; det < ndet; det++) {
-      log_value<doublevar> thisdet=detVal(0,det,0)*detVal(0,det,1);
+      log_value<doublevar> thisdet=detVal(0,str(0,det,0),0)
+        *detVal(0,str(0,det,1),1);
       detvals(det)=parent->detwt(det)*thisdet;
     }
 
@@ -629,7 +855,8 @@ template <> inline int Slat_wf<doublevar>::getParmDeriv(Wavefunction_data *  wfd
       for(int j=1;j<parent->CSF(csf).GetDim(0);j++){
         doublevar coeff=parent->CSF(csf)(j);
         int index=csf-1;
-        log_value<doublevar> thisdet=detVal(0,det,0)*detVal(0,det,1);
+        log_value<doublevar> thisdet=detVal(0,str(0,det,0),0)
+          *detVal(0,str(0,det,1),1);
         derivatives.gradient(index)+=coeff*thisdet.val();
         for(int e=0; e< tote; e++) {
           for(int d=1; d< 5; d++) {
@@ -707,50 +934,27 @@ template <class T>inline void Slat_wf<T>::updateInverse(Slat_wf_data * dataptr,
   int maxmatsize=max(nelectrons(0),nelectrons(1));
   Array1 <T> modet(maxmatsize);
   int s=spin(e);
-  int ndet_update=ndet;
-  if(parent->use_clark_updates) ndet_update=1;
   for(int f=0; f< nfunc_; f++)  {
-    for(int det=0; det< ndet_update; det++)  {
+    int recalculated=0;
+    int nupdate=nstrings(f,s);
+    if(parent->use_clark_updates) nupdate=1;
+    for(int u=0; u< nupdate; u++)  {
+      int det=dataptr->string_det(f,s)(u);
       //fill the molecular orbitals for this
       //determinant
-      if(real_qw(detVal(f,det,s).logval) < -1e200) { 
-        Array2 <T> allmos(nelectrons(s), nelectrons(s));
-        for(int e=0; e< nelectrons(s); e++) {
-          int curre=s*nelectrons(0)+e;
-          if(dataptr->optimize_mo){
-            Array1<T> orb;
-            orb.Resize(parent->orbrot->Nact(det,s));
-            for(int i=0;i<orb.GetDim(0);i++){
-              orb(i)=moVal(0,curre,dataptr->occupation(f,det,s)(i)); 
-            }
-            dataptr->orbrot->rotMoVals<T>(det,s,orb);
-            for(int i=0;i<nelectrons(s);i++){
-              allmos(e,i)=orb(i);
-            }
-          }else{
-            for(int i=0; i< nelectrons(s); i++) {
-              allmos(e,i)=moVal(0,curre, dataptr->occupation(f,det,s)(i));
-            }
-          }
-        }
-
+      if(real_qw(detVal(f,u,s).logval) < -1e200) { 
+        recalculated=1;
 #ifdef SUPERDEBUG
         cout << "Slat_wf::updateInverse: near-zero determinant " 
-          << " f " << f << " det " << det << " old det " << detVal(f,det,s).logval
+          << " f " << f << " det " << det << " old det " << detVal(f,u,s).logval
           << endl;
 #endif
-
-
-        detVal(f,det,s)=
-          TransposeInverseMatrix(allmos,inverse(f,det,s), nelectrons(s));
+        recalcInverse(f,u,s);
 #ifdef SUPERDEBUG
         cout << "Slat_wf::updateInverse: near-zero determinant " 
-          << " f " << f << " det " << det << " new det " << detVal(f,det,s).logval
+          << " f " << f << " det " << det << " new det " << detVal(f,u,s).logval
           << endl;
 #endif
-
-        
-
       }
       else { 
         if(dataptr->optimize_mo){
@@ -768,26 +972,39 @@ template <class T>inline void Slat_wf<T>::updateInverse(Slat_wf_data * dataptr,
             modet(i)=moVal(0,e,dataptr->occupation(f,det,s)(i));
           }
         }
-        T ratio=1./InverseUpdateColumn(inverse(f,det,s),
+        T ratio;
+        if(use_delay(s)) 
+          ratio=delayed(f,u,s).update(inverse(f,u,s),modet,rede(e));
+        else if(use_single(s)) 
+          ratio=single(f,u,s).update(modet,rede(e));
+        else 
+          ratio=1./InverseUpdateColumn(inverse(f,u,s),
             modet, rede(e),
             nelectrons(s));
 
-        detVal(f,det, s)=ratio*detVal(f,det, s);
+        detVal(f,u, s)=ratio*detVal(f,u, s);
+        if(use_single(s) && (single(f,u,s).updates() >= refresh(s) 
+              || singleError(f,u,s) > parent->inverse_tolerance)) { 
+#ifdef SUPERDEBUG
+          cout << "Slat_wf::updateInverse: refreshing single precision inverse "
+            << " f " << f << " u " << u << " after " << single(f,u,s).updates()
+            << " updates, error " << singleError(f,u,s) << endl;
+#endif
+          recalcInverse(f,u,s);
+        }
       }
     }
     if(parent->use_clark_updates) { 
-
-      Array2 <T> M(nelectrons(s),updatedMoVal.GetDim(0));
-      for(int i=0; i< nelectrons(s); i++){ 
-        int elec=i+s*nelectrons(0);
-        for(int j=0; j< updatedMoVal.GetDim(0); j++) { 
-          M(i,j)=moVal(0,elec,j);
-        }
+      if(recalculated) buildTable(s);
+      else { 
+        Array1 <T> newrow(nmo);
+        for(int j=0; j< nmo; j++) newrow(j)=moVal(0,e,j);
+        parent->excitations.updateTable(inverse(0,0,s),newrow,rede(e),s,table(s));
       }
       Array1 <T> ratios;
-      parent->excitations.clark_updates(inverse(0,0,s),M,s,ratios);
-      for(int d=0; d< ndet; d++) { 
-        detVal(0,d,s)=ratios(d)*detVal(0,0,s); 
+      parent->excitations.tableRatios(table(s),s,ratios);
+      for(int u=1; u< nstrings(0,s); u++) { 
+        detVal(0,u,s)=ratios(dataptr->string_det(0,s)(u))*detVal(0,0,s); 
       }
 
     }
@@ -798,21 +1015,79 @@ template <class T>inline void Slat_wf<T>::updateInverse(Slat_wf_data * dataptr,
 
 //------------------------------------------------------------------------
 
+template <class T> inline void Slat_wf<T>::recalcInverse(int f, int u, int s) { 
+  int det=parent->string_det(f,s)(u);
+  Array2 <T> allmos(nelectrons(s), nelectrons(s));
+  for(int e=0; e< nelectrons(s); e++) {
+    int curre=s*nelectrons(0)+e;
+    if(parent->optimize_mo){
+      Array1<T> orb;
+      orb.Resize(parent->orbrot->Nact(det,s));
+      for(int i=0;i<orb.GetDim(0);i++){
+        orb(i)=moVal(0,curre,parent->occupation(f,det,s)(i)); 
+      }
+      parent->orbrot->rotMoVals<T>(det,s,orb);
+      for(int i=0;i<nelectrons(s);i++){
+        allmos(e,i)=orb(i);
+      }
+    }else{
+      for(int i=0; i< nelectrons(s); i++) {
+        allmos(e,i)=moVal(0,curre, parent->occupation(f,det,s)(i));
+      }
+    }
+  }
+  detVal(f,u,s)=
+    TransposeInverseMatrix(allmos,inverse(f,u,s), nelectrons(s));
+  delayed(f,u,s).reset();
+  if(use_single(s)) single(f,u,s).load(inverse(f,u,s));
+}
+
+//------------------------------------------------------------------------
+
+template <class T> inline doublevar Slat_wf<T>::singleError(int f, int u, int s) { 
+  int n=nelectrons(s);
+  if(n==0) return 0.0;
+  int det=parent->string_det(f,s)(u);
+  //a different electron every update, so that all the rows get checked
+  int k=single(f,u,s).updates()%n;
+  int curre=s*nelectrons(0)+k;
+  Array1 <T> modet(n);
+  if(parent->optimize_mo){
+    Array1<T> orb;
+    orb.Resize(parent->orbrot->Nact(det,s));
+    for(int i=0;i<orb.GetDim(0);i++){
+      orb(i)=moVal(0,curre,parent->occupation(f,det,s)(i)); 
+    }
+    parent->orbrot->rotMoVals<T>(det,s,orb);
+    for(int i=0;i<n;i++){
+      modet(i)=orb(i);
+    }
+  }else{
+    for(int i=0; i< n; i++) {
+      modet(i)=moVal(0,curre, parent->occupation(f,det,s)(i));
+    }
+  }
+  return abs(single(f,u,s).ratio(modet,k)-T(1.0));
+}
+
+//------------------------------------------------------------------------
+
 template <class T> inline int Slat_wf<T>::updateValNoInverse(Slat_wf_data * dataptr, int e) { 
   int maxmatsize=max(nelectrons(0),nelectrons(1));
   Array1 <T> modet(maxmatsize);
   int s=spin(e);
   for(int f=0; f< nfunc_; f++)  {
-    for(int det=0; det< ndet; det++)  {
+    for(int u=0; u< nstrings(f,s); u++)  {
       //fill the molecular orbitals for this
       //determinant
-      if(real_qw(detVal(f,det,s).logval) < -1e200) return 0;
+      if(real_qw(detVal(f,u,s).logval) < -1e200) return 0;
     }
   }
   
   
   for(int f=0; f< nfunc_; f++)  {
-    for(int det=0; det< ndet; det++)  {
+    for(int u=0; u< nstrings(f,s); u++)  {
+      int det=dataptr->string_det(f,s)(u);
       //fill the molecular orbitals for this
       //determinant
       if(dataptr->optimize_mo){
@@ -832,19 +1107,25 @@ template <class T> inline int Slat_wf<T>::updateValNoInverse(Slat_wf_data * data
       }
       
       
-      T ratio=1./InverseGetNewRatio(inverse(f,det,s),
+      T ratio;
+      if(use_delay(s)) 
+        ratio=delayed(f,u,s).getRatio(inverse(f,u,s),modet,rede(e));
+      else if(use_single(s)) 
+        ratio=single(f,u,s).ratio(modet,rede(e));
+      else 
+        ratio=1./InverseGetNewRatio(inverse(f,u,s),
                                             modet, rede(e),
                                             nelectrons(s));
 #ifdef SUPERDEBUG
-      T tmpratio=InverseGetNewRatio(inverse(f,det,s),
+      T tmpratio=InverseGetNewRatio(inverse(f,u,s),
                                             modet, rede(e),
                                             nelectrons(s));
 
       cout << "Slat_wf::updateValNoInverse: " << "ratio " << ratio 
-        << " inv ratio " << tmpratio << " old detVal " << detVal(f,det,s).logval << endl;
+        << " inv ratio " << tmpratio << " old detVal " << detVal(f,u,s).logval << endl;
 #endif
 
-      detVal(f,det, s)=ratio*detVal(f,det, s);
+      detVal(f,u, s)=ratio*detVal(f,u, s);
       
     }
   }
@@ -872,7 +1153,7 @@ template <class T> inline void Slat_wf<T>::updateVal( Slat_wf_data * dataptr, Sa
   int s=spin(e);
 
   //update all the mo's that we will be using.
-  molecorb->updateVal(sample,e,s,updatedMoVal);
+  molecorb->updateVal(sample,e,s,updatedMoVal,mo_ws);
   for(int i=0; i< updatedMoVal.GetDim(0); i++)
     moVal(0,e,i)=updatedMoVal(i,0);
 
@@ -921,7 +1202,8 @@ template <class T>inline void Slat_wf<T>::getVal(Wavefunction_data * wfdata, int
   for(int f=0; f< nfunc_; f++) {
     Array1 <log_value<T> > detvals(ndet);
     for(int det=0; det < ndet; det++) {
-      detvals(det) = dataptr->detwt(det)*detVal(f,det,s)*detVal(f,det,opp);
+      detvals(det) = dataptr->detwt(det)*detVal(f,str(f,det,s),s)
+        *detVal(f,str(f,det,opp),opp);
     }
     log_value<T> totval=sum(detvals);
     //vals(f,0)=totval.logval;
@@ -956,7 +1238,7 @@ template <class T> inline void Slat_wf<T>::calcLap(Slat_wf_data * dataptr, Sampl
     //update all the mo's that we will be using, using the lists made in
     //Slat_wf_data(one for each spin).
     //cout << "mo_updatelap " << endl;
-    molecorb->updateLap(sample, e, s, updatedMoVal);
+    molecorb->updateLap(sample, e, s, updatedMoVal, mo_ws);
     //cout << "done " << endl;
     for(int d=0; d< 5; d++)  {
       for(int i=0; i< updatedMoVal.GetDim(0); i++) {
@@ -971,9 +1253,13 @@ template <class T> inline void Slat_wf<T>::calcLap(Slat_wf_data * dataptr, Sampl
   //matout.precision(15);
   //matout << "initial_matrix " << nelectrons(0) << " rows are electrons, columns are orbital values " << endl;
   //cout << "here " << endl;
+  //With the table method, only the reference determinant is needed
   for(int f=0; f< nfunc_; f++)   {
-    for(int det=0; det < ndet; det++ ) {
-      for(int s=0; s< 2; s++ ) {
+    for(int s=0; s< 2; s++ ) {
+      int ncalc=nstrings(f,s);
+      if(parent->use_clark_updates) ncalc=1;
+      for(int u=0; u < ncalc; u++ ) {
+        int det=dataptr->string_det(f,s)(u);
 
 
         for(int e=0; e< nelectrons(s); e++) {
@@ -999,59 +1285,68 @@ template <class T> inline void Slat_wf<T>::calcLap(Slat_wf_data * dataptr, Sampl
         }
         
         if(nelectrons(s) > 0) { 
-          detVal(f,det,s)=
-          TransposeInverseMatrix(modet,inverse(f,det,s), nelectrons(s));
+          detVal(f,u,s)=
+          TransposeInverseMatrix(modet,inverse(f,u,s), nelectrons(s));
         }
-        else detVal(f,det,s)=T(1.0);
+        else detVal(f,u,s)=T(1.0);
+        delayed(f,u,s).reset();
+        if(use_single(s)) single(f,u,s).load(inverse(f,u,s));
 #ifdef SUPERDEBUG
         cout << "Slat_wf::calcLap: f " << f<< " det " << det 
-          << " detVal " << detVal(f,det,s).logval << endl;
+          << " detVal " << detVal(f,u,s).logval << endl;
 #endif
         //if(f==0 && det==0 && s==0) matout << "determinant " << detVal(f,det,s) 
          //   << " should be " << modet(0,0)*modet(1,1)-modet(0,1)*modet(1,0) << endl;
       }
     }
   }
+  if(parent->use_clark_updates) { 
+    for(int s=0; s< 2; s++) { 
+      buildTable(s);
+      Array1 <T> ratios;
+      parent->excitations.tableRatios(table(s),s,ratios);
+      for(int u=1; u< nstrings(0,s); u++) 
+        detVal(0,u,s)=ratios(dataptr->string_det(0,s)(u))*detVal(0,0,s);
+    }
+  }
   //cout << "done " << endl;
 }
 
 //------------------------------------------------------------------------
 
+template <class T> inline void Slat_wf<T>::buildTable(int s) { 
+  Array2 <T> M(nelectrons(s),nmo);
+  for(int i=0; i< nelectrons(s); i++) { 
+    int elec=i+s*nelectrons(0);
+    for(int j=0; j< nmo; j++) M(i,j)=moVal(0,elec,j);
+  }
+  parent->excitations.buildTable(inverse(0,0,s),M,s,table(s));
+}
+
+//------------------------------------------------------------------------
+
 
 template <class T> void Slat_wf<T>::getDetLap(int e, Array3<log_value <T> > &  vals ) { 
   vals.Resize(nfunc_,ndet,5);
   int s=spin(e);
   int opp=opspin(e);
 
-  //Prepare the matrices we need for the inverse.
-  //There is likely a way to do this via updates, but we'll
-  //leave it for now since it doesn't seem to cost too much.
-  Array2 <T> & lapvec=work2;
-  Array1 <T> tmplapvec(nelectrons(s));
   int n=moVal.GetDim(2);
-  if(parent->use_clark_updates) { 
-    lapvec.Resize(nelectrons(s),n);
-    for(int e1=0; e1< nelectrons(s); e1++) {
-      int shift=e1+s*nelectrons(0);
-      for(int j=0; j< n; j++) {  
-        lapvec(e1,j)=moVal(0,shift,j);
-      }
-    }
-  }
+  Array1 <T> lapvec(n);
 
 
   for(int f=0; f< nfunc_; f++) {
-    Array1 <log_value <T> > detvals(ndet);
     for(int det=0; det < ndet; det++) {
-      detvals(det) = detVal(f,det,s)*detVal(f,det,opp);
-
-      vals(f,det,0)=detvals(det);
+      vals(f,det,0)=detVal(f,str(f,det,s),s)*detVal(f,str(f,det,opp),opp);
     }
     
-    Array1 <log_value <T> > detgrads(ndet);
+    //derivatives of the strings of this spin, then of the determinants
+    int nstr=nstrings(f,s);
+    Array1 <log_value <T> > detgrads(nstr);
     for(int i=1; i< 5; i++) {
       if(!parent->use_clark_updates) {   //Sherman-Morrison updates
-        for(int det=0; det < ndet; det++) {
+        for(int u=0; u < nstr; u++) {
+          int det=parent->string_det(f,s)(u);
           T temp=0;
           if(parent->optimize_mo){  
             Array1<T> orb;
@@ -1060,47 +1355,37 @@ template <class T> void Slat_wf<T>::getDetLap(int e, Array3<log_value <T> > &  v
               orb(j)=moVal(i,e,parent->occupation(f,det,s)(j)); 
             }
             parent->orbrot->rotMoVals<T>(det,s,orb);
-            for(int j=0;j<nelectrons(s);j++){
-              temp+=orb(j)*inverse(f,det,s)(rede(e),j);
-            }
+            if(use_delay(s)) 
+              temp=delayed(f,u,s).getRatio(inverse(f,u,s),orb,rede(e));
+            else 
+              temp=inverseRatio(f,u,s,orb,e);
           }else{
-            for(int j=0; j<nelectrons(s); j++) {
-              temp+=moVal(i , e, parent->occupation(f,det,s)(j) )
-                *inverse(f,det,s)(rede(e), j);
-            }
+            for(int j=0; j<nelectrons(s); j++) 
+              lapvec(j)=moVal(i,e,parent->occupation(f,det,s)(j));
+            if(use_delay(s)) 
+              temp=delayed(f,u,s).getRatio(inverse(f,u,s),lapvec,rede(e));
+            else 
+              temp=inverseRatio(f,u,s,lapvec,e);
           }
-          detgrads(det)=temp; 
-          detgrads(det)*=detVal(f,det,s);
+          detgrads(u)=temp; 
+          detgrads(u)*=detVal(f,u,s);
         }
       } //-------
-      else {  //clark updates
-
-        Array2 <T> &  tmpinverse=work1;
-        tmpinverse=inverse(f,0,s);
-
+      else {  //clark updates: the derivative replaces the electron's row
         for(int j=0; j< n; j++) 
-          lapvec(rede(e),j)=moVal(i,e,j);
-
-        for(int j=0; j< nelectrons(s); j++) 
-          tmplapvec(j)=lapvec(rede(e),parent->occupation(f,0,s)(j));
-
-        T baseratio=1.0/InverseUpdateColumn(tmpinverse,tmplapvec,
-            rede(e),nelectrons(s));
+          lapvec(j)=moVal(i,e,j);
         Array1 <T> ratios;
-        parent->excitations.clark_updates(tmpinverse,lapvec,s,ratios);
+        T baseratio=parent->excitations.testRatios(inverse(f,0,s),table(s),
+            lapvec,rede(e),s,ratios);
         detgrads(0)=baseratio*detVal(f,0,s);
-        for(int d=1; d< ndet; d++) { 
-          //detgrads(d)=baseratio*ratios(d)*detVal(f,0,s);
-          detgrads(d)=ratios(d)*detgrads(0);
+        for(int u=1; u< nstr; u++) { 
+          detgrads(u)=ratios(parent->string_det(f,s)(u))*detgrads(0);
         }
       } //------Done clark updates
-      for(int d=0; d< ndet; d++) {
-        detgrads(d)*=detVal(f,d,opp);
-      }
 
       //--------------------------------
       for(int d=0; d< ndet; d++) {
-        vals(f,d,i)=detgrads(d);
+        vals(f,d,i)=detgrads(str(f,d,s))*detVal(f,str(f,d,opp),opp);
       }
     }
 
@@ -1162,7 +1447,7 @@ template <class T> inline void Slat_wf<T>::updateLap(Slat_wf_data * dataptr,
 
 
   //update all the mo's that we will be using.
-  molecorb->updateLap(sample,e,s,updatedMoVal);
+  molecorb->updateLap(sample,e,s,updatedMoVal,mo_ws);
 
   for(int d=0; d< 5; d++)
     for(int i=0; i< updatedMoVal.GetDim(0); i++)
@@ -1173,6 +1458,190 @@ template <class T> inline void Slat_wf<T>::updateLap(Slat_wf_data * dataptr,
 
 //-------------------------------------------------------------------------
 
+/*!
+The ratios to the current strings come from the old inverses, the same 
+way as evalTestPos() does for the value, so nothing but the orbitals at 
+the new position is kept until acceptMove().
+*/
+template <class T> inline void Slat_wf<T>::proposeLap(Wavefunction_data * wfdata,
+    Sample_point * sample, int e, Wf_return & lap) { 
+  if(inverseStale) { 
+    inverseStale=0;
+    detVal=lastDetVal;
+    updateInverse(parent, lastValUpdate);
+  }
+  int s=spin(e);
+  int opp=opspin(e);
+  sample->updateEIDist();
+  molecorb->updateLap(sample,e,s,proposedMoVal,mo_ws);
+
+  Array2 <log_value <T> > vals(nfunc_,5);
+  Array1 <T> modet(nmo);
+  Array1 <log_value<T> > tempsum(ndet);
+  for(int f=0; f< nfunc_; f++) { 
+    int nstr=nstrings(f,s);
+    Array2 <log_value <T> > strvals(nstr,5);
+    if(!parent->use_clark_updates) { 
+      for(int u=0; u< nstr; u++) { 
+        int det=parent->string_det(f,s)(u);
+        for(int d=0; d< 5; d++) { 
+          if(parent->optimize_mo) { 
+            Array1<T> orb;
+            orb.Resize(parent->orbrot->Nact(det,s));
+            for(int j=0;j<orb.GetDim(0);j++){
+              orb(j)=proposedMoVal(parent->occupation(f,det,s)(j),d); 
+            }
+            parent->orbrot->rotMoVals<T>(det,s,orb);
+            for(int j=0; j<nelectrons(s); j++) modet(j)=orb(j);
+          }
+          else { 
+            for(int j=0; j<nelectrons(s); j++) 
+              modet(j)=proposedMoVal(parent->occupation(f,det,s)(j),d);
+          }
+          T ratio;
+          if(use_delay(s)) 
+            ratio=delayed(f,u,s).getRatio(inverse(f,u,s),modet,rede(e));
+          else 
+            ratio=inverseRatio(f,u,s,modet,e);
+          strvals(u,d)=ratio;
+          strvals(u,d)*=detVal(f,u,s);
+        }
+      }
+    }
+    else { 
+      for(int d=0; d< 5; d++) { 
+        for(int j=0; j< nmo; j++) modet(j)=proposedMoVal(j,d);
+        Array1 <T> ratios;
+        T baseratio=parent->excitations.testRatios(inverse(f,0,s),table(s),
+            modet,rede(e),s,ratios);
+        strvals(0,d)=baseratio*detVal(f,0,s);
+        for(int u=1; u< nstr; u++) 
+          strvals(u,d)=ratios(parent->string_det(f,s)(u))*strvals(0,d);
+      }
+    }
+
+    for(int d=0; d< 5; d++) { 
+      for(int det=0; det< ndet; det++) 
+        tempsum(det)=parent->detwt(det)*strvals(str(f,det,s),d)
+          *detVal(f,str(f,det,opp),opp);
+      vals(f,d)=sum(tempsum);
+    }
+    log_value<T> inv=vals(f,0);
+    inv.logval*=-1;
+    for(int d=1; d< 5; d++) vals(f,d)*=inv;
+  }
+  lap.setVals(vals);
+}
+
+//-------------------------------------------------------------------------
+
+template <class T> inline void Slat_wf<T>::acceptMove(Wavefunction_data * wfdata,
+    Sample_point * sample, int e) { 
+  for(int d=0; d< 5; d++)
+    for(int i=0; i< proposedMoVal.GetDim(0); i++)
+      moVal(d,e,i)=proposedMoVal(i,d);
+  updateInverse(parent,e);
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//-------------------------------------------------------------------------
+
+template <class T> inline void Slat_wf<T>::rejectMove(Sample_point * sample, 
+    int e) { 
+  electronIsStaleVal(e)=0;
+  electronIsStaleLap(e)=0;
+}
+
+//-------------------------------------------------------------------------
+
+/*!
+Each string's ratio is the dot product of the new column with electron e's
+row of the inverse (or its delayed or single precision counterpart), as in
+proposeLap(), so a test position costs its orbitals and O(N) per string.
+The orbitals at all the test positions are evaluated in one batch.
+*/
+template <class T> inline void Slat_wf<T>::testRatios(Wavefunction_data * wfdata,
+    Sample_point * sample, int e, const Array2 <doublevar> & pos,
+    Array1 <Wf_return> & ratio) { 
+  if(inverseStale) { 
+    inverseStale=0;
+    detVal=lastDetVal;
+    updateInverse(parent, lastValUpdate);
+  }
+  int s=spin(e);
+  int opp=opspin(e);
+  int npos=pos.GetDim(0);
+
+  Array1 <Array2 <T> > movals(npos);
+  for(int k=0; k< npos; k++) movals(k).Resize(nmo,1);
+  molecorb->updateValBatch(sample,e,pos,s,movals,mo_ws);
+
+  //the current values, to divide out
+  Array1 <log_value<T> > invval(nfunc_);
+  Array1 <log_value<T> > tempsum(ndet);
+  for(int f=0; f< nfunc_; f++) { 
+    for(int det=0; det< ndet; det++) 
+      tempsum(det)=parent->detwt(det)*detVal(f,str(f,det,s),s)
+        *detVal(f,str(f,det,opp),opp);
+    invval(f)=sum(tempsum);
+    invval(f).logval*=-1;
+  }
+
+  ratio.Resize(npos);
+  Array2 <log_value <T> > vals(nfunc_,1);
+  Array1 <T> modet(nmo);
+  Array1 <log_value<T> > strvals(parent->maxstrings);
+  for(int k=0; k< npos; k++) { 
+    for(int f=0; f< nfunc_; f++) { 
+      int nstr=nstrings(f,s);
+      if(!parent->use_clark_updates) { 
+        for(int u=0; u< nstr; u++) { 
+          int det=parent->string_det(f,s)(u);
+          if(parent->optimize_mo) { 
+            Array1<T> orb;
+            orb.Resize(parent->orbrot->Nact(det,s));
+            for(int j=0;j<orb.GetDim(0);j++){
+              orb(j)=movals(k)(parent->occupation(f,det,s)(j),0); 
+            }
+            parent->orbrot->rotMoVals<T>(det,s,orb);
+            for(int j=0; j<nelectrons(s); j++) modet(j)=orb(j);
+          }
+          else { 
+            for(int j=0; j<nelectrons(s); j++) 
+              modet(j)=movals(k)(parent->occupation(f,det,s)(j),0);
+          }
+          T r;
+          if(use_delay(s)) 
+            r=delayed(f,u,s).getRatio(inverse(f,u,s),modet,rede(e));
+          else 
+            r=inverseRatio(f,u,s,modet,e);
+          strvals(u)=r;
+          strvals(u)*=detVal(f,u,s);
+        }
+      }
+      else { 
+        for(int j=0; j< nmo; j++) modet(j)=movals(k)(j,0);
+        Array1 <T> ratios;
+        T baseratio=parent->excitations.testRatios(inverse(f,0,s),table(s),
+            modet,rede(e),s,ratios);
+        strvals(0)=baseratio*detVal(f,0,s);
+        for(int u=1; u< nstr; u++) 
+          strvals(u)=ratios(parent->string_det(f,s)(u))*strvals(0);
+      }
+      for(int det=0; det< ndet; det++) 
+        tempsum(det)=parent->detwt(det)*strvals(str(f,det,s))
+          *detVal(f,str(f,det,opp),opp);
+      vals(f,0)=sum(tempsum);
+      vals(f,0)*=invval(f);
+    }
+    ratio(k).Resize(nfunc_,1);
+    ratio(k).setVals(vals);
+  }
+}
+
+//-------------------------------------------------------------------------
+
 template <class T> inline void Slat_wf<T>::evalTestPos(Array1 <doublevar> & pos, 
     Sample_point * sample, Array1 <Wf_return> & wf) {
   
@@ -1192,23 +1661,25 @@ template <class T> inline void Slat_wf<T>::evalTestPos(Array1 <doublevar> & pos,
     movals(s).Resize(nmo,1);
     sample->setElectronPosNoNotify(0,pos);
     sample->updateEIDist();
-    molecorb->updateVal(sample,0,s,movals(s));
+    molecorb->updateVal(sample,0,s,movals(s),mo_ws);
   }
   sample->setElectronPosNoNotify(0,oldpos);
 
   int tote=sample->electronSize();
   wf.Resize(tote);
 
-  for(int e=0; e< tote; e++) { 
-    wf(e).Resize(nfunc_,1);
-    Array2 <log_value<T> > vals(nfunc_,1,T(0.0));
-     
-    int s=spin(e);
-    int opps= s==0?1:0;
-    Array1 <log_value <T> > new_detVals(ndet);
-    int f=0;
-    if(!parent->use_clark_updates) {  //Sherman-morrison updates
-      for(int det=0; det< ndet; det++)  {
+  //The new column of each string is the same for all the electrons
+  //of a spin.  With delayed updates, correct them once here so that each 
+  //electron's ratio is a single dot product.
+  int f=0;
+  Array2 <Array1 <T> > newcols;
+  Array2 <Array1 <T> > ycorr;
+  if(!parent->use_clark_updates) { 
+    newcols.Resize(nspin,parent->maxstrings);
+    ycorr.Resize(nspin,parent->maxstrings);
+    for(int s=0; s< nspin; s++) { 
+      for(int u=0; u< nstrings(f,s); u++)  {
+        int det=parent->string_det(f,s)(u);
         if(parent->optimize_mo){
           Array1<T> orb;
           orb.Resize(parent->orbrot->Nact(det,s));
@@ -1224,40 +1695,55 @@ template <class T> inline void Slat_wf<T>::evalTestPos(Array1 <doublevar> & pos,
             modet(i)=movals(s)(parent->occupation(f,det,s)(i),0);
           }
         }
-        T ratio=1./InverseGetNewRatio(inverse(f,det,s),
-            modet, rede(e),
+        if(use_delay(s)) 
+          delayed(f,u,s).correctColumn(inverse(f,u,s),modet,
+              newcols(s,u),ycorr(s,u));
+        else 
+          newcols(s,u)=modet;
+      }
+    }
+  }
+
+  Array1 <log_value <T> > new_strVals(parent->maxstrings);
+  for(int e=0; e< tote; e++) { 
+    wf(e).Resize(nfunc_,1);
+    Array2 <log_value<T> > vals(nfunc_,1,T(0.0));
+     
+    int s=spin(e);
+    int opps= s==0?1:0;
+    if(!parent->use_clark_updates) {  //Sherman-morrison updates
+      for(int u=0; u< nstrings(f,s); u++)  {
+        T ratio;
+        if(use_delay(s)) 
+          ratio=delayed(f,u,s).ratio(inverse(f,u,s),newcols(s,u),
+              ycorr(s,u),rede(e));
+        else if(use_single(s)) 
+          ratio=single(f,u,s).ratio(newcols(s,u),rede(e));
+        else 
+          ratio=1./InverseGetNewRatio(inverse(f,u,s),
+            newcols(s,u), rede(e),
             nelectrons(s));
-        new_detVals(det)=parent->detwt(det)*detVal(f,det,s);
-        new_detVals(det)*=ratio;
-        new_detVals(det)*=detVal(f,det,opps);
+        new_strVals(u)=detVal(f,u,s);
+        new_strVals(u)*=ratio;
       }
     }
     else { //Clark updates 
-      Array2 <T> & motmp=work1;
-      Array2 <T> & invtmp=work2;
-      invtmp=inverse(f,0,s);
-      int n=moVal.GetDim(2);
-      motmp.Resize(nelectrons(s),n);
-      for(int e1=0; e1< nelectrons(s); e1++) {
-        int shift=e1+s*nelectrons(0);
-        for(int j=0; j< n; j++) {  
-          motmp(e1,j)=moVal(0,shift,j);
-        }
-      }
-      for(int j=0; j< n; j++) motmp(rede(e),j)=movals(s)(j,0);
-      Array1 <T> tmpvec(nelectrons(s));
-      for(int j=0; j< nelectrons(s); j++) 
-        tmpvec(j)=movals(s)(parent->occupation(f,0,s)(j),0);
-      T baseratio=1.0/InverseUpdateColumn(invtmp,tmpvec,rede(e),nelectrons(s));
+      Array1 <T> tmpvec(nmo);
+      for(int j=0; j< nmo; j++) tmpvec(j)=movals(s)(j,0);
       Array1 <T> ratios;
-      parent->excitations.clark_updates(invtmp,motmp,s,ratios);
-      for(int d=0; d< ndet; d++) {
-        new_detVals(d)=parent->detwt(d)*detVal(f,0,s);
-        new_detVals(d)*=baseratio*ratios(d);
-        new_detVals(d)*=detVal(f,d,opps);
+      T baseratio=parent->excitations.testRatios(inverse(f,0,s),table(s),
+          tmpvec,rede(e),s,ratios);
+      for(int u=0; u< nstrings(f,s); u++) {
+        new_strVals(u)=detVal(f,0,s);
+        new_strVals(u)*=baseratio*ratios(parent->string_det(f,s)(u));
       }
       
     }
+    Array1 <log_value <T> > new_detVals(ndet);
+    for(int det=0; det< ndet; det++) { 
+      new_detVals(det)=parent->detwt(det)*new_strVals(str(f,det,s));
+      new_detVals(det)*=detVal(f,str(f,det,opps),opps);
+    }
     log_value<T> totval=sum(new_detVals);
     vals(f,0)=totval;
     wf(e).setVals(vals);
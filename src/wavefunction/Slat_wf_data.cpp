@@ -281,6 +281,8 @@ void Slat_wf_data::read(vector <string> & words, unsigned int & pos,
     nmo=orbrot->getnmo();
   }
 
+  find_spin_strings();
+
   //Decide on the updating scheme:
   
   if(ndet > 1 && tote > 10) {
@@ -293,6 +295,34 @@ void Slat_wf_data::read(vector <string> & words, unsigned int & pos,
   else if(haskeyword(words,pos=startpos,"SHERMAN_MORRISON_UPDATES")) { 
     use_clark_updates=false;
   }
+  //-1 lets Slat_wf decide by the number of electrons
+  if(readvalue(words,pos=startpos,delayed_updates,"DELAYED_UPDATES")) { 
+    if(delayed_updates < 1) 
+      error("DELAYED_UPDATES must be at least 1");
+  }
+  else delayed_updates=-1;
+  single_inverse=haskeyword(words,pos=startpos,"SINGLE_PRECISION_INVERSE");
+  if(single_inverse) { 
+    if(haskeyword(words,pos=startpos,"CLARK_UPDATES"))
+      error("SINGLE_PRECISION_INVERSE needs Sherman-Morrison updates, not CLARK_UPDATES");
+    if(delayed_updates > 1) 
+      error("SINGLE_PRECISION_INVERSE can't be used with DELAYED_UPDATES");
+    //Only the inverses are single precision; the orbital values stay in 
+    //double precision, since the ratios and their derivatives are 
+    //accumulated from them.
+    if(use_clark_updates) 
+      single_write(cout,"SINGLE_PRECISION_INVERSE: using Sherman-Morrison "
+                   "updates instead of Clark updates\n");
+    use_clark_updates=false;
+    delayed_updates=1;
+  }
+  if(readvalue(words,pos=startpos,refresh_inverse,"REFRESH_INVERSE")) { 
+    if(refresh_inverse < 1)
+      error("REFRESH_INVERSE must be at least 1");
+  }
+  else refresh_inverse=-1;
+  if(!readvalue(words,pos=startpos,inverse_tolerance,"INVERSE_TOLERANCE"))
+    inverse_tolerance=1e-4;
 
 
 
@@ -312,6 +342,10 @@ int Slat_wf_data::supports(wf_support_type support) {
       return 1;
     case parameter_derivatives:
       return 1;
+    case move_proposal:
+      return 1;
+    case test_ratios:
+      return 1;
     default:
       return 0;
   }
@@ -319,6 +353,42 @@ int Slat_wf_data::supports(wf_support_type support) {
 
 //----------------------------------------------------------------------
 
+/*!
+Most determinants of a large expansion share their up or their down 
+occupation with many others, so Slat_wf keeps one inverse and value per 
+unique occupation of each spin and multiplies them together for each 
+determinant.  With optimized orbitals, each determinant has its own 
+rotation, so nothing is shared.
+*/
+void Slat_wf_data::find_spin_strings() { 
+  spin_string.Resize(nfunc,ndet,2);
+  string_det.Resize(nfunc,2);
+  maxstrings=0;
+  for(int f=0; f< nfunc; f++) { 
+    for(int s=0; s< 2; s++) { 
+      map <vector <int>, int> found;
+      vector <int> firstdet;
+      for(int det=0; det < ndet; det++) { 
+        vector <int> occ(occupation(f,det,s).v,
+                         occupation(f,det,s).v+nelectrons(s));
+        map <vector <int>, int>::iterator it=found.find(occ);
+        if(optimize_mo || it==found.end()) { 
+          spin_string(f,det,s)=firstdet.size();
+          found[occ]=firstdet.size();
+          firstdet.push_back(det);
+        }
+        else spin_string(f,det,s)=it->second;
+      }
+      string_det(f,s).Resize(firstdet.size());
+      for(unsigned int i=0; i< firstdet.size(); i++) 
+        string_det(f,s)(i)=firstdet[i];
+      maxstrings=max(maxstrings,int(firstdet.size()));
+    }
+  }
+}
+
+//----------------------------------------------------------------------
+
 void Slat_wf_data::init_mo() {
   Array1 <int> nmospin(2);
   nmospin=0;
@@ -400,8 +470,13 @@ int Slat_wf_data::showinfo(ostream & os)
 
   if(optimize_mo) 
     os << "Optimizing molecular orbital coefficients" << endl;
-  if(ndet > 1) 
+  if(ndet > 1) { 
     os << ndet << " determinants\n";
+    for(int f=0; f< nfunc; f++) 
+      os << "Unique occupations for function " << f << ": " 
+         << string_det(f,0).GetDim(0) << " up, " 
+         << string_det(f,1).GetDim(0) << " down\n";
+  }
   else
     os << "1 determinant" << endl;
 
@@ -409,6 +484,12 @@ int Slat_wf_data::showinfo(ostream & os)
     os << "Using fast updates for multideterminants.  Reference: \n";
     os << "Clark, Morales, McMinis, Kim, and Scuseria. J. Chem. Phys. 135 244105 (2011)\n";
   }
+  if(single_inverse) { 
+    os << "Single precision inverses, recomputed in double precision every ";
+    if(refresh_inverse > 0) os << refresh_inverse;
+    else os << "4*(number of electrons)";
+    os << " updates or when the error is over " << inverse_tolerance << endl;
+  }
 
   for(int f=0; f< nfunc; f++) {
     if(nfunc > 1)
@@ -455,6 +536,14 @@ int Slat_wf_data::writeinput(string & indent, ostream & os) {
     os << indent << "CLARK_UPDATES" << endl;
   else 
     os << indent << "SHERMAN_MORRISON_UPDATES" << endl;
+  if(delayed_updates > 0)
+    os << indent << "DELAYED_UPDATES " << delayed_updates << endl;
+  if(single_inverse) { 
+    os << indent << "SINGLE_PRECISION_INVERSE" << endl;
+    if(refresh_inverse > 0) 
+      os << indent << "REFRESH_INVERSE " << refresh_inverse << endl;
+    os << indent << "INVERSE_TOLERANCE " << inverse_tolerance << endl;
+  }
   if(!sort)
     os << indent << "NOSORT" << endl;
 
@@ -132,6 +132,7 @@ public:
 
 private:
   void init_mo();
+  void find_spin_strings();
   friend class Slat_wf<doublevar>;
   friend class Slat_wf<dcomplex>;
   friend class Cslat_wf;
@@ -141,6 +142,11 @@ private:
   Array3 < Array1 <int> > occupation_orig;
   //!< The molecular orbitals numbers for (function, determinant, spin)
   Array1 <log_value<doublevar> > detwt;
+  Array3 <int> spin_string;
+  //!< (function, determinant, spin) which unique occupation of that spin the determinant uses; see find_spin_strings()
+  Array2 < Array1 <int> > string_det;
+  //!< (function, spin)(string) the first determinant with each unique occupation
+  int maxstrings; //!< the most unique occupations of any (function, spin)
   Array1 < Array1 <int> > totoccupation; //!< all the molecular orbitals for a given spin
 
   int max_occupation_changes;
@@ -164,6 +170,17 @@ private:
   MO_matrix * molecorb;
   int use_complexmo;
   bool use_clark_updates; //!<Use Bryan Clark's updates.
+  //! How many accepted moves Sherman-Morrison holds before updating the 
+  //! inverses; -1 for the default
+  int delayed_updates;
+  //! Keep the Sherman-Morrison inverses in single precision; the orbital
+  //! values stay in double precision
+  int single_inverse;
+  //! Recompute single precision inverses in double precision after this 
+  //! many updates; -1 for the default
+  int refresh_inverse;
+  //! ..or when an electron's ratio with itself is off from 1 by this much
+  doublevar inverse_tolerance;
   Excitation_list excitations;
   Complex_MO_matrix * cmolecorb;
   Orbital_rotation * orbrot;
@@ -219,6 +219,76 @@ public:
   virtual void restoreUpdate(Sample_point *, int e1, int e2, Wavefunction_storage *)
   {error("This Wavefunction object doesn't have two electron storage");}
 
+  /*!
+    \brief
+    Electron e has been moved in the sample since the last updateLap().
+    Return in lap what getLap() would give for it at the new position, 
+    without changing the state of the wave function, so that a rejected
+    move costs nothing to undo.  Must be followed by acceptMove() or 
+    rejectMove() before anything else is done with the wave function.
+
+    Only available if the Wavefunction_data supports(move_proposal).
+   */
+  virtual void proposeLap(Wavefunction_data *, Sample_point *, int e,
+                          Wf_return & lap)
+  {error("This Wavefunction object doesn't support move proposals");}
+
+  /*!
+    \brief
+    Make the move given to proposeLap() part of the state.
+   */
+  virtual void acceptMove(Wavefunction_data *, Sample_point *, int e)
+  {error("This Wavefunction object doesn't support move proposals");}
+
+  /*!
+    \brief
+    Forget the move given to proposeLap().  The sample must already be
+    back at the old position, without a notify() (Sample_point::restoreUpdate()).
+   */
+  virtual void rejectMove(Sample_point *, int e)
+  {error("This Wavefunction object doesn't support move proposals");}
+
+  /*!
+    \brief
+    The wave function with electron e moved to each of the positions
+    pos(k,0..2), as ratios to its current value: amp(w,0) is the log of 
+    the magnitude of the ratio and phase(w,0) its phase.  Neither the 
+    sample nor the value of the wave function changes, and the wave 
+    function must be up to date (updateVal()).
+
+    The electron is moved with setElectronPosNoNotify() and put back the
+    same way, so its distances are left stale; the caller can keep them 
+    with Sample_point::saveUpdate() and restoreUpdate().  Any factor that 
+    Sample_point::translateElectron() would have put into the overall 
+    sign or phase is also up to the caller.
+    Only available if the Wavefunction_data supports(test_ratios).
+   */
+  virtual void testRatios(Wavefunction_data *, Sample_point *, int e,
+                          const Array2 <doublevar> & pos, 
+                          Array1 <Wf_return> & ratio)
+  {error("This Wavefunction object doesn't support test ratios");}
+
+  /*!
+    \brief
+    Save the complete state of the wave function for the sample it is
+    attached to, so that it can be put back with restoreState()
+    instead of recalculating everything with updateLap().
+
+    wfstate is allocated if it is NULL.  Returns the approximate number 
+    of bytes stored, or zero if the wave function doesn't support this,
+    in which case the caller has to recalculate.
+   */
+  virtual int saveState(Wavefunction_storage * & wfstate) 
+  { return 0; } 
+
+  /*!
+    \brief
+    Restore a state saved by saveState().  The sample must already be 
+    back at the positions it had when the state was saved.
+   */
+  virtual void restoreState(Wavefunction_storage * wfstate) 
+  {error("This Wavefunction object doesn't support restoreState");}
+
 
   /*! \brief
     Plots 1d functions from inside the wave function, e.g. constituents
@@ -315,6 +385,11 @@ public:
   {
     sample->restoreUpdate(e, sampStore);
   }  
+  //! Only the sample, for Wavefunction::proposeLap() and testRatios()
+  void saveUpdate(Sample_point * sample, int e)
+  {
+    sample->saveUpdate(e, sampStore);
+  }
 
 
 
@@ -30,7 +30,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
  \brief 
  Query whether a particular wave function supports various features.
  */
-enum wf_support_type { laplacian_update, density, parameter_derivatives };
+enum wf_support_type { laplacian_update, density, parameter_derivatives,
+                       move_proposal, test_ratios };
 
 /*!
 \brief
@@ -19,6 +19,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "clark_updates.h"
+#include <map>
+#include <algorithm>
 void Excitation_list::build_excitation_list(Array3 <Array1 <int> > & occupation,int f) { //(function,det,spin) (orb #)
   int ndet=occupation.GetDim(1);
   int ns=occupation.GetDim(2);
@@ -106,68 +108,83 @@ void Excitation_list::build_excitation_list(Array3 <Array1 <int> > & occupation,
   }
 
 
-  //Now we build some of the lookup variables
+  //Now we build the lookup tables for each spin
   int nex=excitations.GetDim(0);
-  alle.resize(ns);
-  allg.resize(ns);
-  for(int e=0; e< nex; e++) { 
-    for(int s=0; s< ns; s++) {  
-      for(int i=0; i< excitations(e).g(s).GetDim(0); i++) { 
-        int g=excitations(e).g(s)(i);
-        bool found=false;
-        for(vector<int>::iterator gi=allg[s].begin(); gi!=allg[s].end(); gi++) {
-          if(g==*gi) {
-            found=true;
-            break;
-          }
-        }
-        if(!found) allg[s].push_back(g);
-        int ex=excitations(e).e(s)(i);
-        found=false;
-        for(vector<int>::iterator ei=alle[s].begin(); ei!=alle[s].end(); ei++) {
-          if(ex==*ei) {
-            found=true;
-            break;
-          }
+  spins.Resize(ns);
+  for(int s=0; s< ns; s++) { 
+    Spin_excitations & sp=spins(s);
+    sp.occ=occupation(0,base,s);
+    vector <int> holes, particles;
+    for(int d=0; d< nex; d++) { 
+      for(int i=0; i< excitations(d).g(s).GetDim(0); i++) { 
+        int g=excitations(d).g(s)(i);
+        if(find(holes.begin(),holes.end(),g)==holes.end()) holes.push_back(g);
+        int e=excitations(d).e(s)(i);
+        if(find(particles.begin(),particles.end(),e)==particles.end()) 
+          particles.push_back(e);
+      }
+    }
+    
+    //The rows of the table are ordered with the holes first
+    sp.nholes=holes.size();
+    sp.row_order.Resize(nspin(s));
+    vector <int> isrow(nspin(s),0);
+    int row=0;
+    for(int h=0; h< sp.nholes; h++) { 
+      for(int j=0; j< nspin(s); j++) { 
+        if(sp.occ(j)==holes[h]) { 
+          sp.row_order(row++)=j;
+          isrow[j]=1;
+          break;
         }
-        if(!found) alle[s].push_back(ex);
       }
     }
-  }
-
-  
-
-  //Array1 <Excitation> remap(nex);
-  remap.Resize(nex);
-  for(int e=0; e< nex; e++) { 
-    remap(e).g.Resize(ns);
-    remap(e).e.Resize(ns);
-    for(int s=0; s< ns; s++) {
-      int n=excitations(e).g(s).GetDim(0);
-
-      remap(e).g(s).Resize(n);
-      remap(e).e(s).Resize(n);
-
-      int ng=allg[s].size();
-      int ne=alle[s].size();
+    for(int j=0; j< nspin(s); j++) 
+      if(!isrow[j]) sp.row_order(row++)=j;
+    sp.particles.Resize(particles.size());
+    for(unsigned int i=0; i< particles.size(); i++) sp.particles(i)=particles[i];
+    
+    //Find the unique excitations of this spin, in terms of table rows and columns
+    map <pair <vector <int>, vector <int> >, int> unique;
+    vector <vector <pair <vector <int>, vector <int> > > > byrank(1);
+    byrank[0].push_back(pair <vector <int>, vector <int> >());
+    sp.det_rank.Resize(nex);
+    sp.det_idx.Resize(nex);
+    for(int d=0; d< nex; d++) { 
+      int n=excitations(d).g(s).GetDim(0);
+      pair <vector <int>, vector <int> > ex;
       for(int i=0; i< n; i++) { 
-        for(int j=0; j< ng; j++) { 
-          if(allg[s][j]==excitations(e).g(s)(i)) {
-            remap(e).g(s)(i)=j;
-            break;
-          }
-        }
-        for(int j=0; j< ne; j++) { 
-          if(alle[s][j]==excitations(e).e(s)(i)) { 
-            remap(e).e(s)(i)=j;
-            break;
-          }
+        ex.first.push_back(find(holes.begin(),holes.end(),excitations(d).g(s)(i))-holes.begin());
+        ex.second.push_back(find(particles.begin(),particles.end(),excitations(d).e(s)(i))-particles.begin());
+      }
+      sp.det_rank(d)=n;
+      if(n==0) { 
+        sp.det_idx(d)=0;
+        continue;
+      }
+      map <pair <vector <int>, vector <int> >, int>::iterator u=unique.find(ex);
+      if(u!=unique.end()) { 
+        sp.det_idx(d)=u->second;
+        continue;
+      }
+      if(int(byrank.size()) <= n) byrank.resize(n+1);
+      sp.det_idx(d)=byrank[n].size();
+      unique[ex]=byrank[n].size();
+      byrank[n].push_back(ex);
+    }
+    int maxrank=byrank.size()-1;
+    sp.hole_idx.Resize(maxrank+1);
+    sp.part_idx.Resize(maxrank+1);
+    for(int r=0; r<= maxrank; r++) { 
+      int n=byrank[r].size();
+      sp.hole_idx(r).Resize(n,r);
+      sp.part_idx(r).Resize(n,r);
+      for(int i=0; i< n; i++) { 
+        for(int j=0; j< r; j++) { 
+          sp.hole_idx(r)(i,j)=byrank[r][i].first[j];
+          sp.part_idx(r)(i,j)=byrank[r][i].second[j];
         }
       }
     }
   }
-
-  
 }
-
-
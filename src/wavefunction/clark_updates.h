@@ -31,86 +31,209 @@ struct Excitation {
   Array1 <int> sign;  //Sign of the permutation compared to the input orbital ordering
 };
 
+/*!
+The excitations of one spin channel, relative to the reference 
+determinant, in the form used by the table method.
+*/
+struct Spin_excitations { 
+  Array1 <int> occ; //!< reference occupation (orbital numbers)
+  Array1 <int> particles; //!< all orbitals that some excitation adds
+  int nholes; //!< number of orbitals that some excitation removes
+  //! positions in occ of the table rows; the first nholes are the holes
+  Array1 <int> row_order; 
+  //! The unique excitations, grouped by rank.  hole_idx(r)(i,j) and 
+  //! part_idx(r)(i,j) are the table row and column of the j'th hole and 
+  //! particle of the i'th excitation of rank r.
+  Array1 <Array2 <int> > hole_idx, part_idx;
+  //! (det) the rank and number within that rank of its excitation
+  Array1 <int> det_rank, det_idx;
+};
+
+/*!
+\brief
+Multideterminant ratios by the table method of 
+Clark, Morales, McMinis, Kim, and Scuseria. J. Chem. Phys. 135 244105 (2011).
+
+For each spin we keep a table \f$ T = A^{-1} M \f$, where A is the 
+Slater matrix of the reference determinant and M has the values of the 
+orbitals that the excitations add.  The ratio of an excited determinant 
+to the reference is the determinant of the rows of T for its holes and 
+the columns for its particles.  When one electron moves, T changes by 
+a rank-1 update, so it is never rebuilt during a run.  Each unique 
+excitation of a spin channel is evaluated once, so the cost does not 
+depend on how many determinants share it.
+
+The inverse is the transposed inverse kept by Slat_wf, and M has a row 
+for each electron of the spin and a column for every orbital.
+*/
 class Excitation_list { 
   public:
      void build_excitation_list(Array3 <Array1 <int> > & occupation,int f);//(function,det,spin) (orb #) )
-     template <class T> void clark_updates(Array2 <T> & ginv, Array2 <T> & M,
-         int s, Array1 <T> & ratios);
+     
+     //! Number of rows and columns of the table for spin s
+     int tableRows(int s) { return spins(s).row_order.GetDim(0); } 
+     int tableCols(int s) { return spins(s).particles.GetDim(0); } 
+     
+     //! Build the table from scratch.
+     template <class T> void buildTable(Array2 <T> & inverse, Array2 <T> & M, 
+         int s, Array2 <T> & table);
+     /*!
+       Update the table after electron k of spin s has moved; newrow has 
+       its orbital values at the new position and inverse has already 
+       been updated.
+      */
+     template <class T> void updateTable(Array2 <T> & inverse, Array1 <T> & newrow,
+         int k, int s, Array2 <T> & table);
+     //! Ratios of the determinants to the reference for spin s
+     template <class T> void tableRatios(Array2 <T> & table, int s, Array1 <T> & ratios);
+     /*!
+       The ratios if row k of the Slater matrix were replaced by newrow
+       (which can also be a derivative of the orbitals).  Returns the 
+       ratio of the new reference determinant to the old one, and ratios
+       are relative to the new reference.  Nothing is changed.
+      */
+     template <class T> T testRatios(Array2 <T> & inverse, Array2 <T> & table,
+         Array1 <T> & newrow, int k, int s, Array1 <T> & ratios);
   private:
+     template <class T> void subtableRatios(Array2 <T> & tab, int s, Array1 <T> & ratios);
+     //! w=newrow(particles)-newrow(occ)^T table
+     template <class T> void rowCorrection(Array2 <T> & table, Array1 <T> & newrow, 
+         int s, Array1 <T> & w);
      Array1 <Excitation> excitations;
-     Array1 <Excitation> remap;
-     vector <vector <int> > allg,alle;
+     Array1 <Spin_excitations> spins;
 };
 
 //---------
 
-template <class T> void Excitation_list::clark_updates(Array2 <T> & ginv, Array2 <T> & M,
-     int s, Array1 <T> & ratios) { 
+template <class T> void Excitation_list::buildTable(Array2 <T> & inverse, 
+    Array2 <T> & M, int s, Array2 <T> & table) { 
+  Spin_excitations & sp=spins(s);
   int ne=M.GetDim(0);
-  int nex=excitations.GetDim(0);
-
-  Array2 <T>  tmat,detmat;
-
-  tmat.Resize(allg[s].size(),alle[s].size());
-  int counti=0;
-  for(vector<int>::iterator gi=allg[s].begin(); gi!=allg[s].end(); gi++) { 
-    int countj=0;
-    for(vector <int>::iterator ei=alle[s].begin(); ei!=alle[s].end(); ei++) { 
-      int i=*gi;
-      int j=*ei;
+  int nrow=sp.row_order.GetDim(0);
+  int ncol=sp.particles.GetDim(0);
+  table.Resize(nrow,ncol);
+  for(int i=0; i< nrow; i++) { 
+    int g=sp.row_order(i);
+    for(int c=0; c< ncol; c++) { 
+      int j=sp.particles(c);
       T dot=0.0;
-      for(int e=0; e< ne; e++) {
-        dot+=ginv(e,i)*M(e,j);
-      }
-//      cout << "tmat " << i << " " << j << " : " << dot << endl;
-      tmat(counti,countj)=dot;
-      countj++;
+      for(int e=0; e< ne; e++) 
+        dot+=inverse(e,g)*M(e,j);
+      table(i,c)=dot;
     }
-    counti++;
   }
-    
-  ratios.Resize(nex);
-  ratios=T(1.0);
+}
+
+//---------
+
+template <class T> void Excitation_list::rowCorrection(Array2 <T> & table, 
+    Array1 <T> & newrow, int s, Array1 <T> & w) { 
+  Spin_excitations & sp=spins(s);
+  int nrow=sp.row_order.GetDim(0);
+  int ncol=sp.particles.GetDim(0);
+  w.Resize(ncol);
+  for(int c=0; c< ncol; c++) w(c)=newrow(sp.particles(c));
+  for(int i=0; i< nrow; i++) { 
+    T a=newrow(sp.occ(sp.row_order(i)));
+    T * trow=table.v+i*ncol;
+    for(int c=0; c< ncol; c++) w(c)-=a*trow[c];
+  }
+}
+
+//---------
+
+template <class T> void Excitation_list::updateTable(Array2 <T> & inverse, 
+    Array1 <T> & newrow, int k, int s, Array2 <T> & table) { 
+  Spin_excitations & sp=spins(s);
+  int nrow=sp.row_order.GetDim(0);
+  int ncol=sp.particles.GetDim(0);
+  Array1 <T> w;
+  rowCorrection(table,newrow,s,w);
+  for(int i=0; i< nrow; i++) { 
+    T c=inverse(k,sp.row_order(i));
+    T * trow=table.v+i*ncol;
+    for(int j=0; j< ncol; j++) trow[j]+=c*w(j);
+  }
+}
+
+//---------
+
+template <class T> void Excitation_list::tableRatios(Array2 <T> & table, 
+    int s, Array1 <T> & ratios) { 
+  subtableRatios(table,s,ratios);
+}
+
+//---------
+
+template <class T> T Excitation_list::testRatios(Array2 <T> & inverse, 
+    Array2 <T> & table, Array1 <T> & newrow, int k, int s, Array1 <T> & ratios) { 
+  Spin_excitations & sp=spins(s);
+  int nocc=sp.occ.GetDim(0);
+  int ncol=sp.particles.GetDim(0);
+  T baseratio=0.0;
+  for(int j=0; j< nocc; j++) baseratio+=newrow(sp.occ(j))*inverse(k,j);
   
-  for(int ex=1; ex < nex; ex++) { 
-    Array1 <int> & g=remap(ex).g(s);
-    Array1 <int> & e=remap(ex).e(s);
-    int n=excitations(ex).g(s).GetDim(0);
-    switch(n) { 
-      case 0:
-        break;
-      case 1:
-        ratios(ex)=T(excitations(ex).sign(s))*tmat(g(0),e(0));
-        break;
-      case 2:
-        ratios(ex)=T(excitations(ex).sign(s))* (tmat(g(0),e(0))*tmat(g(1),e(1))
-              - tmat(g(1),e(0))*tmat(g(0),e(1)));
-        break;
-      default:
-        detmat.Resize(n,n);
-        for(int i=0; i < n; i++ ) { 
-          for(int j=0; j < n; j++) { 
-            detmat(i,j)=tmat(g(i),e(j));
-          }
-        }
-        ratios(ex)=Determinant(detmat,n)*T(excitations(ex).sign(s));
-        break;
+  Array1 <T> w;
+  rowCorrection(table,newrow,s,w);
+  //Only the rows of the holes are needed for the ratios
+  Array2 <T> tab(sp.nholes,ncol);
+  for(int i=0; i< sp.nholes; i++) { 
+    T c=inverse(k,sp.row_order(i))/baseratio;
+    for(int j=0; j< ncol; j++) tab(i,j)=table(i,j)+c*w(j);
+  }
+  subtableRatios(tab,s,ratios);
+  return baseratio;
+}
+
+//---------
+
+//Only the first nholes rows of tab are used.
+template <class T> void Excitation_list::subtableRatios(Array2 <T> & tab, 
+    int s, Array1 <T> & ratios) { 
+  Spin_excitations & sp=spins(s);
+  int maxrank=sp.hole_idx.GetDim(0)-1;
+  Array1 <Array1 <T> > uratios(maxrank+1);
+  uratios(0).Resize(1);
+  uratios(0)(0)=1.0;
+  if(maxrank >= 1) { 
+    Array2 <int> & g=sp.hole_idx(1);
+    Array2 <int> & e=sp.part_idx(1);
+    int n=g.GetDim(0);
+    Array1 <T> & r=uratios(1);
+    r.Resize(n);
+    for(int i=0; i< n; i++) 
+      r(i)=tab(g(i,0),e(i,0));
+  }
+  if(maxrank >= 2) { 
+    Array2 <int> & g=sp.hole_idx(2);
+    Array2 <int> & e=sp.part_idx(2);
+    int n=g.GetDim(0);
+    Array1 <T> & r=uratios(2);
+    r.Resize(n);
+    for(int i=0; i< n; i++) 
+      r(i)=tab(g(i,0),e(i,0))*tab(g(i,1),e(i,1))
+          -tab(g(i,1),e(i,0))*tab(g(i,0),e(i,1));
+  }
+  Array2 <T> detmat;
+  for(int rank=3; rank <= maxrank; rank++) { 
+    Array2 <int> & g=sp.hole_idx(rank);
+    Array2 <int> & e=sp.part_idx(rank);
+    int n=g.GetDim(0);
+    Array1 <T> & r=uratios(rank);
+    r.Resize(n);
+    detmat.Resize(rank,rank);
+    for(int i=0; i< n; i++) { 
+      for(int a=0; a< rank; a++) 
+        for(int b=0; b< rank; b++) 
+          detmat(a,b)=tab(g(i,a),e(i,b));
+      r(i)=Determinant(detmat,rank);
     }
-    //if(n==0) { }  //do nothing
-    //else if(n==1) { 
-    //  ratios(ex)=T(excitations(ex).sign(s))*tmat(g(0),e(0));
-    //}
-    //else  { 
-    //  detmat.Resize(n,n);
-    //  for(int i=0; i < n; i++ ) { 
-    //    for(int j=0; j < n; j++) { 
-    //      detmat(i,j)=tmat(g(i),e(j));
-    //    }
-    //  }
-    //  ratios(ex)=Determinant(detmat,n)*T(excitations(ex).sign(s));
-    //}
   }
 
+  int ndet=sp.det_rank.GetDim(0);
+  ratios.Resize(ndet);
+  for(int d=0; d< ndet; d++) 
+    ratios(d)=T(excitations(d).sign(s))*uratios(sp.det_rank(d))(sp.det_idx(d));
 }
 
 //--------
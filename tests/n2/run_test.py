@@ -47,6 +47,64 @@ for k,v in success.items():
 
 reports.extend(summarize_results(ref_data,dat_properties,success,systems,methods,descriptions))
 
+print("""###########################################
+Comparing the determinant update schemes to Sherman-Morrison updates along 
+the same random walk, and the backflow updates to recomputing from scratch.
+Each value, gradient, laplacian, and nonlocal energy must agree to within 
+the tolerance of the scheme.  The batched orbital evaluations are compared 
+to evaluating one point at a time.
+################################################""")
+
+#Close to a node the differences grow; the largest seen are about 1e-10 for 
+#Clark updates, 1e-6 for delayed updates and 5e-3 for single precision.
+compare_tolerances={'clark':1e-8,
+                    'delay':1e-5,
+                    'single':1e-2,
+                    'bf':1e-8,
+                    'batch':1e-10,
+                    }
+#Every quantity here must be reported, so that a test that stops printing 
+#one can't pass by not checking it.
+compare_quantities={'clark':['log value','gradient','laplacian','nonlocal energy'],
+                    'delay':['log value','gradient','laplacian','nonlocal energy'],
+                    'single':['log value','gradient','laplacian','nonlocal energy'],
+                    'bf':['log value','gradient','laplacian','nonlocal energy'],
+                    'batch':['batched values','batched laplacians','batched test positions'],
+                    }
+for name,tol in compare_tolerances.items():
+  out=subprocess.check_output([QW,'qw.'+name+'test']).decode()
+  found=set()
+  for line in out.split('\n'):
+    if not line.startswith('max difference in'):
+      continue
+    quantity=line[len('max difference in '):].rsplit(' ',1)[0]
+    found.add(quantity)
+    diff=float(line.split()[-1])
+    passed=abs(diff) < tol
+    allsuc.append(passed)
+    reports.append({'system':'n2',
+                    'method':'compare_'+name,
+                    'description':'Maximum difference in the '+quantity+' from the reference updates',
+                    'quantity':quantity,
+                    'result':diff,
+                    'error':0.0,
+                    'reference':0.0,
+                    'err_ref':tol,
+                    'passed':passed})
+  for quantity in compare_quantities.get(name,[]):
+    if quantity not in found:
+      print("qw."+name+"test didn't report the difference in the",quantity)
+      allsuc.append(False)
+      reports.append({'system':'n2',
+                      'method':'compare_'+name,
+                      'description':'Maximum difference in the '+quantity+' was not reported',
+                      'quantity':quantity,
+                      'result':float('nan'),
+                      'error':0.0,
+                      'reference':0.0,
+                      'err_ref':tol,
+                      'passed':False})
+
 print_results(reports)
 save_results(reports)
 
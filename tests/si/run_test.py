@@ -52,6 +52,39 @@ for bc in ['111','222']:
 
     reports.extend(summarize_results(ref_data[bc],dat_properties,success,systems,methods,descriptions))
 
+print("""###########################################
+Ewald sum with automatically chosen parameters.  The same short random walk
+as the version with fixed Ewald parameters should give the same energies.
+################################################""")
+
+#From the fixed parameters (alpha=5/smallest cell height, 706 g points)
+ewald_ref={'total_energy':-7.721934044,
+           'potential':-12.69649033,
+           }
+ewald_tol=1e-5
+fname='qw_111.ewald'
+for f in [fname+'.log',fname+'.config']:
+  try:
+    subprocess.check_output(['rm',f])
+  except:
+    pass
+subprocess.check_output([QW,fname])
+json_str=subprocess.check_output([GOS,'-json',fname+'.log'])
+dat_properties=json.loads(json_str)['properties']
+for k,ref in ewald_ref.items():
+  result=dat_properties[k]['value'][0]
+  passed=abs(result-ref) < ewald_tol
+  allsuc.append(passed)
+  reports.append({'system':'silicon',
+                  'method':'ewald',
+                  'description':'EWALD_TOLERANCE reproduces the energy with fixed Ewald parameters',
+                  'quantity':k,
+                  'result':result,
+                  'error':0.0,
+                  'reference':ref,
+                  'err_ref':ewald_tol,
+                  'passed':passed})
+
 print_results(reports)
 save_results(reports)
 